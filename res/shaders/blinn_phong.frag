@@ -1,43 +1,207 @@
 #version 330 core
 
+// Variant defines are injected after the version directive:
+// TEXTURED: modulate material color by the texture
+// NORMALS: interpolate vertex normals, otherwise faces are shaded flat
+// SPECULAR: add normalized Blinn-Phong specular
+// VIRTUAL_TEXTURE: sample the texture through the indirection table of a virtual texture
+// VIRTUAL_FEEDBACK: write the virtual texture page sampled by the fragment instead of its color
+// Virtual texture variants are textured
+
 #define PI     3.14159265358979323846
 #define INV_PI 0.31830988618379067154
 
+// Specular reflectance at normal incidence of dielectrics
+#define F0 0.04
+
 in vec3 P;   // Surface position
+in vec3 C;   // Material color
+
+#ifdef NORMALS
 in vec3 N;   // Surface normal
-in vec2 UV;  // Surface UV coordinate
+#endif
 
-// Surface material attributes
-uniform struct Material {
-    vec3 color;
-    float exponent;
-} material;
+#ifdef TEXTURED
+in vec2 UV;  // Surface UV coordinate
+#endif
 
-// Light attributes
-uniform struct Light {
-    vec3 position;
-    vec3 color;
-} light;
+#ifdef SPECULAR
+in float E;  // Material exponent
+#endif
 
-// Camera attributes
-uniform struct Camera {
-    vec3 position;
-} camera;
+// Per-frame parameters shared by all objects
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 clusterScale;
+    ivec4 clusterCounts;
+    vec4 cameraPosition;
+} frame;
 
+#ifdef TEXTURED
 uniform sampler2D image;
+#endif
+
+#ifdef VIRTUAL_TEXTURE
+// Slot column, slot row and level of the finest resident page covering every page,
+// one indirection level per page level
+uniform usampler2D indirection;
+
+// Physical atlas of resident pages with their borders
+uniform sampler2D atlas;
+
+// Image size over the padded virtual texture size, virtual texture size in pixels and coarsest level
+uniform vec4 virtualTexture;
+
+// Page size, page border and atlas slot size in pixels, level of detail bias
+uniform vec4 virtualPages;
+#endif
+
+// Point lights as two texels: position and radius, then color
+uniform samplerBuffer lights;
+
+// Offset and count of the light indices of every cluster
+uniform usamplerBuffer clusters;
+
+// Light indices of all clusters
+uniform usamplerBuffer lightIndices;
+
+// Get cluster of fragment from its window coordinate and view depth
+int getCluster() {
+    float depth = -(frame.view * vec4(P, 1.0f)).z;
+    
+    ivec3 cluster = ivec3(
+        ivec2(gl_FragCoord.xy * frame.clusterScale.xy),
+        int(floor(log(max(depth, 1e-6f)) * frame.clusterScale.z + frame.clusterScale.w)));
+    
+    cluster = clamp(cluster, ivec3(0), frame.clusterCounts.xyz - 1);
+    
+    return (cluster.z * frame.clusterCounts.y + cluster.y) * frame.clusterCounts.x + cluster.x;
+}
+
+#ifdef VIRTUAL_TEXTURE
+// Get level of detail of virtual texture coordinate from its screen space derivatives
+float getVirtualLevel(vec2 uv) {
+    vec2 dx = dFdx(uv) * virtualTexture.z;
+    vec2 dy = dFdy(uv) * virtualTexture.z;
+    
+    float lod = 0.5f * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-12f)) + virtualPages.w;
+    
+    return clamp(lod, 0.0f, virtualTexture.w);
+}
 
-// Lambert material implementation (diffuse)
+// Get page of virtual texture coordinate at level
+ivec2 getVirtualPage(vec2 uv, int level) {
+    ivec2 pageCount = textureSize(indirection, level);
+    
+    return clamp(ivec2(uv * vec2(pageCount)), ivec2(0), pageCount - 1);
+}
+
+// Sample level of virtual texture from the atlas, missing pages are replaced
+// by their finest resident ancestor
+vec3 sampleVirtualLevel(vec2 uv, int level) {
+    ivec2 page = getVirtualPage(uv, level);
+    uvec4 entry = texelFetch(indirection, page, level);
+    
+    // Position inside the resident page
+    int shift = int(entry.z) - level;
+    vec2 offset = clamp(uv * vec2(textureSize(indirection, level) >> shift) - vec2(page >> shift), 0.0f, 1.0f);
+    
+    vec2 texel = vec2(entry.xy) * virtualPages.z + virtualPages.y + offset * virtualPages.x;
+    
+    return textureLod(atlas, texel / vec2(textureSize(atlas, 0)), 0.0f).rgb;
+}
+
+// Sample virtual texture with trilinear filtering between the two nearest levels
+vec3 sampleVirtualTexture(vec2 uv, float lod) {
+    int level = int(lod);
+    
+    vec3 fine = sampleVirtualLevel(uv, level);
+    vec3 coarse = sampleVirtualLevel(uv, min(level + 1, int(virtualTexture.w)));
+    
+    return mix(fine, coarse, lod - float(level));
+}
+
+// Encode page of the finer level sampled by trilinear filtering in RGBA8
+vec4 encodeVirtualPage(vec2 uv, float lod) {
+    int level = int(lod);
+    ivec2 page = getVirtualPage(uv, level);
+    
+    return vec4(vec3(page & 255, (page.x >> 8) | ((page.y >> 8) << 4)), level + 1) / 255.0f;
+}
+#endif
+
+// Lambert material implementation (diffuse) with optional Blinn-Phong specular
 void main() {
+#ifdef NORMALS
+    vec3 n = normalize(N);
+#else
+    vec3 n = normalize(cross(dFdx(P), dFdy(P)));
+#endif
+    
+#ifdef TEXTURED
     vec2 uv = vec2(UV.x, -UV.y);
     
-    vec3 L = light.position - P;
-    float invD2 = 1.0f / dot(L, L);
+#ifdef VIRTUAL_TEXTURE
+    // Repeat the image inside the padded virtual texture,
+    // levels of detail follow the coordinates before wrapping
+    vec2 virtualUV = fract(uv) * virtualTexture.xy;
+    float lod = getVirtualLevel(uv * virtualTexture.xy);
+    
+#ifdef VIRTUAL_FEEDBACK
+    gl_FragColor = encodeVirtualPage(virtualUV, lod);
+    return;
+#endif
+    
+    vec3 albedo = C * sampleVirtualTexture(virtualUV, lod);
+#else
+    vec3 albedo = C * texture(image, uv).rgb;
+#endif
+#else
+    vec3 albedo = C;
+#endif
+    
+    vec3 brdf = albedo * INV_PI;
+    
+#ifdef SPECULAR
+    vec3 V = normalize(frame.cameraPosition.xyz - P);
+    
+    // Normalization keeps reflected energy constant across exponents
+    float normalization = (E + 8.0f) * INV_PI / 8.0f;
+#endif
     
-    L *= sqrt(invD2);
+    // Accumulate lights of fragment cluster only
+    uvec2 range = texelFetch(clusters, getCluster()).rg;
+    vec3 color = vec3(0.0f);
     
-    vec3 li = light.color * invD2;
-    vec3 brdf = material.color * texture(image, uv).rgb * INV_PI;
-    vec3 diffuse = brdf * li * max(dot(N, L), 0.0f);
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        
+        vec4 sphere = texelFetch(lights, light * 2);
+        vec3 lightColor = texelFetch(lights, light * 2 + 1).rgb;
+        
+        vec3 L = sphere.xyz - P;
+        float d2 = dot(L, L);
+        
+        // Inverse square falloff windowed to zero at the light radius
+        float ratio = d2 / (sphere.w * sphere.w);
+        float window = clamp(1.0f - ratio * ratio, 0.0f, 1.0f);
+        
+        L *= inversesqrt(d2);
+        
+        float cosTheta = max(dot(n, L), 0.0f);
+        
+        vec3 li = lightColor * window * window / d2;
+        vec3 f = brdf;
+        
+#ifdef SPECULAR
+        vec3 H = normalize(L + V);
+        f += vec3(F0 * normalization * pow(max(dot(n, H), 0.0f), E));
+#endif
+        
+        color += f * li * cosTheta;
+    }
     
-    gl_FragColor = vec4(diffuse, 1.0f); // Output color
+    gl_FragColor = vec4(color, 1.0f); // Output color
 }
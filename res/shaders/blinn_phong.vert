@@ -1,21 +1,89 @@
 #version 330 core
 
+// Variant defines are injected after the version directive:
+// TEXTURED: pass texture coordinates
+// NORMALS: pass vertex normals, otherwise the fragment shader shades faces flat
+// SPECULAR: pass the material exponent
+
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 textureCoordinate;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Per-instance affine model matrix rows and material color (exponent in w)
+layout(location = 3) in vec4 modelRow0;
+layout(location = 4) in vec4 modelRow1;
+layout(location = 5) in vec4 modelRow2;
+layout(location = 6) in vec4 materialColor;
+
+// Per-frame parameters shared by all objects
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 clusterScale;
+    ivec4 clusterCounts;
+    vec4 cameraPosition;
+} frame;
+
+// Per-mesh parameters decoding vertices, objects are placed by their instance matrix
+// Normals are octahedral encoded in the first two components when vertices are quantized
+layout(std140) uniform Mesh {
+    mat4 dequantization;
+    bool octahedralNormals;
+} mesh;
 
 out vec3 P;
+out vec3 C;
+
+#ifdef NORMALS
 out vec3 N;
+#endif
+
+#ifdef TEXTURED
 out vec2 UV;
+#endif
+
+#ifdef SPECULAR
+out float E;
+#endif
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    
+    return normalize(n);
+}
 
 void main() {
-    P = (model * vec4(position, 1.0f)).xyz;
-    N = normalize((transpose(inverse(model)) * vec4(normal, 0.0f)).xyz);
+    vec4 p = mesh.dequantization * vec4(position, 1.0f);
+    
+    P = vec3(dot(modelRow0, p), dot(modelRow1, p), dot(modelRow2, p));
+    C = materialColor.rgb;
+    
+#ifdef NORMALS
+    vec3 n = mesh.octahedralNormals ? decodeOctahedral(normal.xy) : normal;
+    
+    // Transform normal by the cofactor matrix, the inverse transpose up to its determinant
+    vec3 a0 = modelRow0.xyz;
+    vec3 a1 = modelRow1.xyz;
+    vec3 a2 = modelRow2.xyz;
+    
+    vec3 c0 = cross(a1, a2);
+    float determinantSign = dot(a0, c0) < 0.0f ? -1.0f : 1.0f;
+    
+    N = normalize(n * mat3(c0, cross(a2, a0), cross(a0, a1)) * determinantSign);
+#endif
+    
+#ifdef TEXTURED
     UV = textureCoordinate;
+#endif
+    
+#ifdef SPECULAR
+    E = materialColor.w;
+#endif
     
-    gl_Position = projection * view * vec4(P, 1.0f);
+    gl_Position = frame.viewProjection * vec4(P, 1.0f);
 }
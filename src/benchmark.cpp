@@ -0,0 +1,144 @@
+#include "benchmark.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+const float TWO_PI = 6.28318530717958647692f;
+
+// Camera distance range relative to the distance fitting the bounding sphere
+const float MIN_DISTANCE_SCALE = 1.25f;
+const float MAX_DISTANCE_SCALE = 4.0f;
+
+// Number of times the camera moves in and out along the path
+const float DOLLY_CYCLES = 2.0f;
+
+double getPercentile(const std::vector<double> & sortedSamples, double percentile) {
+    size_t rank = (size_t)std::ceil(percentile / 100.0 * sortedSamples.size());
+    return sortedSamples[std::max(rank, (size_t)1) - 1];
+}
+
+std::string escapeJson(const std::string & value) {
+    std::string result;
+
+    for (size_t i = 0; i < value.size(); i++) {
+        char c = value[i];
+
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        }
+        else if ((unsigned char)c < 0x20) {
+            const char digits[] = "0123456789abcdef";
+
+            result += "\\u00";
+            result += digits[(c >> 4) & 0xF];
+            result += digits[c & 0xF];
+        }
+        else
+            result += c;
+    }
+
+    return result;
+}
+
+void formatStatistics(std::ostringstream & stream, const char * name, const BenchmarkStatistics & statistics) {
+    stream << "  \"" << name << "\": { "
+        << "\"mean\": " << statistics.mean << ", "
+        << "\"p50\": " << statistics.p50 << ", "
+        << "\"p95\": " << statistics.p95 << ", "
+        << "\"p99\": " << statistics.p99 << " }";
+}
+
+}
+
+void computeBenchmarkStatistics(const std::vector<double> & samples, BenchmarkStatistics & statistics) {
+    if (samples.empty()) {
+        statistics.mean = statistics.p50 = statistics.p95 = statistics.p99 = 0.0;
+        return;
+    }
+
+    std::vector<double> sortedSamples(samples);
+    std::sort(sortedSamples.begin(), sortedSamples.end());
+
+    double sum = 0.0;
+
+    for (size_t i = 0; i < sortedSamples.size(); i++)
+        sum += sortedSamples[i];
+
+    statistics.mean = sum / sortedSamples.size();
+    statistics.p50 = getPercentile(sortedSamples, 50.0);
+    statistics.p95 = getPercentile(sortedSamples, 95.0);
+    statistics.p99 = getPercentile(sortedSamples, 99.0);
+}
+
+void getBenchmarkFrame(
+        size_t frame,
+        size_t frameCount,
+        const BoundingBox & bounds,
+        const glm::mat4 & projection,
+        glm::mat4 & model,
+        glm::vec3 & camera) {
+    float t = frameCount > 0 ? (float)frame / frameCount : 0.0f;
+
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+
+    // Distance where the sphere fits the narrower field of view
+    float focalLength = std::max(std::fabs(projection[0][0]), std::fabs(projection[1][1]));
+    float fitDistance = radius * std::sqrt(1.0f + focalLength * focalLength);
+
+    float dolly = 0.5f - 0.5f * std::cos(TWO_PI * DOLLY_CYCLES * t);
+    float distance = fitDistance * (MIN_DISTANCE_SCALE + (MAX_DISTANCE_SCALE - MIN_DISTANCE_SCALE) * dolly);
+
+    model = glm::rotate(glm::mat4(1.0f), TWO_PI * t, glm::vec3(0.0f, 1.0f, 0.0f))
+        * glm::translate(glm::mat4(1.0f), -center);
+
+    camera = glm::vec3(distance, 0.0f, 0.0f);
+}
+
+std::string formatBenchmarkReport(const BenchmarkReport & report) {
+    // Triangles per second of each frame from its CPU frame time
+    std::vector<double> triangleRates(report.cpuTimes.size(), 0.0);
+
+    for (size_t i = 0; i < triangleRates.size(); i++) {
+        if (report.cpuTimes[i] > 0.0)
+            triangleRates[i] = report.triangleCounts[i] / (report.cpuTimes[i] * 1e-3);
+    }
+
+    BenchmarkStatistics cpuStatistics, gpuStatistics, triangleStatistics;
+    computeBenchmarkStatistics(report.cpuTimes, cpuStatistics);
+    computeBenchmarkStatistics(report.gpuTimes, gpuStatistics);
+    computeBenchmarkStatistics(triangleRates, triangleStatistics);
+
+    std::ostringstream stream;
+    stream.precision(6);
+
+    stream << "{\n"
+        << "  \"mesh\": \"" << escapeJson(report.meshFilename) << "\",\n"
+        << "  \"texture\": \"" << escapeJson(report.imageFilename) << "\",\n"
+        << "  \"renderer\": \"" << escapeJson(report.renderer) << "\",\n"
+        << "  \"vertexFormat\": \"" << escapeJson(report.vertexFormat) << "\",\n"
+        << "  \"width\": " << report.width << ",\n"
+        << "  \"height\": " << report.height << ",\n"
+        << "  \"instances\": " << report.instanceCount << ",\n"
+        << "  \"lights\": " << report.lightCount << ",\n"
+        << "  \"warmupFrames\": " << BENCHMARK_WARMUP_FRAMES << ",\n"
+        << "  \"frames\": " << report.cpuTimes.size() << ",\n";
+
+    formatStatistics(stream, "cpuFrameTimeMs", cpuStatistics);
+    stream << ",\n";
+
+    formatStatistics(stream, "gpuTimeMs", gpuStatistics);
+    stream << ",\n";
+
+    formatStatistics(stream, "trianglesPerSecond", triangleStatistics);
+    stream << "\n}\n";
+
+    return stream.str();
+}
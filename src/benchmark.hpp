@@ -0,0 +1,59 @@
+#ifndef CG20192_BENCHMARK_HPP
+#define CG20192_BENCHMARK_HPP
+
+#include "mesh.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <string>
+#include <vector>
+
+// Frames rendered at the start of the path before samples are recorded
+const size_t BENCHMARK_WARMUP_FRAMES = 10;
+
+// Mean and nearest-rank percentiles of per-frame samples
+struct BenchmarkStatistics {
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+};
+
+// Benchmark run description and per-frame samples after warmup
+// Times are in milliseconds and GPU times are empty when not measured
+// Instance count is zero when a single mesh is drawn
+// Light count includes the default light drawn when the scene has no lights
+struct BenchmarkReport {
+    std::string meshFilename;
+    std::string imageFilename;
+    std::string renderer;
+    std::string vertexFormat;
+    size_t width;
+    size_t height;
+    size_t instanceCount;
+    size_t lightCount;
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    std::vector<double> triangleCounts;
+};
+
+// Compute statistics of samples, all zero when there are no samples
+void computeBenchmarkStatistics(const std::vector<double> & samples, BenchmarkStatistics & statistics);
+
+// Get model matrix and camera position of frame on the benchmark path
+// The model turns once around the vertical axis while the camera moves between
+// 1.25 and 4 times the distance that fits the mesh bounding sphere, crossing levels of detail
+// The path depends only on the frame index, so every run renders the same frames
+void getBenchmarkFrame(
+        size_t frame,
+        size_t frameCount,
+        const BoundingBox & bounds,
+        const glm::mat4 & projection,
+        glm::mat4 & model,
+        glm::vec3 & camera);
+
+// Format report as JSON with CPU frame time, GPU time and triangles per second statistics
+std::string formatBenchmarkReport(const BenchmarkReport & report);
+
+#endif
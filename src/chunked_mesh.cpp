@@ -0,0 +1,327 @@
+#include "chunked_mesh.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+// File identification and format version
+const char CHUNKED_MESH_MAGIC[8] = { 'C', 'G', 'C', 'H', 'U', 'N', 'K', '\0' };
+const uint32_t CHUNKED_MESH_VERSION = 1;
+
+// Extension of chunked mesh files and separator of the chunk index in chunk filenames
+const char * const CHUNKED_MESH_EXTENSION = ".cgchunks";
+const char CHUNK_INDEX_SEPARATOR = '#';
+
+// Alignment of data blocks inside the file
+const uint64_t CHUNKED_MESH_ALIGNMENT = 16;
+
+// Chunked mesh file header, stored in native byte order
+struct ChunkedMeshHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexSize;
+
+    uint64_t chunkCount;
+    uint64_t chunkOffset;
+
+    float boundsMin[3];
+    float boundsMax[3];
+
+    uint32_t meshletSize;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ChunkedMeshHeader) == 64, "Unexpected chunked mesh header padding");
+
+// Chunk table entry
+struct ChunkedMeshEntry {
+    float boundsMin[3];
+    float boundsMax[3];
+
+    uint64_t vertexOffset;
+    uint64_t vertexCount;
+
+    uint64_t indexOffset;
+    uint64_t indexCount;
+
+    uint64_t meshletOffset;
+    uint64_t meshletCount;
+
+    uint32_t indexSize;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ChunkedMeshEntry) == 80, "Unexpected chunked mesh entry padding");
+
+inline uint64_t alignOffset(uint64_t offset) {
+    return (offset + CHUNKED_MESH_ALIGNMENT - 1) / CHUNKED_MESH_ALIGNMENT * CHUNKED_MESH_ALIGNMENT;
+}
+
+// Write block followed by zero padding to the next aligned offset
+bool writeAlignedBlock(ChunkedMeshWriter & writer, const void * data, size_t size) {
+    const char padding[CHUNKED_MESH_ALIGNMENT] = {};
+
+    if (size > 0 && std::fwrite(data, 1, size, writer.file) != size)
+        return false;
+
+    writer.offset += size;
+
+    size_t paddingSize = (size_t)(alignOffset(writer.offset) - writer.offset);
+
+    if (paddingSize > 0 && std::fwrite(padding, 1, paddingSize, writer.file) != paddingSize)
+        return false;
+
+    writer.offset += paddingSize;
+
+    return true;
+}
+
+}
+
+bool isChunkedMeshFilename(const std::string & filename) {
+    std::string chunkedFilename = filename;
+    size_t index;
+
+    parseMeshChunkFilename(filename, chunkedFilename, index);
+
+    size_t extensionSize = std::strlen(CHUNKED_MESH_EXTENSION);
+
+    return chunkedFilename.size() >= extensionSize
+        && chunkedFilename.compare(chunkedFilename.size() - extensionSize, extensionSize, CHUNKED_MESH_EXTENSION) == 0;
+}
+
+std::string getMeshChunkFilename(const std::string & filename, size_t index) {
+    std::ostringstream chunkFilename;
+    chunkFilename << filename << CHUNK_INDEX_SEPARATOR << index;
+
+    return chunkFilename.str();
+}
+
+bool parseMeshChunkFilename(const std::string & chunkFilename, std::string & filename, size_t & index) {
+    size_t separator = chunkFilename.find_last_of(CHUNK_INDEX_SEPARATOR);
+
+    if (separator == std::string::npos || separator + 1 == chunkFilename.size())
+        return false;
+
+    char * end;
+    unsigned long long value = std::strtoull(chunkFilename.c_str() + separator + 1, &end, 10);
+
+    if (*end != '\0')
+        return false;
+
+    filename = chunkFilename.substr(0, separator);
+    index = (size_t)value;
+
+    return true;
+}
+
+bool openChunkedMesh(const std::string & filename, ChunkedMesh & mesh) {
+    PROFILE_ZONE("openChunkedMesh");
+
+    if (!openMappedFile(filename, mesh.file))
+        return false;
+
+    const MappedFile & file = mesh.file;
+    ChunkedMeshHeader header;
+
+    bool valid = file.size >= sizeof(header);
+
+    if (valid) {
+        std::memcpy(&header, file.data, sizeof(header));
+
+        valid = std::memcmp(header.magic, CHUNKED_MESH_MAGIC, sizeof(CHUNKED_MESH_MAGIC)) == 0
+            && header.version == CHUNKED_MESH_VERSION
+            && header.vertexSize == sizeof(Vertex)
+            && header.meshletSize == sizeof(Meshlet)
+            && header.chunkOffset >= sizeof(header)
+            && header.chunkOffset <= file.size
+            && header.chunkCount <= (file.size - header.chunkOffset) / sizeof(ChunkedMeshEntry);
+    }
+
+    // Validate data ranges of each chunk
+    mesh.chunks.clear();
+
+    for (uint64_t i = 0; valid && i < header.chunkCount; i++) {
+        ChunkedMeshEntry entry;
+        std::memcpy(&entry, file.data + header.chunkOffset + i * sizeof(entry), sizeof(entry));
+
+        valid = (entry.indexSize == sizeof(uint16_t) || entry.indexSize == sizeof(uint32_t))
+            && entry.vertexOffset % CHUNKED_MESH_ALIGNMENT == 0
+            && entry.indexOffset % CHUNKED_MESH_ALIGNMENT == 0
+            && entry.meshletOffset % CHUNKED_MESH_ALIGNMENT == 0
+            && entry.vertexOffset <= file.size
+            && entry.vertexCount <= (file.size - entry.vertexOffset) / sizeof(Vertex)
+            && entry.indexOffset <= file.size
+            && entry.indexCount <= (file.size - entry.indexOffset) / entry.indexSize
+            && entry.meshletOffset <= file.size
+            && entry.meshletCount <= (file.size - entry.meshletOffset) / sizeof(Meshlet);
+
+        MeshChunk chunk;
+        chunk.bounds.min = glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]);
+        chunk.bounds.max = glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]);
+        chunk.vertexOffset = entry.vertexOffset;
+        chunk.vertexCount = entry.vertexCount;
+        chunk.indexOffset = entry.indexOffset;
+        chunk.indexCount = entry.indexCount;
+        chunk.indexSize = entry.indexSize;
+        chunk.meshletOffset = entry.meshletOffset;
+        chunk.meshletCount = entry.meshletCount;
+
+        mesh.chunks.push_back(chunk);
+    }
+
+    if (!valid) {
+        mesh.chunks.clear();
+        closeMappedFile(mesh.file);
+        return false;
+    }
+
+    mesh.bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    mesh.bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+
+    return true;
+}
+
+void closeChunkedMesh(ChunkedMesh & mesh) {
+    closeMappedFile(mesh.file);
+    mesh.chunks.clear();
+}
+
+void getMeshChunk(
+        const ChunkedMesh & mesh,
+        size_t index,
+        const Vertex *& vertices,
+        const void *& indices,
+        const Meshlet *& meshlets) {
+    const MeshChunk & chunk = mesh.chunks[index];
+
+    vertices = (const Vertex *)(mesh.file.data + chunk.vertexOffset);
+    indices = mesh.file.data + chunk.indexOffset;
+    meshlets = (const Meshlet *)(mesh.file.data + chunk.meshletOffset);
+}
+
+bool beginChunkedMesh(const std::string & filename, ChunkedMeshWriter & writer) {
+    writer.filename = filename;
+    writer.temporaryFilename = getTemporaryFilename(filename);
+    writer.file = std::fopen(writer.temporaryFilename.c_str(), "wb");
+    writer.offset = 0;
+    writer.bounds.min = glm::vec3(INFINITY);
+    writer.bounds.max = glm::vec3(-INFINITY);
+    writer.chunks.clear();
+
+    if (writer.file == nullptr)
+        return false;
+
+    // Reserve header, written once the chunk table is known
+    ChunkedMeshHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    return writeAlignedBlock(writer, &header, sizeof(header));
+}
+
+bool appendMeshChunk(ChunkedMeshWriter & writer, const TriangleMesh & mesh) {
+    PROFILE_ZONE("appendMeshChunk");
+
+    const LevelOfDetail & level = mesh.levels[0];
+
+    std::vector<uint32_t> levelIndices(
+        mesh.indices.begin() + level.indexOffset,
+        mesh.indices.begin() + level.indexOffset + level.indexCount);
+
+    std::vector<unsigned char> indices;
+    packIndices(levelIndices, mesh.vertices.size(), indices);
+
+    MeshChunk chunk;
+    chunk.bounds = computeBoundingBox(mesh.vertices.data(), mesh.vertices.size());
+    chunk.vertexCount = mesh.vertices.size();
+    chunk.indexCount = levelIndices.size();
+    chunk.indexSize = (uint32_t)getIndexSize(mesh.vertices.size());
+    chunk.meshletCount = level.meshletCount;
+
+    chunk.vertexOffset = writer.offset;
+    bool success = writeAlignedBlock(writer, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+
+    chunk.indexOffset = writer.offset;
+    success = success && writeAlignedBlock(writer, indices.data(), indices.size());
+
+    chunk.meshletOffset = writer.offset;
+    success = success && writeAlignedBlock(
+        writer,
+        mesh.meshlets.data() + level.meshletOffset,
+        level.meshletCount * sizeof(Meshlet));
+
+    writer.bounds.min = glm::min(writer.bounds.min, chunk.bounds.min);
+    writer.bounds.max = glm::max(writer.bounds.max, chunk.bounds.max);
+    writer.chunks.push_back(chunk);
+
+    return success;
+}
+
+bool endChunkedMesh(ChunkedMeshWriter & writer, bool success) {
+    PROFILE_ZONE("endChunkedMesh");
+
+    if (writer.file == nullptr)
+        return false;
+
+    if (writer.chunks.empty())
+        writer.bounds.min = writer.bounds.max = glm::vec3(0.0f);
+
+    // Write chunk table
+    std::vector<ChunkedMeshEntry> entries(writer.chunks.size());
+
+    for (size_t i = 0; i < writer.chunks.size(); i++) {
+        const MeshChunk & chunk = writer.chunks[i];
+        ChunkedMeshEntry & entry = entries[i];
+
+        for (int j = 0; j < 3; j++) {
+            entry.boundsMin[j] = chunk.bounds.min[j];
+            entry.boundsMax[j] = chunk.bounds.max[j];
+        }
+
+        entry.vertexOffset = chunk.vertexOffset;
+        entry.vertexCount = chunk.vertexCount;
+        entry.indexOffset = chunk.indexOffset;
+        entry.indexCount = chunk.indexCount;
+        entry.meshletOffset = chunk.meshletOffset;
+        entry.meshletCount = chunk.meshletCount;
+        entry.indexSize = chunk.indexSize;
+        entry.reserved = 0;
+    }
+
+    ChunkedMeshHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHUNKED_MESH_MAGIC, sizeof(CHUNKED_MESH_MAGIC));
+    header.version = CHUNKED_MESH_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.chunkCount = entries.size();
+    header.chunkOffset = writer.offset;
+    header.meshletSize = sizeof(Meshlet);
+
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = writer.bounds.min[i];
+        header.boundsMax[i] = writer.bounds.max[i];
+    }
+
+    success = success && writeAlignedBlock(writer, entries.data(), entries.size() * sizeof(ChunkedMeshEntry));
+
+    // Write header over the reserved space
+    success = success
+        && std::fseek(writer.file, 0, SEEK_SET) == 0
+        && std::fwrite(&header, 1, sizeof(header), writer.file) == sizeof(header);
+
+    success = std::fclose(writer.file) == 0 && success;
+    writer.file = nullptr;
+
+    if (!success) {
+        std::remove(writer.temporaryFilename.c_str());
+        return false;
+    }
+
+    return replaceFile(writer.temporaryFilename, writer.filename);
+}
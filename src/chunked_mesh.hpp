@@ -0,0 +1,79 @@
+#ifndef CG20192_CHUNKED_MESH_HPP
+#define CG20192_CHUNKED_MESH_HPP
+
+#include "file.hpp"
+#include "mesh.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Spatially coherent part of a chunked mesh with its own vertices, indices and meshlets
+// Offsets are in bytes from the beginning of the file
+struct MeshChunk {
+    BoundingBox bounds;
+
+    uint64_t vertexOffset;
+    uint64_t vertexCount;
+
+    uint64_t indexOffset;
+    uint64_t indexCount;
+    uint32_t indexSize;
+
+    uint64_t meshletOffset;
+    uint64_t meshletCount;
+};
+
+// Chunked mesh file (.cgchunks) mapped to memory
+// Chunks are independent meshes, so a viewer can load them one by one
+struct ChunkedMesh {
+    MappedFile file;
+    BoundingBox bounds;
+    std::vector<MeshChunk> chunks;
+};
+
+// Chunked mesh file written one chunk at a time, the chunk table is written at the end
+struct ChunkedMeshWriter {
+    std::string filename;
+    std::string temporaryFilename;
+    std::FILE * file;
+    uint64_t offset;
+    BoundingBox bounds;
+    std::vector<MeshChunk> chunks;
+};
+
+// Check whether filename names a chunked mesh or one of its chunks
+bool isChunkedMeshFilename(const std::string & filename);
+
+// Get filename of chunk, read by readMeshAsset as a separate mesh
+std::string getMeshChunkFilename(const std::string & filename, size_t index);
+
+// Split chunk filename in chunked mesh filename and chunk index
+bool parseMeshChunkFilename(const std::string & chunkFilename, std::string & filename, size_t & index);
+
+// Map chunked mesh file and validate its chunk table
+bool openChunkedMesh(const std::string & filename, ChunkedMesh & mesh);
+
+// Unmap chunked mesh file
+void closeChunkedMesh(ChunkedMesh & mesh);
+
+// Get vertices, indices and meshlets of chunk, pointing into the mapped file
+// The chunk has a single level of detail
+void getMeshChunk(
+        const ChunkedMesh & mesh,
+        size_t index,
+        const Vertex *& vertices,
+        const void *& indices,
+        const Meshlet *& meshlets);
+
+// Create chunked mesh file through a temporary file
+bool beginChunkedMesh(const std::string & filename, ChunkedMeshWriter & writer);
+
+// Append full resolution level of triangle mesh with its meshlets as the next chunk
+bool appendMeshChunk(ChunkedMeshWriter & writer, const TriangleMesh & mesh);
+
+// Write chunk table and header, then replace the target file
+// Discards the file when writing failed or success is false
+bool endChunkedMesh(ChunkedMeshWriter & writer, bool success);
+
+#endif
@@ -0,0 +1,321 @@
+#include "file.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include <sys/stat.h>
+
+namespace {
+
+// Chunk size hashed independently, fixed so the file hash does not depend on the thread count
+const size_t HASH_CHUNK_SIZE = 1 << 24;
+
+const uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t HASH_PRIME_3 = 0x165667B19E3779F9ULL;
+
+inline uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t readWord(const unsigned char * data) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+
+    return word;
+}
+
+inline uint64_t mixWord(uint64_t hash, uint64_t word) {
+    hash += word * HASH_PRIME_2;
+    hash = rotateLeft(hash, 31);
+
+    return hash * HASH_PRIME_1;
+}
+
+// Map entire file to memory, reading ahead sequential files
+bool mapFile(const std::string & filename, bool sequential, MappedFile & file) {
+    file.data = nullptr;
+    file.size = 0;
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(
+        filename.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS),
+        nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    if (size.QuadPart == 0) {
+        CloseHandle(handle);
+        return true;
+    }
+
+    // The view keeps the mapping and the file open after handles are closed
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(handle);
+
+    if (mapping == nullptr)
+        return false;
+
+    void * data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (data == nullptr)
+        return false;
+
+    file.data = (const char *)data;
+    file.size = (size_t)size.QuadPart;
+#else
+    int descriptor = open(filename.c_str(), O_RDONLY);
+
+    if (descriptor < 0)
+        return false;
+
+    struct stat status;
+
+    if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode)) {
+        close(descriptor);
+        return false;
+    }
+
+    if (status.st_size == 0) {
+        close(descriptor);
+        return true;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void * data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    // Pages are read ahead when the whole file is consumed, otherwise only touched pages are read
+    madvise(data, (size_t)status.st_size, sequential ? MADV_WILLNEED : MADV_RANDOM);
+
+    file.data = (const char *)data;
+    file.size = (size_t)status.st_size;
+#endif
+
+    return true;
+}
+
+}
+
+bool openMappedFile(const std::string & filename, MappedFile & file) {
+    return mapFile(filename, true, file);
+}
+
+bool openMappedFileOnDemand(const std::string & filename, MappedFile & file) {
+    return mapFile(filename, false, file);
+}
+
+void closeMappedFile(MappedFile & file) {
+    if (file.data != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(file.data);
+#else
+        munmap((void *)file.data, file.size);
+#endif
+    }
+
+    file.data = nullptr;
+    file.size = 0;
+}
+
+bool readTextFile(const std::string & filename, std::string & text) {
+    std::ifstream file(filename, std::ifstream::in);
+
+    if (!file.is_open())
+        return false;
+
+    std::stringstream buffer;
+
+    buffer << file.rdbuf();
+    text = buffer.str();
+
+    return true;
+}
+
+bool getFileStatus(const std::string & filename, uint64_t & size, int64_t & modificationTime) {
+    // The plain stat of Windows runtimes has a 32-bit size, wrong for files over 2 GB
+#ifdef _WIN32
+    struct _stat64 status;
+
+    if (_stat64(filename.c_str(), &status) != 0)
+        return false;
+#else
+    struct stat status;
+
+    if (stat(filename.c_str(), &status) != 0)
+        return false;
+#endif
+
+    size = (uint64_t)status.st_size;
+    modificationTime = (int64_t)status.st_mtime;
+
+    return true;
+}
+
+uint64_t hashData(const void * data, size_t size, uint64_t seed) {
+    const unsigned char * p = (const unsigned char *)data;
+    const unsigned char * end = p + size;
+
+    // Four independent lanes over 32-byte blocks
+    uint64_t lanes[4] = {
+        seed + HASH_PRIME_1 + HASH_PRIME_2,
+        seed + HASH_PRIME_2,
+        seed,
+        seed - HASH_PRIME_1
+    };
+
+    while (end - p >= 32) {
+        for (size_t i = 0; i < 4; i++)
+            lanes[i] = mixWord(lanes[i], readWord(p + i * 8));
+
+        p += 32;
+    }
+
+    uint64_t hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7)
+        + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+
+    hash += (uint64_t)size;
+
+    // Remaining words and bytes
+    while (end - p >= 8) {
+        hash ^= mixWord(0, readWord(p));
+        hash = rotateLeft(hash, 27) * HASH_PRIME_1 + HASH_PRIME_3;
+        p += 8;
+    }
+
+    while (p < end) {
+        hash ^= (uint64_t)(*p) * HASH_PRIME_3;
+        hash = rotateLeft(hash, 11) * HASH_PRIME_1;
+        p++;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+bool hashFile(const std::string & filename, uint64_t & hash) {
+    PROFILE_ZONE("hashFile");
+
+    MappedFile file;
+
+    if (!openMappedFile(filename, file))
+        return false;
+
+    size_t chunkCount = (file.size + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE;
+    std::vector<uint64_t> chunkHashes(chunkCount);
+
+    parallelFor(chunkCount, [&](size_t index, size_t) {
+        size_t offset = index * HASH_CHUNK_SIZE;
+        size_t size = std::min(HASH_CHUNK_SIZE, file.size - offset);
+
+        chunkHashes[index] = hashData(file.data + offset, size, index);
+    });
+
+    hash = hashData(chunkHashes.data(), chunkHashes.size() * sizeof(uint64_t), file.size);
+
+    closeMappedFile(file);
+
+    return true;
+}
+
+std::string getTemporaryFilename(const std::string & filename) {
+    static std::atomic<uint64_t> counter(0);
+
+#ifdef _WIN32
+    unsigned long processID = GetCurrentProcessId();
+#else
+    unsigned long processID = (unsigned long)getpid();
+#endif
+
+    std::ostringstream temporaryFilename;
+    temporaryFilename << filename << "." << processID << "." << counter.fetch_add(1) << ".tmp";
+
+    return temporaryFilename.str();
+}
+
+bool writeFileAtomic(
+        const std::string & filename,
+        const void * const * blocks,
+        const size_t * sizes,
+        size_t blockCount) {
+    PROFILE_ZONE("writeFileAtomic");
+
+    std::string temporaryFilename = getTemporaryFilename(filename);
+
+    FILE * file = std::fopen(temporaryFilename.c_str(), "wb");
+
+    if (file == nullptr)
+        return false;
+
+    bool success = true;
+
+    for (size_t i = 0; i < blockCount && success; i++) {
+        if (sizes[i] > 0)
+            success = std::fwrite(blocks[i], 1, sizes[i], file) == sizes[i];
+    }
+
+    success = std::fclose(file) == 0 && success;
+
+    if (!success) {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    return replaceFile(temporaryFilename, filename);
+}
+
+bool replaceFile(const std::string & temporaryFilename, const std::string & filename) {
+#ifdef _WIN32
+    bool success = MoveFileExA(
+        temporaryFilename.c_str(),
+        filename.c_str(),
+        MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool success = std::rename(temporaryFilename.c_str(), filename.c_str()) == 0;
+#endif
+
+    if (!success)
+        std::remove(temporaryFilename.c_str());
+
+    return success;
+}
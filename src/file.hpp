@@ -0,0 +1,54 @@
+#ifndef CG20192_FILE_HPP
+#define CG20192_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapped file
+// Empty files are mapped as a null pointer with zero size
+struct MappedFile {
+    const char * data;
+    size_t size;
+};
+
+// Map entire file to memory for reading
+bool openMappedFile(const std::string & filename, MappedFile & file);
+
+// Map entire file to memory for reading parts of it on demand
+// Nothing is read ahead, so only the touched pages of the file are read from disk
+bool openMappedFileOnDemand(const std::string & filename, MappedFile & file);
+
+// Unmap file from memory
+void closeMappedFile(MappedFile & file);
+
+// Read entire text file to string
+bool readTextFile(const std::string & filename, std::string & text);
+
+// Get file size in bytes and last modification time in seconds since epoch
+// Sizes are 64-bit on every platform, so files over 4 GB are reported correctly
+bool getFileStatus(const std::string & filename, uint64_t & size, int64_t & modificationTime);
+
+// Hash memory block with a fast 64-bit non-cryptographic hash
+uint64_t hashData(const void * data, size_t size, uint64_t seed);
+
+// Hash file contents in parallel
+// The result depends only on the file contents, not on the number of threads
+bool hashFile(const std::string & filename, uint64_t & hash);
+
+// Get name of temporary file next to file, unique among the processes and threads writing it
+// so concurrent writers of the same file never share their temporary file
+std::string getTemporaryFilename(const std::string & filename);
+
+// Write memory blocks to file through a temporary file replacing the target at the end
+// Readers never observe a partially written file
+bool writeFileAtomic(
+        const std::string & filename,
+        const void * const * blocks,
+        const size_t * sizes,
+        size_t blockCount);
+
+// Move completely written temporary file over the target file, removing it on failure
+bool replaceFile(const std::string & temporaryFilename, const std::string & filename);
+
+#endif
@@ -0,0 +1,30 @@
+#include "gl_utility.hpp"
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+bool hasExtension(const char * name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (GLint i = 0; i < count; i++) {
+        const char * extension = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+
+        if (extension != nullptr && std::strcmp(extension, name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+bool hasVersionOrExtension(int major, int minor, const char * extension) {
+    GLint contextMajor = 0, contextMinor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+
+    if (contextMajor > major || (contextMajor == major && contextMinor >= minor))
+        return true;
+
+    return hasExtension(extension);
+}
@@ -0,0 +1,11 @@
+#ifndef CG20192_GL_UTILITY_HPP
+#define CG20192_GL_UTILITY_HPP
+
+// Check whether the current OpenGL context supports extension
+bool hasExtension(const char * name);
+
+// Check whether the current OpenGL context has at least version major.minor
+// or otherwise supports extension providing the same feature
+bool hasVersionOrExtension(int major, int minor, const char * extension);
+
+#endif
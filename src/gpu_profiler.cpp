@@ -0,0 +1,97 @@
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+
+namespace {
+
+GLuint acquireQuery(GpuProfiler & profiler) {
+    if (profiler.freeQueries.empty()) {
+        GLuint query;
+        glGenQueries(1, &query);
+
+        return query;
+    }
+
+    GLuint query = profiler.freeQueries.back();
+    profiler.freeQueries.pop_back();
+
+    return query;
+}
+
+}
+
+void createGpuProfiler(GpuProfiler & profiler) {
+    GLint64 gpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+
+    profiler.offset = (int64_t)getProfilerNanoseconds() - gpuTime;
+}
+
+void deleteGpuProfiler(GpuProfiler & profiler) {
+    for (size_t i = 0; i < profiler.pendingZones.size(); i++) {
+        profiler.freeQueries.push_back(profiler.pendingZones[i].beginQuery);
+        profiler.freeQueries.push_back(profiler.pendingZones[i].endQuery);
+    }
+
+    for (size_t i = 0; i < profiler.openZones.size(); i++)
+        profiler.freeQueries.push_back(profiler.openZones[i].beginQuery);
+
+    if (!profiler.freeQueries.empty())
+        glDeleteQueries((GLsizei)profiler.freeQueries.size(), profiler.freeQueries.data());
+
+    profiler.freeQueries.clear();
+    profiler.openZones.clear();
+    profiler.pendingZones.clear();
+}
+
+void beginGpuZone(GpuProfiler & profiler, const char * name) {
+    GpuZone zone;
+    zone.name = name;
+    zone.beginQuery = acquireQuery(profiler);
+    zone.endQuery = 0;
+
+    glQueryCounter(zone.beginQuery, GL_TIMESTAMP);
+
+    profiler.openZones.push_back(zone);
+}
+
+void endGpuZone(GpuProfiler & profiler) {
+    if (profiler.openZones.empty())
+        return;
+
+    GpuZone zone = profiler.openZones.back();
+    profiler.openZones.pop_back();
+
+    zone.endQuery = acquireQuery(profiler);
+    glQueryCounter(zone.endQuery, GL_TIMESTAMP);
+
+    profiler.pendingZones.push_back(zone);
+}
+
+void resolveGpuZones(GpuProfiler & profiler) {
+    while (!profiler.pendingZones.empty()) {
+        const GpuZone & zone = profiler.pendingZones.front();
+
+        // Queries complete in order, so later zones are not ready either
+        GLint available = 0;
+        glGetQueryObjectiv(zone.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available)
+            break;
+
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(zone.beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(zone.endQuery, GL_QUERY_RESULT, &end);
+
+        recordProfileTrackZone(
+            "GPU",
+            zone.name,
+            (uint64_t)((int64_t)begin + profiler.offset),
+            (uint64_t)((int64_t)std::max(begin, end) + profiler.offset));
+
+        profiler.freeQueries.push_back(zone.beginQuery);
+        profiler.freeQueries.push_back(zone.endQuery);
+
+        profiler.pendingZones.pop_front();
+    }
+}
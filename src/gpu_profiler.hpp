@@ -0,0 +1,65 @@
+#ifndef CG20192_GPU_PROFILER_HPP
+#define CG20192_GPU_PROFILER_HPP
+
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <vector>
+
+// GPU zone waiting for its timestamp queries
+struct GpuZone {
+    const char * name;
+    GLuint beginQuery;
+    GLuint endQuery;
+};
+
+// GPU zones measured with timestamp queries and resolved frames later,
+// so reading results never stalls the pipeline
+// GPU timestamps are mapped to the profiler clock by an offset sampled at creation
+struct GpuProfiler {
+    std::vector<GLuint> freeQueries;
+    std::vector<GpuZone> openZones;
+    std::deque<GpuZone> pendingZones;
+    int64_t offset;
+};
+
+// Synchronize GPU and profiler clocks
+void createGpuProfiler(GpuProfiler & profiler);
+
+// Delete all queries
+void deleteGpuProfiler(GpuProfiler & profiler);
+
+// Issue timestamp query starting a zone, zones nest in issue order
+void beginGpuZone(GpuProfiler & profiler, const char * name);
+
+// Issue timestamp query ending the innermost open zone
+void endGpuZone(GpuProfiler & profiler);
+
+// Record zones whose queries are available on the GPU track, in issue order
+// Call once per frame; zones still in flight are kept for the next frames
+void resolveGpuZones(GpuProfiler & profiler);
+
+// Scoped GPU zone
+struct GpuProfileZone {
+    GpuProfiler & profiler;
+
+    GpuProfileZone(GpuProfiler & zoneProfiler, const char * name) : profiler(zoneProfiler) {
+        beginGpuZone(profiler, name);
+    }
+
+    ~GpuProfileZone() {
+        endGpuZone(profiler);
+    }
+};
+
+// Record GPU zone from this line to the end of the enclosing scope
+#if CG20192_PROFILER
+#define PROFILE_GPU_ZONE(profiler, name) \
+    GpuProfileZone CG20192_PROFILE_CONCATENATE(gpuProfileZone, __LINE__)(profiler, name)
+#else
+#define PROFILE_GPU_ZONE(profiler, name)
+#endif
+
+#endif
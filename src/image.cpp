@@ -0,0 +1,322 @@
+#include "image.hpp"
+#include "file.hpp"
+#include "simd.hpp"
+#include "profiler.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "Unexpected glm::vec3 padding");
+
+namespace {
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// Skip whitespace and comments between header fields
+const char * skipHeaderSpaces(const char * cursor, const char * end) {
+    while (cursor < end) {
+        if (*cursor == '#') {
+            while (cursor < end && *cursor != '\n')
+                cursor++;
+        }
+        else if (isSpace(*cursor))
+            cursor++;
+        else
+            break;
+    }
+
+    return cursor;
+}
+
+// Parse unsigned decimal number from header or plain text payload
+bool parseNumber(const char *& cursor, const char * end, size_t & value) {
+    const char * p = skipHeaderSpaces(cursor, end);
+
+    if (p == end || !isDigit(*p))
+        return false;
+
+    size_t result = 0;
+
+    while (p < end && isDigit(*p)) {
+        if (result > 0xFFFFFFFF)
+            return false;
+
+        result = result * 10 + (size_t)(*p - '0');
+        p++;
+    }
+
+    value = result;
+    cursor = p;
+
+    return true;
+}
+
+// Rescale channel value to the full range of the channel size
+inline uint32_t rescaleChannel(uint32_t value, uint32_t maximum, uint32_t fullRange) {
+    if (value >= maximum)
+        return fullRange;
+
+    return (value * fullRange + maximum / 2) / maximum;
+}
+
+// Parse header of mapped Netpbm file, leaving cursor at the end of the maximum value
+bool parseHeader(
+        const MappedFile & file,
+        const char *& cursor,
+        char & format,
+        size_t & width,
+        size_t & height,
+        size_t & maximum) {
+    const char * end = file.data + file.size;
+    cursor = file.data;
+
+    bool valid = file.size >= 2 && cursor[0] == 'P'
+        && (cursor[1] == '2' || cursor[1] == '3' || cursor[1] == '5' || cursor[1] == '6');
+
+    if (!valid)
+        return false;
+
+    format = cursor[1];
+    cursor += 2;
+
+    return parseNumber(cursor, end, width)
+        && parseNumber(cursor, end, height)
+        && parseNumber(cursor, end, maximum)
+        && width > 0 && height > 0
+        && width <= SIZE_MAX / 6 / height
+        && maximum > 0 && maximum <= 0xFFFF;
+}
+
+}
+
+bool readImage(const std::string & filename, Image & image) {
+    PROFILE_ZONE("readImage");
+
+    MappedFile file;
+
+    if (!openMappedFile(filename, file))
+        return false;
+
+    const char * cursor;
+    const char * end = file.data + file.size;
+
+    // Read header
+    char format;
+    size_t width, height, maximum;
+
+    if (!parseHeader(file, cursor, format, width, height, maximum)) {
+        closeMappedFile(file);
+        return false;
+    }
+
+    size_t channelCount = format == '3' || format == '6' ? 3 : 1;
+    size_t channelSize = maximum > 0xFF ? 2 : 1;
+    size_t count = width * height * channelCount;
+
+    uint32_t fullRange = channelSize == 1 ? 0xFF : 0xFFFF;
+    bool rescale = maximum != fullRange;
+
+    image.width = width;
+    image.height = height;
+    image.channelCount = channelCount;
+    image.channelSize = channelSize;
+    image.pixels.resize(count * channelSize);
+
+    if (format == '5' || format == '6') {
+        // Binary payload starts after a single whitespace character
+        if (cursor == end || (size_t)(end - cursor - 1) < count * channelSize) {
+            closeMappedFile(file);
+            return false;
+        }
+
+        const unsigned char * data = (const unsigned char *)cursor + 1;
+
+        if (channelSize == 1) {
+            if (!rescale)
+                std::memcpy(image.pixels.data(), data, count);
+            else {
+                for (size_t i = 0; i < count; i++)
+                    image.pixels[i] = (unsigned char)rescaleChannel(data[i], (uint32_t)maximum, fullRange);
+            }
+        }
+        else {
+            // Convert big-endian channels to native byte order
+            uint16_t * pixels = (uint16_t *)image.pixels.data();
+
+            for (size_t i = 0; i < count; i++) {
+                uint32_t value = ((uint32_t)data[i * 2] << 8) | data[i * 2 + 1];
+
+                if (rescale)
+                    value = rescaleChannel(value, (uint32_t)maximum, fullRange);
+
+                pixels[i] = (uint16_t)value;
+            }
+        }
+    }
+    else {
+        // Plain text payload with decimal values separated by whitespace
+        for (size_t i = 0; i < count; i++) {
+            size_t value;
+
+            if (!parseNumber(cursor, end, value)) {
+                closeMappedFile(file);
+                return false;
+            }
+
+            value = rescaleChannel((uint32_t)std::min(value, maximum), (uint32_t)maximum, fullRange);
+
+            if (channelSize == 1)
+                image.pixels[i] = (unsigned char)value;
+            else
+                ((uint16_t *)image.pixels.data())[i] = (uint16_t)value;
+        }
+    }
+
+    closeMappedFile(file);
+
+    return true;
+}
+
+bool openMappedImage(const std::string & filename, MappedImage & image) {
+    if (!openMappedFile(filename, image.file))
+        return false;
+
+    const char * cursor;
+    const char * end = image.file.data + image.file.size;
+
+    char format = '\0';
+    size_t width = 0, height = 0, maximum = 0;
+
+    // Only binary payloads can be addressed in place
+    bool valid = parseHeader(image.file, cursor, format, width, height, maximum)
+        && (format == '5' || format == '6');
+
+    size_t channelCount = format == '6' ? 3 : 1;
+    size_t channelSize = maximum > 0xFF ? 2 : 1;
+
+    // Binary payload starts after a single whitespace character
+    if (!valid || cursor == end || (size_t)(end - cursor - 1) < width * height * channelCount * channelSize) {
+        closeMappedFile(image.file);
+        return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.channelCount = channelCount;
+    image.channelSize = channelSize;
+    image.maximum = (uint32_t)maximum;
+    image.pixels = (const unsigned char *)cursor + 1;
+
+    return true;
+}
+
+void closeMappedImage(MappedImage & image) {
+    closeMappedFile(image.file);
+    image.pixels = nullptr;
+}
+
+bool writeImage(const std::string & filename, const Image & image) {
+    PROFILE_ZONE("writeImage");
+
+    std::string header = std::string(image.channelCount == 3 ? "P6" : "P5") + "\n"
+        + std::to_string(image.width) + " " + std::to_string(image.height) + "\n"
+        + std::to_string(image.channelSize == 1 ? 0xFF : 0xFFFF) + "\n";
+
+    const void * blocks[2] = { header.data(), image.pixels.data() };
+    size_t sizes[2] = { header.size(), image.pixels.size() };
+
+    if (image.channelSize == 1)
+        return writeFileAtomic(filename, blocks, sizes, 2);
+
+    // Convert native byte order channels to big-endian
+    std::vector<unsigned char> pixels(image.pixels.size());
+    const uint16_t * input = (const uint16_t *)image.pixels.data();
+
+    for (size_t i = 0; i < pixels.size() / 2; i++) {
+        pixels[i * 2] = (unsigned char)(input[i] >> 8);
+        pixels[i * 2 + 1] = (unsigned char)(input[i] & 0xFF);
+    }
+
+    blocks[1] = pixels.data();
+
+    return writeFileAtomic(filename, blocks, sizes, 2);
+}
+
+void convertImage(const Image & image, std::vector<glm::vec3> & pixels) {
+    PROFILE_ZONE("convertImage");
+
+    size_t pixelCount = image.width * image.height;
+    size_t count = pixelCount * image.channelCount;
+
+    pixels.resize(pixelCount);
+
+    // Convert grayscale images through the RGB expansion
+    std::vector<float> channels;
+    float * output = (float *)pixels.data();
+
+    if (image.channelCount != 3) {
+        channels.resize(count);
+        output = channels.data();
+    }
+
+    size_t i = 0;
+
+    if (image.channelSize == 1) {
+        const unsigned char * input = image.pixels.data();
+        const float scale = 1.0f / 0xFF;
+
+#ifdef CG20192_SSE2
+        // Widen 16 channels per iteration from 8-bit integers to floats
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 factor = _mm_set1_ps(scale);
+
+        for (; i + 16 <= count; i += 16) {
+            __m128i bytes = _mm_loadu_si128((const __m128i *)(input + i));
+
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), factor));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), factor));
+            _mm_storeu_ps(output + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), factor));
+            _mm_storeu_ps(output + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), factor));
+        }
+#endif
+
+        for (; i < count; i++)
+            output[i] = input[i] * scale;
+    }
+    else {
+        const uint16_t * input = (const uint16_t *)image.pixels.data();
+        const float scale = 1.0f / 0xFFFF;
+
+#ifdef CG20192_SSE2
+        // Widen 8 channels per iteration from 16-bit integers to floats
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 factor = _mm_set1_ps(scale);
+
+        for (; i + 8 <= count; i += 8) {
+            __m128i words = _mm_loadu_si128((const __m128i *)(input + i));
+
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), factor));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), factor));
+        }
+#endif
+
+        for (; i < count; i++)
+            output[i] = input[i] * scale;
+    }
+
+    if (image.channelCount != 3) {
+        for (size_t j = 0; j < pixelCount; j++)
+            pixels[j] = glm::vec3(channels[j]);
+    }
+}
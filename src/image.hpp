@@ -0,0 +1,53 @@
+#ifndef CG20192_IMAGE_HPP
+#define CG20192_IMAGE_HPP
+
+#include "file.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Image with 8-bit or 16-bit unsigned normalized channels
+// Rows are stored top to bottom and 16-bit channels in native byte order
+struct Image {
+    size_t width;
+    size_t height;
+    size_t channelCount;
+    size_t channelSize;
+    std::vector<unsigned char> pixels;
+};
+
+// Read grayscale or RGB image from Netpbm file format (PGM and PPM, binary or plain text)
+// The payload is mapped and copied at once, keeping 8-bit or 16-bit channels
+// Channels with maximum values other than 255 or 65535 are rescaled to the full range
+bool readImage(const std::string & filename, Image & image);
+
+// Binary grayscale or RGB Netpbm image mapped to memory, pixels point into the mapped file
+// Channels keep their maximum value and 16-bit channels their big-endian byte order
+struct MappedImage {
+    MappedFile file;
+    size_t width;
+    size_t height;
+    size_t channelCount;
+    size_t channelSize;
+    uint32_t maximum;
+    const unsigned char * pixels;
+};
+
+// Map binary PGM or PPM image without reading its payload, plain text images cannot be mapped
+bool openMappedImage(const std::string & filename, MappedImage & image);
+
+// Unmap image file
+void closeMappedImage(MappedImage & image);
+
+// Write grayscale or RGB image to binary Netpbm file format (PGM or PPM)
+// 16-bit channels are stored in big-endian byte order
+bool writeImage(const std::string & filename, const Image & image);
+
+// Convert image to 32-bit linear RGB image
+// Grayscale images are replicated to all channels
+void convertImage(const Image & image, std::vector<glm::vec3> & pixels);
+
+#endif
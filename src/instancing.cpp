@@ -0,0 +1,376 @@
+#include "instancing.hpp"
+#include "meshlet.hpp"
+#include "simplification.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const float TWO_PI = 6.28318530717958647692f;
+
+// Number of clusters culled by one parallel task
+const size_t CULL_BLOCK_CLUSTER_COUNT = 16;
+
+// Grid spacing relative to the mesh bounding box diagonal and jitter relative to the spacing
+const float GRID_SPACING = 1.5f;
+const float GRID_JITTER = 0.15f;
+
+// Instance scale range
+const float MIN_INSTANCE_SCALE = 0.75f;
+const float MAX_INSTANCE_SCALE = 1.25f;
+
+// Integer hash with good avalanche (lowbias32)
+uint32_t hashInteger(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+
+    return x;
+}
+
+// Get uniform random number in [0, 1) from instance index and stream
+float getRandom(size_t index, uint32_t stream) {
+    return (hashInteger((uint32_t)index * 8u + stream) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Spread lower 10 bits of value to every third bit
+uint32_t expandBits(uint32_t value) {
+    value &= 0x3FF;
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+
+    return value;
+}
+
+// Append instances to ranges, extending the last range when contiguous with the same level
+void appendRange(std::vector<InstanceRange> & ranges, size_t offset, size_t count, uint32_t level) {
+    if (!ranges.empty()) {
+        InstanceRange & last = ranges.back();
+
+        if (last.level == level && last.offset + last.count == offset) {
+            last.count += (uint32_t)count;
+            return;
+        }
+    }
+
+    InstanceRange range;
+    range.offset = (uint32_t)offset;
+    range.count = (uint32_t)count;
+    range.level = level;
+
+    ranges.push_back(range);
+}
+
+}
+
+glm::mat4 getInstanceModel(const Instance & instance) {
+    glm::mat4 model(1.0f);
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 4; j++)
+            model[j][i] = instance.modelRows[i][j];
+
+    return model;
+}
+
+void setInstanceModel(const glm::mat4 & model, Instance & instance) {
+    for (int i = 0; i < 3; i++)
+        instance.modelRows[i] = glm::vec4(model[0][i], model[1][i], model[2][i], model[3][i]);
+}
+
+void placeInstances(
+        size_t count,
+        const BoundingBox & meshBounds,
+        float materialExponent,
+        std::vector<Instance> & instances) {
+    instances.resize(count);
+
+    glm::vec3 center = (meshBounds.min + meshBounds.max) * 0.5f;
+    float spacing = glm::length(meshBounds.max - meshBounds.min) * GRID_SPACING;
+
+    size_t side = 1;
+
+    while (side * side * side < count)
+        side++;
+
+    float half = (side - 1) * 0.5f;
+
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 cell((float)(i % side), (float)(i / side % side), (float)(i / (side * side)));
+
+        glm::vec3 jitter(getRandom(i, 0), getRandom(i, 1), getRandom(i, 2));
+        glm::vec3 position = (cell - half + (jitter - 0.5f) * 2.0f * GRID_JITTER) * spacing;
+
+        float angle = TWO_PI * getRandom(i, 3);
+        float scale = MIN_INSTANCE_SCALE + (MAX_INSTANCE_SCALE - MIN_INSTANCE_SCALE) * getRandom(i, 4);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position)
+            * glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f))
+            * glm::scale(glm::mat4(1.0f), glm::vec3(scale))
+            * glm::translate(glm::mat4(1.0f), -center);
+
+        Instance & instance = instances[i];
+        setInstanceModel(model, instance);
+
+        instance.materialColor = glm::vec4(
+            0.25f + 0.75f * getRandom(i, 5),
+            0.25f + 0.75f * getRandom(i, 6),
+            0.25f + 0.75f * getRandom(i, 7),
+            materialExponent);
+    }
+}
+
+void buildInstanceSet(
+        const std::vector<Instance> & instances,
+        const BoundingBox & meshBounds,
+        InstanceSet & set) {
+    PROFILE_ZONE("buildInstanceSet");
+
+    size_t count = instances.size();
+
+    glm::vec3 meshCenter = (meshBounds.min + meshBounds.max) * 0.5f;
+    float meshRadius = glm::length(meshBounds.max - meshBounds.min) * 0.5f;
+
+    // Transform mesh bounding sphere by each instance, scaled by the largest axis scale
+    std::vector<glm::vec4> spheres(count);
+
+    glm::vec3 minCenter(INFINITY), maxCenter(-INFINITY);
+
+    for (size_t i = 0; i < count; i++) {
+        glm::mat4 model = getInstanceModel(instances[i]);
+        glm::vec3 center(model * glm::vec4(meshCenter, 1.0f));
+
+        float scale = std::max(
+            std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))),
+            glm::length(glm::vec3(model[2])));
+
+        spheres[i] = glm::vec4(center, meshRadius * scale);
+
+        minCenter = glm::min(minCenter, center);
+        maxCenter = glm::max(maxCenter, center);
+    }
+
+    // Sort instances by Morton code of their centers quantized to 10 bits per axis
+    glm::vec3 extent = maxCenter - minCenter;
+    float maxExtent = std::max(std::max(extent.x, extent.y), extent.z);
+    float quantization = maxExtent > 0.0f ? 1023.0f / maxExtent : 0.0f;
+
+    std::vector<std::pair<uint32_t, uint32_t> > codes(count);
+
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 cell = (glm::vec3(spheres[i]) - minCenter) * quantization;
+
+        uint32_t code = expandBits((uint32_t)cell.x)
+            | (expandBits((uint32_t)cell.y) << 1)
+            | (expandBits((uint32_t)cell.z) << 2);
+
+        codes[i] = std::make_pair(code, (uint32_t)i);
+    }
+
+    std::sort(codes.begin(), codes.end());
+
+    set.instances.resize(count);
+    set.spheres.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        set.instances[i] = instances[codes[i].second];
+        set.spheres[i] = spheres[codes[i].second];
+    }
+
+    // Bound consecutive instances by cluster spheres centered on their bounding boxes
+    set.clusters.clear();
+    set.bounds.min = glm::vec3(INFINITY);
+    set.bounds.max = glm::vec3(-INFINITY);
+
+    for (size_t offset = 0; offset < count; offset += INSTANCE_CLUSTER_SIZE) {
+        InstanceCluster cluster;
+        cluster.offset = offset;
+        cluster.count = std::min(INSTANCE_CLUSTER_SIZE, count - offset);
+        cluster.minInstanceRadius = INFINITY;
+        cluster.maxInstanceRadius = 0.0f;
+
+        glm::vec3 minPoint(INFINITY), maxPoint(-INFINITY);
+
+        for (size_t i = offset; i < offset + cluster.count; i++) {
+            glm::vec3 center(set.spheres[i]);
+            float radius = set.spheres[i].w;
+
+            minPoint = glm::min(minPoint, center - radius);
+            maxPoint = glm::max(maxPoint, center + radius);
+
+            cluster.minInstanceRadius = std::min(cluster.minInstanceRadius, radius);
+            cluster.maxInstanceRadius = std::max(cluster.maxInstanceRadius, radius);
+        }
+
+        cluster.center = (minPoint + maxPoint) * 0.5f;
+        cluster.radius = 0.0f;
+
+        for (size_t i = offset; i < offset + cluster.count; i++)
+            cluster.radius = std::max(
+                cluster.radius,
+                glm::distance(cluster.center, glm::vec3(set.spheres[i])) + set.spheres[i].w);
+
+        set.clusters.push_back(cluster);
+
+        set.bounds.min = glm::min(set.bounds.min, minPoint);
+        set.bounds.max = glm::max(set.bounds.max, maxPoint);
+    }
+
+    if (count == 0)
+        set.bounds.min = set.bounds.max = glm::vec3(0.0f);
+}
+
+void cullInstances(
+        const InstanceSet & set,
+        const std::vector<LevelOfDetail> & levels,
+        const glm::mat4 & viewProjection,
+        const glm::vec3 & camera,
+        float projectionScale,
+        float pixelError,
+        InstanceBatches & batches) {
+    PROFILE_ZONE("cullInstances");
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+
+    size_t levelCount = levels.size();
+    size_t blockCount = (set.clusters.size() + CULL_BLOCK_CLUSTER_COUNT - 1) / CULL_BLOCK_CLUSTER_COUNT;
+
+    batches.blockRanges.resize(blockCount);
+    batches.blockOffsets.assign(blockCount * levelCount, 0);
+
+    // Find visible ranges of each block of clusters with their level of detail
+    parallelFor(blockCount, [&](size_t block, size_t) {
+        PROFILE_ZONE("cullInstanceBlock");
+
+        std::vector<InstanceRange> & ranges = batches.blockRanges[block];
+        ranges.clear();
+
+        size_t * blockCounts = &batches.blockOffsets[block * levelCount];
+
+        size_t begin = block * CULL_BLOCK_CLUSTER_COUNT;
+        size_t end = std::min(begin + CULL_BLOCK_CLUSTER_COUNT, set.clusters.size());
+
+        for (size_t i = begin; i < end; i++) {
+            const InstanceCluster & cluster = set.clusters[i];
+
+            // A cluster is outside when its sphere is behind a plane
+            // and inside when its sphere is in front of all planes
+            bool outside = false;
+            bool inside = true;
+
+            for (int j = 0; j < 6 && !outside; j++) {
+                float distance = glm::dot(glm::vec3(planes[j]), cluster.center) + planes[j].w;
+
+                outside = distance <= -cluster.radius;
+                inside = inside && distance >= cluster.radius;
+            }
+
+            if (outside)
+                continue;
+
+            // Accept the whole cluster when its nearest and farthest instances share a level
+            if (inside) {
+                float distance = glm::distance(cluster.center, camera);
+
+                uint32_t finestLevel = (uint32_t)selectLevelOfDetail(
+                    levels,
+                    cluster.maxInstanceRadius,
+                    std::max(distance - cluster.radius, 0.0f),
+                    projectionScale,
+                    pixelError);
+
+                uint32_t coarsestLevel = (uint32_t)selectLevelOfDetail(
+                    levels,
+                    cluster.minInstanceRadius,
+                    distance + cluster.radius,
+                    projectionScale,
+                    pixelError);
+
+                if (finestLevel == coarsestLevel) {
+                    appendRange(ranges, cluster.offset, cluster.count, finestLevel);
+                    blockCounts[finestLevel] += cluster.count;
+                    continue;
+                }
+            }
+
+            // Test instances of clusters crossing the frustum and select their levels
+            for (size_t k = cluster.offset; k < cluster.offset + cluster.count; k++) {
+                const glm::vec4 & sphere = set.spheres[k];
+                glm::vec3 center(sphere);
+
+                bool visible = true;
+
+                for (int j = 0; j < 6 && !inside && visible; j++)
+                    visible = glm::dot(glm::vec3(planes[j]), center) + planes[j].w > -sphere.w;
+
+                if (!visible)
+                    continue;
+
+                uint32_t level = (uint32_t)selectLevelOfDetail(
+                    levels,
+                    sphere.w,
+                    glm::distance(center, camera),
+                    projectionScale,
+                    pixelError);
+
+                appendRange(ranges, k, 1, level);
+                blockCounts[level]++;
+            }
+        }
+    });
+
+    // Replace block counts by output offsets, blocks are ordered within each level
+    batches.levelOffsets.assign(levelCount, 0);
+    batches.levelCounts.assign(levelCount, 0);
+
+    size_t total = 0;
+
+    for (size_t level = 0; level < levelCount; level++) {
+        batches.levelOffsets[level] = total;
+
+        for (size_t block = 0; block < blockCount; block++) {
+            size_t & offset = batches.blockOffsets[block * levelCount + level];
+            size_t count = offset;
+
+            offset = total;
+            total += count;
+        }
+
+        batches.levelCounts[level] = total - batches.levelOffsets[level];
+    }
+
+    // Grow without shrinking, only the first total instances are valid
+    if (batches.instances.size() < total)
+        batches.instances.resize(std::max(total, set.instances.size()));
+
+    // Copy visible ranges to their level batch
+    parallelFor(blockCount, [&](size_t block, size_t) {
+        PROFILE_ZONE("copyInstanceBlock");
+
+        const std::vector<InstanceRange> & ranges = batches.blockRanges[block];
+        size_t * offsets = &batches.blockOffsets[block * levelCount];
+
+        for (size_t i = 0; i < ranges.size(); i++) {
+            const InstanceRange & range = ranges[i];
+
+            std::memcpy(
+                &batches.instances[offsets[range.level]],
+                &set.instances[range.offset],
+                range.count * sizeof(Instance));
+
+            offsets[range.level] += range.count;
+        }
+    });
+}
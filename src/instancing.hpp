@@ -0,0 +1,97 @@
+#ifndef CG20192_INSTANCING_HPP
+#define CG20192_INSTANCING_HPP
+
+#include "mesh.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Number of consecutive instances bounded by one cluster sphere
+const size_t INSTANCE_CLUSTER_SIZE = 64;
+
+// Per-instance vertex attributes
+// The model matrix is affine and stored as its first three rows,
+// the material exponent is stored in the fourth component of the material color
+struct Instance {
+    glm::vec4 modelRows[3];
+    glm::vec4 materialColor;
+};
+
+static_assert(sizeof(Instance) == 64, "Unexpected instance attribute size");
+
+// Bounding sphere of a range of instances and range of their sphere radii
+struct InstanceCluster {
+    size_t offset;
+    size_t count;
+    glm::vec3 center;
+    float radius;
+    float minInstanceRadius;
+    float maxInstanceRadius;
+};
+
+// Instances sorted along a Morton curve so clusters of consecutive instances are spatially compact
+// Spheres hold the center in xyz and radius in w of each instance in world space
+struct InstanceSet {
+    std::vector<Instance> instances;
+    std::vector<glm::vec4> spheres;
+    std::vector<InstanceCluster> clusters;
+    BoundingBox bounds;
+};
+
+// Range of visible instances drawn with the same level of detail
+struct InstanceRange {
+    uint32_t offset;
+    uint32_t count;
+    uint32_t level;
+};
+
+// Visible instances grouped by level of detail, ready to upload as one attribute buffer
+// Instances of each level start at its offset, the buffer is not shrunk between frames
+// Block ranges and offsets are scratch buffers kept across frames to avoid allocations
+struct InstanceBatches {
+    std::vector<Instance> instances;
+    std::vector<size_t> levelOffsets;
+    std::vector<size_t> levelCounts;
+    std::vector<std::vector<InstanceRange> > blockRanges;
+    std::vector<size_t> blockOffsets;
+};
+
+// Get model matrix of instance
+glm::mat4 getInstanceModel(const Instance & instance);
+
+// Set model matrix rows of instance, the last row of the affine matrix is dropped
+void setInstanceModel(const glm::mat4 & model, Instance & instance);
+
+// Place instances of mesh on a jittered cubic grid around the origin
+// Rotation about the vertical axis, scale and color of each instance depend only on its index
+void placeInstances(
+        size_t count,
+        const BoundingBox & meshBounds,
+        float materialExponent,
+        std::vector<Instance> & instances);
+
+// Sort instances spatially and compute instance and cluster bounding spheres
+void buildInstanceSet(
+        const std::vector<Instance> & instances,
+        const BoundingBox & meshBounds,
+        InstanceSet & set);
+
+// Find instances intersecting the view frustum and group them by level of detail
+// Clusters outside the frustum are skipped and clusters inside it are accepted without
+// testing their instances, so the cost grows with the number of clusters crossing the frustum
+// Levels are selected as for a single mesh, from the projected sphere diameter in pixels,
+// where projection scale is the vertical projection factor times the viewport height
+void cullInstances(
+        const InstanceSet & set,
+        const std::vector<LevelOfDetail> & levels,
+        const glm::mat4 & viewProjection,
+        const glm::vec3 & camera,
+        float projectionScale,
+        float pixelError,
+        InstanceBatches & batches);
+
+#endif
@@ -0,0 +1,314 @@
+#include "light_clusters.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Lights handled by a single task when computing light ranges
+const size_t LIGHT_BLOCK_SIZE = 256;
+
+// Values per light range: first and last tile column, tile row and slice
+const size_t LIGHT_RANGE_SIZE = 6;
+
+// Radius of placed lights relative to the bounds diagonal divided by the cube root of the count
+const float PLACED_LIGHT_RADIUS = 0.5f;
+
+// Intensity of placed lights relative to their squared radius
+const float PLACED_LIGHT_INTENSITY = 0.1f;
+
+// Integer hash with good avalanche (lowbias32)
+uint32_t hashInteger(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+
+    return x;
+}
+
+// Get uniform random number in [0, 1) from light index and stream
+float getRandom(size_t index, uint32_t stream) {
+    return (hashInteger((uint32_t)index * 8u + stream) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Get slice of view depth, matching the fragment shader
+size_t getSlice(const ClusterGrid & grid, float depth) {
+    if (depth <= 0.0f)
+        return 0;
+
+    float slice = std::floor(std::log(depth) * grid.sliceScale + grid.sliceBias);
+
+    return (size_t)std::min(std::max(slice, 0.0f), (float)(grid.sliceCount - 1));
+}
+
+// Get tile of window coordinate in pixels, clamped to the tile count
+size_t getTile(float coordinate, size_t tileCount) {
+    float tile = std::floor(coordinate / CLUSTER_TILE_SIZE);
+
+    return (size_t)std::min(std::max(tile, 0.0f), (float)(tileCount - 1));
+}
+
+// Check whether sphere intersects box
+bool intersectSphereBox(const glm::vec4 & sphere, const BoundingBox & box) {
+    glm::vec3 center(sphere);
+    glm::vec3 offset = glm::max(box.min - center, glm::vec3(0.0f)) + glm::max(center - box.max, glm::vec3(0.0f));
+
+    return glm::dot(offset, offset) <= sphere.w * sphere.w;
+}
+
+// Find view space sphere, slice range and tile rectangle of light
+// Lights outside the depth range get an empty slice range
+void computeLightRange(
+        const ClusterGrid & grid,
+        const glm::mat4 & view,
+        const PointLight & light,
+        glm::vec4 & sphere,
+        uint32_t * range) {
+    glm::vec3 center(view * glm::vec4(light.position, 1.0f));
+    sphere = glm::vec4(center, light.radius);
+
+    float minDepth = -center.z - light.radius;
+    float maxDepth = -center.z + light.radius;
+
+    if (maxDepth < grid.near || minDepth > grid.far) {
+        range[4] = 1;
+        range[5] = 0;
+        return;
+    }
+
+    range[4] = (uint32_t)getSlice(grid, minDepth);
+    range[5] = (uint32_t)getSlice(grid, maxDepth);
+
+    // Spheres crossing the near plane may cover any tile
+    if (minDepth <= grid.near) {
+        range[0] = 0;
+        range[1] = (uint32_t)grid.tileCountX - 1;
+        range[2] = 0;
+        range[3] = (uint32_t)grid.tileCountY - 1;
+        return;
+    }
+
+    // Project corners of the box around the sphere, all in front of the near plane
+    glm::vec2 minCoordinate(INFINITY);
+    glm::vec2 maxCoordinate(-INFINITY);
+
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = center + glm::vec3(
+            i & 1 ? light.radius : -light.radius,
+            i & 2 ? light.radius : -light.radius,
+            i & 4 ? light.radius : -light.radius);
+
+        glm::vec4 clip = grid.projection * glm::vec4(corner, 1.0f);
+        glm::vec2 coordinate = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(grid.width, grid.height);
+
+        minCoordinate = glm::min(minCoordinate, coordinate);
+        maxCoordinate = glm::max(maxCoordinate, coordinate);
+    }
+
+    range[0] = (uint32_t)getTile(minCoordinate.x, grid.tileCountX);
+    range[1] = (uint32_t)getTile(maxCoordinate.x, grid.tileCountX);
+    range[2] = (uint32_t)getTile(minCoordinate.y, grid.tileCountY);
+    range[3] = (uint32_t)getTile(maxCoordinate.y, grid.tileCountY);
+}
+
+// Bin lights of slice by tile, keeping lights in increasing order within each tile
+void assignSliceLights(const ClusterGrid & grid, size_t slice, LightClusters & clusters) {
+    size_t tileCount = grid.tileCountX * grid.tileCountY;
+    size_t lightCount = clusters.lightSpheres.size();
+
+    const BoundingBox * bounds = grid.bounds.data() + slice * tileCount;
+
+    std::vector<uint32_t> & entries = clusters.sliceEntries[slice];
+    std::vector<uint32_t> & indices = clusters.sliceIndices[slice];
+    std::vector<uint32_t> & counts = clusters.sliceCounts[slice];
+
+    entries.clear();
+    counts.assign(tileCount + 1, 0);
+
+    // Test lights covering slice against the clusters of their tile rectangle
+    for (size_t i = 0; i < lightCount; i++) {
+        const uint32_t * range = &clusters.lightRanges[i * LIGHT_RANGE_SIZE];
+
+        if (slice < range[4] || slice > range[5])
+            continue;
+
+        for (uint32_t y = range[2]; y <= range[3]; y++) {
+            for (uint32_t x = range[0]; x <= range[1]; x++) {
+                uint32_t tile = y * (uint32_t)grid.tileCountX + x;
+
+                if (!intersectSphereBox(clusters.lightSpheres[i], bounds[tile]))
+                    continue;
+
+                entries.push_back(tile);
+                entries.push_back((uint32_t)i);
+                counts[tile + 1]++;
+            }
+        }
+    }
+
+    // Sort entries by tile with a counting sort, counts become tile offsets
+    for (size_t i = 0; i < tileCount; i++)
+        counts[i + 1] += counts[i];
+
+    indices.resize(entries.size() / 2);
+
+    std::vector<uint32_t> offsets(counts.begin(), counts.end() - 1);
+
+    for (size_t i = 0; i < entries.size(); i += 2)
+        indices[offsets[entries[i]]++] = entries[i + 1];
+}
+
+}
+
+void createClusterGrid(
+        size_t width,
+        size_t height,
+        const glm::mat4 & projection,
+        float near,
+        float far,
+        ClusterGrid & grid) {
+    PROFILE_ZONE("createClusterGrid");
+
+    grid.width = width;
+    grid.height = height;
+    grid.projection = projection;
+    grid.near = near;
+    grid.far = far;
+
+    grid.tileCountX = std::max<size_t>(1, (width + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE);
+    grid.tileCountY = std::max<size_t>(1, (height + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE);
+    grid.sliceCount = CLUSTER_SLICE_COUNT;
+
+    grid.sliceScale = grid.sliceCount / std::log(far / CLUSTER_NEAR);
+    grid.sliceBias = -std::log(CLUSTER_NEAR) * grid.sliceScale;
+
+    // Get view space direction through tile corners, scaled to unit depth
+    glm::mat4 inverseProjection = glm::inverse(projection);
+
+    std::vector<glm::vec3> directions((grid.tileCountX + 1) * (grid.tileCountY + 1));
+
+    for (size_t y = 0; y <= grid.tileCountY; y++) {
+        for (size_t x = 0; x <= grid.tileCountX; x++) {
+            glm::vec2 coordinate(
+                std::min(x * CLUSTER_TILE_SIZE, width) / (float)std::max<size_t>(width, 1),
+                std::min(y * CLUSTER_TILE_SIZE, height) / (float)std::max<size_t>(height, 1));
+
+            glm::vec4 point = inverseProjection * glm::vec4(coordinate * 2.0f - 1.0f, -1.0f, 1.0f);
+            glm::vec3 direction = glm::vec3(point) / point.w;
+
+            directions[y * (grid.tileCountX + 1) + x] = direction / -direction.z;
+        }
+    }
+
+    // Bound frustum part of each cluster between its slice depths
+    grid.bounds.resize(grid.tileCountX * grid.tileCountY * grid.sliceCount);
+
+    for (size_t slice = 0; slice < grid.sliceCount; slice++) {
+        float depths[2] = {
+            slice == 0 ? near : CLUSTER_NEAR * std::pow(far / CLUSTER_NEAR, slice / (float)grid.sliceCount),
+            CLUSTER_NEAR * std::pow(far / CLUSTER_NEAR, (slice + 1) / (float)grid.sliceCount)
+        };
+
+        for (size_t y = 0; y < grid.tileCountY; y++) {
+            for (size_t x = 0; x < grid.tileCountX; x++) {
+                BoundingBox & bounds = grid.bounds[(slice * grid.tileCountY + y) * grid.tileCountX + x];
+                bounds.min = glm::vec3(INFINITY);
+                bounds.max = glm::vec3(-INFINITY);
+
+                for (int i = 0; i < 8; i++) {
+                    size_t corner = (y + (i >> 1 & 1)) * (grid.tileCountX + 1) + x + (i & 1);
+                    glm::vec3 point = directions[corner] * depths[i >> 2];
+
+                    bounds.min = glm::min(bounds.min, point);
+                    bounds.max = glm::max(bounds.max, point);
+                }
+            }
+        }
+    }
+}
+
+bool isClusterGridValid(const ClusterGrid & grid, size_t width, size_t height, const glm::mat4 & projection) {
+    return !grid.bounds.empty() && grid.width == width && grid.height == height && grid.projection == projection;
+}
+
+void assignLights(
+        const ClusterGrid & grid,
+        const glm::mat4 & view,
+        const std::vector<PointLight> & lights,
+        LightClusters & clusters) {
+    PROFILE_ZONE("assignLights");
+
+    size_t tileCount = grid.tileCountX * grid.tileCountY;
+    size_t lightCount = lights.size();
+
+    // Find view space spheres and cluster ranges of lights in parallel blocks
+    clusters.lightSpheres.resize(lightCount);
+    clusters.lightRanges.resize(lightCount * LIGHT_RANGE_SIZE);
+
+    parallelFor((lightCount + LIGHT_BLOCK_SIZE - 1) / LIGHT_BLOCK_SIZE, [&](size_t block, size_t) {
+        size_t end = std::min(lightCount, (block + 1) * LIGHT_BLOCK_SIZE);
+
+        for (size_t i = block * LIGHT_BLOCK_SIZE; i < end; i++)
+            computeLightRange(
+                grid,
+                view,
+                lights[i],
+                clusters.lightSpheres[i],
+                &clusters.lightRanges[i * LIGHT_RANGE_SIZE]);
+    });
+
+    // Bin lights of each slice independently
+    clusters.sliceEntries.resize(grid.sliceCount);
+    clusters.sliceIndices.resize(grid.sliceCount);
+    clusters.sliceCounts.resize(grid.sliceCount);
+
+    parallelFor(grid.sliceCount, [&](size_t slice, size_t) {
+        assignSliceLights(grid, slice, clusters);
+    });
+
+    // Concatenate slice lists and offset cluster ranges by the preceding slices
+    std::vector<size_t> sliceOffsets(grid.sliceCount + 1, 0);
+
+    for (size_t i = 0; i < grid.sliceCount; i++)
+        sliceOffsets[i + 1] = sliceOffsets[i] + clusters.sliceIndices[i].size();
+
+    clusters.ranges.resize(tileCount * grid.sliceCount * 2);
+    clusters.indices.resize(sliceOffsets[grid.sliceCount]);
+
+    parallelFor(grid.sliceCount, [&](size_t slice, size_t) {
+        const std::vector<uint32_t> & indices = clusters.sliceIndices[slice];
+        const std::vector<uint32_t> & counts = clusters.sliceCounts[slice];
+
+        std::copy(indices.begin(), indices.end(), clusters.indices.begin() + sliceOffsets[slice]);
+
+        for (size_t i = 0; i < tileCount; i++) {
+            uint32_t * range = &clusters.ranges[(slice * tileCount + i) * 2];
+            range[0] = (uint32_t)(sliceOffsets[slice] + counts[i]);
+            range[1] = counts[i + 1] - counts[i];
+        }
+    });
+}
+
+void placeLights(size_t count, const BoundingBox & bounds, std::vector<PointLight> & lights) {
+    lights.resize(count);
+
+    glm::vec3 extent = bounds.max - bounds.min;
+    float radius = PLACED_LIGHT_RADIUS * glm::length(extent) / std::cbrt((float)std::max<size_t>(count, 1));
+
+    for (size_t i = 0; i < count; i++) {
+        PointLight & light = lights[i];
+
+        light.position = bounds.min + extent * glm::vec3(getRandom(i, 0), getRandom(i, 1), getRandom(i, 2));
+        light.radius = radius;
+        light.color = glm::vec3(
+            0.25f + 0.75f * getRandom(i, 3),
+            0.25f + 0.75f * getRandom(i, 4),
+            0.25f + 0.75f * getRandom(i, 5)) * PLACED_LIGHT_INTENSITY * radius * radius;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef CG20192_LIGHT_CLUSTERS_HPP
+#define CG20192_LIGHT_CLUSTERS_HPP
+
+#include "mesh.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Cluster grid resolution: screen tiles in pixels and exponential depth slices
+const size_t CLUSTER_TILE_SIZE = 64;
+const size_t CLUSTER_SLICE_COUNT = 32;
+
+// View depth where exponential slices begin, closer fragments fall in the first slice
+const float CLUSTER_NEAR = 1.0f;
+
+// Point light with a finite radius, its inverse square falloff is windowed to zero at the radius
+struct PointLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+};
+
+// Froxel grid of the view frustum, clusters are ordered by slice, then tile row, then tile column
+// Cluster bounds are view space boxes enclosing their frustum part
+struct ClusterGrid {
+    size_t width;
+    size_t height;
+    glm::mat4 projection;
+    float near;
+    float far;
+
+    size_t tileCountX;
+    size_t tileCountY;
+    size_t sliceCount;
+
+    float sliceScale;
+    float sliceBias;
+
+    std::vector<BoundingBox> bounds;
+};
+
+// Light index lists of every cluster, packed one after another
+// Cluster ranges hold the offset and count of their indices
+// Buffers are kept across frames to avoid allocations
+struct LightClusters {
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> indices;
+
+    std::vector<glm::vec4> lightSpheres;
+    std::vector<uint32_t> lightRanges;
+    std::vector<std::vector<uint32_t> > sliceEntries;
+    std::vector<std::vector<uint32_t> > sliceIndices;
+    std::vector<std::vector<uint32_t> > sliceCounts;
+};
+
+// Build cluster grid of viewport with perspective projection between near and far planes
+// The fragment slice is floor(log(depth) * slice scale + slice bias), clamped to the grid
+void createClusterGrid(
+        size_t width,
+        size_t height,
+        const glm::mat4 & projection,
+        float near,
+        float far,
+        ClusterGrid & grid);
+
+// Check whether grid was built for viewport and projection
+bool isClusterGridValid(const ClusterGrid & grid, size_t width, size_t height, const glm::mat4 & projection);
+
+// Bin lights in the clusters their spheres intersect, slices are binned in parallel
+// Lights are given in the space transformed to view space by the view matrix, which must be rigid
+// Work is proportional to the number of clusters touched by each light, not to the cluster count
+void assignLights(
+        const ClusterGrid & grid,
+        const glm::mat4 & view,
+        const std::vector<PointLight> & lights,
+        LightClusters & clusters);
+
+// Scatter lights with random colors inside bounds
+// Radii shrink with the light count so lights overlap about the same number of neighbours
+void placeLights(size_t count, const BoundingBox & bounds, std::vector<PointLight> & lights);
+
+#endif
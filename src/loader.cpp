@@ -0,0 +1,553 @@
+#include "loader.hpp"
+#include "obj.hpp"
+#include "mesh_cache.hpp"
+#include "chunked_mesh.hpp"
+#include "optimization.hpp"
+#include "tangent_space.hpp"
+#include "image.hpp"
+#include "texture_cache.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Store vertices in the vertex format, quantizing them against the bounding box
+// Mapped vertices are kept in place when they are already in the vertex format
+void storeVertices(
+        const Vertex * vertices,
+        size_t vertexCount,
+        VertexFormat vertexFormat,
+        bool mapped,
+        MeshAsset & asset) {
+    asset.vertexCount = vertexCount;
+    asset.vertexBytes = vertexCount * getVertexSize(vertexFormat);
+    asset.vertexFormat = vertexFormat;
+    asset.dequantization = glm::mat4(1.0f);
+
+    if (vertexFormat == VERTEX_FORMAT_FLOAT) {
+        const unsigned char * bytes = (const unsigned char *)vertices;
+
+        if (mapped)
+            asset.vertices = bytes;
+        else {
+            asset.vertexStorage.assign(bytes, bytes + asset.vertexBytes);
+            asset.vertices = asset.vertexStorage.data();
+        }
+
+        return;
+    }
+
+    // Quantize vertices and report error bounds
+    std::vector<QuantizedVertex> quantizedVertices;
+    QuantizationError error;
+
+    quantizeVertices(
+        vertices,
+        vertexCount,
+        asset.bounds,
+        quantizedVertices,
+        asset.dequantization,
+        error);
+
+    const unsigned char * bytes = (const unsigned char *)quantizedVertices.data();
+    asset.vertexStorage.assign(bytes, bytes + asset.vertexBytes);
+    asset.vertices = asset.vertexStorage.data();
+
+    // Write message at once, so messages of concurrent loader threads do not interleave
+    std::ostringstream message;
+
+    message << "Quantized vertices: "
+        << sizeof(Vertex) << " to " << sizeof(QuantizedVertex) << " bytes per vertex, "
+        << "maximum position error " << error.position << ", "
+        << "normal error " << error.normal << " degrees, "
+        << "texture coordinate error " << error.textureCoordinate << "." << std::endl;
+
+    std::cout << message.str();
+}
+
+// Append mipmap level to storage of image asset
+// Point the image data at the storage once every level is appended
+void appendImageLevel(size_t width, size_t height, const void * data, size_t size, ImageAsset & asset) {
+    ImageAssetLevel level;
+    level.width = width;
+    level.height = height;
+    level.offset = asset.storage.size();
+    level.size = size;
+
+    const unsigned char * bytes = (const unsigned char *)data;
+    asset.storage.insert(asset.storage.end(), bytes, bytes + size);
+
+    asset.levels.push_back(level);
+}
+
+// Read requests claimed from the loader until none is left
+void runAssetLoader(AssetLoader * loader) {
+    size_t index;
+
+    while ((index = loader->nextRequest.fetch_add(1)) < loader->requests.size()) {
+        PROFILE_ZONE("loadAsset");
+
+        const AssetRequest & request = loader->requests[index];
+
+        LoadedAsset * asset = new LoadedAsset();
+        asset->type = request.type;
+        asset->index = request.index;
+        asset->filename = request.filename;
+        asset->file.data = nullptr;
+        asset->file.size = 0;
+
+        if (request.type == ASSET_MESH)
+            asset->loaded = readMeshAsset(
+                request.filename,
+                loader->vertexFormat,
+                loader->settings,
+                asset->file,
+                asset->mesh);
+        else
+            asset->loaded = readImageAsset(
+                request.filename,
+                loader->sRGB,
+                loader->filter,
+                loader->compression,
+                asset->file,
+                asset->image);
+
+        // The queue holds every request, so it is never full
+        pushLoadedAsset(loader->queue, asset);
+    }
+}
+
+}
+
+void createLoadedAssetQueue(size_t capacity, LoadedAssetQueue & queue) {
+    size_t size = 2;
+
+    while (size < capacity)
+        size *= 2;
+
+    queue.cells.reset(new LoadedAssetQueueCell[size]);
+    queue.mask = size - 1;
+
+    for (size_t i = 0; i < size; i++) {
+        queue.cells[i].sequence.store(i, std::memory_order_relaxed);
+        queue.cells[i].asset = nullptr;
+    }
+
+    queue.enqueuePosition.store(0, std::memory_order_relaxed);
+    queue.dequeuePosition.store(0, std::memory_order_relaxed);
+}
+
+bool pushLoadedAsset(LoadedAssetQueue & queue, LoadedAsset * asset) {
+    size_t position = queue.enqueuePosition.load(std::memory_order_relaxed);
+    LoadedAssetQueueCell * cell;
+
+    // A cell is free for a position when its sequence equals the position
+    while (true) {
+        cell = &queue.cells[position & queue.mask];
+
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+        if (difference == 0) {
+            if (queue.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+            return false;
+        else
+            position = queue.enqueuePosition.load(std::memory_order_relaxed);
+    }
+
+    cell->asset = asset;
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool popLoadedAsset(LoadedAssetQueue & queue, LoadedAsset *& asset) {
+    size_t position = queue.dequeuePosition.load(std::memory_order_relaxed);
+    LoadedAssetQueueCell * cell;
+
+    // A cell is filled for a position when its sequence is one past the position
+    while (true) {
+        cell = &queue.cells[position & queue.mask];
+
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+        if (difference == 0) {
+            if (queue.dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+            return false;
+        else
+            position = queue.dequeuePosition.load(std::memory_order_relaxed);
+    }
+
+    asset = cell->asset;
+    cell->sequence.store(position + queue.mask + 1, std::memory_order_release);
+
+    return true;
+}
+
+// Read triangle mesh from Wavefront OBJ file, simplify it in levels of detail,
+// optimize it for rendering, split it in meshlets and rebuild the binary mesh cache next to it
+bool buildTriangleMeshFile(
+        const std::string & filename,
+        const LevelOfDetailSettings & settings,
+        TriangleMesh & mesh) {
+    PROFILE_ZONE("buildTriangleMeshFile");
+
+    // Read triangle mesh from Wavefront OBJ file format
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> textureCoordinates;
+        std::vector<uint32_t> positionIndices;
+        std::vector<uint32_t> normalIndices;
+        std::vector<uint32_t> textureCoordinateIndices;
+
+        if (!readTriangleMesh(
+                filename,
+                positions,
+                normals,
+                textureCoordinates,
+                positionIndices,
+                normalIndices,
+                textureCoordinateIndices))
+            return false;
+
+        // Merge shared vertices in an indexed triangle mesh
+        buildTriangleMesh(
+            positions,
+            normals,
+            textureCoordinates,
+            positionIndices,
+            normalIndices,
+            textureCoordinateIndices,
+            mesh);
+    }
+
+    VertexCacheStatistics original, optimized;
+    analyzeVertexCache(
+        mesh.indices.data(),
+        mesh.indices.size(),
+        mesh.vertices.size(),
+        VERTEX_CACHE_SIZE,
+        original);
+
+    // Simplify levels of detail sharing the vertices
+    generateLevelsOfDetail(mesh, settings);
+
+    // Write messages at once, so messages of concurrent loader threads do not interleave
+    std::ostringstream message;
+
+    for (size_t i = 0; i < mesh.levels.size(); i++)
+        message << "Level of detail " << i << ": "
+            << mesh.levels[i].indexCount / 3 << " triangles, "
+            << "error " << mesh.levels[i].error << "." << std::endl;
+
+    std::cout << message.str();
+
+    // Reorder triangles and vertices for vertex cache, overdraw and vertex fetch
+    optimizeTriangleMesh(mesh);
+
+    // Split levels of detail in meshlets for culling
+    buildMeshlets(mesh);
+
+    message.str("");
+    message << "Meshlets: " << mesh.meshlets.size() << "." << std::endl;
+
+    std::cout << message.str();
+
+    // Generate tangents once vertices are in their final order
+    generateTangents(mesh, mesh.tangents);
+
+    analyzeVertexCache(
+        mesh.indices.data(),
+        mesh.levels[0].indexCount,
+        mesh.vertices.size(),
+        VERTEX_CACHE_SIZE,
+        optimized);
+
+    message.str("");
+    message << "Optimized triangle mesh: "
+        << "ACMR " << original.acmr << " to " << optimized.acmr << ", "
+        << "ATVR " << original.atvr << " to " << optimized.atvr << "." << std::endl;
+
+    std::cout << message.str();
+
+    // Rebuild cache for the next runs
+    if (!writeMeshCache(getMeshCacheFilename(filename), filename, settings, mesh))
+        std::cout << "Cannot write mesh cache." << std::endl;
+
+    return true;
+}
+
+// Read triangle mesh from Wavefront OBJ file to memory through the binary mesh cache
+// The cache is copied when it is up to date, otherwise the source file is processed
+bool readTriangleMeshFile(
+        const std::string & filename,
+        const LevelOfDetailSettings & settings,
+        TriangleMesh & mesh) {
+    PROFILE_ZONE("readTriangleMeshFile");
+
+    MeshCache cache;
+
+    if (openMeshCache(getMeshCacheFilename(filename), filename, settings, cache)) {
+        mesh.vertices.assign(cache.vertices, cache.vertices + cache.vertexCount);
+        unpackIndices(cache.indices, cache.indexCount, cache.indexSize, mesh.indices);
+
+        mesh.levels = cache.levels;
+        mesh.meshlets.assign(cache.meshlets, cache.meshlets + cache.meshletCount);
+
+        if (cache.tangents != nullptr)
+            mesh.tangents.assign(cache.tangents, cache.tangents + cache.vertexCount);
+        else
+            mesh.tangents.clear();
+
+        closeMeshCache(cache);
+
+        return true;
+    }
+
+    return buildTriangleMeshFile(filename, settings, mesh);
+}
+
+// Read triangle mesh through the binary mesh cache in the vertex format
+bool readMeshAsset(
+        const std::string & filename,
+        VertexFormat vertexFormat,
+        const LevelOfDetailSettings & settings,
+        MappedFile & file,
+        MeshAsset & asset) {
+    PROFILE_ZONE("readMeshAsset");
+
+    std::string chunkedFilename;
+    size_t chunkIndex;
+
+    MeshCache cache;
+
+    // Point at chunk of mapped chunked mesh file with its single level of detail
+    if (isChunkedMeshFilename(filename)) {
+        ChunkedMesh chunkedMesh;
+
+        if (!parseMeshChunkFilename(filename, chunkedFilename, chunkIndex)
+                || !openChunkedMesh(chunkedFilename, chunkedMesh))
+            return false;
+
+        if (chunkIndex >= chunkedMesh.chunks.size()) {
+            closeChunkedMesh(chunkedMesh);
+            return false;
+        }
+
+        const MeshChunk & chunk = chunkedMesh.chunks[chunkIndex];
+
+        const Vertex * vertices;
+        const void * indices;
+        const Meshlet * meshlets;
+
+        getMeshChunk(chunkedMesh, chunkIndex, vertices, indices, meshlets);
+
+        LevelOfDetail level;
+        level.indexOffset = 0;
+        level.indexCount = (size_t)chunk.indexCount;
+        level.error = 0.0f;
+        level.meshletOffset = 0;
+        level.meshletCount = (size_t)chunk.meshletCount;
+
+        asset.indices = (const unsigned char *)indices;
+        asset.indexCount = (size_t)chunk.indexCount;
+        asset.indexSize = chunk.indexSize;
+        asset.indexBytes = asset.indexCount * asset.indexSize;
+        asset.levels.assign(1, level);
+        asset.meshlets.assign(meshlets, meshlets + chunk.meshletCount);
+        asset.bounds = chunk.bounds;
+
+        storeVertices(vertices, (size_t)chunk.vertexCount, vertexFormat, true, asset);
+
+        // Keep file mapped until upload
+        file = chunkedMesh.file;
+    }
+    // Point at vertex and index data of mapped cache file
+    else if (openMeshCache(getMeshCacheFilename(filename), filename, settings, cache)) {
+        asset.indices = (const unsigned char *)cache.indices;
+        asset.indexCount = cache.indexCount;
+        asset.indexSize = cache.indexSize;
+        asset.indexBytes = asset.indexCount * asset.indexSize;
+        asset.levels = cache.levels;
+        asset.meshlets.assign(cache.meshlets, cache.meshlets + cache.meshletCount);
+        asset.bounds = cache.bounds;
+
+        storeVertices(cache.vertices, cache.vertexCount, vertexFormat, true, asset);
+
+        // Keep file mapped until upload
+        file = cache.file;
+    }
+    else {
+        TriangleMesh mesh;
+
+        if (!buildTriangleMeshFile(filename, settings, mesh))
+            return false;
+
+        packIndices(mesh.indices, mesh.vertices.size(), asset.indexStorage);
+
+        asset.indices = asset.indexStorage.data();
+        asset.indexCount = mesh.indices.size();
+        asset.indexSize = getIndexSize(mesh.vertices.size());
+        asset.indexBytes = asset.indexStorage.size();
+        asset.levels = mesh.levels;
+        asset.meshlets = mesh.meshlets;
+        asset.bounds = computeBoundingBox(mesh.vertices.data(), mesh.vertices.size());
+
+        storeVertices(mesh.vertices.data(), mesh.vertices.size(), vertexFormat, false, asset);
+    }
+
+    buildMeshletBounds(asset.meshlets.data(), asset.meshlets.size(), asset.meshletBounds);
+
+    return true;
+}
+
+// Read image with its mipmap chain through the texture cache
+bool readImageAsset(
+        const std::string & filename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        MappedFile & file,
+        ImageAsset & asset) {
+    PROFILE_ZONE("readImageAsset");
+
+    std::string cacheFilename = getTextureCacheFilename(filename);
+
+    // Point at every level of mapped cache file
+    TextureCache cache;
+
+    if (openTextureCache(cacheFilename, filename, sRGB, filter, compression, cache)) {
+        asset.data = (const unsigned char *)cache.file.data;
+
+        for (size_t i = 0; i < cache.levels.size(); i++) {
+            const TextureLevel & level = cache.levels[i];
+
+            ImageAssetLevel assetLevel;
+            assetLevel.width = level.width;
+            assetLevel.height = level.height;
+            assetLevel.offset = (const unsigned char *)level.data - asset.data;
+            assetLevel.size = level.size;
+
+            asset.levels.push_back(assetLevel);
+        }
+
+        asset.internalFormat = cache.internalFormat;
+        asset.format = cache.format;
+        asset.type = cache.type;
+        asset.alignment = cache.alignment;
+
+        // Keep file mapped until upload
+        file = cache.file;
+
+        return true;
+    }
+
+    // Read 8-bit or 16-bit image from Netpbm file format
+    Image image;
+
+    if (!readImage(filename, image))
+        return false;
+
+    // Build mipmap chain
+    std::vector<Image> images;
+    buildMipmaps(image, sRGB, filter, images);
+
+    // Compress every level of 8-bit images
+    if (compression.format != TEXTURE_COMPRESSION_NONE && isImageCompressible(image)) {
+        std::vector<CompressedImage> compressedImages(images.size());
+
+        for (size_t i = 0; i < images.size(); i++)
+            compressImage(images[i], compression, compressedImages[i]);
+
+        // Rebuild cache for the next runs
+        if (!writeCompressedTextureCache(cacheFilename, filename, sRGB, filter, compression, compressedImages))
+            std::cout << "Cannot write texture cache." << std::endl;
+
+        for (size_t i = 0; i < compressedImages.size(); i++) {
+            const CompressedImage & level = compressedImages[i];
+            appendImageLevel(level.width, level.height, level.blocks.data(), level.blocks.size(), asset);
+        }
+
+        asset.data = asset.storage.data();
+
+        asset.internalFormat = getCompressedTextureFormat(compression.format, sRGB);
+        asset.format = 0;
+        asset.type = 0;
+        asset.alignment = 1;
+
+        return true;
+    }
+
+    // Rebuild cache for the next runs
+    if (!writeTextureCache(cacheFilename, filename, sRGB, filter, compression, images))
+        std::cout << "Cannot write texture cache." << std::endl;
+
+    // Keep tightly packed levels
+    for (size_t i = 0; i < images.size(); i++)
+        appendImageLevel(images[i].width, images[i].height, images[i].pixels.data(), images[i].pixels.size(), asset);
+
+    asset.data = asset.storage.data();
+
+    getTextureFormat(image, sRGB, asset.internalFormat, asset.format, asset.type);
+    asset.alignment = 1;
+
+    return true;
+}
+
+void deleteLoadedAsset(LoadedAsset * asset) {
+    closeMappedFile(asset->file);
+    delete asset;
+}
+
+void startAssetLoader(
+        const std::vector<AssetRequest> & requests,
+        VertexFormat vertexFormat,
+        const LevelOfDetailSettings & settings,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        size_t threadCount,
+        AssetLoader & loader) {
+    loader.requests = requests;
+    loader.nextRequest.store(0);
+    loader.vertexFormat = vertexFormat;
+    loader.settings = settings;
+    loader.sRGB = sRGB;
+    loader.filter = filter;
+    loader.compression = compression;
+
+    createLoadedAssetQueue(requests.size(), loader.queue);
+
+    threadCount = std::min(threadCount, requests.size());
+
+    for (size_t i = 0; i < threadCount; i++)
+        loader.threads.push_back(std::thread(runAssetLoader, &loader));
+}
+
+void stopAssetLoader(AssetLoader & loader) {
+    // Skip requests not claimed yet
+    loader.nextRequest.store(loader.requests.size());
+
+    for (size_t i = 0; i < loader.threads.size(); i++)
+        loader.threads[i].join();
+
+    loader.threads.clear();
+
+    LoadedAsset * asset;
+
+    while (popLoadedAsset(loader.queue, asset))
+        deleteLoadedAsset(asset);
+}
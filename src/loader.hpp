@@ -0,0 +1,188 @@
+#ifndef CG20192_LOADER_HPP
+#define CG20192_LOADER_HPP
+
+#include "mesh.hpp"
+#include "meshlet.hpp"
+#include "quantization.hpp"
+#include "simplification.hpp"
+#include "mipmap.hpp"
+#include "texture_compression.hpp"
+#include "file.hpp"
+
+#include <glm/mat4x4.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Kind of asset read by the loader
+enum AssetType {
+    ASSET_MESH,
+    ASSET_IMAGE
+};
+
+// Triangle mesh in memory in the layout uploaded to OpenGL
+// Vertices are in the vertex format and indices are packed in integers of index size
+// Vertices and indices point into the mapped file of the loaded asset when they are stored
+// in the upload layout, otherwise into the storage of the asset
+struct MeshAsset {
+    const unsigned char * vertices;
+    size_t vertexCount;
+    size_t vertexBytes;
+    VertexFormat vertexFormat;
+    const unsigned char * indices;
+    size_t indexCount;
+    size_t indexSize;
+    size_t indexBytes;
+    std::vector<LevelOfDetail> levels;
+    std::vector<Meshlet> meshlets;
+    MeshletBounds meshletBounds;
+    glm::mat4 dequantization;
+    BoundingBox bounds;
+
+    std::vector<unsigned char> vertexStorage;
+    std::vector<unsigned char> indexStorage;
+};
+
+// Mipmap level of image asset at offset from the image data
+// Rows are padded to the row alignment in bytes
+struct ImageAssetLevel {
+    size_t width;
+    size_t height;
+    size_t offset;
+    size_t size;
+};
+
+// Complete mipmap chain in memory in the layout uploaded to OpenGL
+// Block compressed images have no pixel format and type, their levels hold rows of blocks
+// The data points into the mapped file of the loaded asset when read from the texture cache,
+// otherwise into the storage of the asset
+struct ImageAsset {
+    const unsigned char * data;
+    std::vector<ImageAssetLevel> levels;
+    uint32_t internalFormat;
+    uint32_t format;
+    uint32_t type;
+    size_t alignment;
+
+    std::vector<unsigned char> storage;
+};
+
+// Asset read by a loader thread, not loaded when its file cannot be read
+// The cache or chunked mesh file is kept mapped until the asset is uploaded, so its data
+// is copied to OpenGL straight from the mapping, the file is empty when nothing is mapped
+struct LoadedAsset {
+    AssetType type;
+    size_t index;
+    std::string filename;
+    bool loaded;
+    MappedFile file;
+    MeshAsset mesh;
+    ImageAsset image;
+};
+
+// Asset to read by the loader, the index is passed through to the loaded asset
+struct AssetRequest {
+    AssetType type;
+    size_t index;
+    std::string filename;
+};
+
+// Cell of the loaded asset queue, its sequence tells whether it is free or filled for a position
+struct LoadedAssetQueueCell {
+    std::atomic<size_t> sequence;
+    LoadedAsset * asset;
+};
+
+// Bounded lock-free queue handing loaded assets from loader threads to the render thread
+// Multiple producers and consumers claim positions with compare and swap on the cell sequences
+struct LoadedAssetQueue {
+    std::unique_ptr<LoadedAssetQueueCell[]> cells;
+    size_t mask;
+    std::atomic<size_t> enqueuePosition;
+    std::atomic<size_t> dequeuePosition;
+};
+
+// Loader threads reading requested assets in request order
+// Threads claim requests with an atomic counter and exit when all requests are claimed
+struct AssetLoader {
+    std::vector<AssetRequest> requests;
+    std::atomic<size_t> nextRequest;
+    std::vector<std::thread> threads;
+    LoadedAssetQueue queue;
+
+    VertexFormat vertexFormat;
+    LevelOfDetailSettings settings;
+    bool sRGB;
+    MipmapFilter filter;
+    TextureCompressionSettings compression;
+};
+
+// Create queue holding at least capacity assets
+void createLoadedAssetQueue(size_t capacity, LoadedAssetQueue & queue);
+
+// Append asset to queue, fails when the queue is full
+bool pushLoadedAsset(LoadedAssetQueue & queue, LoadedAsset * asset);
+
+// Remove the oldest asset from queue, fails when the queue is empty
+bool popLoadedAsset(LoadedAssetQueue & queue, LoadedAsset *& asset);
+
+// Read triangle mesh from Wavefront OBJ file, simplify it in levels of detail,
+// optimize it for rendering, split it in meshlets and rebuild the binary mesh cache next to it
+bool buildTriangleMeshFile(
+        const std::string & filename,
+        const LevelOfDetailSettings & settings,
+        TriangleMesh & mesh);
+
+// Read triangle mesh from Wavefront OBJ file to memory through the binary mesh cache
+// The cache is copied when it is up to date, otherwise the source file is processed
+bool readTriangleMeshFile(
+        const std::string & filename,
+        const LevelOfDetailSettings & settings,
+        TriangleMesh & mesh);
+
+// Read triangle mesh through the binary mesh cache in the vertex format
+// Chunk filenames of chunked mesh files read the chunk as a mesh with a single level of detail
+// Quantized vertices are dequantized by a transform to be folded into the model matrix
+// The cache or chunked mesh file stays mapped in file while the asset points into it
+bool readMeshAsset(
+        const std::string & filename,
+        VertexFormat vertexFormat,
+        const LevelOfDetailSettings & settings,
+        MappedFile & file,
+        MeshAsset & asset);
+
+// Read image with its mipmap chain through the texture cache
+// 8-bit images can be stored as sRGB to be linearized by texture sampling and mipmap filtering
+// and can be block compressed, 16-bit images are kept uncompressed
+// The cache file stays mapped in file while the asset points into it
+bool readImageAsset(
+        const std::string & filename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        MappedFile & file,
+        ImageAsset & asset);
+
+// Unmap file of loaded asset and delete it
+void deleteLoadedAsset(LoadedAsset * asset);
+
+// Start loader threads reading requests concurrently
+// Loaded assets, including failed ones, are pushed to the loader queue in completion order
+void startAssetLoader(
+        const std::vector<AssetRequest> & requests,
+        VertexFormat vertexFormat,
+        const LevelOfDetailSettings & settings,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        size_t threadCount,
+        AssetLoader & loader);
+
+// Wait for loader threads to finish and delete assets left in the queue
+void stopAssetLoader(AssetLoader & loader);
+
+#endif
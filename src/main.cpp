@@ -8,26 +8,68 @@
 #include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
 
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
-#include <sstream>
-#include <algorithm>
+
+#include "obj.hpp"
+#include "file.hpp"
+#include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "chunked_mesh.hpp"
+#include "optimization.hpp"
+#include "simplification.hpp"
+#include "meshlet.hpp"
+#include "quantization.hpp"
+#include "image.hpp"
+#include "mipmap.hpp"
+#include "texture_cache.hpp"
+#include "texture_compression.hpp"
+#include "rasterizer.hpp"
+#include "parallel.hpp"
+#include "benchmark.hpp"
+#include "profiler.hpp"
+#include "gpu_profiler.hpp"
+#include "uniforms.hpp"
+#include "instancing.hpp"
+#include "scene.hpp"
+#include "loader.hpp"
+#include "program_cache.hpp"
+#include "light_clusters.hpp"
+#include "simulation.hpp"
+#include "morph.hpp"
+#include "stream_buffer.hpp"
+#include "virtual_texture.hpp"
 
 // Global variables
 bool BACKGROUND_STATE = false;
 
+// Input recorded by window callbacks for the update thread
+SimulationInput INPUT;
+
+// Viewport size in pixels
+glm::ivec2 VIEWPORT(800, 600);
+
+// Clipping planes of the projection matrix
+const float NEAR_PLANE = 0.001f;
+const float FAR_PLANE = 1000.0f;
+
 // Transformation matrices
 glm::mat4 PROJECTION(1.0f);
 glm::mat4 VIEW(1.0f);
 glm::mat4 MODEL(1.0f);
 
-// Light
-struct Light {
-    glm::vec3 position;
-    glm::vec3 color;
-} LIGHT;
+// Light, drawn when the scene has no lights
+PointLight LIGHT;
 
 // Camera
 struct Camera {
@@ -40,62 +82,19 @@ struct Material {
     float exponent;
 } MATERIAL;
 
-// Read 8-bit RGB image from Netpbm binary file format (PPM)
-// and convert to 32-bit linear RGB image
-bool readImage(
-        const std::string & filename,
-        size_t & width, size_t & height,
-        std::vector<glm::vec3> & pixels) {
-    std::ifstream file(filename, std::ifstream::in | std::ifstream::binary);
-    
-    if (!file.is_open())
-        return false;
-    
-    std::string magic, comment;
-    size_t w, h, depth;
-    
-    file >> magic;
-    
-    file.ignore();
-
-    if (file.peek() == '#')
-        std::getline(file, comment);
-    
-    file >> w >> h >> depth;
+// Load texture with all mipmap levels to OpenGL without conversion to floating point
+// Levels are given from the full resolution image down to a single pixel
+// Grayscale textures are stored in a single channel and replicated by swizzling
+// Block compressed levels are copied as is, without pixel format and type
+// Levels without data only allocate storage, to be filled later
+GLuint loadImage(
+        const std::vector<TextureLevel> & levels,
+        GLenum internalFormat,
+        GLenum format,
+        GLenum type,
+        GLint alignment) {
+    PROFILE_ZONE("loadImage");
     
-    file.ignore();
-    
-    if (magic != "P6" || depth == 0) {
-        file.close();
-        return false;
-    }
-    
-    float inverseDepth = 1.0f / depth;
-    size_t size = w * h;
-    
-    width = w;
-    height = h;
-    
-    pixels.resize(size);
-    
-    for (size_t i = 0; i < size; i++) {
-        glm::vec3 & pixel = pixels[i];
-        unsigned char data[3];
-        
-        file.read((char *)data, sizeof(data));
-        
-        pixel.r = glm::clamp((float)data[0] * inverseDepth, 0.0f, 1.0f);
-        pixel.g = glm::clamp((float)data[1] * inverseDepth, 0.0f, 1.0f);
-        pixel.b = glm::clamp((float)data[2] * inverseDepth, 0.0f, 1.0f);
-    }
-    
-    file.close();
-    
-    return true;
-}
-
-// Load 32-bit linear RBG image to OpenGL
-GLuint loadImage(size_t width, size_t height, const std::vector<glm::vec3> & pixels) {
     GLuint textureID;
     
     // Create and bind texture
@@ -106,210 +105,96 @@ GLuint loadImage(size_t width, size_t height, const std::vector<glm::vec3> & pix
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    
-    // Copy pixel data to texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
     
-    // Generate mipmap textures
-    glGenerateMipmap(GL_TEXTURE_2D);
-    
-    return textureID;
-}
-
-// Read triangle mesh from Wavefront OBJ file format
-bool readTriangleMesh(
-        const std::string & filename,
-        std::vector<glm::vec3> & positions,
-        std::vector<glm::vec3> & normals,
-        std::vector<glm::vec2> & textureCoordinates,
-        std::vector<size_t> & positionIndices,
-        std::vector<size_t> & normalIndices,
-        std::vector<size_t> & textureCoordinateIndices) {
-    std::ifstream file(filename, std::ifstream::in);
-
-    if (!file.is_open())
-        return false;
-
-    std::string line;
-
-    while (std::getline(file, line)) {
-        std::istringstream attributes(line);
-
-        std::string type;
-        attributes >> type;
-
-        if (type == "v") {
-            glm::vec3 position;
-            attributes >> position.x >> position.y >> position.z;
-
-            positions.push_back(position);
-        }
-        else if (type == "vt") {
-            glm::vec2 textureCoordinate;
-            attributes >> textureCoordinate.x >> textureCoordinate.y;
-
-            textureCoordinates.push_back(textureCoordinate);
-        }
-        else if (type == "vn") {
-            glm::vec3 normal;
-            attributes >> normal.x >> normal.y >> normal.z;
-
-            normals.push_back(normal);
-        }
-        else if (type == "f") {
-            for (size_t i = 0; i < 3; i++) {
-                std::string tokens;
-                attributes >> tokens;
-
-                std::replace(tokens.begin(), tokens.end(), '/', ' ');
-
-                std::istringstream indices(tokens);
-                size_t index;
-
-                indices >> index;
-                positionIndices.push_back(index - 1);
-
-                if (indices.peek() == ' ') {
-                    indices.ignore();
-
-                    if (indices.peek() == ' ') {
-                        indices.ignore();
-
-                        indices >> index;
-                        normalIndices.push_back(index - 1);
-                    }
-                    else {
-                        indices >> index;
-                        textureCoordinateIndices.push_back(index - 1);
-
-                        if (indices.peek() == ' ') {
-                            indices.ignore();
-
-                            indices >> index;
-                            normalIndices.push_back(index - 1);
-                        }
-                    }
-                }
-            }
-        }
+    // Replicate single channel to RGB
+    if (format == GL_RED) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
     }
-
-    file.close();
-
-    return true;
-}
-
-// Load triangle mesh to OpenGL
-// Normal and texture coordinate attributes are calculated by primitive when not available
-// Vertex attributes are exported to shader program at locations:
-// 0: position
-// 1: normal
-// 2: texture coordinate
-size_t loadTriangleMesh(
-        const std::vector<glm::vec3> & positions,
-        const std::vector<glm::vec3> & normals,
-        const std::vector<glm::vec2> & textureCoordinates,
-        const std::vector<size_t> & positionIndices,
-        const std::vector<size_t> & normalIndices,
-        const std::vector<size_t> & textureCoordinateIndices,
-        GLenum usage,
-        GLuint & vao,
-        GLuint & vbo) {
-    // Duplicate and expand the triangle vertices in a flat array
-    struct Vertex {
-        glm::vec3 position;
-        glm::vec3 normal;
-        glm::vec2 textureCoordinate;
-    };
     
-    bool hasNormals = normalIndices.size() > 0;
-    bool hasTextureCoordinates = textureCoordinateIndices.size() > 0;
+    // Setup row alignment of pixel data
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
     
-    size_t vertexCount = positionIndices.size();
-    size_t vertexSize = sizeof(Vertex);
+    bool compressed = getTextureCompression(internalFormat) != TEXTURE_COMPRESSION_NONE;
     
-    std::vector<Vertex> vertices;
-    vertices.reserve(vertexCount);
-    
-    for (size_t i = 0; i < vertexCount / 3; i++) {
-        Vertex triangleVertices[3];
-        
-        for (size_t j = 0; j < 3; j++) {
-            Vertex & vertex = triangleVertices[j];
-            vertex.position = positions[positionIndices[i * 3 + j]];
-        }
-        
-        if (hasNormals) {
-            for (size_t j = 0; j < 3; j++){
-                Vertex & vertex = triangleVertices[j];
-                vertex.normal = normals[normalIndices[i * 3 + j]];
-            }
-        }
-        else {
-            Vertex & vertex0 = triangleVertices[0];
-            Vertex & vertex1 = triangleVertices[1];
-            Vertex & vertex2 = triangleVertices[2];
-            
-            glm::vec3 u = vertex1.position - vertex0.position;
-            glm::vec3 v = vertex2.position - vertex0.position;
-            
-            glm::vec3 n = glm::normalize(glm::cross(u, v));
-            
-            for (size_t j = 0; j < 3; j++) {
-                Vertex & vertex = triangleVertices[j];
-                vertex.normal = n;
-            }
-        }
+    // Copy pixel data of each mipmap level to texture
+    for (size_t i = 0; i < levels.size(); i++) {
+        const TextureLevel & level = levels[i];
         
-        for (size_t j = 0; j < 3; j++) {
-            Vertex & vertex = triangleVertices[j];
+        if (compressed) {
+            glCompressedTexImage2D(
+                GL_TEXTURE_2D,
+                (GLint)i,
+                internalFormat,
+                level.width,
+                level.height,
+                0,
+                (GLsizei)level.size,
+                level.data);
             
-            if (hasTextureCoordinates)
-                vertex.textureCoordinate = textureCoordinates[textureCoordinateIndices[i * 3 + j]];
-            else
-                vertex.textureCoordinate = glm::vec2((float)(j == 1), (float)(j == 2));
+            continue;
         }
         
-        for (size_t j = 0; j < 3; j++)
-            vertices.push_back(triangleVertices[j]);
+        glTexImage2D(
+            GL_TEXTURE_2D,
+            (GLint)i,
+            internalFormat,
+            level.width,
+            level.height,
+            0,
+            format,
+            type,
+            level.data);
     }
     
-    // Create and bind vertex array object
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    
-    // Create and bind vertex buffer object
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    
-    // Copy vertex attribute data to vertex buffer object
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        vertices.size() * vertexSize,
-        vertices.data(),
-        usage);
+    return textureID;
+}
+
+// Largest simplification error of a drawn level of detail in pixels
+const float LEVEL_OF_DETAIL_PIXEL_ERROR = 1.0f;
+
+// Define vertex attributes of bound vertex buffer object in the vertex format,
+// with vertices starting at byte offset
+// Vertex attributes are exported to shader program at locations:
+// 0: position
+// 1: normal (octahedral encoded when quantized)
+// 2: texture coordinate
+void setVertexAttributes(VertexFormat vertexFormat, size_t offset) {
+    size_t vertexSize = getVertexSize(vertexFormat);
+    bool quantized = vertexFormat == VERTEX_FORMAT_QUANTIZED;
     
     // Define position attribute to shader program
     glVertexAttribPointer(
         0,
         3,
-        GL_FLOAT,
-        GL_FALSE,
+        quantized ? GL_UNSIGNED_SHORT : GL_FLOAT,
+        quantized ? GL_TRUE : GL_FALSE,
         vertexSize,
-        (const GLvoid *)nullptr);
+        (const GLvoid *)offset);
     
     // Enable position attribute to shader program
     glEnableVertexAttribArray(0);
     
     // Define normal attribute to shader program
-    glVertexAttribPointer(
-        1,
-        3,
-        GL_FLOAT,
-        GL_FALSE,
-        vertexSize,
-        (const GLvoid *)(3 * sizeof(GLfloat)));
+    if (quantized)
+        glVertexAttribPointer(
+            1,
+            2,
+            GL_SHORT,
+            GL_TRUE,
+            vertexSize,
+            (const GLvoid *)(offset + offsetof(QuantizedVertex, normal)));
+    else
+        glVertexAttribPointer(
+            1,
+            3,
+            GL_FLOAT,
+            GL_FALSE,
+            vertexSize,
+            (const GLvoid *)(offset + offsetof(Vertex, normal)));
     
     // Enable normal attribute to shader program
     glEnableVertexAttribArray(1);
@@ -318,32 +203,232 @@ size_t loadTriangleMesh(
     glVertexAttribPointer(
         2,
         2,
-        GL_FLOAT,
+        quantized ? GL_HALF_FLOAT : GL_FLOAT,
         GL_FALSE,
         vertexSize,
-        (const GLvoid *)(6 * sizeof(GLfloat)));
+        quantized
+            ? (const GLvoid *)(offset + offsetof(QuantizedVertex, textureCoordinate))
+            : (const GLvoid *)(offset + offsetof(Vertex, textureCoordinate)));
     
     // Enable texture coordinate attribute to shader program
     glEnableVertexAttribArray(2);
+}
+
+// Load indexed triangle mesh to OpenGL
+// Vertices are given in the vertex format and indices are 16-bit or 32-bit integers
+// according to index size
+// Buffers are only allocated when vertex and index data are null, to be filled later
+void loadTriangleMesh(
+        const void * vertices,
+        size_t vertexCount,
+        VertexFormat vertexFormat,
+        const void * indices,
+        size_t indexCount,
+        size_t indexSize,
+        GLenum usage,
+        MeshBuffers & buffers) {
+    PROFILE_ZONE("loadTriangleMesh");
+    
+    size_t vertexSize = getVertexSize(vertexFormat);
+    
+    buffers.indexType = indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    buffers.indexSize = indexSize;
+    buffers.vertexFormat = vertexFormat;
+    
+    // Create and bind vertex array object
+    glGenVertexArrays(1, &buffers.vao);
+    glBindVertexArray(buffers.vao);
+    
+    // Create and bind vertex buffer object
+    glGenBuffers(1, &buffers.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+    
+    // Copy vertex attribute data to vertex buffer object
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        vertexCount * vertexSize,
+        vertices,
+        usage);
+    
+    // Create and bind element buffer object to vertex array object
+    glGenBuffers(1, &buffers.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo);
+    
+    // Copy index data to element buffer object
+    glBufferData(
+        GL_ELEMENT_ARRAY_BUFFER,
+        indexCount * indexSize,
+        indices,
+        usage);
+    
+    // Define vertex attributes of vertex buffer object to shader program
+    setVertexAttributes(vertexFormat, 0);
+}
+
+// Draw visible meshlets of level of detail with a single multi-draw call
+// Meshlets outside the view frustum or facing away from the camera are skipped
+// and contiguous visible meshlets are merged in one draw
+// The camera position is given in object space
+// Returns the number of drawn triangles
+size_t drawMeshlets(
+        const MeshBuffers & buffers,
+        const LevelOfDetail & level,
+        const glm::mat4 & modelViewProjection,
+        const glm::vec3 & camera,
+        std::vector<uint32_t> & visibleMeshlets,
+        std::vector<GLsizei> & counts,
+        std::vector<const GLvoid *> & offsets) {
+    PROFILE_ZONE("drawMeshlets");
+    
+    cullMeshlets(
+        buffers.meshletBounds,
+        level.meshletOffset,
+        level.meshletCount,
+        modelViewProjection,
+        camera,
+        visibleMeshlets);
+    
+    counts.clear();
+    offsets.clear();
+    
+    size_t end = 0;
+    size_t indexCount = 0;
+    
+    for (size_t i = 0; i < visibleMeshlets.size(); i++) {
+        const Meshlet & meshlet = buffers.meshlets[visibleMeshlets[i]];
+        
+        indexCount += meshlet.indexCount;
+        
+        if (!counts.empty() && meshlet.indexOffset == end)
+            counts.back() += meshlet.indexCount;
+        else {
+            counts.push_back(meshlet.indexCount);
+            offsets.push_back((const GLvoid *)(meshlet.indexOffset * buffers.indexSize));
+        }
+        
+        end = meshlet.indexOffset + meshlet.indexCount;
+    }
+    
+    if (!counts.empty())
+        glMultiDrawElements(
+            GL_TRIANGLES,
+            counts.data(),
+            buffers.indexType,
+            offsets.data(),
+            (GLsizei)counts.size());
+    
+    return indexCount / 3;
+}
+
+// Select level of detail of mesh transformed by model matrix
+// The screen size is estimated from the bounding sphere of the mesh projected
+// with the view and projection matrices
+size_t selectLevelOfDetail(
+        const std::vector<LevelOfDetail> & levels,
+        const BoundingBox & bounds,
+        const glm::mat4 & model) {
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 extent = bounds.max - bounds.min;
+    
+    // Scale sphere by the largest axis scale of model matrix
+    float scale = std::max(
+        std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))),
+        glm::length(glm::vec3(model[2])));
     
-    // Return vertex count or three times the triangle count
-    return vertexCount;
+    float radius = glm::length(extent) * 0.5f * scale;
+    float distance = glm::length(glm::vec3(VIEW * model * glm::vec4(center, 1.0f)));
+    
+    return selectLevelOfDetail(
+        levels,
+        radius,
+        distance,
+        std::fabs(PROJECTION[1][1]) * VIEWPORT.y,
+        LEVEL_OF_DETAIL_PIXEL_ERROR);
 }
 
-// Compile shader source code from text file format
-bool compileShader(const std::string & filename, GLenum type, GLuint & id) {
-    // Read from text file to string
-    std::ifstream file(filename, std::ifstream::in);
+// Define per-instance attributes of bound vertex buffer object from byte offset
+// Instance attributes are exported to shader program at locations:
+// 3, 4, 5: model matrix rows
+// 6: material color and exponent
+void setInstanceAttributes(size_t offset) {
+    for (GLuint i = 0; i < 4; i++) {
+        glVertexAttribPointer(
+            3 + i,
+            4,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(Instance),
+            (const GLvoid *)(offset + i * sizeof(glm::vec4)));
+    }
+}
 
-    if (!file.is_open())
-        return false;
+// Read per-instance attributes of mesh vertex array object from instance buffer object
+// Attributes advance once per instance and read the first instance in draws without instancing
+void enableInstanceAttributes(const MeshBuffers & mesh, GLuint instanceBuffer) {
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    
+    setInstanceAttributes(0);
+    
+    // Enable instance attributes to shader program
+    for (GLuint i = 3; i < 7; i++) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+}
 
-    std::stringstream buffer;
-    std::string source;
+// Orphan instance buffer object and upload instances
+// Orphaning lets the upload proceed without waiting for draws of previous frames
+void uploadInstances(GLuint instanceBuffer, const Instance * instances, size_t instanceCount) {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(Instance), instances);
+}
 
-    buffer << file.rdbuf();
-    source = buffer.str();
+// Draw visible instances with one instanced draw call per level of detail
+// OpenGL 3.3 has no base instance, so instance attributes are pointed at the batch of each level
+// Returns the number of drawn triangles
+size_t drawInstances(
+        const MeshBuffers & mesh,
+        GLuint instanceBuffer,
+        const InstanceBatches & batches) {
+    PROFILE_ZONE("drawInstances");
+    
+    size_t instanceCount = 0;
+    
+    for (size_t i = 0; i < batches.levelCounts.size(); i++)
+        instanceCount += batches.levelCounts[i];
+    
+    glBindVertexArray(mesh.vao);
+    uploadInstances(instanceBuffer, batches.instances.data(), instanceCount);
+    
+    size_t triangleCount = 0;
+    
+    for (size_t i = 0; i < batches.levelCounts.size(); i++) {
+        if (batches.levelCounts[i] == 0)
+            continue;
+        
+        const LevelOfDetail & level = mesh.levels[i];
+        
+        setInstanceAttributes(batches.levelOffsets[i] * sizeof(Instance));
+        
+        glDrawElementsInstanced(
+            GL_TRIANGLES,
+            (GLsizei)level.indexCount,
+            mesh.indexType,
+            (const GLvoid *)(level.indexOffset * mesh.indexSize),
+            (GLsizei)batches.levelCounts[i]);
+        
+        triangleCount += level.indexCount / 3 * batches.levelCounts[i];
+    }
+    
+    return triangleCount;
+}
 
+// Compile shader source code
+bool compileShader(const std::string & source, GLenum type, GLuint & id) {
+    PROFILE_ZONE("compileShader");
+    
     // Create shader
     GLuint shaderID = glCreateShader(type);
 
@@ -385,20 +470,46 @@ bool compileShader(const std::string & filename, GLenum type, GLuint & id) {
     return true;
 }
 
-// Create shader program
-bool createProgram(const std::string & name, GLuint & id) {
+// Create shader program variant through the program cache
+// Variant defines are injected into the sources, and the linked program is reloaded
+// from its driver binary without compiling while sources and driver are unchanged
+bool createProgram(const std::string & name, uint32_t variant, GLuint & id) {
+    PROFILE_ZONE("createProgram");
+    
+    std::string vertexSource, fragmentSource;
+    
+    // Read shader sources
+    if (!readTextFile(name + ".vert", vertexSource) || !readTextFile(name + ".frag", fragmentSource))
+        return false;
+    
+    // Inject variant defines
+    std::string defines = getShaderDefines(variant);
+    
+    vertexSource = injectShaderDefines(vertexSource, defines);
+    fragmentSource = injectShaderDefines(fragmentSource, defines);
+    
+    // Reload linked program from cache file
+    std::string cacheFilename = getProgramCacheFilename(name, variant);
+    uint64_t sourceHash = hashProgramSources(vertexSource, fragmentSource);
+    
+    if (readProgramCache(cacheFilename, sourceHash, id))
+        return true;
+    
     GLuint vertexShaderID, fragmentShaderID;
 
-    // Load and compile vertex shader
-    if (!compileShader(name + ".vert", GL_VERTEX_SHADER, vertexShaderID))
+    // Compile vertex shader
+    if (!compileShader(vertexSource, GL_VERTEX_SHADER, vertexShaderID))
         return false;
 
-    // Load and compile fragment shader
-    if (!compileShader(name + ".frag", GL_FRAGMENT_SHADER, fragmentShaderID))
+    // Compile fragment shader
+    if (!compileShader(fragmentSource, GL_FRAGMENT_SHADER, fragmentShaderID)) {
+        glDeleteShader(vertexShaderID);
         return false;
+    }
     
-    // Create shader program
+    // Create shader program, retrievable as binary after linkage
     GLuint programID = glCreateProgram();
+    setProgramRetrievable(programID);
 
     // Attach compiled shaders to program
     glAttachShader(programID, vertexShaderID);
@@ -435,6 +546,10 @@ bool createProgram(const std::string & name, GLuint & id) {
 
         return false;
     }
+    
+    // Rebuild cache for the next runs
+    if (isProgramBinarySupported() && !writeProgramCache(cacheFilename, sourceHash, programID))
+        std::cout << "Cannot write program cache." << std::endl;
 
     // Return shader program id
     id = programID;
@@ -442,197 +557,1851 @@ bool createProgram(const std::string & name, GLuint & id) {
     return true;
 }
 
+// Update viewport size and projection matrix
+void setViewport(int width, int height) {
+    VIEWPORT = glm::ivec2(width, height);
+    
+    if (height > 0)
+        PROJECTION = glm::perspective(45.0f, width / (float)height, NEAR_PLANE, FAR_PLANE);
+}
+
 // Resize event callback
 void resize(GLFWwindow * window, int width, int height) {
     glViewport(0, 0, width, height);
     
-    if (height > 0)
-        PROJECTION = glm::perspective(45.0f, width / (float)height, 0.001f, 1000.0f);
+    setViewport(width, height);
 }
 
-// Keyboard event callback
+// Keyboard event callback, recording input applied by the next simulation step
 void keyboard(
         GLFWwindow * window,
         int key, int scancode, int action, int modifier) {
     if (key == GLFW_KEY_A && action == GLFW_PRESS)
-        BACKGROUND_STATE = !BACKGROUND_STATE;
+        INPUT.backgroundToggles++;
     
     if (key == GLFW_KEY_LEFT && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::rotate(MODEL, 0.1f, glm::vec3(0.0f, 1.0f, 0.0f));
+        INPUT.rotationSteps++;
 }
 
-int main(int argc, char ** argv) {
-    // GLM usage
-    //
-    // glm::vec3 u(1.0f, 0, 0);
-    // glm::vec3 v(0, 1.0f, 0);
-    //
-    // glm::vec3 d = glm::dot(u, v);
-    //
-    // glm::mat3 m(0.0f, 1.0f, 2.0f,  // First column
-    //			   3.0f, 4.0f, 5.0f,  // Second column
-    //			   6.0f, 7.0f, 8.0f); // Third column
-    //
-    // Print GLM matrix
-    // std::cout << glm::to_string(m) << std::endl;
-    //
-    // Access the first column as GLM vector
-    // std::cout << glm::to_string(m[0]) << std::endl;
-    //
-    // Access the second element of the first column as float
-    // std::cout << m[0][1] << std::endl;
-
-    // Check GLFW initialization
-    if (!glfwInit()) {
-        std::cout << "Cannot initialize GLFW." << std::endl;
-        return -1;
-    }
-
-    // Setup OpenGL context
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 16);
-
-    // Create window
-    GLFWwindow * window = glfwCreateWindow(800, 600, "Window", nullptr, nullptr);
-
-    // Check if cannot create window
-    if (window == nullptr) {
-        glfwTerminate();
-
-        std::cout << "Cannot create window." << std::endl;
-        return -1;
-    }
-
-    // Register event callbacks
-    glfwSetFramebufferSizeCallback(window, resize);
-    glfwSetKeyCallback(window, keyboard);
-
-    // Setup window context
-    glfwMakeContextCurrent(window);
-
-    // Check if cannot load OpenGL procedures
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        glfwTerminate();
-
-        std::cout << "Cannot load OpenGL procedures." << std::endl;
-        return -1;
-    }
-    
-    // Shader program ID
-    GLuint programID;
+// Uniform buffer object holding a copy of its last uploaded contents
+template <typename T>
+struct UniformBlock {
+    GLuint ubo;
+    T contents;
+    bool uploaded;
+};
+
+// Create uniform buffer object and bind it to the binding point of its shader program block
+template <typename T>
+void createUniformBlock(GLuint binding, UniformBlock<T> & block) {
+    glGenBuffers(1, &block.ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, block.ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, block.ubo);
     
-    // Check if cannot create shader program
-    if (!createProgram("../res/shaders/blinn_phong", programID)) {
-        glfwTerminate();
+    block.uploaded = false;
+}
 
-        std::cout << "Cannot create shader program." << std::endl;
-        return -1;
-    }
+// Upload block contents only when they differ from the last upload
+// Returns true when the buffer was updated
+template <typename T>
+bool updateUniformBlock(UniformBlock<T> & block, const T & contents) {
+    if (block.uploaded && std::memcmp(&block.contents, &contents, sizeof(T)) == 0)
+        return false;
     
-    // Use shader program
-    glUseProgram(programID);
+    block.contents = contents;
+    block.uploaded = true;
     
-    // Enable depth test
-    glEnable(GL_DEPTH_TEST);
+    glBindBuffer(GL_UNIFORM_BUFFER, block.ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &block.contents);
     
-    // Read triangle mesh from Wavefront OBJ file format
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> textureCoordinates;
-    std::vector<size_t> positionIndices;
-    std::vector<size_t> normalIndices;
-    std::vector<size_t> textureCoordinateIndices;
-    
-    if (!readTriangleMesh(
-            "../res/meshes/emily.obj",
-            positions,
-            normals,
-            textureCoordinates,
-            positionIndices,
-            normalIndices,
-            textureCoordinateIndices)) {
-        glfwTerminate();
+    return true;
+}
 
-        std::cout << "Cannot read triangle mesh." << std::endl;
-        return -1;
-    };
-    
-    // Load triangle mesh to OpenGL
-    GLuint vao, vbo;
-    
-    size_t vertexCount = loadTriangleMesh(
-        positions,
-        normals,
-        textureCoordinates,
-        positionIndices,
-        normalIndices,
-        textureCoordinateIndices,
-        GL_STATIC_DRAW,
-        vao,
-        vbo);
+// Bind uniform block of shader program to binding point
+void bindUniformBlock(GLuint programID, const char * name, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(programID, name);
     
-    // Read 8-bit RGB image from Netpbm binary file format (PPM)
-    size_t width, height;
-    std::vector<glm::vec3> pixels;
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(programID, index, binding);
+}
+
+// Sentinel for state not bound yet by the draw loop
+const uint32_t UNBOUND_STATE = 0xFFFFFFFF;
+
+// Draw batches of draw list, binding program, texture and mesh only when they change
+// Batches of a single object draw its visible meshlets, others draw all their instances at once
+// Programs are indexed like the scene programs, so passes can replace the shading programs
+// Returns the number of drawn triangles
+size_t drawScene(
+        const Scene & scene,
+        const std::vector<GLuint> & programs,
+        const DrawList & list,
+        const glm::mat4 & viewProjection,
+        const glm::vec3 & camera,
+        UniformBlock<MeshUniforms> & meshBlock,
+        std::vector<uint32_t> & visibleMeshlets,
+        std::vector<GLsizei> & counts,
+        std::vector<const GLvoid *> & offsets) {
+    PROFILE_ZONE("drawScene");
     
-    if (!readImage("../res/textures/diffuse.ppm", width, height, pixels)) {
-        glfwTerminate();
-        
-        std::cout << "Cannot read image." << std::endl;
-        return -1;
-    };
+    uploadInstances(scene.instanceBuffer, list.instances.data(), list.items.size());
     
-    // Load 32-bit linear RGB image to OpenGL
-    GLuint textureID = loadImage(width, height, pixels);
+    uint32_t program = UNBOUND_STATE;
+    uint32_t texture = UNBOUND_STATE;
+    uint32_t mesh = UNBOUND_STATE;
     
-    // Initialize projection matrix and viewport
-    resize(window, 800, 600);
+    size_t triangleCount = 0;
     
-    // Initialize light parameters
+    for (size_t i = 0; i < list.batches.size(); i++) {
+        const DrawBatch & batch = list.batches[i];
+        const MeshBuffers & buffers = scene.meshes[batch.mesh];
+        const LevelOfDetail & level = buffers.levels[batch.level];
+        
+        if (batch.program != program) {
+            program = batch.program;
+            glUseProgram(programs[program]);
+        }
+        
+        if (batch.texture != texture) {
+            texture = batch.texture;
+            
+            if (texture != SCENE_NO_TEXTURE)
+                glBindTexture(GL_TEXTURE_2D, scene.textures[texture]);
+        }
+        
+        // Update per-mesh uniform block with the vertex array object, skipped for equal contents
+        if (batch.mesh != mesh) {
+            mesh = batch.mesh;
+            glBindVertexArray(buffers.vao);
+            
+            MeshUniforms meshUniforms;
+            
+            computeMeshUniforms(
+                buffers.dequantization,
+                buffers.vertexFormat == VERTEX_FORMAT_QUANTIZED,
+                meshUniforms);
+            
+            updateUniformBlock(meshBlock, meshUniforms);
+        }
+        
+        // Point instance attributes at the batch, the instance buffer stays bound
+        setInstanceAttributes(batch.instanceOffset * sizeof(Instance));
+        
+        if (batch.instanceCount == 1) {
+            const glm::mat4 & model = scene.objects[batch.object].model;
+            
+            triangleCount += drawMeshlets(
+                buffers,
+                level,
+                viewProjection * model,
+                glm::vec3(glm::inverse(model) * glm::vec4(camera, 1.0f)),
+                visibleMeshlets,
+                counts,
+                offsets);
+        }
+        else {
+            glDrawElementsInstanced(
+                GL_TRIANGLES,
+                (GLsizei)level.indexCount,
+                buffers.indexType,
+                (const GLvoid *)(level.indexOffset * buffers.indexSize),
+                (GLsizei)batch.instanceCount);
+            
+            triangleCount += level.indexCount / 3 * batch.instanceCount;
+        }
+    }
+    
+    return triangleCount;
+}
+
+// Loaded asset copied to OpenGL in slices over several frames
+// Vertex and index data are copied to buffer objects and image rows through a pixel buffer object
+struct AssetUploader {
+    LoadedAsset * asset;
+    MeshBuffers buffers;
+    GLuint texture;
+    size_t level;
+    size_t offset;
+    GLuint pixelBuffer;
+    size_t completedCount;
+    size_t failedCount;
+};
+
+// Bytes copied to OpenGL per frame while assets are loading
+const size_t ASSET_UPLOAD_BUDGET = 4 << 20;
+
+// Create placeholder mesh and texture drawn until assets are loaded
+// The placeholder mesh is a unit cube and the placeholder texture a single gray pixel
+void createPlaceholders(Scene & scene) {
+    PROFILE_ZONE("createPlaceholders");
+    
+    // Build cube with flat normals calculated by face
+    std::vector<glm::vec3> positions;
+    
+    for (int i = 0; i < 8; i++)
+        positions.push_back(glm::vec3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f));
+    
+    const uint32_t faces[] = {
+        0, 2, 3, 0, 3, 1,
+        4, 5, 7, 4, 7, 6,
+        0, 1, 5, 0, 5, 4,
+        2, 6, 7, 2, 7, 3,
+        0, 4, 6, 0, 6, 2,
+        1, 3, 7, 1, 7, 5
+    };
+    
+    std::vector<uint32_t> positionIndices(faces, faces + sizeof(faces) / sizeof(faces[0]));
+    
+    TriangleMesh mesh;
+    
+    buildTriangleMesh(
+        positions,
+        std::vector<glm::vec3>(),
+        std::vector<glm::vec2>(),
+        positionIndices,
+        std::vector<uint32_t>(),
+        std::vector<uint32_t>(),
+        mesh);
+    
+    buildMeshlets(mesh);
+    
+    // Upload cube without quantization
+    MeshBuffers & buffers = scene.placeholderMesh;
+    
+    loadTriangleMesh(
+        mesh.vertices.data(),
+        mesh.vertices.size(),
+        VERTEX_FORMAT_FLOAT,
+        mesh.indices.data(),
+        mesh.indices.size(),
+        sizeof(uint32_t),
+        GL_STATIC_DRAW,
+        buffers);
+    
+    buffers.levels = mesh.levels;
+    buffers.meshlets = mesh.meshlets;
+    buffers.dequantization = glm::mat4(1.0f);
+    buffers.bounds = computeBoundingBox(mesh.vertices.data(), mesh.vertices.size());
+    
+    buildMeshletBounds(buffers.meshlets.data(), buffers.meshlets.size(), buffers.meshletBounds);
+    
+    enableInstanceAttributes(buffers, scene.instanceBuffer);
+    
+    // Upload single gray pixel
+    const unsigned char pixel[3] = { 128, 128, 128 };
+    
+    TextureLevel pixelLevel;
+    pixelLevel.width = 1;
+    pixelLevel.height = 1;
+    pixelLevel.data = pixel;
+    pixelLevel.size = sizeof(pixel);
+    
+    scene.placeholderTexture = loadImage(
+        std::vector<TextureLevel>(1, pixelLevel),
+        GL_RGB8,
+        GL_RGB,
+        GL_UNSIGNED_BYTE,
+        1);
+}
+
+// First texture unit of light buffers, after the unit of scene textures
+const GLint LIGHT_TEXTURE_UNIT = 1;
+
+// Texture unit of the virtual texture indirection table, after the light buffers
+const GLint VIRTUAL_TEXTURE_UNIT = LIGHT_TEXTURE_UNIT + 3;
+
+// Texture buffer objects read by the fragment shader:
+// lights as position and radius then color texels, cluster offset and count, light indices
+struct LightBuffers {
+    GLuint buffers[3];
+    GLuint textures[3];
+    std::vector<glm::vec4> lightTexels;
+};
+
+// Upload data to texture buffer object, orphaning the storage read by previous frames
+// Buffers are never empty, so texture buffers always have storage
+void uploadLightBuffer(GLuint buffer, const void * data, size_t size) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(size, sizeof(glm::vec4)), nullptr, GL_STREAM_DRAW);
+    
+    if (size > 0)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+// Create texture buffer objects of lights and bind them to their texture units
+void createLightBuffers(LightBuffers & buffers) {
+    const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    
+    glGenBuffers(3, buffers.buffers);
+    glGenTextures(3, buffers.textures);
+    
+    for (int i = 0; i < 3; i++) {
+        uploadLightBuffer(buffers.buffers[i], nullptr, 0);
+        
+        glActiveTexture(GL_TEXTURE0 + LIGHT_TEXTURE_UNIT + i);
+        glBindTexture(GL_TEXTURE_BUFFER, buffers.textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers.buffers[i]);
+    }
+    
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Upload lights moved into model space and their cluster lists
+void updateLightBuffers(
+        const std::vector<PointLight> & lights,
+        const glm::mat4 & inverseModel,
+        const LightClusters & clusters,
+        LightBuffers & buffers) {
+    PROFILE_ZONE("updateLightBuffers");
+    
+    buffers.lightTexels.resize(lights.size() * 2);
+    
+    for (size_t i = 0; i < lights.size(); i++) {
+        glm::vec3 position(inverseModel * glm::vec4(lights[i].position, 1.0f));
+        
+        buffers.lightTexels[i * 2] = glm::vec4(position, lights[i].radius);
+        buffers.lightTexels[i * 2 + 1] = glm::vec4(lights[i].color, 0.0f);
+    }
+    
+    uploadLightBuffer(buffers.buffers[0], buffers.lightTexels.data(), buffers.lightTexels.size() * sizeof(glm::vec4));
+    uploadLightBuffer(buffers.buffers[1], clusters.ranges.data(), clusters.ranges.size() * sizeof(uint32_t));
+    uploadLightBuffer(buffers.buffers[2], clusters.indices.data(), clusters.indices.size() * sizeof(uint32_t));
+    
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Delete texture buffer objects of lights
+void deleteLightBuffers(LightBuffers & buffers) {
+    glDeleteTextures(3, buffers.textures);
+    glDeleteBuffers(3, buffers.buffers);
+}
+
+// Get shader variant of material
+uint32_t getMaterialVariant(const SceneMaterial & material) {
+    uint32_t variant = 0;
+    
+    if (material.texture != SCENE_NO_TEXTURE)
+        variant |= SHADER_TEXTURED;
+    
+    if (!material.flatShading)
+        variant |= SHADER_NORMALS;
+    
+    if (material.exponent > 0.0f)
+        variant |= SHADER_SPECULAR;
+    
+    return variant;
+}
+
+// Bind uniform blocks and sampler of shader program
+void setupProgram(GLuint programID) {
+    // Bind per-frame and per-mesh uniform blocks of shader program
+    bindUniformBlock(programID, "Frame", FRAME_UNIFORM_BINDING);
+    bindUniformBlock(programID, "Mesh", MESH_UNIFORM_BINDING);
+    
+    // Load texture unit as sampler parameter to shader program, ignored by untextured variants
+    glUseProgram(programID);
+    glUniform1i(glGetUniformLocation(programID, "image"), 0);
+    
+    // Load texture units of light buffers as sampler parameters to shader program
+    glUniform1i(glGetUniformLocation(programID, "lights"), LIGHT_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(programID, "clusters"), LIGHT_TEXTURE_UNIT + 1);
+    glUniform1i(glGetUniformLocation(programID, "lightIndices"), LIGHT_TEXTURE_UNIT + 2);
+    
+    // Load texture units of virtual texture as sampler parameters, ignored by other variants
+    glUniform1i(glGetUniformLocation(programID, "atlas"), 0);
+    glUniform1i(glGetUniformLocation(programID, "indirection"), VIRTUAL_TEXTURE_UNIT);
+}
+
+// Create every shader program variant, so later runs reload all of them from the program cache
+// Returns false when a variant cannot be created
+bool precompilePrograms(const std::string & name) {
+    PROFILE_ZONE("precompilePrograms");
+    
+    for (uint32_t variant = 0; variant < SHADER_VARIANT_COUNT; variant++) {
+        GLuint programID;
+    
+        if (!createProgram(name, variant, programID))
+            return false;
+    
+        glDeleteProgram(programID);
+    }
+    
+    return true;
+}
+
+// Create scene drawing placeholders for all meshes and textures of scene description
+// and list the files to be read by the asset loader, meshes first
+// Materials sharing a shader variant share its program, created through the program cache
+// Variant bits are added to the variant of every material
+// Returns false when a shader program cannot be created
+bool createScene(
+        const SceneDescription & description,
+        const std::string & programName,
+        uint32_t variantBits,
+        Scene & scene,
+        std::vector<AssetRequest> & requests) {
+    scene.materials = description.materials;
+    scene.objects = description.objects;
+    scene.lights = description.lights;
+    
+    std::vector<uint32_t> variants;
+    
+    for (size_t i = 0; i < scene.materials.size(); i++) {
+        uint32_t variant = getMaterialVariant(scene.materials[i]) | variantBits;
+        size_t program = std::find(variants.begin(), variants.end(), variant) - variants.begin();
+    
+        if (program == variants.size()) {
+            GLuint programID;
+    
+            if (!createProgram(programName, variant, programID))
+                return false;
+    
+            setupProgram(programID);
+    
+            variants.push_back(variant);
+            scene.programs.push_back(programID);
+        }
+    
+        scene.materials[i].program = (uint32_t)program;
+    }
+    
+    // Create instance buffer object read by all meshes
+    glGenBuffers(1, &scene.instanceBuffer);
+    
+    createPlaceholders(scene);
+    
+    scene.meshes.assign(description.meshFilenames.size(), scene.placeholderMesh);
+    scene.textures.assign(description.imageFilenames.size(), scene.placeholderTexture);
+    
+    for (size_t i = 0; i < description.meshFilenames.size(); i++) {
+        AssetRequest request;
+        request.type = ASSET_MESH;
+        request.index = i;
+        request.filename = description.meshFilenames[i];
+        
+        requests.push_back(request);
+    }
+    
+    for (size_t i = 0; i < description.imageFilenames.size(); i++) {
+        AssetRequest request;
+        request.type = ASSET_IMAGE;
+        request.index = i;
+        request.filename = description.imageFilenames[i];
+        
+        requests.push_back(request);
+    }
+    
+    return true;
+}
+
+// Create pixel buffer object for image uploads
+void createAssetUploader(AssetUploader & uploader) {
+    uploader.asset = nullptr;
+    uploader.completedCount = 0;
+    uploader.failedCount = 0;
+    
+    glGenBuffers(1, &uploader.pixelBuffer);
+}
+
+// Allocate OpenGL objects of asset, filled by the following slices
+void beginAssetUpload(const Scene & scene, AssetUploader & uploader) {
+    const LoadedAsset & asset = *uploader.asset;
+    
+    uploader.level = 0;
+    uploader.offset = 0;
+    
+    if (asset.type == ASSET_MESH) {
+        const MeshAsset & mesh = asset.mesh;
+        
+        loadTriangleMesh(
+            nullptr,
+            mesh.vertexCount,
+            mesh.vertexFormat,
+            nullptr,
+            mesh.indexCount,
+            mesh.indexSize,
+            GL_STATIC_DRAW,
+            uploader.buffers);
+        
+        enableInstanceAttributes(uploader.buffers, scene.instanceBuffer);
+    }
+    else {
+        const ImageAsset & image = asset.image;
+        
+        std::vector<TextureLevel> levels(image.levels.size());
+        
+        for (size_t i = 0; i < levels.size(); i++) {
+            levels[i].width = image.levels[i].width;
+            levels[i].height = image.levels[i].height;
+            levels[i].data = nullptr;
+            levels[i].size = image.levels[i].size;
+        }
+        
+        uploader.texture = loadImage(levels, image.internalFormat, image.format, image.type, (GLint)image.alignment);
+    }
+}
+
+// Copy next slice of mesh asset, vertices then indices, through the copy write target
+// so the element buffer binding of the bound vertex array object is kept
+// Returns the number of copied bytes
+size_t uploadMeshSlice(AssetUploader & uploader, size_t byteBudget) {
+    const MeshAsset & mesh = uploader.asset->mesh;
+    
+    size_t vertexBytes = mesh.vertexBytes;
+    size_t totalBytes = vertexBytes + mesh.indexBytes;
+    size_t start = uploader.offset;
+    size_t end = start + std::min(totalBytes - start, byteBudget);
+    
+    if (start < vertexBytes) {
+        size_t sliceEnd = std::min(end, vertexBytes);
+        
+        glBindBuffer(GL_COPY_WRITE_BUFFER, uploader.buffers.vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, start, sliceEnd - start, mesh.vertices + start);
+        
+        start = sliceEnd;
+    }
+    
+    if (start < end) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, uploader.buffers.ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, start - vertexBytes, end - start, mesh.indices + (start - vertexBytes));
+    }
+    
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    
+    size_t bytes = end - uploader.offset;
+    uploader.offset = end;
+    
+    return bytes;
+}
+
+// Copy next band of rows of current image level through the orphaned pixel buffer object
+// Compressed levels are copied in rows of blocks, the uploader offset counts rows of blocks
+// At least one row is copied, so progress is made with any budget
+// Returns the number of copied bytes, zero when the pixel buffer object cannot be mapped
+// so the band is copied again by the next call
+size_t uploadImageSlice(AssetUploader & uploader, size_t byteBudget) {
+    const ImageAsset & image = uploader.asset->image;
+    const ImageAssetLevel & level = image.levels[uploader.level];
+    
+    bool compressed = getTextureCompression(image.internalFormat) != TEXTURE_COMPRESSION_NONE;
+    size_t rowHeight = compressed ? COMPRESSION_BLOCK_SIZE : 1;
+    size_t levelRowCount = (level.height + rowHeight - 1) / rowHeight;
+    
+    size_t rowSize = level.size / levelRowCount;
+    size_t rowCount = std::min(levelRowCount - uploader.offset, std::max(byteBudget / rowSize, (size_t)1));
+    size_t bytes = rowCount * rowSize;
+    
+    // The last row of blocks may cover fewer pixel rows
+    size_t y = uploader.offset * rowHeight;
+    size_t height = std::min(rowCount * rowHeight, level.height - y);
+    
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploader.pixelBuffer);
+    
+    // Orphan previous storage, which may still be read by pending uploads
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    
+    void * data = glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER,
+        0,
+        bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    
+    // Keep the band for the next call when the buffer cannot be mapped
+    if (data == nullptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return 0;
+    }
+    
+    std::memcpy(data, image.data + level.offset + uploader.offset * rowSize, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    
+    glBindTexture(GL_TEXTURE_2D, uploader.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, (GLint)image.alignment);
+    
+    if (compressed) {
+        glCompressedTexSubImage2D(
+            GL_TEXTURE_2D,
+            (GLint)uploader.level,
+            0,
+            (GLint)y,
+            (GLsizei)level.width,
+            (GLsizei)height,
+            image.internalFormat,
+            (GLsizei)bytes,
+            (const GLvoid *)nullptr);
+    }
+    else {
+        glTexSubImage2D(
+            GL_TEXTURE_2D,
+            (GLint)uploader.level,
+            0,
+            (GLint)y,
+            (GLsizei)level.width,
+            (GLsizei)height,
+            image.format,
+            image.type,
+            (const GLvoid *)nullptr);
+    }
+    
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    
+    // Move to next level after its last row
+    uploader.offset += rowCount;
+    
+    if (uploader.offset == levelRowCount) {
+        uploader.level++;
+        uploader.offset = 0;
+    }
+    
+    return bytes;
+}
+
+// Replace placeholder of uploaded asset in scene
+void finishAssetUpload(Scene & scene, AssetUploader & uploader) {
+    const LoadedAsset & asset = *uploader.asset;
+    
+    if (asset.type == ASSET_MESH) {
+        MeshBuffers & buffers = uploader.buffers;
+        
+        buffers.levels = asset.mesh.levels;
+        buffers.meshlets = asset.mesh.meshlets;
+        buffers.meshletBounds = asset.mesh.meshletBounds;
+        buffers.dequantization = asset.mesh.dequantization;
+        buffers.bounds = asset.mesh.bounds;
+        
+        scene.meshes[asset.index] = buffers;
+    }
+    else
+        scene.textures[asset.index] = uploader.texture;
+}
+
+// Take loaded assets from loader queue and copy them to OpenGL until the byte budget is spent
+// Assets that cannot be read keep their placeholder
+void updateAssetUploader(AssetLoader & loader, Scene & scene, size_t byteBudget, AssetUploader & uploader) {
+    PROFILE_ZONE("updateAssetUploader");
+    
+    size_t bytes = 0;
+    
+    while (bytes < byteBudget) {
+        // Take next asset, beginning its upload
+        if (uploader.asset == nullptr) {
+            if (!popLoadedAsset(loader.queue, uploader.asset))
+                break;
+            
+            if (!uploader.asset->loaded) {
+                if (uploader.asset->type == ASSET_MESH)
+                    std::cout << "Cannot read triangle mesh " << uploader.asset->filename << "." << std::endl;
+                else
+                    std::cout << "Cannot read image " << uploader.asset->filename << "." << std::endl;
+                
+                deleteLoadedAsset(uploader.asset);
+                uploader.asset = nullptr;
+                
+                uploader.completedCount++;
+                uploader.failedCount++;
+                
+                continue;
+            }
+            
+            beginAssetUpload(scene, uploader);
+        }
+        
+        // Copy slice and install asset after its last slice
+        size_t sliceBytes;
+        bool complete;
+        
+        if (uploader.asset->type == ASSET_MESH) {
+            sliceBytes = uploadMeshSlice(uploader, byteBudget - bytes);
+            complete = uploader.offset == uploader.asset->mesh.vertexBytes + uploader.asset->mesh.indexBytes;
+        }
+        else {
+            sliceBytes = uploadImageSlice(uploader, byteBudget - bytes);
+            complete = uploader.level == uploader.asset->image.levels.size();
+        }
+        
+        bytes += sliceBytes;
+        
+        // Retry slice that could not be copied in the next frame
+        if (!complete && sliceBytes == 0)
+            break;
+        
+        if (complete) {
+            finishAssetUpload(scene, uploader);
+            
+            deleteLoadedAsset(uploader.asset);
+            uploader.asset = nullptr;
+            
+            uploader.completedCount++;
+        }
+    }
+}
+
+// Delete pixel buffer object and objects of the asset being uploaded
+void deleteAssetUploader(AssetUploader & uploader) {
+    if (uploader.asset != nullptr) {
+        if (uploader.asset->type == ASSET_MESH) {
+            glDeleteVertexArrays(1, &uploader.buffers.vao);
+            glDeleteBuffers(1, &uploader.buffers.vbo);
+            glDeleteBuffers(1, &uploader.buffers.ebo);
+        }
+        else
+            glDeleteTextures(1, &uploader.texture);
+        
+        deleteLoadedAsset(uploader.asset);
+        uploader.asset = nullptr;
+    }
+    
+    glDeleteBuffers(1, &uploader.pixelBuffer);
+}
+
+// Delete OpenGL objects of scene, except shader programs
+// Meshes and textures not loaded yet share the placeholders, deleted once
+void deleteScene(Scene & scene) {
+    for (size_t i = 0; i < scene.meshes.size(); i++) {
+        if (scene.meshes[i].vao == scene.placeholderMesh.vao)
+            continue;
+        
+        glDeleteVertexArrays(1, &scene.meshes[i].vao);
+        glDeleteBuffers(1, &scene.meshes[i].vbo);
+        glDeleteBuffers(1, &scene.meshes[i].ebo);
+    }
+    
+    for (size_t i = 0; i < scene.textures.size(); i++) {
+        if (scene.textures[i] != scene.placeholderTexture)
+            glDeleteTextures(1, &scene.textures[i]);
+    }
+    
+    glDeleteVertexArrays(1, &scene.placeholderMesh.vao);
+    glDeleteBuffers(1, &scene.placeholderMesh.vbo);
+    glDeleteBuffers(1, &scene.placeholderMesh.ebo);
+    glDeleteTextures(1, &scene.placeholderTexture);
+    
+    glDeleteBuffers(1, &scene.instanceBuffer);
+}
+
+// Mesh of the scene deformed on the CPU every frame
+// Deformed vertices are written straight into the regions of a stream buffer in turn,
+// the vertex array object reads the region written last and the element buffer of the mesh
+struct DynamicMesh {
+    MorphMesh morph;
+    StreamBuffer vertices;
+};
+
+// Replace vertex buffer of loaded scene mesh by a stream buffer of deformed vertices
+// Vertices are read again through the mesh cache, in the order of the loaded indices
+// Bounds and meshlet bounds are grown by the largest displacement of the morph targets
+bool createDynamicMesh(
+        const std::string & filename,
+        const LevelOfDetailSettings & settings,
+        Scene & scene,
+        size_t mesh,
+        DynamicMesh & dynamicMesh) {
+    PROFILE_ZONE("createDynamicMesh");
+    
+    TriangleMesh triangleMesh;
+    
+    if (!readTriangleMeshFile(filename, settings, triangleMesh))
+        return false;
+    
+    MeshBuffers & buffers = scene.meshes[mesh];
+    
+    createMorphMesh(triangleMesh.vertices, dynamicMesh.morph);
+    addProceduralMorphTargets(buffers.bounds, dynamicMesh.morph);
+    
+    createStreamBuffer(GL_COPY_WRITE_BUFFER, triangleMesh.vertices.size() * sizeof(Vertex), dynamicMesh.vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    
+    // Delete static vertices and read the stream buffer with the element buffer of the mesh
+    glDeleteVertexArrays(1, &buffers.vao);
+    glDeleteBuffers(1, &buffers.vbo);
+    
+    glGenVertexArrays(1, &buffers.vao);
+    glBindVertexArray(buffers.vao);
+    
+    glBindBuffer(GL_ARRAY_BUFFER, dynamicMesh.vertices.buffer);
+    setVertexAttributes(VERTEX_FORMAT_FLOAT, 0);
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo);
+    
+    enableInstanceAttributes(buffers, scene.instanceBuffer);
+    
+    buffers.vbo = 0;
+    buffers.vertexFormat = VERTEX_FORMAT_FLOAT;
+    buffers.dequantization = glm::mat4(1.0f);
+    buffers.bounds.min -= dynamicMesh.morph.maxDisplacement;
+    buffers.bounds.max += dynamicMesh.morph.maxDisplacement;
+    
+    loosenMeshletBounds(dynamicMesh.morph.maxDisplacement, buffers.meshletBounds);
+    
+    return true;
+}
+
+// Deform vertices into the next region of the stream buffer and point the vertex array object at it
+// Nothing is copied, the region is only waited for when the GPU is more than two frames behind
+void updateDynamicMesh(const float * weights, const MeshBuffers & buffers, DynamicMesh & dynamicMesh) {
+    PROFILE_ZONE("updateDynamicMesh");
+    
+    void * vertices = beginStreamRegion(dynamicMesh.vertices);
+    
+    // Draw the vertices of the previous frame again when the region cannot be mapped
+    size_t offset;
+    
+    if (vertices != nullptr) {
+        deformMorphMesh(dynamicMesh.morph, weights, (Vertex *)vertices);
+        offset = endStreamRegion(dynamicMesh.vertices);
+    }
+    else
+        offset = abortStreamRegion(dynamicMesh.vertices);
+    
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    
+    glBindVertexArray(buffers.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, dynamicMesh.vertices.buffer);
+    
+    setVertexAttributes(VERTEX_FORMAT_FLOAT, offset);
+}
+
+// Atlas slots along each side of the virtual texture atlas
+const size_t VIRTUAL_ATLAS_SLOTS = 16;
+
+// Pages held by the streaming thread, copied from the page file and not uploaded yet
+const size_t VIRTUAL_STAGING_COUNT = 32;
+
+// Pages uploaded to the atlas per frame, bounding the upload time of a frame
+const size_t VIRTUAL_UPLOAD_BUDGET = 16;
+
+// Feedback framebuffer size relative to the viewport as a power of two,
+// its level of detail bias makes fragments request the levels they sample in the viewport
+const int VIRTUAL_FEEDBACK_SHIFT = 3;
+
+// Virtual texture of the mesh, pages are streamed from its page file into a fixed size atlas
+// The feedback pass draws the pages sampled by fragments into a small framebuffer, read back
+// through two pixel buffer objects in turn, so pages sampled by a frame are requested two frames later
+// GPU memory is bounded by the atlas and CPU memory by the staging slots, the indirection table
+// takes 4 bytes per page
+struct VirtualTexture {
+    VirtualTextureFile file;
+    VirtualPageCache cache;
+    VirtualTextureStreamer streamer;
+    
+    GLuint atlas;
+    GLuint indirection;
+    
+    std::vector<GLuint> feedbackPrograms;
+    GLuint feedbackFramebuffer;
+    GLuint feedbackColor;
+    GLuint feedbackDepth;
+    GLuint feedbackBuffers[2];
+    int feedbackWidth;
+    int feedbackHeight;
+    size_t feedbackCount;
+    
+    std::vector<uint32_t> sampledPages;
+    std::vector<uint32_t> missingPages;
+    std::vector<StreamedPage> streamedPages;
+};
+
+// Load virtual texture parameters of page file to shader program
+void setVirtualTextureUniforms(GLuint programID, const VirtualTextureFile & file, float levelOfDetailBias) {
+    float size = (float)(file.pageCount * VIRTUAL_PAGE_SIZE);
+    
+    glUseProgram(programID);
+    
+    glUniform4f(
+        glGetUniformLocation(programID, "virtualTexture"),
+        file.width / size,
+        file.height / size,
+        size,
+        (float)(file.levelCount - 1));
+    
+    glUniform4f(
+        glGetUniformLocation(programID, "virtualPages"),
+        (float)VIRTUAL_PAGE_SIZE,
+        (float)VIRTUAL_PAGE_BORDER,
+        (float)VIRTUAL_TILE_SIZE,
+        levelOfDetailBias);
+}
+
+// Copy page to atlas slot, the atlas must be bound
+void uploadVirtualPage(const VirtualPageCache & cache, size_t slot, const unsigned char * pixels) {
+    glTexSubImage2D(
+        GL_TEXTURE_2D,
+        0,
+        (GLint)(slot % cache.slotColumns * VIRTUAL_TILE_SIZE),
+        (GLint)(slot / cache.slotColumns * VIRTUAL_TILE_SIZE),
+        (GLsizei)VIRTUAL_TILE_SIZE,
+        (GLsizei)VIRTUAL_TILE_SIZE,
+        GL_RGB,
+        GL_UNSIGNED_BYTE,
+        pixels);
+}
+
+// Copy dirty regions of indirection levels to the indirection texture and mark them clean
+void uploadVirtualIndirection(VirtualTexture & texture) {
+    VirtualPageCache & cache = texture.cache;
+    
+    glActiveTexture(GL_TEXTURE0 + VIRTUAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, texture.indirection);
+    
+    for (size_t level = 0; level < cache.levelCount; level++) {
+        const VirtualRegion & region = cache.dirtyRegions[level];
+        
+        if (region.beginX >= region.endX || region.beginY >= region.endY)
+            continue;
+        
+        // Rows of the region are read from the rows of the whole level
+        size_t count = cache.pageCount >> level;
+        
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)count);
+        
+        glTexSubImage2D(
+            GL_TEXTURE_2D,
+            (GLint)level,
+            (GLint)region.beginX,
+            (GLint)region.beginY,
+            (GLsizei)(region.endX - region.beginX),
+            (GLsizei)(region.endY - region.beginY),
+            GL_RGBA_INTEGER,
+            GL_UNSIGNED_BYTE,
+            &cache.indirection[level][(region.beginY * count + region.beginX) * 4]);
+    }
+    
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glActiveTexture(GL_TEXTURE0);
+    
+    clearVirtualDirtyRegions(cache);
+}
+
+// Map page file of image, rebuilding it when it is stale, create atlas holding the root page,
+// indirection texture and feedback programs, and start the streaming thread
+// Scene programs get the virtual texture parameters, the atlas is bound to texture unit 0
+bool createVirtualTexture(
+        const std::string & imageFilename,
+        const std::string & programName,
+        size_t slotCount,
+        const Scene & scene,
+        VirtualTexture & texture) {
+    PROFILE_ZONE("createVirtualTexture");
+    
+    if (!loadVirtualTextureFile(imageFilename, texture.file))
+        return false;
+    
+    // Fit atlas in the texture size limit
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    
+    slotCount = std::min(slotCount, std::min(MAX_VIRTUAL_SLOT_COUNT, (size_t)maxTextureSize / VIRTUAL_TILE_SIZE));
+    
+    createVirtualPageCache(texture.file, slotCount, slotCount, texture.cache);
+    
+    // Create atlas with the root page in the first slot
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    
+    glGenTextures(1, &texture.atlas);
+    glBindTexture(GL_TEXTURE_2D, texture.atlas);
+    
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    
+    GLsizei atlasSize = (GLsizei)(slotCount * VIRTUAL_TILE_SIZE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, atlasSize, atlasSize, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    
+    uploadVirtualPage(texture.cache, 0, getVirtualPage(texture.file, texture.cache.slotPages[0]));
+    
+    // Create indirection texture with a mipmap level per page level, integer textures are not filtered
+    glActiveTexture(GL_TEXTURE0 + VIRTUAL_TEXTURE_UNIT);
+    
+    glGenTextures(1, &texture.indirection);
+    glBindTexture(GL_TEXTURE_2D, texture.indirection);
+    
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)(texture.file.levelCount - 1));
+    
+    for (size_t level = 0; level < texture.file.levelCount; level++) {
+        GLsizei count = (GLsizei)(texture.file.pageCount >> level);
+        glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8UI, count, count, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+    }
+    
+    uploadVirtualIndirection(texture);
+    
+    glBindTexture(GL_TEXTURE_2D, texture.atlas);
+    
+    // Load virtual texture parameters to scene programs
+    for (size_t i = 0; i < scene.programs.size(); i++)
+        setVirtualTextureUniforms(scene.programs[i], texture.file, 0.0f);
+    
+    // Create feedback program of every scene program, requesting levels of the full viewport
+    texture.feedbackPrograms.assign(scene.programs.size(), 0);
+    
+    for (size_t i = 0; i < scene.materials.size(); i++) {
+        GLuint & programID = texture.feedbackPrograms[scene.materials[i].program];
+        
+        if (programID != 0)
+            continue;
+        
+        uint32_t variant = getMaterialVariant(scene.materials[i])
+            | SHADER_TEXTURED | SHADER_VIRTUAL_TEXTURE | SHADER_VIRTUAL_FEEDBACK;
+        
+        if (!createProgram(programName, variant, programID))
+            return false;
+        
+        setupProgram(programID);
+        setVirtualTextureUniforms(programID, texture.file, -(float)VIRTUAL_FEEDBACK_SHIFT);
+    }
+    
+    // Create pixel buffer objects of feedback, the framebuffer is created at the first pass
+    glGenBuffers(2, texture.feedbackBuffers);
+    
+    texture.feedbackFramebuffer = 0;
+    texture.feedbackColor = 0;
+    texture.feedbackDepth = 0;
+    texture.feedbackWidth = 0;
+    texture.feedbackHeight = 0;
+    texture.feedbackCount = 0;
+    
+    startVirtualTextureStreamer(texture.file, VIRTUAL_STAGING_COUNT, texture.streamer);
+    
+    return true;
+}
+
+// Stop streaming thread, delete OpenGL objects and unmap page file
+void deleteVirtualTexture(VirtualTexture & texture) {
+    stopVirtualTextureStreamer(texture.streamer);
+    
+    glDeleteTextures(1, &texture.atlas);
+    glDeleteTextures(1, &texture.indirection);
+    
+    for (size_t i = 0; i < texture.feedbackPrograms.size(); i++)
+        glDeleteProgram(texture.feedbackPrograms[i]);
+    
+    glDeleteFramebuffers(1, &texture.feedbackFramebuffer);
+    glDeleteRenderbuffers(1, &texture.feedbackColor);
+    glDeleteRenderbuffers(1, &texture.feedbackDepth);
+    glDeleteBuffers(2, texture.feedbackBuffers);
+    
+    closeVirtualTextureFile(texture.file);
+}
+
+// Request pages sampled by an earlier feedback pass and upload streamed pages to the atlas
+// Feedback is read from the pixel buffer object written two passes before, which this frame
+// reuses, so its readback has had a whole frame to finish and mapping it does not wait for the GPU
+void updateVirtualTexture(uint64_t frame, VirtualTexture & texture) {
+    PROFILE_ZONE("updateVirtualTexture");
+    
+    VirtualPageCache & cache = texture.cache;
+    
+    // Decode pages sampled by the feedback pass before the previous one, once two passes exist
+    texture.sampledPages.clear();
+    
+    if (texture.feedbackCount >= 2) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, texture.feedbackBuffers[texture.feedbackCount % 2]);
+        
+        const unsigned char * pixels = (const unsigned char *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        
+        if (pixels != nullptr) {
+            decodeVirtualFeedback(
+                cache,
+                pixels,
+                (size_t)texture.feedbackWidth * texture.feedbackHeight,
+                texture.sampledPages);
+            
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    
+    // Keep sampled pages and list missing ones before placing pages, so sampled pages are not evicted
+    findMissingVirtualPages(cache, texture.sampledPages, frame, texture.missingPages);
+    
+    // Place streamed pages within the upload budget
+    takeStreamedPages(texture.streamer, VIRTUAL_UPLOAD_BUDGET, texture.streamedPages);
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, texture.atlas);
+    
+    for (size_t i = 0; i < texture.streamedPages.size(); i++) {
+        const StreamedPage & page = texture.streamedPages[i];
+        size_t slot;
+        
+        if (insertVirtualPage(cache, page.page, frame, slot))
+            uploadVirtualPage(cache, slot, getStagingPage(texture.streamer, page.staging));
+        
+        releaseStagingPage(texture.streamer, page.staging);
+    }
+    
+    // Request pages still missing, replacing the requests of the previous frame
+    texture.missingPages.erase(
+        std::remove_if(texture.missingPages.begin(), texture.missingPages.end(), [&](uint32_t page) {
+            return isVirtualPageResident(cache, page);
+        }),
+        texture.missingPages.end());
+    
+    requestStreamedPages(texture.streamer, texture.missingPages);
+    
+    uploadVirtualIndirection(texture);
+}
+
+// Bind feedback framebuffer of viewport, recreated when the viewport size changes, and clear it
+// Pixels without samples stay zero
+void beginVirtualFeedback(int width, int height, VirtualTexture & texture) {
+    int feedbackWidth = std::max(1, (width + (1 << VIRTUAL_FEEDBACK_SHIFT) - 1) >> VIRTUAL_FEEDBACK_SHIFT);
+    int feedbackHeight = std::max(1, (height + (1 << VIRTUAL_FEEDBACK_SHIFT) - 1) >> VIRTUAL_FEEDBACK_SHIFT);
+    
+    if (feedbackWidth != texture.feedbackWidth || feedbackHeight != texture.feedbackHeight) {
+        glDeleteFramebuffers(1, &texture.feedbackFramebuffer);
+        glDeleteRenderbuffers(1, &texture.feedbackColor);
+        glDeleteRenderbuffers(1, &texture.feedbackDepth);
+        
+        // Create color and depth renderbuffers
+        glGenRenderbuffers(1, &texture.feedbackColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, texture.feedbackColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, feedbackWidth, feedbackHeight);
+        
+        glGenRenderbuffers(1, &texture.feedbackDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, texture.feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+        
+        glGenFramebuffers(1, &texture.feedbackFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, texture.feedbackFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, texture.feedbackColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, texture.feedbackDepth);
+        
+        // Resize pixel buffer objects, discarding pending feedback of the previous size
+        for (size_t i = 0; i < 2; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, texture.feedbackBuffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)feedbackWidth * feedbackHeight * 4, nullptr, GL_STREAM_READ);
+        }
+        
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        
+        texture.feedbackWidth = feedbackWidth;
+        texture.feedbackHeight = feedbackHeight;
+        texture.feedbackCount = 0;
+    }
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, texture.feedbackFramebuffer);
+    glViewport(0, 0, feedbackWidth, feedbackHeight);
+    
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClearDepth(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Start reading feedback into the next pixel buffer object and rebind the framebuffer and viewport
+void endVirtualFeedback(GLuint framebuffer, int width, int height, VirtualTexture & texture) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, texture.feedbackBuffers[texture.feedbackCount % 2]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, texture.feedbackWidth, texture.feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    texture.feedbackCount++;
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
+
+// Number of GPU timer queries in flight, so results are read without stalling the pipeline
+const size_t BENCHMARK_QUERY_COUNT = 4;
+
+// Framebuffer object with multisampled color and depth renderbuffers
+struct OffscreenBuffers {
+    GLuint fbo;
+    GLuint color;
+    GLuint depth;
+};
+
+// Create and bind framebuffer object replacing the window framebuffer
+bool createOffscreenBuffers(int width, int height, OffscreenBuffers & buffers) {
+    // Match window multisampling within the implementation limit
+    GLint samples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &samples);
+    samples = std::min(samples, 16);
+    
+    // Create color and depth renderbuffers
+    glGenRenderbuffers(1, &buffers.color);
+    glBindRenderbuffer(GL_RENDERBUFFER, buffers.color);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    
+    glGenRenderbuffers(1, &buffers.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, buffers.depth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    
+    // Create and bind framebuffer object with attached renderbuffers
+    glGenFramebuffers(1, &buffers.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, buffers.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, buffers.color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, buffers.depth);
+    
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+// Delete framebuffer object and renderbuffers
+void deleteOffscreenBuffers(OffscreenBuffers & buffers) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    glDeleteFramebuffers(1, &buffers.fbo);
+    glDeleteRenderbuffers(1, &buffers.color);
+    glDeleteRenderbuffers(1, &buffers.depth);
+}
+
+// Get elapsed time of timer query in milliseconds, waiting for the result
+double getQueryTime(GLuint query) {
+    GLuint64 time = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &time);
+    
+    return time * 1e-6;
+}
+
+// Initialize light, camera, material and view matrix
+void setupScene() {
+    // Initialize light parameters
     LIGHT.position = glm::vec3(40.0f, 0.0f, 0.0f);
     LIGHT.color = glm::vec3(1.0f, 1.0f, 1.0f) * 500.0f;
+    LIGHT.radius = 1000.0f;
+    
+    // Initialize camera parameters
+    CAMERA.position = glm::vec3(40.0f, 0.0f, 0.0f);
+    
+    // Initialize material parameters
+    MATERIAL.color = glm::vec3(1.0f, 1.0f, 1.0f);
+    MATERIAL.exponent = 15.0f;
+    
+    // Setup view matrix
+    VIEW = glm::lookAt(
+        CAMERA.position,
+        glm::vec3(0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Output file of the software rasterizer when OpenGL is not available
+const char * const HEADLESS_OUTPUT_FILENAME = "frame.ppm";
+
+// Shader sources of the scene programs, without extension
+const char * const PROGRAM_NAME = "../res/shaders/blinn_phong";
+
+// Write recorded profiler zones to trace file when requested
+void writeTrace(const std::string & traceFilename) {
+    if (!traceFilename.empty() && !writeProfileTrace(traceFilename))
+        std::cout << "Cannot write trace." << std::endl;
+}
+
+// Render a single frame with the software rasterizer and write it to Netpbm file format (PPM)
+// Used on machines without display or GPU, with the same mesh, texture and scene as the window
+int renderHeadless(
+        const std::string & meshFilename,
+        const std::string & imageFilename,
+        const LevelOfDetailSettings & settings,
+        const std::string & outputFilename,
+        const std::string & traceFilename) {
+    // Read triangle mesh from Wavefront OBJ file format to memory
+    TriangleMesh mesh;
+    
+    if (!readTriangleMeshFile(meshFilename, settings, mesh)) {
+        std::cout << "Cannot read triangle mesh." << std::endl;
+        return -1;
+    }
+    
+    // Read full resolution image from Netpbm file format (PPM) as linear colors
+    RasterizerTexture texture;
+    
+    {
+        Image image;
+        
+        if (!readImage(imageFilename, image)) {
+            std::cout << "Cannot read image." << std::endl;
+            return -1;
+        }
+        
+        texture.width = image.width;
+        texture.height = image.height;
+        
+        convertImage(image, texture.texels);
+    }
     
-    // Initialize camera parameters
-    CAMERA.position = glm::vec3(40.0f, 0.0f, 0.0f);
+    setViewport(800, 600);
+    setupScene();
     
-    // Initialize material parameters
-    MATERIAL.color = glm::vec3(1.0f, 1.0f, 1.0f);
-    MATERIAL.exponent = 15.0f;
+    RasterizerUniforms uniforms;
+    uniforms.model = MODEL;
+    uniforms.view = VIEW;
+    uniforms.projection = PROJECTION;
+    uniforms.cameraPosition = CAMERA.position;
+    uniforms.lightPosition = LIGHT.position;
+    uniforms.lightColor = LIGHT.color;
+    uniforms.materialColor = MATERIAL.color;
+    uniforms.exponent = MATERIAL.exponent;
+    uniforms.clearColor = BACKGROUND_STATE ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f);
     
-    // Setup view matrix
-    VIEW = glm::lookAt(
-        CAMERA.position,
-        glm::vec3(0.0f),
-        glm::vec3(0.0f, 1.0f, 0.0f));
+    // Render level of detail selected as in the window
+    BoundingBox bounds = computeBoundingBox(mesh.vertices.data(), mesh.vertices.size());
+    const LevelOfDetail & level = mesh.levels[selectLevelOfDetail(mesh.levels, bounds, MODEL)];
+    
+    Image frame;
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    renderTriangles(
+        mesh.vertices.data(),
+        mesh.vertices.size(),
+        mesh.indices.data() + level.indexOffset,
+        level.indexCount,
+        uniforms,
+        texture,
+        (size_t)VIEWPORT.x,
+        (size_t)VIEWPORT.y,
+        frame);
+    
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    
+    std::cout << "Rendered " << level.indexCount / 3 << " triangles in "
+        << elapsed.count() << " ms on " << getThreadCount() << " threads." << std::endl;
+    
+    if (!writeImage(outputFilename, frame)) {
+        std::cout << "Cannot write image." << std::endl;
+        return -1;
+    }
+    
+    writeTrace(traceFilename);
+    
+    return 0;
+}
+
+int main(int argc, char ** argv) {
+    // GLM usage
+    //
+    // glm::vec3 u(1.0f, 0, 0);
+    // glm::vec3 v(0, 1.0f, 0);
+    //
+    // glm::vec3 d = glm::dot(u, v);
+    //
+    // glm::mat3 m(0.0f, 1.0f, 2.0f,  // First column
+    //			   3.0f, 4.0f, 5.0f,  // Second column
+    //			   6.0f, 7.0f, 8.0f); // Third column
+    //
+    // Print GLM matrix
+    // std::cout << glm::to_string(m) << std::endl;
+    //
+    // Access the first column as GLM vector
+    // std::cout << glm::to_string(m[0]) << std::endl;
+    //
+    // Access the second element of the first column as float
+    // std::cout << m[0][1] << std::endl;
+
+    // Start time of time to first frame and to all assets loaded
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    
+    // Parse command line options
+    // --quantize: upload compressed vertices
+    // --lod-count <count>: number of levels of detail including full resolution
+    // --headless <output>: render a single frame on the CPU to a PPM file
+    // --mesh <file>: Wavefront OBJ file or chunked mesh file (.cgchunks) to render
+    // --texture <file>: Netpbm image file to map on the mesh
+    // --benchmark: render frames along a fixed path without vsync and report timings
+    // --frames <count>: number of benchmark frames after warmup
+    // --offscreen: render benchmark frames to a framebuffer object in a hidden window
+    // --report <file>: write benchmark report to file instead of standard output
+    // --trace <file>: write profiler zones in Chrome trace event format at exit
+    // --instances <count>: draw copies of the mesh on a grid with per-instance culling
+    // --lights <count>: scatter point lights in the scene bounds, added to the scene lights
+    // --scene <file>: draw meshes, textures and materials of a scene file instead of the mesh
+    // --precompile-shaders: create every shader variant, filling the program cache
+    // --deform: deform the mesh every frame with morph targets streamed to the GPU
+    // --compress <bc1|bc7>: block compress 8-bit textures, cached next to the image files
+    // --compression-quality <quality>: compression quality from 0 (fastest) to 3 (best)
+    // --virtual-texture: stream pages of the texture from a page file built next to it
+    // --virtual-atlas <slots>: pages along each side of the virtual texture atlas
+    VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
+    
+    bool headless = false;
+    std::string outputFilename = HEADLESS_OUTPUT_FILENAME;
+    
+    std::string meshFilename = "../res/meshes/emily.obj";
+    std::string imageFilename = "../res/textures/diffuse.ppm";
+    
+    bool benchmark = false;
+    bool offscreen = false;
+    size_t benchmarkFrameCount = 1000;
+    std::string reportFilename;
+    std::string traceFilename;
+    size_t instanceCount = 0;
+    size_t lightCount = 0;
+    std::string sceneFilename;
+    bool precompileShaders = false;
+    bool deform = false;
+    bool virtualTexture = false;
+    size_t virtualAtlasSlots = VIRTUAL_ATLAS_SLOTS;
+    
+    TextureCompressionSettings textureCompression;
+    textureCompression.format = TEXTURE_COMPRESSION_NONE;
+    textureCompression.quality = 2;
+    
+    LevelOfDetailSettings levelOfDetailSettings;
+    levelOfDetailSettings.levelCount = 4;
+    levelOfDetailSettings.ratio = 0.5f;
+    levelOfDetailSettings.maxError = 0.05f;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        
+        if (option == "--quantize")
+            vertexFormat = VERTEX_FORMAT_QUANTIZED;
+        else if (option == "--lod-count" && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            levelOfDetailSettings.levelCount = (size_t)std::atoi(argv[++i]);
+        else if (option == "--headless" && i + 1 < argc) {
+            headless = true;
+            outputFilename = argv[++i];
+        }
+        else if (option == "--mesh" && i + 1 < argc)
+            meshFilename = argv[++i];
+        else if (option == "--texture" && i + 1 < argc)
+            imageFilename = argv[++i];
+        else if (option == "--benchmark")
+            benchmark = true;
+        else if (option == "--frames" && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            benchmarkFrameCount = (size_t)std::atoi(argv[++i]);
+        else if (option == "--offscreen")
+            offscreen = true;
+        else if (option == "--report" && i + 1 < argc)
+            reportFilename = argv[++i];
+        else if (option == "--trace" && i + 1 < argc)
+            traceFilename = argv[++i];
+        else if (option == "--instances" && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            instanceCount = (size_t)std::atoi(argv[++i]);
+        else if (option == "--lights" && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            lightCount = (size_t)std::atoi(argv[++i]);
+        else if (option == "--scene" && i + 1 < argc)
+            sceneFilename = argv[++i];
+        else if (option == "--precompile-shaders")
+            precompileShaders = true;
+        else if (option == "--deform")
+            deform = true;
+        else if (option == "--virtual-texture")
+            virtualTexture = true;
+        else if (option == "--virtual-atlas" && i + 1 < argc
+                && std::atoi(argv[i + 1]) > 1 && std::atoi(argv[i + 1]) <= (int)MAX_VIRTUAL_SLOT_COUNT)
+            virtualAtlasSlots = (size_t)std::atoi(argv[++i]);
+        else if (option == "--compress" && i + 1 < argc && std::string(argv[i + 1]) == "bc1") {
+            textureCompression.format = TEXTURE_COMPRESSION_BC1;
+            i++;
+        }
+        else if (option == "--compress" && i + 1 < argc && std::string(argv[i + 1]) == "bc7") {
+            textureCompression.format = TEXTURE_COMPRESSION_BC7;
+            i++;
+        }
+        else if (option == "--compression-quality" && i + 1 < argc
+                && std::atoi(argv[i + 1]) >= 0 && std::atoi(argv[i + 1]) <= (int)MAX_COMPRESSION_QUALITY)
+            textureCompression.quality = (uint32_t)std::atoi(argv[++i]);
+        else {
+            std::cout << "Unknown option " << option << "." << std::endl;
+            return -1;
+        }
+    }
+    
+    if (offscreen && !benchmark) {
+        std::cout << "Option --offscreen requires --benchmark." << std::endl;
+        return -1;
+    }
+    
+    if (deform && (!sceneFilename.empty() || instanceCount > 0 || isChunkedMeshFilename(meshFilename))) {
+        std::cout << "Option --deform requires a single mesh without instances." << std::endl;
+        return -1;
+    }
+    
+    if (virtualTexture && (!sceneFilename.empty() || instanceCount > 0)) {
+        std::cout << "Option --virtual-texture requires a single mesh without instances." << std::endl;
+        return -1;
+    }
+    
+    if (virtualTexture && textureCompression.format != TEXTURE_COMPRESSION_NONE) {
+        std::cout << "Option --virtual-texture cannot be combined with --compress." << std::endl;
+        return -1;
+    }
+    
+    if (headless)
+        return renderHeadless(meshFilename, imageFilename, levelOfDetailSettings, outputFilename, traceFilename);
+    
+    // Check GLFW initialization, falling back to the software rasterizer outside benchmarks
+    if (!glfwInit()) {
+        if (benchmark) {
+            std::cout << "Cannot initialize GLFW." << std::endl;
+            return -1;
+        }
+        
+        std::cout << "Cannot initialize GLFW, rendering to " << outputFilename << "." << std::endl;
+        return renderHeadless(meshFilename, imageFilename, levelOfDetailSettings, outputFilename, traceFilename);
+    }
+
+    // Setup OpenGL context
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_SAMPLES, 16);
+    
+    // Hide window when rendering offscreen
+    if (offscreen)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    // Create window
+    GLFWwindow * window = glfwCreateWindow(800, 600, "Window", nullptr, nullptr);
+
+    // Check if cannot create window, falling back to the software rasterizer
+    if (window == nullptr) {
+        glfwTerminate();
+        
+        if (benchmark) {
+            std::cout << "Cannot create window." << std::endl;
+            return -1;
+        }
+
+        std::cout << "Cannot create window, rendering to " << outputFilename << "." << std::endl;
+        return renderHeadless(meshFilename, imageFilename, levelOfDetailSettings, outputFilename, traceFilename);
+    }
+
+    // Register event callbacks
+    glfwSetFramebufferSizeCallback(window, resize);
+    glfwSetKeyCallback(window, keyboard);
+
+    // Setup window context
+    glfwMakeContextCurrent(window);
+
+    // Check if cannot load OpenGL procedures, falling back to the software rasterizer
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        
+        if (benchmark) {
+            std::cout << "Cannot load OpenGL procedures." << std::endl;
+            return -1;
+        }
+
+        std::cout << "Cannot load OpenGL procedures, rendering to " << outputFilename << "." << std::endl;
+        return renderHeadless(meshFilename, imageFilename, levelOfDetailSettings, outputFilename, traceFilename);
+    }
+    
+    // Synchronize GPU timer queries with the profiler clock
+    GpuProfiler gpuProfiler;
+    createGpuProfiler(gpuProfiler);
+    
+    // Load program binary procedures of the program cache
+    if (!loadProgramBinaryProcedures((GLADloadproc)glfwGetProcAddress))
+        std::cout << "Program binaries are not supported, shaders are compiled at every run." << std::endl;
+    
+    // Load buffer storage procedure of persistently mapped stream buffers
+    if (!loadBufferStorageProcedures((GLADloadproc)glfwGetProcAddress) && deform)
+        std::cout << "Buffer storage is not supported, dynamic meshes are mapped every frame." << std::endl;
+    
+    // Check support of the compressed texture format, falling back to uncompressed textures
+    if (!isTextureCompressionSupported(textureCompression.format)) {
+        std::cout << "Texture compression is not supported, textures are uncompressed." << std::endl;
+        textureCompression.format = TEXTURE_COMPRESSION_NONE;
+    }
+    
+    // Check if cannot create shader program variants
+    if (precompileShaders && !precompilePrograms(PROGRAM_NAME)) {
+        glfwTerminate();
+
+        std::cout << "Cannot create shader program." << std::endl;
+        return -1;
+    }
+    
+    // Enable depth test
+    glEnable(GL_DEPTH_TEST);
+    
+    // Initialize projection matrix and viewport
+    resize(window, 800, 600);
+    
+    // Initialize light, camera, material and view matrix
+    setupScene();
+    
+    // Read scene file or place the mesh with its texture and the default material at the origin
+    SceneDescription sceneDescription;
+    
+    if (!sceneFilename.empty()) {
+        if (!readSceneFile(sceneFilename, sceneDescription)) {
+            glfwTerminate();
+            
+            std::cout << "Cannot read scene." << std::endl;
+            return -1;
+        }
+    }
+    else {
+        SceneMaterial material;
+        material.color = MATERIAL.color;
+        material.exponent = MATERIAL.exponent;
+        material.texture = virtualTexture ? SCENE_NO_TEXTURE : 0;
+        material.program = 0;
+        material.flatShading = false;
+        
+        SceneObject object;
+        object.mesh = 0;
+        object.material = 0;
+        object.model = glm::mat4(1.0f);
+        
+        // Place every chunk of chunked mesh file as a separate mesh, loaded and culled on its own
+        ChunkedMesh chunkedMesh;
+        
+        if (isChunkedMeshFilename(meshFilename) && openChunkedMesh(meshFilename, chunkedMesh)) {
+            for (size_t i = 0; i < chunkedMesh.chunks.size(); i++) {
+                object.mesh = (uint32_t)i;
+                
+                sceneDescription.meshFilenames.push_back(getMeshChunkFilename(meshFilename, i));
+                sceneDescription.objects.push_back(object);
+            }
+            
+            closeChunkedMesh(chunkedMesh);
+        }
+        else {
+            sceneDescription.meshFilenames.push_back(meshFilename);
+            sceneDescription.objects.push_back(object);
+        }
+        
+        // Virtual textures are streamed by pages instead of loaded by the asset loader
+        if (!virtualTexture)
+            sceneDescription.imageFilenames.push_back(imageFilename);
+        
+        sceneDescription.materials.push_back(material);
+    }
+    
+    // Draw placeholders while loader threads read meshes and textures of scene
+    // Color values of textures are kept linear as in the shading model
+    Scene scene;
+    std::vector<AssetRequest> assetRequests;
+    
+    // Check if cannot create shader programs of scene materials
+    uint32_t variantBits = virtualTexture ? SHADER_TEXTURED | SHADER_VIRTUAL_TEXTURE : 0;
+    
+    if (!createScene(sceneDescription, PROGRAM_NAME, variantBits, scene, assetRequests)) {
+        glfwTerminate();
+        
+        std::cout << "Cannot create shader program." << std::endl;
+        return -1;
+    }
+    
+    // Use shader program of the first material, drawn by instancing
+    if (!scene.programs.empty())
+        glUseProgram(scene.programs[0]);
+    
+    AssetLoader assetLoader;
+    
+    startAssetLoader(
+        assetRequests,
+        vertexFormat,
+        levelOfDetailSettings,
+        false,
+        MIPMAP_FILTER_KAISER,
+        textureCompression,
+        getThreadCount(),
+        assetLoader);
+    
+    AssetUploader assetUploader;
+    createAssetUploader(assetUploader);
+    
+    // Benchmarks, instancing, placed lights and deformation wait for all assets,
+    // so frames, bounds and vertices do not depend on load times
+    if (benchmark || instanceCount > 0 || lightCount > 0 || deform) {
+        while (assetUploader.completedCount < assetRequests.size()) {
+            updateAssetUploader(assetLoader, scene, SIZE_MAX, assetUploader);
+            std::this_thread::yield();
+        }
+        
+        if (assetUploader.failedCount > 0) {
+            stopAssetLoader(assetLoader);
+            glfwTerminate();
+            
+            std::cout << "Cannot load scene." << std::endl;
+            return -1;
+        }
+    }
+    
+    // Stream deformed vertices of the mesh instead of its static vertices
+    DynamicMesh dynamicMesh;
     
-    // Get model matrix location in shader program
-    GLint modelLocationID = glGetUniformLocation(programID, "model");
+    if (deform && !createDynamicMesh(meshFilename, levelOfDetailSettings, scene, 0, dynamicMesh)) {
+        stopAssetLoader(assetLoader);
+        glfwTerminate();
+        
+        std::cout << "Cannot create dynamic mesh." << std::endl;
+        return -1;
+    }
+    
+    // Stream pages of the texture into the atlas instead of loading the whole texture
+    VirtualTexture virtualTextureState;
+    
+    if (virtualTexture && !createVirtualTexture(imageFilename, PROGRAM_NAME, virtualAtlasSlots, scene, virtualTextureState)) {
+        stopAssetLoader(assetLoader);
+        glfwTerminate();
+        
+        std::cout << "Cannot create virtual texture." << std::endl;
+        return -1;
+    }
+    
+    // Create uniform buffer objects updated when their contents change
+    UniformBlock<FrameUniforms> frameBlock;
+    UniformBlock<MeshUniforms> meshBlock;
+    
+    createUniformBlock(FRAME_UNIFORM_BINDING, frameBlock);
+    createUniformBlock(MESH_UNIFORM_BINDING, meshBlock);
+    
+    // Select texture unit of scene textures
+    glActiveTexture(GL_TEXTURE0);
+    
+    // Draw list and meshlet culling buffers reused across frames
+    DrawList drawList;
+    
+    std::vector<uint32_t> visibleMeshlets;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const GLvoid *> drawOffsets;
+    
+    // Place instances of the first mesh, visible instances are batched every frame
+    InstanceSet instanceSet;
+    InstanceBatches instanceBatches;
     
-    // Get view matrix location in shader program
-    GLint viewLocationID = glGetUniformLocation(programID, "view");
+    if (instanceCount > 0) {
+        std::vector<Instance> instances;
+        placeInstances(instanceCount, scene.meshes[0].bounds, MATERIAL.exponent, instances);
+        buildInstanceSet(instances, scene.meshes[0].bounds, instanceSet);
+    }
+    
+    BoundingBox sceneBounds = instanceCount > 0 ? instanceSet.bounds : computeSceneBounds(scene);
+    
+    // Add placed lights to the scene lights, falling back to the default light
+    std::vector<PointLight> lights = scene.lights;
+    
+    if (lightCount > 0) {
+        std::vector<PointLight> placedLights;
+        placeLights(lightCount, sceneBounds, placedLights);
+        
+        lights.insert(lights.end(), placedLights.begin(), placedLights.end());
+    }
+    
+    if (lights.empty())
+        lights.push_back(LIGHT);
+    
+    // Light buffers and cluster grid, rebuilt when the viewport or projection change
+    LightBuffers lightBuffers;
+    createLightBuffers(lightBuffers);
     
-    // Get projection matrix location in shader program
-    GLint projectionLocationID = glGetUniformLocation(programID, "projection");
+    ClusterGrid clusterGrid;
+    LightClusters lightClusters;
+    
+    // Setup benchmark without vsync, with offscreen framebuffer and GPU timer queries
+    OffscreenBuffers offscreenBuffers = {};
+    GLuint timerQueries[BENCHMARK_QUERY_COUNT] = {};
+    
+    BenchmarkReport report;
+    size_t frame = 0;
+    size_t totalFrameCount = BENCHMARK_WARMUP_FRAMES + benchmarkFrameCount;
+    
+    if (benchmark) {
+        glfwSwapInterval(0);
+        
+        if (offscreen && !createOffscreenBuffers(VIEWPORT.x, VIEWPORT.y, offscreenBuffers)) {
+            stopAssetLoader(assetLoader);
+            glfwTerminate();
+            
+            std::cout << "Cannot create offscreen framebuffer." << std::endl;
+            return -1;
+        }
+        
+        glGenQueries(BENCHMARK_QUERY_COUNT, timerQueries);
+        
+        report.meshFilename = sceneFilename.empty() ? meshFilename : sceneFilename;
+        report.imageFilename = sceneFilename.empty() ? imageFilename : "";
+        report.renderer = (const char *)glGetString(GL_RENDERER);
+        report.vertexFormat = vertexFormat == VERTEX_FORMAT_QUANTIZED ? "quantized" : "float";
+        report.width = (size_t)VIEWPORT.x;
+        report.height = (size_t)VIEWPORT.y;
+        report.instanceCount = instanceCount;
+        report.lightCount = lights.size();
+    }
     
-    // Get light position location in shader program
-    GLint lightPositionLocationID = glGetUniformLocation(programID, "light.position");
+    // Step simulation on the update thread, benchmarks step it once per frame instead,
+    // so frames depend only on the frame index
+    // Placed lights orbit the scene center, scene lights and the default light stay in place
+    LightOrbits lightOrbits;
+    createLightOrbits(lights, lights.size() - lightCount, (sceneBounds.min + sceneBounds.max) * 0.5f, lightOrbits);
     
-    // Get light color location in shader program
-    GLint lightColorLocationID = glGetUniformLocation(programID, "light.color");
+    SimulationState simulationState;
+    simulationState.step = 0;
+    simulationState.time = 0.0;
+    simulationState.modelAngle = 0.0f;
+    simulationState.background = BACKGROUND_STATE;
+    simulationState.lights = lights;
     
-    // Get camera position location in shader program
-    GLint cameraPositionLocationID = glGetUniformLocation(programID, "camera.position");
+    Simulation simulation;
     
-    // Get material color location in shader program
-    GLint materialColorLocationID = glGetUniformLocation(programID, "material.color");
+    if (!benchmark)
+        startSimulation(simulationState, lightOrbits, INPUT, simulation);
     
-    // Get image location in shader program
-    GLint imageLocationID = glGetUniformLocation(programID, "image");
+    bool assetsLoaded = false;
     
     // Render loop
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) && (!benchmark || frame < totalFrameCount)) {
+        PROFILE_ZONE("frame");
+        
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        
+        // Copy assets read by loader threads to OpenGL within the frame budget
+        if (!assetsLoaded) {
+            updateAssetUploader(assetLoader, scene, ASSET_UPLOAD_BUDGET, assetUploader);
+            
+            if (assetUploader.completedCount == assetRequests.size()) {
+                assetsLoaded = true;
+                
+                std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+                std::cout << "Assets loaded after " << loadTime.count() << " ms." << std::endl;
+            }
+        }
+        
+        // Take state of the latest simulation step, interpolated to the frame start
+        if (benchmark)
+            stepSimulation(lightOrbits, 0, 0, simulationState);
+        else
+            interpolateSimulation(acquireSnapshot(simulation), frameStart, simulationState);
+        
+        MODEL = glm::rotate(glm::mat4(1.0f), simulationState.modelAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+        BACKGROUND_STATE = simulationState.background;
+        
+        if (benchmark) {
+            GLuint timerQuery = timerQueries[frame % BENCHMARK_QUERY_COUNT];
+            
+            // Read GPU time of the frame that used the query before
+            if (frame >= BENCHMARK_WARMUP_FRAMES + BENCHMARK_QUERY_COUNT)
+                report.gpuTimes.push_back(getQueryTime(timerQuery));
+            
+            // Move model and camera along the benchmark path, holding the start during warmup
+            size_t pathFrame = frame < BENCHMARK_WARMUP_FRAMES ? 0 : frame - BENCHMARK_WARMUP_FRAMES;
+            
+            getBenchmarkFrame(
+                pathFrame,
+                benchmarkFrameCount,
+                sceneBounds,
+                PROJECTION,
+                MODEL,
+                CAMERA.position);
+            
+            VIEW = glm::lookAt(
+                CAMERA.position,
+                glm::vec3(0.0f),
+                glm::vec3(0.0f, 1.0f, 0.0f));
+            
+            glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+        }
+        
+        // Measure clear and draw on the GPU track of the trace
+        beginGpuZone(gpuProfiler, "frame");
+        
         // Setup color buffer
         if (BACKGROUND_STATE)
             glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
@@ -648,60 +2417,227 @@ int main(int argc, char ** argv) {
         // Clear depth buffer
         glClear(GL_DEPTH_BUFFER_BIT);
         
-        // Load model matrix as parameter to shader program
-        glUniformMatrix4fv(modelLocationID, 1, GL_FALSE, glm::value_ptr(MODEL));
+        // Objects are placed in model space, so view, light and camera are moved into it
+        // instead of transforming every object by the model matrix
+        glm::mat4 inverseModel = glm::inverse(MODEL);
+        glm::vec3 camera = glm::vec3(inverseModel * glm::vec4(CAMERA.position, 1.0f));
+        
+        // Bin lights in the clusters of the view frustum and upload their lists
+        if (!isClusterGridValid(clusterGrid, (size_t)VIEWPORT.x, (size_t)VIEWPORT.y, PROJECTION))
+            createClusterGrid((size_t)VIEWPORT.x, (size_t)VIEWPORT.y, PROJECTION, NEAR_PLANE, FAR_PLANE, clusterGrid);
+        
+        assignLights(clusterGrid, VIEW, simulationState.lights, lightClusters);
+        updateLightBuffers(simulationState.lights, inverseModel, lightClusters, lightBuffers);
         
-        // Load view matrix as parameter to shader program
-        glUniformMatrix4fv(viewLocationID, 1, GL_FALSE, glm::value_ptr(VIEW));
+        // Update per-frame uniform block when view, projection, cluster grid or camera change
+        FrameUniforms frameUniforms;
         
-        // Load projection matrix as parameter to shader program
-        glUniformMatrix4fv(projectionLocationID, 1, GL_FALSE, glm::value_ptr(PROJECTION));
+        computeFrameUniforms(
+            VIEW * MODEL,
+            PROJECTION,
+            camera,
+            clusterGrid,
+            frameUniforms);
         
-        // Load light position as parameter to shader program
-        glUniform3fv(lightPositionLocationID, 1, glm::value_ptr(LIGHT.position));
+        updateUniformBlock(frameBlock, frameUniforms);
         
-        // Load light color as parameter to shader program
-        glUniform3fv(lightColorLocationID, 1, glm::value_ptr(LIGHT.color));
+        // Request sampled pages and place streamed pages in the atlas
+        if (virtualTexture)
+            updateVirtualTexture(frame, virtualTextureState);
         
-        // Load camera position as parameter to shader program
-        glUniform3fv(cameraPositionLocationID, 1, glm::value_ptr(CAMERA.position));
+        // Deform mesh into the next region of its stream buffer
+        if (deform) {
+            float weights[2];
+            getProceduralMorphWeights(simulationState.time, weights);
+            
+            updateDynamicMesh(weights, scene.meshes[0], dynamicMesh);
+        }
         
-        // Load material color as parameter to shader program
-        glUniform3fv(materialColorLocationID, 1, glm::value_ptr(MATERIAL.color));
+        size_t triangleCount;
+        
+        if (instanceCount > 0) {
+            const MeshBuffers & mesh = scene.meshes[0];
+            
+            // Update per-mesh uniform block and texture of the instanced mesh
+            MeshUniforms meshUniforms;
+            
+            computeMeshUniforms(
+                mesh.dequantization,
+                mesh.vertexFormat == VERTEX_FORMAT_QUANTIZED,
+                meshUniforms);
+            
+            updateUniformBlock(meshBlock, meshUniforms);
+            
+            glBindTexture(GL_TEXTURE_2D, scene.textures[0]);
+            
+            // Batch visible instances by level of detail and draw each level with one call
+            cullInstances(
+                instanceSet,
+                mesh.levels,
+                frameUniforms.viewProjection,
+                camera,
+                std::fabs(PROJECTION[1][1]) * VIEWPORT.y,
+                LEVEL_OF_DETAIL_PIXEL_ERROR,
+                instanceBatches);
+            
+            beginGpuZone(gpuProfiler, "drawInstances");
+            
+            triangleCount = drawInstances(mesh, scene.instanceBuffer, instanceBatches);
+        }
+        else {
+            // Sort visible objects by state and draw them in merged batches
+            buildDrawList(
+                scene,
+                frameUniforms.viewProjection,
+                camera,
+                std::fabs(PROJECTION[1][1]) * VIEWPORT.y,
+                LEVEL_OF_DETAIL_PIXEL_ERROR,
+                drawList);
+            
+            // Draw pages sampled by fragments, read back by the next frame
+            if (virtualTexture) {
+                beginGpuZone(gpuProfiler, "drawVirtualFeedback");
+                
+                beginVirtualFeedback(VIEWPORT.x, VIEWPORT.y, virtualTextureState);
+                
+                drawScene(
+                    scene,
+                    virtualTextureState.feedbackPrograms,
+                    drawList,
+                    frameUniforms.viewProjection,
+                    camera,
+                    meshBlock,
+                    visibleMeshlets,
+                    drawCounts,
+                    drawOffsets);
+                
+                endVirtualFeedback(offscreenBuffers.fbo, VIEWPORT.x, VIEWPORT.y, virtualTextureState);
+                
+                endGpuZone(gpuProfiler);
+            }
+            
+            beginGpuZone(gpuProfiler, "drawScene");
+            
+            triangleCount = drawScene(
+                scene,
+                scene.programs,
+                drawList,
+                frameUniforms.viewProjection,
+                camera,
+                meshBlock,
+                visibleMeshlets,
+                drawCounts,
+                drawOffsets);
+        }
         
-        // Bind texture to texture unit
-        glActiveTexture(GL_TEXTURE0);
+        endGpuZone(gpuProfiler);
+        endGpuZone(gpuProfiler);
         
-        // Load texture unit as sampler parameter to shader program
-        glUniform1i(imageLocationID, 0);
+        // Fence stream buffer region after the draws reading it
+        if (deform)
+            fenceStreamRegion(dynamicMesh.vertices);
         
-        // Draw vertex array as triangles
-        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        if (benchmark)
+            glEndQuery(GL_TIME_ELAPSED);
         
         // Swap double buffer
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("swapBuffers");
+            
+            glfwSwapBuffers(window);
+        }
+
+        if (frame == 0) {
+            std::chrono::duration<double, std::milli> firstFrameTime = std::chrono::steady_clock::now() - startTime;
+            std::cout << "First frame after " << firstFrameTime.count() << " ms." << std::endl;
+        }
 
         // Process events and callbacks
         glfwPollEvents();
+        
+        // Record GPU zones of previous frames that completed
+        resolveGpuZones(gpuProfiler);
+        
+        // Record CPU frame time and drawn triangles after warmup
+        if (benchmark && frame >= BENCHMARK_WARMUP_FRAMES) {
+            std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+            
+            report.cpuTimes.push_back(frameTime.count());
+            report.triangleCounts.push_back((double)triangleCount);
+        }
+        
+        frame++;
+    }
+    
+    if (benchmark) {
+        // Read GPU times of the last frames in flight
+        size_t pendingFrame = std::max(frame, BENCHMARK_WARMUP_FRAMES + BENCHMARK_QUERY_COUNT) - BENCHMARK_QUERY_COUNT;
+        
+        for (; pendingFrame < frame; pendingFrame++)
+            report.gpuTimes.push_back(getQueryTime(timerQueries[pendingFrame % BENCHMARK_QUERY_COUNT]));
+        
+        glDeleteQueries(BENCHMARK_QUERY_COUNT, timerQueries);
+        
+        if (offscreen)
+            deleteOffscreenBuffers(offscreenBuffers);
+        
+        // Write benchmark report
+        std::string json = formatBenchmarkReport(report);
+        
+        if (reportFilename.empty())
+            std::cout << json;
+        else {
+            std::ofstream file(reportFilename, std::ofstream::out | std::ofstream::binary);
+            file << json;
+            
+            if (!file)
+                std::cout << "Cannot write benchmark report." << std::endl;
+        }
     }
 
-    // Delete shader program
-    glDeleteProgram(programID);
+    // Stop update thread
+    if (!benchmark)
+        stopSimulation(simulation);
 
-    // Delete vertex array object
-    glDeleteVertexArrays(1, &vao);
+    // Wait for the last frames and record their GPU zones
+    glFinish();
+    resolveGpuZones(gpuProfiler);
+    deleteGpuProfiler(gpuProfiler);
 
-    // Delete vertex buffer object
-    glDeleteBuffers(1, &vbo);
-    
-    // Delete texture
-    glDeleteTextures(1, &textureID);
+    // Delete uniform buffer objects
+    glDeleteBuffers(1, &frameBlock.ubo);
+    glDeleteBuffers(1, &meshBlock.ubo);
+
+    // Delete light buffers
+    deleteLightBuffers(lightBuffers);
+
+    // Delete shader programs
+    for (size_t i = 0; i < scene.programs.size(); i++)
+        glDeleteProgram(scene.programs[i]);
+
+    // Wait for loader threads and delete assets not uploaded
+    stopAssetLoader(assetLoader);
+    deleteAssetUploader(assetUploader);
+
+    // Stop streaming thread and delete virtual texture
+    if (virtualTexture)
+        deleteVirtualTexture(virtualTextureState);
+
+    // Delete stream buffer of deformed vertices
+    if (deform)
+        deleteStreamBuffer(dynamicMesh.vertices);
+
+    // Delete vertex array, buffer and texture objects of scene
+    deleteScene(scene);
 
     // Destroy window
     glfwDestroyWindow(window);
 
     // Deinitialize GLFW
     glfwTerminate();
+    
+    // Write trace of the whole run
+    writeTrace(traceFilename);
 
     return 0;
 }
@@ -0,0 +1,200 @@
+#include "mesh.hpp"
+#include "tangent_space.hpp"
+#include "profiler.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#include <cstring>
+
+namespace {
+
+// Hash vertex attributes bitwise
+inline uint32_t hashVertex(const Vertex & vertex) {
+    uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+    std::memcpy(words, &vertex, sizeof(Vertex));
+
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < sizeof(words) / sizeof(uint32_t); i++) {
+        hash ^= words[i];
+        hash *= 16777619u;
+        hash ^= hash >> 15;
+    }
+
+    return hash;
+}
+
+// Insert vertex in open addressing hash table and return its index in the unique vertex array
+uint32_t insertVertex(
+        const Vertex & vertex,
+        std::vector<uint32_t> & table,
+        std::vector<Vertex> & vertices) {
+    const uint32_t empty = ~0u;
+
+    size_t mask = table.size() - 1;
+    size_t slot = hashVertex(vertex) & mask;
+
+    while (table[slot] != empty) {
+        if (std::memcmp(&vertices[table[slot]], &vertex, sizeof(Vertex)) == 0)
+            return table[slot];
+
+        slot = (slot + 1) & mask;
+    }
+
+    table[slot] = (uint32_t)vertices.size();
+    vertices.push_back(vertex);
+
+    return table[slot];
+}
+
+}
+
+void buildTriangleMesh(
+        const std::vector<glm::vec3> & positions,
+        const std::vector<glm::vec3> & normals,
+        const std::vector<glm::vec2> & textureCoordinates,
+        const std::vector<uint32_t> & positionIndices,
+        const std::vector<uint32_t> & normalIndices,
+        const std::vector<uint32_t> & textureCoordinateIndices,
+        TriangleMesh & mesh) {
+    PROFILE_ZONE("buildTriangleMesh");
+
+    size_t cornerCount = positionIndices.size() / 3 * 3;
+
+    // Attributes are used only when every corner references them
+    bool hasNormals = normals.size() > 0 && normalIndices.size() >= cornerCount;
+    bool hasTextureCoordinates = textureCoordinates.size() > 0
+        && textureCoordinateIndices.size() >= cornerCount;
+
+    // Generate smooth normals by corner, merged with the other attributes below
+    std::vector<glm::vec3> cornerNormals;
+
+    if (!hasNormals)
+        generateSmoothNormals(
+            positions,
+            positionIndices,
+            DEFAULT_CREASE_ANGLE,
+            NORMAL_WEIGHTING_ANGLE,
+            cornerNormals);
+
+    mesh.vertices.clear();
+    mesh.tangents.clear();
+    mesh.indices.resize(cornerCount);
+
+    // Hash table sized to the next power of two above twice the corner count
+    size_t tableSize = 1;
+
+    while (tableSize < cornerCount * 2)
+        tableSize <<= 1;
+
+    std::vector<uint32_t> table(tableSize, ~0u);
+
+    mesh.vertices.reserve(cornerCount / 4);
+
+    for (size_t i = 0; i < cornerCount / 3; i++) {
+        Vertex triangleVertices[3];
+
+        for (size_t j = 0; j < 3; j++) {
+            Vertex & vertex = triangleVertices[j];
+            vertex.position = positions[positionIndices[i * 3 + j]];
+        }
+
+        if (hasNormals) {
+            for (size_t j = 0; j < 3; j++) {
+                Vertex & vertex = triangleVertices[j];
+                vertex.normal = normals[normalIndices[i * 3 + j]];
+            }
+        }
+        else {
+            for (size_t j = 0; j < 3; j++)
+                triangleVertices[j].normal = cornerNormals[i * 3 + j];
+        }
+
+        for (size_t j = 0; j < 3; j++) {
+            Vertex & vertex = triangleVertices[j];
+
+            if (hasTextureCoordinates)
+                vertex.textureCoordinate = textureCoordinates[textureCoordinateIndices[i * 3 + j]];
+            else
+                vertex.textureCoordinate = glm::vec2((float)(j == 1), (float)(j == 2));
+        }
+
+        for (size_t j = 0; j < 3; j++)
+            mesh.indices[i * 3 + j] = insertVertex(triangleVertices[j], table, mesh.vertices);
+    }
+
+    mesh.vertices.shrink_to_fit();
+
+    // Single full resolution level
+    LevelOfDetail level = { 0, mesh.indices.size(), 0.0f, 0, 0 };
+    mesh.levels.assign(1, level);
+}
+
+BoundingBox computeBoundingBox(const Vertex * vertices, size_t vertexCount) {
+    BoundingBox bounds;
+    bounds.min = glm::vec3(0.0f);
+    bounds.max = glm::vec3(0.0f);
+
+    if (vertexCount == 0)
+        return bounds;
+
+    bounds.min = vertices[0].position;
+    bounds.max = vertices[0].position;
+
+    for (size_t i = 1; i < vertexCount; i++) {
+        bounds.min = glm::min(bounds.min, vertices[i].position);
+        bounds.max = glm::max(bounds.max, vertices[i].position);
+    }
+
+    return bounds;
+}
+
+size_t getIndexSize(size_t vertexCount) {
+    return vertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void packIndices(
+        const std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        std::vector<unsigned char> & buffer) {
+    size_t indexSize = getIndexSize(vertexCount);
+
+    buffer.resize(indices.size() * indexSize);
+
+    if (indexSize == sizeof(uint32_t)) {
+        if (!indices.empty())
+            std::memcpy(buffer.data(), indices.data(), buffer.size());
+
+        return;
+    }
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        uint16_t index = (uint16_t)indices[i];
+        std::memcpy(&buffer[i * sizeof(uint16_t)], &index, sizeof(uint16_t));
+    }
+}
+
+void unpackIndices(
+        const void * buffer,
+        size_t indexCount,
+        size_t indexSize,
+        std::vector<uint32_t> & indices) {
+    indices.resize(indexCount);
+
+    if (indexSize == sizeof(uint32_t)) {
+        if (indexCount > 0)
+            std::memcpy(indices.data(), buffer, indexCount * sizeof(uint32_t));
+
+        return;
+    }
+
+    const unsigned char * input = (const unsigned char *)buffer;
+
+    for (size_t i = 0; i < indexCount; i++) {
+        uint16_t index;
+        std::memcpy(&index, input + i * sizeof(uint16_t), sizeof(uint16_t));
+
+        indices[i] = index;
+    }
+}
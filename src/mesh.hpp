@@ -0,0 +1,94 @@
+#ifndef CG20192_MESH_HPP
+#define CG20192_MESH_HPP
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Interleaved vertex attributes
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 textureCoordinate;
+};
+
+// Range of a level of detail in the index buffer and in the meshlets
+// The error is the simplification distance relative to the mesh extent
+struct LevelOfDetail {
+    size_t indexOffset;
+    size_t indexCount;
+    float error;
+
+    size_t meshletOffset;
+    size_t meshletCount;
+};
+
+// Cluster of triangles contiguous in the index buffer
+// The bounding sphere and the cone of triangle normals are given in object space
+// and the cone cutoff is the sine of the cone spread (1 when the cone cannot cull)
+struct Meshlet {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+
+    glm::vec3 center;
+    float radius;
+
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Indexed triangle mesh with unique vertices
+// Levels of detail share the vertices and are stored one after another in the indices,
+// starting from the full resolution level
+// Tangents with handedness in w are one per vertex, generated once the vertex order is final
+struct TriangleMesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<LevelOfDetail> levels;
+    std::vector<Meshlet> meshlets;
+    std::vector<glm::vec4> tangents;
+};
+
+// Axis-aligned bounding box
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Build indexed triangle mesh from separate attribute index streams
+// Corners sharing the same position, normal and texture coordinate are merged in a single vertex
+// Missing normals are generated smooth with the default crease angle
+// and missing texture coordinates are calculated by primitive
+void buildTriangleMesh(
+        const std::vector<glm::vec3> & positions,
+        const std::vector<glm::vec3> & normals,
+        const std::vector<glm::vec2> & textureCoordinates,
+        const std::vector<uint32_t> & positionIndices,
+        const std::vector<uint32_t> & normalIndices,
+        const std::vector<uint32_t> & textureCoordinateIndices,
+        TriangleMesh & mesh);
+
+// Compute bounding box of vertex positions
+BoundingBox computeBoundingBox(const Vertex * vertices, size_t vertexCount);
+
+// Get index size in bytes required to address vertex count (2 or 4)
+size_t getIndexSize(size_t vertexCount);
+
+// Convert indices to 16-bit when vertex count allows it
+// The output buffer holds indices of getIndexSize(vertexCount) bytes
+void packIndices(
+        const std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        std::vector<unsigned char> & buffer);
+
+// Convert 16-bit or 32-bit packed indices back to 32-bit integers
+void unpackIndices(
+        const void * buffer,
+        size_t indexCount,
+        size_t indexSize,
+        std::vector<uint32_t> & indices);
+
+#endif
@@ -0,0 +1,314 @@
+#include "mesh_cache.hpp"
+#include "profiler.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// File identification and format version
+// The version must be increased whenever the header, the vertex layout
+// or the mesh processing changes
+const char MESH_CACHE_MAGIC[8] = { 'C', 'G', 'M', 'E', 'S', 'H', '\0', '\0' };
+const uint32_t MESH_CACHE_VERSION = 5;
+
+// Alignment of data blocks inside the file
+const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+// Mesh cache file header, stored in native byte order
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexSize;
+
+    uint64_t vertexCount;
+    uint64_t vertexOffset;
+
+    uint64_t indexCount;
+    uint64_t indexOffset;
+    uint32_t indexSize;
+    uint32_t levelCount;
+
+    float boundsMin[3];
+    float boundsMax[3];
+
+    uint64_t sourceSize;
+    int64_t sourceModificationTime;
+    uint64_t sourceHash;
+
+    uint64_t levelOffset;
+    uint32_t settingsLevelCount;
+    float settingsRatio;
+    float settingsMaxError;
+    uint32_t meshletSize;
+
+    uint64_t meshletCount;
+    uint64_t meshletOffset;
+
+    uint64_t tangentCount;
+    uint64_t tangentOffset;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 160, "Unexpected mesh cache header padding");
+
+// Level of detail range in indices and meshlets
+struct MeshCacheLevel {
+    uint64_t indexOffset;
+    uint64_t indexCount;
+    uint64_t meshletOffset;
+    uint64_t meshletCount;
+    float error;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(MeshCacheLevel) == 40, "Unexpected mesh cache level padding");
+
+inline uint64_t alignOffset(uint64_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+}
+
+std::string getMeshCacheFilename(const std::string & sourceFilename) {
+    size_t extension = sourceFilename.find_last_of('.');
+    size_t separator = sourceFilename.find_last_of("/\\");
+
+    if (extension == std::string::npos
+            || (separator != std::string::npos && extension < separator))
+        return sourceFilename + ".cgmesh";
+
+    return sourceFilename.substr(0, extension) + ".cgmesh";
+}
+
+bool openMeshCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        const LevelOfDetailSettings & settings,
+        MeshCache & cache) {
+    PROFILE_ZONE("openMeshCache");
+
+    if (!openMappedFile(filename, cache.file))
+        return false;
+
+    const MappedFile & file = cache.file;
+    MeshCacheHeader header;
+
+    if (file.size < sizeof(header)) {
+        closeMappedFile(cache.file);
+        return false;
+    }
+
+    std::memcpy(&header, file.data, sizeof(header));
+
+    // Validate format and data ranges
+    bool valid = std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0
+        && header.version == MESH_CACHE_VERSION
+        && header.vertexSize == sizeof(Vertex)
+        && (header.indexSize == sizeof(uint16_t) || header.indexSize == sizeof(uint32_t))
+        && header.vertexOffset % MESH_CACHE_ALIGNMENT == 0
+        && header.indexOffset % MESH_CACHE_ALIGNMENT == 0
+        && header.vertexOffset >= sizeof(header)
+        && header.vertexOffset <= file.size
+        && header.vertexCount <= (file.size - header.vertexOffset) / sizeof(Vertex)
+        && header.indexOffset >= header.vertexOffset + header.vertexCount * sizeof(Vertex)
+        && header.indexOffset <= file.size
+        && header.indexCount <= (file.size - header.indexOffset) / header.indexSize
+        && header.levelOffset % MESH_CACHE_ALIGNMENT == 0
+        && header.levelOffset >= header.indexOffset + header.indexCount * header.indexSize
+        && header.levelOffset <= file.size
+        && header.levelCount > 0
+        && header.levelCount <= (file.size - header.levelOffset) / sizeof(MeshCacheLevel)
+        && header.meshletSize == sizeof(Meshlet)
+        && header.meshletOffset % MESH_CACHE_ALIGNMENT == 0
+        && header.meshletOffset >= header.levelOffset + header.levelCount * sizeof(MeshCacheLevel)
+        && header.meshletOffset <= file.size
+        && header.meshletCount <= (file.size - header.meshletOffset) / sizeof(Meshlet)
+        && (header.tangentCount == 0 || header.tangentCount == header.vertexCount)
+        && header.tangentOffset % MESH_CACHE_ALIGNMENT == 0
+        && header.tangentOffset >= header.meshletOffset + header.meshletCount * sizeof(Meshlet)
+        && header.tangentOffset <= file.size
+        && header.tangentCount <= (file.size - header.tangentOffset) / sizeof(glm::vec4);
+
+    // Validate level of detail settings and ranges
+    valid = valid
+        && header.settingsLevelCount == settings.levelCount
+        && header.settingsRatio == settings.ratio
+        && header.settingsMaxError == settings.maxError;
+
+    cache.levels.clear();
+
+    for (uint32_t i = 0; valid && i < header.levelCount; i++) {
+        MeshCacheLevel level;
+        std::memcpy(&level, file.data + header.levelOffset + i * sizeof(level), sizeof(level));
+
+        valid = level.indexOffset <= header.indexCount
+            && level.indexCount <= header.indexCount - level.indexOffset
+            && level.meshletOffset <= header.meshletCount
+            && level.meshletCount <= header.meshletCount - level.meshletOffset;
+
+        LevelOfDetail range = {
+            (size_t)level.indexOffset,
+            (size_t)level.indexCount,
+            level.error,
+            (size_t)level.meshletOffset,
+            (size_t)level.meshletCount
+        };
+
+        cache.levels.push_back(range);
+    }
+
+    // Validate meshlet index ranges
+    const Meshlet * meshlets = (const Meshlet *)(file.data + header.meshletOffset);
+
+    for (uint64_t i = 0; valid && i < header.meshletCount; i++)
+        valid = meshlets[i].indexOffset <= header.indexCount
+            && meshlets[i].indexCount <= header.indexCount - meshlets[i].indexOffset;
+
+    // Validate source file, hashing its contents only when the modification time changed
+    uint64_t sourceSize;
+    int64_t sourceModificationTime;
+
+    valid = valid
+        && getFileStatus(sourceFilename, sourceSize, sourceModificationTime)
+        && sourceSize == header.sourceSize;
+
+    if (valid && sourceModificationTime != header.sourceModificationTime) {
+        uint64_t sourceHash;
+        valid = hashFile(sourceFilename, sourceHash) && sourceHash == header.sourceHash;
+    }
+
+    if (!valid) {
+        cache.levels.clear();
+        closeMappedFile(cache.file);
+        return false;
+    }
+
+    cache.vertices = (const Vertex *)(file.data + header.vertexOffset);
+    cache.vertexCount = (size_t)header.vertexCount;
+
+    cache.indices = file.data + header.indexOffset;
+    cache.indexCount = (size_t)header.indexCount;
+    cache.indexSize = header.indexSize;
+
+    cache.meshlets = meshlets;
+    cache.meshletCount = (size_t)header.meshletCount;
+
+    cache.tangents = header.tangentCount > 0 ? (const glm::vec4 *)(file.data + header.tangentOffset) : nullptr;
+
+    cache.bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    cache.bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+
+    return true;
+}
+
+void closeMeshCache(MeshCache & cache) {
+    closeMappedFile(cache.file);
+
+    cache.vertices = nullptr;
+    cache.vertexCount = 0;
+    cache.indices = nullptr;
+    cache.indexCount = 0;
+    cache.levels.clear();
+    cache.meshlets = nullptr;
+    cache.meshletCount = 0;
+    cache.tangents = nullptr;
+}
+
+bool writeMeshCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        const LevelOfDetailSettings & settings,
+        const TriangleMesh & mesh) {
+    PROFILE_ZONE("writeMeshCache");
+
+    MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    // Identify source file
+    if (!getFileStatus(sourceFilename, header.sourceSize, header.sourceModificationTime))
+        return false;
+
+    if (!hashFile(sourceFilename, header.sourceHash))
+        return false;
+
+    std::vector<unsigned char> indices;
+    packIndices(mesh.indices, mesh.vertices.size(), indices);
+
+    BoundingBox bounds = computeBoundingBox(mesh.vertices.data(), mesh.vertices.size());
+
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+
+    header.vertexCount = mesh.vertices.size();
+    header.vertexOffset = alignOffset(sizeof(header));
+
+    header.indexCount = mesh.indices.size();
+    header.indexSize = (uint32_t)getIndexSize(mesh.vertices.size());
+    header.indexOffset = alignOffset(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+
+    header.levelCount = (uint32_t)mesh.levels.size();
+    header.levelOffset = alignOffset(header.indexOffset + indices.size());
+
+    header.settingsLevelCount = (uint32_t)settings.levelCount;
+    header.settingsRatio = settings.ratio;
+    header.settingsMaxError = settings.maxError;
+
+    header.meshletSize = sizeof(Meshlet);
+    header.meshletCount = mesh.meshlets.size();
+    header.meshletOffset = alignOffset(header.levelOffset + mesh.levels.size() * sizeof(MeshCacheLevel));
+
+    header.tangentCount = mesh.tangents.size() == mesh.vertices.size() ? mesh.tangents.size() : 0;
+    header.tangentOffset = alignOffset(header.meshletOffset + mesh.meshlets.size() * sizeof(Meshlet));
+
+    std::vector<MeshCacheLevel> levels(mesh.levels.size());
+
+    for (size_t i = 0; i < mesh.levels.size(); i++) {
+        levels[i].indexOffset = mesh.levels[i].indexOffset;
+        levels[i].indexCount = mesh.levels[i].indexCount;
+        levels[i].meshletOffset = mesh.levels[i].meshletOffset;
+        levels[i].meshletCount = mesh.levels[i].meshletCount;
+        levels[i].error = mesh.levels[i].error;
+        levels[i].reserved = 0;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = bounds.min[i];
+        header.boundsMax[i] = bounds.max[i];
+    }
+
+    // Write header, vertices, indices, levels, meshlets and tangents with zero padding between blocks
+    const char padding[MESH_CACHE_ALIGNMENT] = {};
+    size_t vertexBytes = mesh.vertices.size() * sizeof(Vertex);
+    size_t meshletBytes = mesh.meshlets.size() * sizeof(Meshlet);
+
+    const void * blocks[] = {
+        &header,
+        padding,
+        mesh.vertices.data(),
+        padding,
+        indices.data(),
+        padding,
+        levels.data(),
+        padding,
+        mesh.meshlets.data(),
+        padding,
+        mesh.tangents.data()
+    };
+
+    size_t sizes[] = {
+        sizeof(header),
+        (size_t)(header.vertexOffset - sizeof(header)),
+        vertexBytes,
+        (size_t)(header.indexOffset - header.vertexOffset - vertexBytes),
+        indices.size(),
+        (size_t)(header.levelOffset - header.indexOffset - indices.size()),
+        levels.size() * sizeof(MeshCacheLevel),
+        (size_t)(header.meshletOffset - header.levelOffset - levels.size() * sizeof(MeshCacheLevel)),
+        meshletBytes,
+        (size_t)(header.tangentOffset - header.meshletOffset - meshletBytes),
+        (size_t)header.tangentCount * sizeof(glm::vec4)
+    };
+
+    return writeFileAtomic(filename, blocks, sizes, sizeof(sizes) / sizeof(sizes[0]));
+}
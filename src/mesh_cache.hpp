@@ -0,0 +1,57 @@
+#ifndef CG20192_MESH_CACHE_HPP
+#define CG20192_MESH_CACHE_HPP
+
+#include "file.hpp"
+#include "mesh.hpp"
+#include "simplification.hpp"
+
+#include <string>
+#include <vector>
+
+// Binary mesh cache (.cgmesh) mapped to memory
+// Vertex and index data point directly into the mapped file in the layout uploaded to OpenGL
+// Tangents are null when the cache was written without them
+struct MeshCache {
+    MappedFile file;
+
+    const Vertex * vertices;
+    size_t vertexCount;
+
+    const void * indices;
+    size_t indexCount;
+    size_t indexSize;
+
+    std::vector<LevelOfDetail> levels;
+
+    const Meshlet * meshlets;
+    size_t meshletCount;
+
+    const glm::vec4 * tangents;
+
+    BoundingBox bounds;
+};
+
+// Get mesh cache filename stored next to the source file
+std::string getMeshCacheFilename(const std::string & sourceFilename);
+
+// Map mesh cache file and validate it against the source file and level of detail settings
+// Fails when the cache is missing, has another version, was built with other settings
+// or the source file changed
+bool openMeshCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        const LevelOfDetailSettings & settings,
+        MeshCache & cache);
+
+// Unmap mesh cache file
+void closeMeshCache(MeshCache & cache);
+
+// Write mesh cache file with packed indices, levels of detail, meshlets, bounds
+// and source file hash
+bool writeMeshCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        const LevelOfDetailSettings & settings,
+        const TriangleMesh & mesh);
+
+#endif
@@ -0,0 +1,399 @@
+#include "meshlet.hpp"
+#include "simd.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+const uint32_t INVALID_MESHLET = 0xFFFFFFFF;
+
+// Normal cones spreading close to a hemisphere cannot cull and are disabled
+const float CONE_MINIMUM_DOT = 0.1f;
+
+// Compute bounding sphere (Ritter) and normal cone of meshlet triangles
+void computeMeshletBounds(const std::vector<Vertex> & vertices, const uint32_t * indices, Meshlet & meshlet) {
+    size_t indexCount = meshlet.indexCount;
+
+    // Start from the farthest pair of points found from the first point
+    glm::vec3 first = vertices[indices[0]].position;
+    glm::vec3 a = first;
+    glm::vec3 b = first;
+
+    for (size_t i = 0; i < indexCount; i++) {
+        const glm::vec3 & position = vertices[indices[i]].position;
+
+        if (glm::distance(position, first) > glm::distance(a, first))
+            a = position;
+    }
+
+    for (size_t i = 0; i < indexCount; i++) {
+        const glm::vec3 & position = vertices[indices[i]].position;
+
+        if (glm::distance(position, a) > glm::distance(b, a))
+            b = position;
+    }
+
+    glm::vec3 center = (a + b) * 0.5f;
+    float radius = glm::distance(a, b) * 0.5f;
+
+    // Grow sphere to enclose remaining points
+    for (size_t i = 0; i < indexCount; i++) {
+        const glm::vec3 & position = vertices[indices[i]].position;
+        float distance = glm::distance(position, center);
+
+        if (distance > radius) {
+            float grownRadius = (radius + distance) * 0.5f;
+            center += (position - center) * ((grownRadius - radius) / distance);
+            radius = grownRadius;
+        }
+    }
+
+    meshlet.center = center;
+    meshlet.radius = radius;
+
+    // Average triangle normals and measure their spread
+    std::vector<glm::vec3> normals;
+    normals.reserve(indexCount / 3);
+
+    glm::vec3 axis(0.0f);
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        const glm::vec3 & p0 = vertices[indices[i]].position;
+        const glm::vec3 & p1 = vertices[indices[i + 1]].position;
+        const glm::vec3 & p2 = vertices[indices[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+
+    float axisLength = glm::length(axis);
+    float minimumDot = 1.0f;
+
+    if (axisLength > 0.0f) {
+        axis /= axisLength;
+
+        for (size_t i = 0; i < normals.size(); i++)
+            minimumDot = std::min(minimumDot, glm::dot(axis, normals[i]));
+    }
+
+    meshlet.coneAxis = axisLength > 0.0f ? axis : glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = axisLength > 0.0f && minimumDot > CONE_MINIMUM_DOT
+        ? std::sqrt(1.0f - minimumDot * minimumDot)
+        : 1.0f;
+}
+
+}
+
+void extractFrustumPlanes(const glm::mat4 & matrix, glm::vec4 planes[6]) {
+    glm::vec4 rows[4];
+
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+
+    for (int i = 0; i < 3; i++) {
+        planes[i * 2] = rows[3] + rows[i];
+        planes[i * 2 + 1] = rows[3] - rows[i];
+    }
+
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+void buildMeshlets(TriangleMesh & mesh) {
+    PROFILE_ZONE("buildMeshlets");
+
+    mesh.meshlets.clear();
+
+    size_t vertexCount = mesh.vertices.size();
+
+    std::vector<uint32_t> marks(vertexCount, INVALID_MESHLET);
+    std::vector<uint32_t> adjacencyCounts(vertexCount);
+    std::vector<size_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<bool> emitted;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> indices;
+
+    for (size_t i = 0; i < mesh.levels.size(); i++) {
+        LevelOfDetail & level = mesh.levels[i];
+        level.meshletOffset = mesh.meshlets.size();
+
+        const uint32_t * levelIndices = &mesh.indices[level.indexOffset];
+        size_t triangleCount = level.indexCount / 3;
+
+        // Triangles adjacent to each vertex
+        std::fill(adjacencyCounts.begin(), adjacencyCounts.end(), 0);
+
+        for (size_t j = 0; j < triangleCount * 3; j++)
+            adjacencyCounts[levelIndices[j]]++;
+
+        adjacencyOffsets[0] = 0;
+
+        for (size_t j = 0; j < vertexCount; j++)
+            adjacencyOffsets[j + 1] = adjacencyOffsets[j] + adjacencyCounts[j];
+
+        adjacency.resize(triangleCount * 3);
+
+        for (size_t j = 0; j < triangleCount * 3; j++)
+            adjacency[adjacencyOffsets[levelIndices[j]] + --adjacencyCounts[levelIndices[j]]] = (uint32_t)(j / 3);
+
+        emitted.assign(triangleCount, false);
+        indices.clear();
+        indices.reserve(triangleCount * 3);
+
+        size_t cursor = 0;
+
+        // Grow meshlets from seeds in index buffer order, adding the adjacent triangle
+        // with the fewest new vertices and closest to the meshlet centroid
+        while (indices.size() < triangleCount * 3) {
+            uint32_t meshletID = (uint32_t)mesh.meshlets.size();
+
+            Meshlet meshlet;
+            meshlet.indexOffset = (uint32_t)(level.indexOffset + indices.size());
+            meshlet.indexCount = 0;
+
+            size_t meshletVertexCount = 0;
+            glm::vec3 sum(0.0f);
+
+            candidates.clear();
+
+            while (meshlet.indexCount / 3 < MESHLET_MAX_TRIANGLES) {
+                uint32_t best = INVALID_MESHLET;
+                size_t bestNewCount = 4;
+                float bestDistance = 0.0f;
+
+                glm::vec3 centroid = meshletVertexCount > 0 ? sum / (float)meshletVertexCount : sum;
+
+                for (size_t j = 0; j < candidates.size();) {
+                    uint32_t triangle = candidates[j];
+
+                    if (emitted[triangle]) {
+                        candidates[j] = candidates.back();
+                        candidates.pop_back();
+                        continue;
+                    }
+
+                    const uint32_t * corners = &levelIndices[triangle * 3];
+
+                    size_t newCount = (marks[corners[0]] != meshletID)
+                        + (marks[corners[1]] != meshletID && corners[1] != corners[0])
+                        + (marks[corners[2]] != meshletID && corners[2] != corners[0] && corners[2] != corners[1]);
+
+                    float distance = glm::distance(
+                        (mesh.vertices[corners[0]].position
+                            + mesh.vertices[corners[1]].position
+                            + mesh.vertices[corners[2]].position) / 3.0f,
+                        centroid);
+
+                    if (meshletVertexCount + newCount <= MESHLET_MAX_VERTICES
+                            && (newCount < bestNewCount
+                                || (newCount == bestNewCount && (distance < bestDistance
+                                    || (distance == bestDistance && triangle < best))))) {
+                        best = triangle;
+                        bestNewCount = newCount;
+                        bestDistance = distance;
+                    }
+
+                    j++;
+                }
+
+                // Continue from the next seed when no adjacent triangle fits
+                if (best == INVALID_MESHLET) {
+                    while (cursor < triangleCount && emitted[cursor])
+                        cursor++;
+
+                    if (cursor == triangleCount)
+                        break;
+
+                    const uint32_t * corners = &levelIndices[cursor * 3];
+
+                    size_t newCount = (marks[corners[0]] != meshletID)
+                        + (marks[corners[1]] != meshletID && corners[1] != corners[0])
+                        + (marks[corners[2]] != meshletID && corners[2] != corners[0] && corners[2] != corners[1]);
+
+                    if (meshletVertexCount + newCount > MESHLET_MAX_VERTICES)
+                        break;
+
+                    best = (uint32_t)cursor;
+                    bestNewCount = newCount;
+                }
+
+                // Emit triangle and collect triangles adjacent to its new vertices
+                const uint32_t * corners = &levelIndices[best * 3];
+
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t vertex = corners[k];
+
+                    indices.push_back(vertex);
+
+                    if (marks[vertex] == meshletID)
+                        continue;
+
+                    marks[vertex] = meshletID;
+                    sum += mesh.vertices[vertex].position;
+
+                    for (size_t j = adjacencyOffsets[vertex]; j < adjacencyOffsets[vertex + 1]; j++) {
+                        if (!emitted[adjacency[j]])
+                            candidates.push_back(adjacency[j]);
+                    }
+                }
+
+                emitted[best] = true;
+                meshletVertexCount += bestNewCount;
+                meshlet.indexCount += 3;
+            }
+
+            computeMeshletBounds(mesh.vertices, &indices[meshlet.indexOffset - level.indexOffset], meshlet);
+            mesh.meshlets.push_back(meshlet);
+        }
+
+        // Store triangles in meshlet order
+        std::copy(indices.begin(), indices.end(), mesh.indices.begin() + level.indexOffset);
+
+        level.meshletCount = mesh.meshlets.size() - level.meshletOffset;
+    }
+}
+
+void buildMeshletBounds(const Meshlet * meshlets, size_t meshletCount, MeshletBounds & bounds) {
+    size_t paddedCount = (meshletCount + 3) / 4 * 4;
+
+    bounds.count = meshletCount;
+
+    bounds.centerX.assign(paddedCount, 0.0f);
+    bounds.centerY.assign(paddedCount, 0.0f);
+    bounds.centerZ.assign(paddedCount, 0.0f);
+    bounds.radius.assign(paddedCount, 0.0f);
+
+    bounds.coneAxisX.assign(paddedCount, 0.0f);
+    bounds.coneAxisY.assign(paddedCount, 0.0f);
+    bounds.coneAxisZ.assign(paddedCount, 0.0f);
+    bounds.coneCutoff.assign(paddedCount, 1.0f);
+
+    for (size_t i = 0; i < meshletCount; i++) {
+        const Meshlet & meshlet = meshlets[i];
+
+        bounds.centerX[i] = meshlet.center.x;
+        bounds.centerY[i] = meshlet.center.y;
+        bounds.centerZ[i] = meshlet.center.z;
+        bounds.radius[i] = meshlet.radius;
+
+        bounds.coneAxisX[i] = meshlet.coneAxis.x;
+        bounds.coneAxisY[i] = meshlet.coneAxis.y;
+        bounds.coneAxisZ[i] = meshlet.coneAxis.z;
+        bounds.coneCutoff[i] = meshlet.coneCutoff;
+    }
+}
+
+void loosenMeshletBounds(float distance, MeshletBounds & bounds) {
+    for (size_t i = 0; i < bounds.count; i++) {
+        bounds.radius[i] += distance;
+        bounds.coneCutoff[i] = 1.0f;
+    }
+}
+
+void cullMeshlets(
+        const MeshletBounds & bounds,
+        size_t meshletOffset,
+        size_t meshletCount,
+        const glm::mat4 & modelViewProjection,
+        const glm::vec3 & camera,
+        std::vector<uint32_t> & visibleMeshlets) {
+    PROFILE_ZONE("cullMeshlets");
+
+    visibleMeshlets.clear();
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(modelViewProjection, planes);
+
+    size_t begin = meshletOffset;
+    size_t end = std::min(meshletOffset + meshletCount, bounds.count);
+
+    // A meshlet is visible when its sphere is not behind any frustum plane
+    // and the camera is not inside the back-facing region of its normal cone:
+    // dot(center - camera, axis) >= cutoff * length(center - camera) + radius
+#ifdef CG20192_SSE2
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+
+    for (int i = 0; i < 6; i++) {
+        planeX[i] = _mm_set1_ps(planes[i].x);
+        planeY[i] = _mm_set1_ps(planes[i].y);
+        planeZ[i] = _mm_set1_ps(planes[i].z);
+        planeW[i] = _mm_set1_ps(planes[i].w);
+    }
+
+    __m128 cameraX = _mm_set1_ps(camera.x);
+    __m128 cameraY = _mm_set1_ps(camera.y);
+    __m128 cameraZ = _mm_set1_ps(camera.z);
+
+    for (size_t i = begin / 4 * 4; i < end; i += 4) {
+        __m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 radius = _mm_loadu_ps(&bounds.radius[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (int j = 0; j < 6; j++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planeX[j], centerX), _mm_mul_ps(planeY[j], centerY)),
+                _mm_add_ps(_mm_mul_ps(planeZ[j], centerZ), planeW[j]));
+
+            visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, negativeRadius));
+        }
+
+        __m128 viewX = _mm_sub_ps(centerX, cameraX);
+        __m128 viewY = _mm_sub_ps(centerY, cameraY);
+        __m128 viewZ = _mm_sub_ps(centerZ, cameraZ);
+
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(viewX, viewX), _mm_mul_ps(viewY, viewY)),
+            _mm_mul_ps(viewZ, viewZ)));
+
+        __m128 dot = _mm_add_ps(
+            _mm_add_ps(
+                _mm_mul_ps(viewX, _mm_loadu_ps(&bounds.coneAxisX[i])),
+                _mm_mul_ps(viewY, _mm_loadu_ps(&bounds.coneAxisY[i]))),
+            _mm_mul_ps(viewZ, _mm_loadu_ps(&bounds.coneAxisZ[i])));
+
+        __m128 threshold = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&bounds.coneCutoff[i]), length), radius);
+
+        visible = _mm_and_ps(visible, _mm_cmplt_ps(dot, threshold));
+
+        int mask = _mm_movemask_ps(visible);
+
+        for (size_t k = 0; k < 4; k++) {
+            size_t index = i + k;
+
+            if ((mask & (1 << k)) && index >= begin && index < end)
+                visibleMeshlets.push_back((uint32_t)index);
+        }
+    }
+#else
+    for (size_t i = begin; i < end; i++) {
+        glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+        glm::vec3 axis(bounds.coneAxisX[i], bounds.coneAxisY[i], bounds.coneAxisZ[i]);
+        float radius = bounds.radius[i];
+
+        bool visible = true;
+
+        for (int j = 0; j < 6; j++)
+            visible = visible && glm::dot(glm::vec3(planes[j]), center) + planes[j].w > -radius;
+
+        glm::vec3 view = center - camera;
+        visible = visible && glm::dot(view, axis) < bounds.coneCutoff[i] * glm::length(view) + radius;
+
+        if (visible)
+            visibleMeshlets.push_back((uint32_t)i);
+    }
+#endif
+}
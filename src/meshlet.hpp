@@ -0,0 +1,59 @@
+#ifndef CG20192_MESHLET_HPP
+#define CG20192_MESHLET_HPP
+
+#include "mesh.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Meshlet size limits
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// Meshlet bounds in structure of arrays layout for SIMD culling
+// Arrays are padded to a multiple of 4 meshlets
+struct MeshletBounds {
+    size_t count;
+
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+
+    std::vector<float> coneAxisX;
+    std::vector<float> coneAxisY;
+    std::vector<float> coneAxisZ;
+    std::vector<float> coneCutoff;
+};
+
+// Extract frustum planes from model view projection matrix
+// Planes are normalized and point inside, in left, right, bottom, top, near, far order
+void extractFrustumPlanes(const glm::mat4 & matrix, glm::vec4 planes[6]);
+
+// Split triangles of each level of detail in meshlets grown over shared vertices
+// Triangles are reordered so every meshlet is a contiguous range of its level,
+// seeds follow the previous index order to keep vertex cache locality
+void buildMeshlets(TriangleMesh & mesh);
+
+// Convert meshlets to structure of arrays layout
+void buildMeshletBounds(const Meshlet * meshlets, size_t meshletCount, MeshletBounds & bounds);
+
+// Grow meshlet spheres by distance and disable cone culling,
+// for meshes deformed after their meshlets were built
+void loosenMeshletBounds(float distance, MeshletBounds & bounds);
+
+// Find meshlets in range intersecting the view frustum and not entirely back-facing
+// The frustum is given by the model view projection matrix and the camera position in object space
+void cullMeshlets(
+        const MeshletBounds & bounds,
+        size_t meshletOffset,
+        size_t meshletCount,
+        const glm::mat4 & modelViewProjection,
+        const glm::vec3 & camera,
+        std::vector<uint32_t> & visibleMeshlets);
+
+#endif
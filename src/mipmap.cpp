@@ -0,0 +1,299 @@
+#include "mipmap.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "profiler.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+namespace {
+
+// Number of destination rows filtered by a single task
+const size_t BAND_SIZE = 32;
+
+// Kaiser windowed sinc parameters, with radius in destination pixels
+const double KAISER_RADIUS = 3.0;
+const double KAISER_ALPHA = 4.0;
+
+const double PI = 3.14159265358979323846;
+
+// Lookup tables converting between 8-bit sRGB and linear values
+// The encoding table is indexed by linear values quantized to 16 bits
+struct ColorTables {
+    float decode[256];
+    unsigned char encode[65536];
+
+    ColorTables() {
+        for (size_t i = 0; i < 256; i++) {
+            double value = i / 255.0;
+
+            decode[i] = (float)(value <= 0.04045
+                ? value / 12.92
+                : std::pow((value + 0.055) / 1.055, 2.4));
+        }
+
+        for (size_t i = 0; i < 65536; i++) {
+            double value = i / 65535.0;
+
+            value = value <= 0.0031308
+                ? value * 12.92
+                : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+
+            encode[i] = (unsigned char)std::min(std::floor(value * 255.0 + 0.5), 255.0);
+        }
+    }
+};
+
+const ColorTables & getColorTables() {
+    static ColorTables tables;
+    return tables;
+}
+
+// Zeroth order modified Bessel function of the first kind
+double bessel(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double half = x * 0.5;
+
+    for (int k = 1; k < 32; k++) {
+        term *= (half / k) * (half / k);
+        sum += term;
+
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+// Evaluate filter at distance measured in destination pixels
+double evaluateFilter(MipmapFilter filter, double x) {
+    x = std::fabs(x);
+
+    if (filter == MIPMAP_FILTER_BOX)
+        return x < 0.5 ? 1.0 : 0.0;
+
+    if (x >= KAISER_RADIUS)
+        return 0.0;
+
+    double sinc = x < 1e-6 ? 1.0 : std::sin(PI * x) / (PI * x);
+    double t = x / KAISER_RADIUS;
+
+    return sinc * bessel(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / bessel(KAISER_ALPHA);
+}
+
+inline size_t wrapIndex(long long index, size_t size) {
+    long long result = index % (long long)size;
+    return (size_t)(result < 0 ? result + (long long)size : result);
+}
+
+// Filter taps of each destination pixel along one axis
+// Taps start at an unwrapped source index and have a fixed count
+struct FilterTaps {
+    size_t tapCount;
+    std::vector<long long> firsts;
+    std::vector<size_t> indices;
+    std::vector<float> weights;
+};
+
+void computeFilterTaps(
+        size_t sourceSize,
+        size_t destinationSize,
+        MipmapFilter filter,
+        FilterTaps & taps) {
+    double scale = (double)sourceSize / destinationSize;
+    double support = filter == MIPMAP_FILTER_BOX ? 0.5 : KAISER_RADIUS;
+    double radius = support * scale;
+
+    taps.tapCount = (size_t)std::ceil(2.0 * radius) + 1;
+    taps.firsts.resize(destinationSize);
+    taps.indices.resize(destinationSize * taps.tapCount);
+    taps.weights.resize(destinationSize * taps.tapCount);
+
+    for (size_t i = 0; i < destinationSize; i++) {
+        double center = (i + 0.5) * scale;
+        long long first = (long long)std::floor(center - radius);
+
+        double sum = 0.0;
+
+        for (size_t k = 0; k < taps.tapCount; k++) {
+            double weight = evaluateFilter(filter, (first + (long long)k + 0.5 - center) / scale);
+
+            taps.indices[i * taps.tapCount + k] = wrapIndex(first + (long long)k, sourceSize);
+            taps.weights[i * taps.tapCount + k] = (float)weight;
+
+            sum += weight;
+        }
+
+        for (size_t k = 0; k < taps.tapCount; k++)
+            taps.weights[i * taps.tapCount + k] = (float)(taps.weights[i * taps.tapCount + k] / sum);
+
+        taps.firsts[i] = first;
+    }
+}
+
+// Decode image row to linear RGBA floats
+void decodeRow(const Image & image, size_t y, bool sRGB, float * output) {
+    const ColorTables & tables = getColorTables();
+
+    size_t count = image.width * image.channelCount;
+    size_t offset = y * count;
+
+    for (size_t x = 0; x < image.width; x++) {
+        float * pixel = output + x * 4;
+
+        pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0.0f;
+
+        for (size_t c = 0; c < image.channelCount; c++) {
+            size_t i = offset + x * image.channelCount + c;
+
+            if (image.channelSize == 1)
+                pixel[c] = sRGB ? tables.decode[image.pixels[i]] : image.pixels[i] * (1.0f / 0xFF);
+            else
+                pixel[c] = ((const uint16_t *)image.pixels.data())[i] * (1.0f / 0xFFFF);
+        }
+    }
+}
+
+// Encode linear RGBA floats to image row
+void encodeRow(const float * input, bool sRGB, size_t y, Image & image) {
+    const ColorTables & tables = getColorTables();
+
+    size_t count = image.width * image.channelCount;
+    size_t offset = y * count;
+
+    for (size_t x = 0; x < image.width; x++) {
+        const float * pixel = input + x * 4;
+
+        for (size_t c = 0; c < image.channelCount; c++) {
+            size_t i = offset + x * image.channelCount + c;
+
+            float value = std::min(std::max(pixel[c], 0.0f), 1.0f);
+            uint32_t quantized = (uint32_t)(value * 65535.0f + 0.5f);
+
+            if (image.channelSize == 2)
+                ((uint16_t *)image.pixels.data())[i] = (uint16_t)quantized;
+            else if (sRGB)
+                image.pixels[i] = tables.encode[quantized];
+            else
+                image.pixels[i] = (unsigned char)(value * 255.0f + 0.5f);
+        }
+    }
+}
+
+// Accumulate weighted RGBA pixel
+inline void accumulatePixel(float * output, const float * input, float weight) {
+#ifdef CG20192_SSE2
+    _mm_storeu_ps(output, _mm_add_ps(
+        _mm_loadu_ps(output),
+        _mm_mul_ps(_mm_loadu_ps(input), _mm_set1_ps(weight))));
+#else
+    for (size_t c = 0; c < 4; c++)
+        output[c] += input[c] * weight;
+#endif
+}
+
+// Filter decoded row horizontally
+void filterRow(const float * input, const FilterTaps & taps, size_t width, float * output) {
+    for (size_t x = 0; x < width; x++) {
+        float * pixel = output + x * 4;
+        pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0.0f;
+
+        const size_t * indices = &taps.indices[x * taps.tapCount];
+        const float * weights = &taps.weights[x * taps.tapCount];
+
+        for (size_t k = 0; k < taps.tapCount; k++) {
+            if (weights[k] != 0.0f)
+                accumulatePixel(pixel, input + indices[k] * 4, weights[k]);
+        }
+    }
+}
+
+}
+
+void downsampleImage(const Image & source, bool sRGB, MipmapFilter filter, Image & destination) {
+    destination.width = std::max(source.width / 2, (size_t)1);
+    destination.height = std::max(source.height / 2, (size_t)1);
+    destination.channelCount = source.channelCount;
+    destination.channelSize = source.channelSize;
+    destination.pixels.resize(
+        destination.width * destination.height * destination.channelCount * destination.channelSize);
+
+    bool encoded = sRGB && source.channelSize == 1;
+
+    FilterTaps horizontal, vertical;
+    computeFilterTaps(source.width, destination.width, filter, horizontal);
+    computeFilterTaps(source.height, destination.height, filter, vertical);
+
+    // Per-thread buffers for decoded rows and horizontally filtered bands
+    size_t threadCount = getThreadCount();
+
+    std::vector<std::vector<float> > decodedRows(threadCount);
+    std::vector<std::vector<float> > bands(threadCount);
+    std::vector<std::vector<float> > outputRows(threadCount);
+
+    size_t bandCount = (destination.height + BAND_SIZE - 1) / BAND_SIZE;
+
+    parallelFor(bandCount, [&](size_t index, size_t thread) {
+        PROFILE_ZONE("resampleBand");
+
+        size_t begin = index * BAND_SIZE;
+        size_t end = std::min(begin + BAND_SIZE, destination.height);
+
+        // Filter horizontally every source row needed by the band
+        long long firstRow = vertical.firsts[begin];
+        size_t rowCount = (size_t)(vertical.firsts[end - 1] - firstRow) + vertical.tapCount;
+
+        std::vector<float> & decoded = decodedRows[thread];
+        std::vector<float> & band = bands[thread];
+        std::vector<float> & output = outputRows[thread];
+
+        decoded.resize(source.width * 4);
+        band.resize(rowCount * destination.width * 4);
+        output.resize(destination.width * 4);
+
+        for (size_t i = 0; i < rowCount; i++) {
+            decodeRow(source, wrapIndex(firstRow + (long long)i, source.height), encoded, decoded.data());
+            filterRow(decoded.data(), horizontal, destination.width, &band[i * destination.width * 4]);
+        }
+
+        // Filter vertically and encode destination rows
+        for (size_t y = begin; y < end; y++) {
+            std::fill(output.begin(), output.end(), 0.0f);
+
+            size_t offset = (size_t)(vertical.firsts[y] - firstRow);
+            const float * weights = &vertical.weights[y * vertical.tapCount];
+
+            for (size_t k = 0; k < vertical.tapCount; k++) {
+                if (weights[k] == 0.0f)
+                    continue;
+
+                const float * row = &band[(offset + k) * destination.width * 4];
+
+                for (size_t x = 0; x < destination.width; x++)
+                    accumulatePixel(&output[x * 4], row + x * 4, weights[k]);
+            }
+
+            encodeRow(output.data(), encoded, y, destination);
+        }
+    });
+}
+
+void buildMipmaps(
+        const Image & image,
+        bool sRGB,
+        MipmapFilter filter,
+        std::vector<Image> & levels) {
+    PROFILE_ZONE("buildMipmaps");
+
+    levels.clear();
+    levels.push_back(image);
+
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        Image level;
+        downsampleImage(levels.back(), sRGB, filter, level);
+
+        levels.push_back(std::move(level));
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef CG20192_MIPMAP_HPP
+#define CG20192_MIPMAP_HPP
+
+#include "image.hpp"
+
+#include <vector>
+
+// Filters used to downsample mipmap levels
+enum MipmapFilter {
+    MIPMAP_FILTER_BOX,
+    MIPMAP_FILTER_KAISER
+};
+
+// Downsample image to half size, rounding down to at least one pixel
+// Filtering is done in linear space, decoding and encoding sRGB channels when requested
+// Texels wrap around the borders as in repeated texture sampling
+void downsampleImage(const Image & source, bool sRGB, MipmapFilter filter, Image & destination);
+
+// Build complete mipmap chain down to a single pixel, starting with a copy of the image
+// Levels are filtered from the previous level in parallel bands of rows
+void buildMipmaps(
+        const Image & image,
+        bool sRGB,
+        MipmapFilter filter,
+        std::vector<Image> & levels);
+
+#endif
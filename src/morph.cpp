@@ -0,0 +1,259 @@
+#include "morph.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Vertices blended by a single task, a multiple of the SIMD width
+const size_t MORPH_BLOCK_SIZE = 4096;
+
+// Inflation of the procedural target relative to the bounding box diagonal
+const float INFLATE_SCALE = 0.05f;
+
+// Twist of the procedural target in radians over the bounding box height
+const float TWIST_ANGLE = 1.0f;
+
+// Angular frequencies of the procedural target weights in radians per second
+const double INFLATE_FREQUENCY = 2.0;
+const double TWIST_FREQUENCY = 1.3;
+
+// Smallest squared normal length renormalized, shorter normals are written as is
+const float MIN_NORMAL_LENGTH_SQUARED = 1e-12f;
+
+// Blend and write vertices in range with scalar code
+void deformVertices(
+        const MorphMesh & mesh,
+        const std::vector<size_t> & targets,
+        const float * weights,
+        size_t begin,
+        size_t end,
+        Vertex * output) {
+    size_t n = mesh.vertexCount;
+
+    for (size_t i = begin; i < end; i++) {
+        glm::vec3 position(mesh.positions[i], mesh.positions[n + i], mesh.positions[2 * n + i]);
+        glm::vec3 normal(mesh.normals[i], mesh.normals[n + i], mesh.normals[2 * n + i]);
+
+        for (size_t j = 0; j < targets.size(); j++) {
+            const float * positionOffsets = &mesh.positionOffsets[targets[j] * 3 * n];
+            const float * normalOffsets = &mesh.normalOffsets[targets[j] * 3 * n];
+            float weight = weights[targets[j]];
+
+            position += weight * glm::vec3(positionOffsets[i], positionOffsets[n + i], positionOffsets[2 * n + i]);
+            normal += weight * glm::vec3(normalOffsets[i], normalOffsets[n + i], normalOffsets[2 * n + i]);
+        }
+
+        float lengthSquared = glm::dot(normal, normal);
+
+        if (lengthSquared > MIN_NORMAL_LENGTH_SQUARED)
+            normal /= std::sqrt(lengthSquared);
+
+        Vertex vertex;
+        vertex.position = position;
+        vertex.normal = normal;
+        vertex.textureCoordinate = mesh.textureCoordinates[i];
+
+        output[i] = vertex;
+    }
+}
+
+#ifdef CG20192_SSE2
+// Blend and write vertices in range four at a time, range size must be a multiple of 4
+// Components are blended across vertices, then transposed to interleaved vertices
+void deformVerticesSSE2(
+        const MorphMesh & mesh,
+        const std::vector<size_t> & targets,
+        const float * weights,
+        size_t begin,
+        size_t end,
+        Vertex * output) {
+    size_t n = mesh.vertexCount;
+
+    const __m128 minLengthSquared = _mm_set1_ps(MIN_NORMAL_LENGTH_SQUARED);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (size_t i = begin; i < end; i += 4) {
+        __m128 px = _mm_loadu_ps(&mesh.positions[i]);
+        __m128 py = _mm_loadu_ps(&mesh.positions[n + i]);
+        __m128 pz = _mm_loadu_ps(&mesh.positions[2 * n + i]);
+        __m128 nx = _mm_loadu_ps(&mesh.normals[i]);
+        __m128 ny = _mm_loadu_ps(&mesh.normals[n + i]);
+        __m128 nz = _mm_loadu_ps(&mesh.normals[2 * n + i]);
+
+        for (size_t j = 0; j < targets.size(); j++) {
+            const float * positionOffsets = &mesh.positionOffsets[targets[j] * 3 * n];
+            const float * normalOffsets = &mesh.normalOffsets[targets[j] * 3 * n];
+            __m128 weight = _mm_set1_ps(weights[targets[j]]);
+
+            px = _mm_add_ps(px, _mm_mul_ps(weight, _mm_loadu_ps(&positionOffsets[i])));
+            py = _mm_add_ps(py, _mm_mul_ps(weight, _mm_loadu_ps(&positionOffsets[n + i])));
+            pz = _mm_add_ps(pz, _mm_mul_ps(weight, _mm_loadu_ps(&positionOffsets[2 * n + i])));
+            nx = _mm_add_ps(nx, _mm_mul_ps(weight, _mm_loadu_ps(&normalOffsets[i])));
+            ny = _mm_add_ps(ny, _mm_mul_ps(weight, _mm_loadu_ps(&normalOffsets[n + i])));
+            nz = _mm_add_ps(nz, _mm_mul_ps(weight, _mm_loadu_ps(&normalOffsets[2 * n + i])));
+        }
+
+        // Renormalize, keeping degenerate normals
+        __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+        __m128 valid = _mm_cmpgt_ps(lengthSquared, minLengthSquared);
+        __m128 scale = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(lengthSquared, minLengthSquared)));
+        scale = _mm_or_ps(_mm_and_ps(valid, scale), _mm_andnot_ps(valid, one));
+
+        nx = _mm_mul_ps(nx, scale);
+        ny = _mm_mul_ps(ny, scale);
+        nz = _mm_mul_ps(nz, scale);
+
+        // Split interleaved texture coordinates in components
+        __m128 uv01 = _mm_loadu_ps(&mesh.textureCoordinates[i].x);
+        __m128 uv23 = _mm_loadu_ps(&mesh.textureCoordinates[i + 2].x);
+        __m128 u = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 v = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(3, 1, 3, 1));
+
+        // Transpose to the two halves of each vertex
+        _MM_TRANSPOSE4_PS(px, py, pz, nx);
+        _MM_TRANSPOSE4_PS(ny, nz, u, v);
+
+        float * vertices = &output[i].position.x;
+
+        _mm_storeu_ps(vertices, px);
+        _mm_storeu_ps(vertices + 4, ny);
+        _mm_storeu_ps(vertices + 8, py);
+        _mm_storeu_ps(vertices + 12, nz);
+        _mm_storeu_ps(vertices + 16, pz);
+        _mm_storeu_ps(vertices + 20, u);
+        _mm_storeu_ps(vertices + 24, nx);
+        _mm_storeu_ps(vertices + 28, v);
+    }
+}
+#endif
+
+}
+
+void createMorphMesh(const std::vector<Vertex> & vertices, MorphMesh & mesh) {
+    size_t n = vertices.size();
+
+    mesh.vertexCount = n;
+    mesh.positions.resize(3 * n);
+    mesh.normals.resize(3 * n);
+    mesh.textureCoordinates.resize(n);
+
+    for (size_t i = 0; i < n; i++) {
+        for (int j = 0; j < 3; j++) {
+            mesh.positions[j * n + i] = vertices[i].position[j];
+            mesh.normals[j * n + i] = vertices[i].normal[j];
+        }
+
+        mesh.textureCoordinates[i] = vertices[i].textureCoordinate;
+    }
+
+    mesh.targetCount = 0;
+    mesh.positionOffsets.clear();
+    mesh.normalOffsets.clear();
+    mesh.maxDisplacement = 0.0f;
+}
+
+void addMorphTarget(
+        const std::vector<glm::vec3> & positionOffsets,
+        const std::vector<glm::vec3> & normalOffsets,
+        MorphMesh & mesh) {
+    size_t n = mesh.vertexCount;
+    size_t offset = mesh.positionOffsets.size();
+
+    mesh.positionOffsets.resize(offset + 3 * n);
+    mesh.normalOffsets.resize(offset + 3 * n);
+
+    float maxLengthSquared = 0.0f;
+
+    for (size_t i = 0; i < n; i++) {
+        for (int j = 0; j < 3; j++) {
+            mesh.positionOffsets[offset + j * n + i] = positionOffsets[i][j];
+            mesh.normalOffsets[offset + j * n + i] = normalOffsets[i][j];
+        }
+
+        maxLengthSquared = std::max(maxLengthSquared, glm::dot(positionOffsets[i], positionOffsets[i]));
+    }
+
+    mesh.targetCount++;
+    mesh.maxDisplacement += std::sqrt(maxLengthSquared);
+}
+
+void addProceduralMorphTargets(const BoundingBox & bounds, MorphMesh & mesh) {
+    size_t n = mesh.vertexCount;
+
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 extent = bounds.max - bounds.min;
+
+    std::vector<glm::vec3> positionOffsets(n);
+    std::vector<glm::vec3> normalOffsets(n);
+
+    // Inflate along normals
+    float inflation = INFLATE_SCALE * glm::length(extent);
+
+    for (size_t i = 0; i < n; i++) {
+        positionOffsets[i] = inflation * glm::vec3(mesh.normals[i], mesh.normals[n + i], mesh.normals[2 * n + i]);
+        normalOffsets[i] = glm::vec3(0.0f);
+    }
+
+    addMorphTarget(positionOffsets, normalOffsets, mesh);
+
+    // Twist about the vertical axis proportionally to the height from the center
+    float twist = extent.y > 0.0f ? TWIST_ANGLE / extent.y : 0.0f;
+
+    for (size_t i = 0; i < n; i++) {
+        glm::vec3 position(mesh.positions[i], mesh.positions[n + i], mesh.positions[2 * n + i]);
+        glm::vec3 normal(mesh.normals[i], mesh.normals[n + i], mesh.normals[2 * n + i]);
+
+        float angle = twist * (position.y - center.y);
+        float cosAngle = std::cos(angle);
+        float sinAngle = std::sin(angle);
+
+        glm::vec3 offset = position - center;
+
+        glm::vec3 twistedOffset(cosAngle * offset.x + sinAngle * offset.z, offset.y, cosAngle * offset.z - sinAngle * offset.x);
+        glm::vec3 twistedNormal(cosAngle * normal.x + sinAngle * normal.z, normal.y, cosAngle * normal.z - sinAngle * normal.x);
+
+        positionOffsets[i] = twistedOffset - offset;
+        normalOffsets[i] = twistedNormal - normal;
+    }
+
+    addMorphTarget(positionOffsets, normalOffsets, mesh);
+}
+
+void getProceduralMorphWeights(double time, float weights[2]) {
+    weights[0] = (float)(0.5 - 0.5 * std::cos(INFLATE_FREQUENCY * time));
+    weights[1] = (float)std::sin(TWIST_FREQUENCY * time);
+}
+
+void deformMorphMesh(const MorphMesh & mesh, const float * weights, Vertex * output) {
+    PROFILE_ZONE("deformMorphMesh");
+
+    // Skip targets without weight
+    std::vector<size_t> targets;
+
+    for (size_t i = 0; i < mesh.targetCount; i++) {
+        if (weights[i] != 0.0f)
+            targets.push_back(i);
+    }
+
+    size_t blockCount = (mesh.vertexCount + MORPH_BLOCK_SIZE - 1) / MORPH_BLOCK_SIZE;
+
+    parallelFor(blockCount, [&](size_t block, size_t) {
+        size_t begin = block * MORPH_BLOCK_SIZE;
+        size_t end = std::min(mesh.vertexCount, begin + MORPH_BLOCK_SIZE);
+
+#ifdef CG20192_SSE2
+        size_t simdEnd = begin + (end - begin) / 4 * 4;
+
+        deformVerticesSSE2(mesh, targets, weights, begin, simdEnd, output);
+        begin = simdEnd;
+#endif
+
+        deformVertices(mesh, targets, weights, begin, end, output);
+    });
+}
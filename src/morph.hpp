@@ -0,0 +1,51 @@
+#ifndef CG20192_MORPH_HPP
+#define CG20192_MORPH_HPP
+
+#include "mesh.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Base vertices and morph targets in structure of arrays layout for SIMD blending
+// Position and normal arrays hold the x, then y, then z components of every vertex,
+// targets hold position and normal offsets from the base vertices, one target after another
+// The largest displacement bounds how far blended positions move with weights in [-1, 1]
+struct MorphMesh {
+    size_t vertexCount;
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<glm::vec2> textureCoordinates;
+
+    size_t targetCount;
+    std::vector<float> positionOffsets;
+    std::vector<float> normalOffsets;
+
+    float maxDisplacement;
+};
+
+// Create morph mesh without targets from base vertices
+void createMorphMesh(const std::vector<Vertex> & vertices, MorphMesh & mesh);
+
+// Append morph target with position and normal offsets of every vertex
+void addMorphTarget(
+        const std::vector<glm::vec3> & positionOffsets,
+        const std::vector<glm::vec3> & normalOffsets,
+        MorphMesh & mesh);
+
+// Append procedural targets inflating the mesh along its normals and twisting it
+// about the vertical axis through the center of its bounding box
+void addProceduralMorphTargets(const BoundingBox & bounds, MorphMesh & mesh);
+
+// Get weights of the procedural targets at time in seconds,
+// inflation pulses in [0, 1] and twist sways in [-1, 1]
+void getProceduralMorphWeights(double time, float weights[2]);
+
+// Blend targets with weights on top of base vertices and renormalize normals
+// Vertices are written in order without being read back, so output can be
+// write-combined mapped buffer memory, blocks of vertices are blended in parallel
+void deformMorphMesh(const MorphMesh & mesh, const float * weights, Vertex * output);
+
+#endif
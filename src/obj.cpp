@@ -0,0 +1,572 @@
+#include "obj.hpp"
+#include "file.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace {
+
+// Minimum chunk size in bytes parsed by a single task
+const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+// Maximum number of chunks per thread used for load balancing
+const size_t CHUNKS_PER_THREAD = 8;
+
+// Bias applied to relative indices until the attribute count of previous chunks is known
+const int64_t RELATIVE_INDEX_BIAS = (int64_t)1 << 62;
+
+// Powers of ten exactly representable in double precision
+const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char * skipSpaces(const char * cursor, const char * end) {
+    while (cursor < end && isSpace(*cursor))
+        cursor++;
+
+    return cursor;
+}
+
+}
+
+// Parse decimal floating point number without allocations or locale lookups
+bool parseFloat(const char *& cursor, const char * end, float & value) {
+    const char * p = skipSpaces(cursor, end);
+
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    // Accumulate up to 18 significant digits in an integer mantissa
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+
+    while (p < end && isDigit(*p)) {
+        if (mantissa < 100000000000000000ULL)
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        else
+            exponent++;
+
+        hasDigits = true;
+        p++;
+    }
+
+    if (p < end && *p == '.') {
+        p++;
+
+        while (p < end && isDigit(*p)) {
+            if (mantissa < 100000000000000000ULL) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                exponent--;
+            }
+
+            hasDigits = true;
+            p++;
+        }
+    }
+
+    if (!hasDigits)
+        return false;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char * q = p + 1;
+        bool negativeExponent = false;
+
+        if (q < end && (*q == '-' || *q == '+')) {
+            negativeExponent = *q == '-';
+            q++;
+        }
+
+        if (q < end && isDigit(*q)) {
+            int e = 0;
+
+            while (q < end && isDigit(*q)) {
+                if (e < 10000)
+                    e = e * 10 + (*q - '0');
+
+                q++;
+            }
+
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    // Scale mantissa by powers of ten
+    double result = (double)mantissa;
+
+    if (mantissa != 0) {
+        if (exponent < -400)
+            result = 0.0;
+        else if (exponent > 400)
+            result = HUGE_VAL;
+        else {
+            while (exponent < -22) {
+                result /= POWERS_OF_TEN[22];
+                exponent += 22;
+            }
+
+            while (exponent > 22) {
+                result *= POWERS_OF_TEN[22];
+                exponent -= 22;
+            }
+
+            if (exponent < 0)
+                result /= POWERS_OF_TEN[-exponent];
+            else
+                result *= POWERS_OF_TEN[exponent];
+        }
+    }
+
+    value = (float)(negative ? -result : result);
+    cursor = p;
+
+    return true;
+}
+
+// Parse signed decimal integer without allocations
+bool parseInteger(const char *& cursor, const char * end, int64_t & value) {
+    const char * p = cursor;
+
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    if (p == end || !isDigit(*p))
+        return false;
+
+    int64_t result = 0;
+
+    while (p < end && isDigit(*p)) {
+        if (result < 100000000000000000LL)
+            result = result * 10 + (*p - '0');
+
+        p++;
+    }
+
+    value = negative ? -result : result;
+    cursor = p;
+
+    return true;
+}
+
+namespace {
+
+// Attributes and face indices parsed from a newline aligned chunk of the file
+// Positive indices are stored zero-based and relative indices are stored biased
+// against the attribute count at the beginning of the chunk
+struct ObjChunk {
+    const char * begin;
+    const char * end;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> textureCoordinates;
+
+    std::vector<int64_t> positionIndices;
+    std::vector<int64_t> normalIndices;
+    std::vector<int64_t> textureCoordinateIndices;
+
+    bool valid;
+};
+
+// Polygon corner indices as read from a face statement
+struct ObjCorner {
+    int64_t position;
+    int64_t textureCoordinate;
+    int64_t normal;
+    bool hasTextureCoordinate;
+    bool hasNormal;
+};
+
+// Convert one-based or negative OBJ index to stored chunk index
+inline int64_t encodeIndex(int64_t index, size_t localCount) {
+    if (index > 0)
+        return index - 1;
+
+    return (int64_t)localCount + index - RELATIVE_INDEX_BIAS;
+}
+
+// Convert stored chunk index to zero-based file index
+inline bool decodeIndex(int64_t index, size_t base, size_t count, uint32_t & result) {
+    int64_t value = index >= 0 ? index : (int64_t)base + index + RELATIVE_INDEX_BIAS;
+
+    if (value < 0 || (uint64_t)value >= count)
+        return false;
+
+    result = (uint32_t)value;
+
+    return true;
+}
+
+// Parse face statement and triangulate polygon as a fan
+bool parseFace(
+        const char * cursor, const char * end,
+        ObjChunk & chunk, std::vector<ObjCorner> & corners) {
+    corners.clear();
+
+    while (true) {
+        cursor = skipSpaces(cursor, end);
+
+        if (cursor == end || *cursor == '#')
+            break;
+
+        ObjCorner corner;
+        corner.hasTextureCoordinate = false;
+        corner.hasNormal = false;
+
+        int64_t index;
+
+        if (!parseInteger(cursor, end, index) || index == 0)
+            return false;
+
+        corner.position = encodeIndex(index, chunk.positions.size());
+
+        if (cursor < end && *cursor == '/') {
+            cursor++;
+
+            if (cursor < end && *cursor != '/') {
+                if (!parseInteger(cursor, end, index) || index == 0)
+                    return false;
+
+                corner.textureCoordinate = encodeIndex(index, chunk.textureCoordinates.size());
+                corner.hasTextureCoordinate = true;
+            }
+
+            if (cursor < end && *cursor == '/') {
+                cursor++;
+
+                if (!parseInteger(cursor, end, index) || index == 0)
+                    return false;
+
+                corner.normal = encodeIndex(index, chunk.normals.size());
+                corner.hasNormal = true;
+            }
+        }
+
+        if (cursor < end && !isSpace(*cursor))
+            return false;
+
+        corners.push_back(corner);
+    }
+
+    for (size_t i = 2; i < corners.size(); i++) {
+        const ObjCorner * triangle[3] = { &corners[0], &corners[i - 1], &corners[i] };
+
+        for (size_t j = 0; j < 3; j++) {
+            const ObjCorner & corner = *triangle[j];
+
+            chunk.positionIndices.push_back(corner.position);
+
+            if (corner.hasTextureCoordinate)
+                chunk.textureCoordinateIndices.push_back(corner.textureCoordinate);
+
+            if (corner.hasNormal)
+                chunk.normalIndices.push_back(corner.normal);
+        }
+    }
+
+    return true;
+}
+
+// Parse all statements in chunk
+void parseChunk(ObjChunk & chunk) {
+    std::vector<ObjCorner> corners;
+
+    const char * cursor = chunk.begin;
+    const char * end = chunk.end;
+
+    chunk.valid = true;
+
+    while (cursor < end) {
+        const char * lineEnd = (const char *)std::memchr(cursor, '\n', end - cursor);
+
+        if (lineEnd == nullptr)
+            lineEnd = end;
+
+        const char * p = skipSpaces(cursor, lineEnd);
+        bool valid = true;
+
+        if (lineEnd - p >= 2 && p[0] == 'v' && isSpace(p[1])) {
+            glm::vec3 position;
+            p++;
+
+            valid = parseFloat(p, lineEnd, position.x)
+                 && parseFloat(p, lineEnd, position.y)
+                 && parseFloat(p, lineEnd, position.z);
+
+            chunk.positions.push_back(position);
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+            glm::vec2 textureCoordinate(0.0f);
+            p += 2;
+
+            valid = parseFloat(p, lineEnd, textureCoordinate.x);
+            parseFloat(p, lineEnd, textureCoordinate.y);
+
+            chunk.textureCoordinates.push_back(textureCoordinate);
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+            glm::vec3 normal;
+            p += 2;
+
+            valid = parseFloat(p, lineEnd, normal.x)
+                 && parseFloat(p, lineEnd, normal.y)
+                 && parseFloat(p, lineEnd, normal.z);
+
+            chunk.normals.push_back(normal);
+        }
+        else if (lineEnd - p >= 2 && p[0] == 'f' && isSpace(p[1]))
+            valid = parseFace(p + 1, lineEnd, chunk, corners);
+
+        if (!valid) {
+            chunk.valid = false;
+            return;
+        }
+
+        cursor = lineEnd + 1;
+    }
+}
+
+// Resolve chunk indices against attribute counts of previous chunks
+bool resolveIndices(
+        const std::vector<int64_t> & indices,
+        size_t base, size_t count,
+        uint32_t * output) {
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (!decodeIndex(indices[i], base, count, output[i]))
+            return false;
+    }
+
+    return true;
+}
+
+}
+
+bool readTriangleMesh(
+        const std::string & filename,
+        std::vector<glm::vec3> & positions,
+        std::vector<glm::vec3> & normals,
+        std::vector<glm::vec2> & textureCoordinates,
+        std::vector<uint32_t> & positionIndices,
+        std::vector<uint32_t> & normalIndices,
+        std::vector<uint32_t> & textureCoordinateIndices) {
+    PROFILE_ZONE("readTriangleMesh");
+
+    MappedFile file;
+
+    if (!openMappedFile(filename, file))
+        return false;
+
+    // Split file in newline aligned chunks
+    size_t chunkCount = std::max(
+        std::min(file.size / MIN_CHUNK_SIZE, getThreadCount() * CHUNKS_PER_THREAD),
+        (size_t)1);
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char * begin = file.data;
+    const char * end = file.data + file.size;
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char * chunkEnd = end;
+
+        if (i + 1 < chunkCount) {
+            chunkEnd = std::max(file.data + file.size * (i + 1) / chunkCount, begin);
+
+            const char * lineEnd = (const char *)std::memchr(chunkEnd, '\n', end - chunkEnd);
+            chunkEnd = lineEnd != nullptr ? lineEnd + 1 : end;
+        }
+
+        chunks[i].begin = begin;
+        chunks[i].end = chunkEnd;
+
+        begin = chunkEnd;
+    }
+
+    // Parse chunks in parallel
+    parallelFor(chunkCount, [&](size_t index, size_t) {
+        PROFILE_ZONE("parseChunk");
+
+        parseChunk(chunks[index]);
+    });
+
+    closeMappedFile(file);
+
+    // Compute attribute and index offsets of each chunk
+    std::vector<size_t> positionOffsets(chunkCount + 1, 0);
+    std::vector<size_t> normalOffsets(chunkCount + 1, 0);
+    std::vector<size_t> textureCoordinateOffsets(chunkCount + 1, 0);
+    std::vector<size_t> positionIndexOffsets(chunkCount + 1, 0);
+    std::vector<size_t> normalIndexOffsets(chunkCount + 1, 0);
+    std::vector<size_t> textureCoordinateIndexOffsets(chunkCount + 1, 0);
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        const ObjChunk & chunk = chunks[i];
+
+        if (!chunk.valid)
+            return false;
+
+        positionOffsets[i + 1] = positionOffsets[i] + chunk.positions.size();
+        normalOffsets[i + 1] = normalOffsets[i] + chunk.normals.size();
+        textureCoordinateOffsets[i + 1] = textureCoordinateOffsets[i] + chunk.textureCoordinates.size();
+        positionIndexOffsets[i + 1] = positionIndexOffsets[i] + chunk.positionIndices.size();
+        normalIndexOffsets[i + 1] = normalIndexOffsets[i] + chunk.normalIndices.size();
+        textureCoordinateIndexOffsets[i + 1] =
+            textureCoordinateIndexOffsets[i] + chunk.textureCoordinateIndices.size();
+    }
+
+    // Attributes must be addressable by 32-bit indices
+    const size_t maxAttributeCount = (size_t)UINT32_MAX;
+
+    if (positionOffsets[chunkCount] > maxAttributeCount
+            || normalOffsets[chunkCount] > maxAttributeCount
+            || textureCoordinateOffsets[chunkCount] > maxAttributeCount)
+        return false;
+
+    positions.resize(positionOffsets[chunkCount]);
+    normals.resize(normalOffsets[chunkCount]);
+    textureCoordinates.resize(textureCoordinateOffsets[chunkCount]);
+    positionIndices.resize(positionIndexOffsets[chunkCount]);
+    normalIndices.resize(normalIndexOffsets[chunkCount]);
+    textureCoordinateIndices.resize(textureCoordinateIndexOffsets[chunkCount]);
+
+    // Merge chunks in file order and resolve indices in parallel
+    std::vector<char> valid(chunkCount, 1);
+
+    parallelFor(chunkCount, [&](size_t index, size_t) {
+        PROFILE_ZONE("resolveChunk");
+
+        ObjChunk & chunk = chunks[index];
+
+        std::copy(chunk.positions.begin(), chunk.positions.end(),
+            positions.begin() + positionOffsets[index]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(),
+            normals.begin() + normalOffsets[index]);
+        std::copy(chunk.textureCoordinates.begin(), chunk.textureCoordinates.end(),
+            textureCoordinates.begin() + textureCoordinateOffsets[index]);
+
+        valid[index] = resolveIndices(
+                chunk.positionIndices,
+                positionOffsets[index], positions.size(),
+                positionIndices.data() + positionIndexOffsets[index])
+            && resolveIndices(
+                chunk.normalIndices,
+                normalOffsets[index], normals.size(),
+                normalIndices.data() + normalIndexOffsets[index])
+            && resolveIndices(
+                chunk.textureCoordinateIndices,
+                textureCoordinateOffsets[index], textureCoordinates.size(),
+                textureCoordinateIndices.data() + textureCoordinateIndexOffsets[index]);
+
+        // Release chunk memory as soon as it is merged
+        chunk = ObjChunk();
+    });
+
+    return std::find(valid.begin(), valid.end(), 0) == valid.end();
+}
+
+bool readTriangleMeshSequential(
+        const std::string & filename,
+        std::vector<glm::vec3> & positions,
+        std::vector<glm::vec3> & normals,
+        std::vector<glm::vec2> & textureCoordinates,
+        std::vector<uint32_t> & positionIndices,
+        std::vector<uint32_t> & normalIndices,
+        std::vector<uint32_t> & textureCoordinateIndices) {
+    PROFILE_ZONE("readTriangleMeshSequential");
+
+    std::ifstream file(filename, std::ifstream::in);
+
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+
+    while (std::getline(file, line)) {
+        std::istringstream attributes(line);
+
+        std::string type;
+        attributes >> type;
+
+        if (type == "v") {
+            glm::vec3 position;
+            attributes >> position.x >> position.y >> position.z;
+
+            positions.push_back(position);
+        }
+        else if (type == "vt") {
+            glm::vec2 textureCoordinate;
+            attributes >> textureCoordinate.x >> textureCoordinate.y;
+
+            textureCoordinates.push_back(textureCoordinate);
+        }
+        else if (type == "vn") {
+            glm::vec3 normal;
+            attributes >> normal.x >> normal.y >> normal.z;
+
+            normals.push_back(normal);
+        }
+        else if (type == "f") {
+            for (size_t i = 0; i < 3; i++) {
+                std::string tokens;
+                attributes >> tokens;
+
+                std::replace(tokens.begin(), tokens.end(), '/', ' ');
+
+                std::istringstream indices(tokens);
+                uint32_t index;
+
+                indices >> index;
+                positionIndices.push_back(index - 1);
+
+                if (indices.peek() == ' ') {
+                    indices.ignore();
+
+                    if (indices.peek() == ' ') {
+                        indices.ignore();
+
+                        indices >> index;
+                        normalIndices.push_back(index - 1);
+                    }
+                    else {
+                        indices >> index;
+                        textureCoordinateIndices.push_back(index - 1);
+
+                        if (indices.peek() == ' ') {
+                            indices.ignore();
+
+                            indices >> index;
+                            normalIndices.push_back(index - 1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    file.close();
+
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef CG20192_OBJ_HPP
+#define CG20192_OBJ_HPP
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parse decimal floating point number after optional spaces without allocations or locale lookups
+// The cursor is advanced past the number
+bool parseFloat(const char *& cursor, const char * end, float & value);
+
+// Parse signed decimal integer at cursor without allocations
+// The cursor is advanced past the number
+bool parseInteger(const char *& cursor, const char * end, int64_t & value);
+
+// Read triangle mesh from Wavefront OBJ file format
+// The file is memory mapped, split in newline aligned chunks and parsed in parallel
+// Polygons are triangulated as fans and negative indices are resolved relative to
+// the attributes read so far
+// Output vectors are overwritten with zero-based 32-bit indices
+bool readTriangleMesh(
+        const std::string & filename,
+        std::vector<glm::vec3> & positions,
+        std::vector<glm::vec3> & normals,
+        std::vector<glm::vec2> & textureCoordinates,
+        std::vector<uint32_t> & positionIndices,
+        std::vector<uint32_t> & normalIndices,
+        std::vector<uint32_t> & textureCoordinateIndices);
+
+// Read triangle mesh from Wavefront OBJ file format line by line
+// Sequential reference implementation for triangle faces with positive indices,
+// kept to validate and compare against readTriangleMesh
+bool readTriangleMeshSequential(
+        const std::string & filename,
+        std::vector<glm::vec3> & positions,
+        std::vector<glm::vec3> & normals,
+        std::vector<glm::vec2> & textureCoordinates,
+        std::vector<uint32_t> & positionIndices,
+        std::vector<uint32_t> & normalIndices,
+        std::vector<uint32_t> & textureCoordinateIndices);
+
+#endif
@@ -0,0 +1,341 @@
+#include "optimization.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+
+namespace {
+
+const uint32_t INVALID_VERTEX = 0xFFFFFFFF;
+
+// Triangles adjacent to each vertex, stored contiguously by vertex
+struct Adjacency {
+    std::vector<uint32_t> counts;
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+void buildAdjacency(const std::vector<uint32_t> & indices, size_t vertexCount, Adjacency & adjacency) {
+    size_t triangleCount = indices.size() / 3;
+
+    adjacency.counts.assign(vertexCount, 0);
+    adjacency.offsets.resize(vertexCount + 1);
+    adjacency.triangles.resize(triangleCount * 3);
+
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency.counts[indices[i]]++;
+
+    adjacency.offsets[0] = 0;
+
+    for (size_t i = 0; i < vertexCount; i++)
+        adjacency.offsets[i + 1] = adjacency.offsets[i] + adjacency.counts[i];
+
+    std::vector<size_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency.triangles[cursors[indices[i]]++] = (uint32_t)(i / 3);
+}
+
+// Insert vertex in FIFO cache simulated with timestamps
+// A vertex is cached while less than cache size insertions happened after its own
+inline size_t updateCache(
+        uint32_t vertex,
+        size_t cacheSize,
+        std::vector<size_t> & timestamps,
+        size_t & time) {
+    if (time - timestamps[vertex] > cacheSize) {
+        timestamps[vertex] = time++;
+        return 1;
+    }
+
+    return 0;
+}
+
+inline size_t updateCache(
+        const uint32_t * triangle,
+        size_t cacheSize,
+        std::vector<size_t> & timestamps,
+        size_t & time) {
+    return updateCache(triangle[0], cacheSize, timestamps, time)
+        + updateCache(triangle[1], cacheSize, timestamps, time)
+        + updateCache(triangle[2], cacheSize, timestamps, time);
+}
+
+}
+
+void analyzeVertexCache(
+        const uint32_t * indices,
+        size_t indexCount,
+        size_t vertexCount,
+        size_t cacheSize,
+        VertexCacheStatistics & statistics) {
+    size_t triangleCount = indexCount / 3;
+
+    std::vector<size_t> timestamps(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    size_t misses = 0;
+
+    for (size_t i = 0; i < triangleCount; i++)
+        misses += updateCache(&indices[i * 3], cacheSize, timestamps, time);
+
+    size_t referencedCount = vertexCount - std::count(timestamps.begin(), timestamps.end(), (size_t)0);
+
+    statistics.acmr = triangleCount > 0 ? (float)misses / triangleCount : 0.0f;
+    statistics.atvr = referencedCount > 0 ? (float)misses / referencedCount : 0.0f;
+}
+
+void optimizeVertexCache(
+        std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        size_t cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0)
+        return;
+
+    Adjacency adjacency;
+    buildAdjacency(indices, vertexCount, adjacency);
+
+    // Number of triangles not emitted yet around each vertex
+    std::vector<uint32_t> & liveCounts = adjacency.counts;
+
+    std::vector<size_t> timestamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+
+    uint32_t fan = indices[0];
+
+    while (fan != INVALID_VERTEX) {
+        candidates.clear();
+
+        // Emit every remaining triangle around fanning vertex
+        for (size_t i = adjacency.offsets[fan]; i < adjacency.offsets[fan + 1]; i++) {
+            uint32_t triangle = adjacency.triangles[i];
+
+            if (emitted[triangle])
+                continue;
+
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t vertex = indices[triangle * 3 + k];
+
+                result.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+
+                liveCounts[vertex]--;
+                updateCache(vertex, cacheSize, timestamps, time);
+            }
+
+            emitted[triangle] = true;
+        }
+
+        // Select the oldest candidate that stays cached while its own fan is emitted
+        fan = INVALID_VERTEX;
+        long long bestPriority = -1;
+
+        for (size_t i = 0; i < candidates.size(); i++) {
+            uint32_t vertex = candidates[i];
+
+            if (liveCounts[vertex] == 0)
+                continue;
+
+            long long age = (long long)(time - timestamps[vertex]);
+            long long priority = age + 2 * (long long)liveCounts[vertex] <= (long long)cacheSize ? age : 0;
+
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fan = vertex;
+            }
+        }
+
+        // Resume from recently used vertices, then from input order
+        while (fan == INVALID_VERTEX && !deadEnds.empty()) {
+            uint32_t vertex = deadEnds.back();
+            deadEnds.pop_back();
+
+            if (liveCounts[vertex] > 0)
+                fan = vertex;
+        }
+
+        while (fan == INVALID_VERTEX && cursor < vertexCount) {
+            if (liveCounts[cursor] > 0)
+                fan = (uint32_t)cursor;
+
+            cursor++;
+        }
+    }
+
+    indices.swap(result);
+}
+
+void optimizeOverdraw(
+        std::vector<uint32_t> & indices,
+        const std::vector<Vertex> & vertices,
+        size_t cacheSize,
+        float threshold) {
+    size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0)
+        return;
+
+    std::vector<size_t> timestamps(vertices.size(), 0);
+    size_t time = cacheSize + 1;
+
+    // Hard boundaries start where a triangle misses all vertices in cache
+    std::vector<size_t> hardClusters;
+
+    for (size_t i = 0; i < triangleCount; i++) {
+        if (updateCache(&indices[i * 3], cacheSize, timestamps, time) == 3 || i == 0)
+            hardClusters.push_back(i);
+    }
+
+    // Split hard clusters while their prefix keeps vertex cache efficiency within threshold
+    std::vector<size_t> clusters;
+
+    for (size_t i = 0; i < hardClusters.size(); i++) {
+        size_t begin = hardClusters[i];
+        size_t end = i + 1 < hardClusters.size() ? hardClusters[i + 1] : triangleCount;
+
+        time += cacheSize + 1;
+        size_t misses = 0;
+
+        for (size_t j = begin; j < end; j++)
+            misses += updateCache(&indices[j * 3], cacheSize, timestamps, time);
+
+        float clusterThreshold = threshold * misses / (end - begin);
+
+        clusters.push_back(begin);
+
+        time += cacheSize + 1;
+        size_t runningMisses = 0;
+        size_t runningCount = 0;
+
+        for (size_t j = begin; j < end; j++) {
+            runningMisses += updateCache(&indices[j * 3], cacheSize, timestamps, time);
+            runningCount++;
+
+            if ((float)runningMisses / runningCount <= clusterThreshold) {
+                clusters.push_back(j + 1);
+
+                time += cacheSize + 1;
+                runningMisses = 0;
+                runningCount = 0;
+            }
+        }
+
+        // Merge the incomplete last cluster with the previous one
+        if (clusters.back() != begin)
+            clusters.pop_back();
+    }
+
+    // Compute area weighted centroid and normal of clusters and mesh
+    size_t clusterCount = clusters.size();
+
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    std::vector<float> areas(clusterCount, 0.0f);
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t i = 0; i < clusterCount; i++) {
+        size_t begin = clusters[i];
+        size_t end = i + 1 < clusterCount ? clusters[i + 1] : triangleCount;
+
+        for (size_t j = begin; j < end; j++) {
+            const glm::vec3 & p0 = vertices[indices[j * 3]].position;
+            const glm::vec3 & p1 = vertices[indices[j * 3 + 1]].position;
+            const glm::vec3 & p2 = vertices[indices[j * 3 + 2]].position;
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+
+            centroids[i] += (p0 + p1 + p2) * (area / 3.0f);
+            normals[i] += normal;
+            areas[i] += area;
+        }
+
+        meshCentroid += centroids[i];
+        meshArea += areas[i];
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Draw clusters facing away from the mesh center first
+    std::vector<float> keys(clusterCount);
+    std::vector<size_t> order(clusterCount);
+
+    for (size_t i = 0; i < clusterCount; i++) {
+        glm::vec3 centroid = areas[i] > 0.0f ? centroids[i] / areas[i] : meshCentroid;
+        float length = glm::length(normals[i]);
+
+        keys[i] = length > 0.0f ? glm::dot(centroid - meshCentroid, normals[i] / length) : 0.0f;
+        order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return keys[a] > keys[b];
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+
+    for (size_t i = 0; i < clusterCount; i++) {
+        size_t cluster = order[i];
+        size_t begin = clusters[cluster];
+        size_t end = cluster + 1 < clusterCount ? clusters[cluster + 1] : triangleCount;
+
+        result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+    }
+
+    indices.swap(result);
+}
+
+void optimizeVertexFetch(TriangleMesh & mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), INVALID_VERTEX);
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        uint32_t & index = mesh.indices[i];
+
+        if (remap[index] == INVALID_VERTEX) {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    mesh.vertices.swap(vertices);
+}
+
+void optimizeTriangleMesh(TriangleMesh & mesh) {
+    PROFILE_ZONE("optimizeTriangleMesh");
+
+    std::vector<uint32_t> indices;
+
+    for (size_t i = 0; i < mesh.levels.size(); i++) {
+        const LevelOfDetail & level = mesh.levels[i];
+        std::vector<uint32_t>::iterator begin = mesh.indices.begin() + level.indexOffset;
+
+        indices.assign(begin, begin + level.indexCount);
+
+        optimizeVertexCache(indices, mesh.vertices.size(), VERTEX_CACHE_SIZE);
+        optimizeOverdraw(indices, mesh.vertices, VERTEX_CACHE_SIZE, OVERDRAW_THRESHOLD);
+
+        std::copy(indices.begin(), indices.end(), begin);
+    }
+
+    optimizeVertexFetch(mesh);
+}
@@ -0,0 +1,54 @@
+#ifndef CG20192_OPTIMIZATION_HPP
+#define CG20192_OPTIMIZATION_HPP
+
+#include "mesh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Simulated post-transform vertex cache size (FIFO entries)
+const size_t VERTEX_CACHE_SIZE = 16;
+
+// Allowed vertex cache degradation when splitting clusters for overdraw
+const float OVERDRAW_THRESHOLD = 1.05f;
+
+// Vertex cache efficiency of a triangle list
+// ACMR is the average number of transformed vertices per triangle (0.5 to 3)
+// and ATVR the average number of transformations per referenced vertex (1 is optimal)
+struct VertexCacheStatistics {
+    float acmr;
+    float atvr;
+};
+
+// Simulate FIFO vertex cache over triangle list
+void analyzeVertexCache(
+        const uint32_t * indices,
+        size_t indexCount,
+        size_t vertexCount,
+        size_t cacheSize,
+        VertexCacheStatistics & statistics);
+
+// Reorder triangles for the post-transform vertex cache (Tipsify)
+void optimizeVertexCache(
+        std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        size_t cacheSize);
+
+// Reorder clusters of vertex cache optimized triangles to reduce overdraw
+// Clusters are split while their vertex cache efficiency stays within threshold
+// and sorted by a view-independent outward facing measure
+void optimizeOverdraw(
+        std::vector<uint32_t> & indices,
+        const std::vector<Vertex> & vertices,
+        size_t cacheSize,
+        float threshold);
+
+// Reorder vertices by first use in triangle list for vertex fetch locality
+// Unreferenced vertices are removed
+void optimizeVertexFetch(TriangleMesh & mesh);
+
+// Run vertex cache and overdraw optimizations on each level of detail,
+// then vertex fetch optimization on the whole index buffer
+void optimizeTriangleMesh(TriangleMesh & mesh);
+
+#endif
@@ -0,0 +1,1205 @@
+#include "out_of_core.hpp"
+#include "chunked_mesh.hpp"
+#include "obj.hpp"
+#include "mesh.hpp"
+#include "meshlet.hpp"
+#include "optimization.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Size of blocks read from the OBJ file, grown for longer lines
+const size_t READ_BLOCK_SIZE = 1 << 20;
+
+// Buffer size and maximum number of spill files open at once
+// Their buffers are reserved from the memory budget
+const size_t SPILL_BUFFER_SIZE = 1 << 15;
+const size_t MAX_SPILL_FILES = 256;
+
+// Number of records moved between spill files at once
+const size_t SPILL_BATCH_SIZE = 4096;
+
+// Top-level grid resolution per axis and maximum depth of cell splits
+// Cells at maximum depth (coincident triangles) are cut in pieces without splitting
+const int GRID_RESOLUTION = 4;
+const int MAX_SPLIT_DEPTH = 16;
+
+// Share of the data budget used by the arrays of each pass
+// Memory kept by the allocator after the previous pass and the chunks being built fit the rest
+const size_t PASS_BUDGET_DIVISOR = 4;
+
+// Bytes per chunk triangle while it is built and optimized, used to bound the chunk size
+const size_t CHUNK_BYTES_PER_TRIANGLE = 512;
+
+// Index of attributes missing from a corner
+const uint32_t MISSING_INDEX = 0xFFFFFFFF;
+
+// Attribute streams spilled by the parser
+enum AttributeType {
+    ATTRIBUTE_POSITION,
+    ATTRIBUTE_NORMAL,
+    ATTRIBUTE_TEXTURE_COORDINATE,
+    ATTRIBUTE_TYPE_COUNT
+};
+
+// Floats per attribute of each type
+const size_t ATTRIBUTE_COMPONENTS[ATTRIBUTE_TYPE_COUNT] = { 3, 3, 2 };
+
+// Triangle with resolved zero-based attribute indices
+struct TriangleRecord {
+    uint32_t position[3];
+    uint32_t normal[3];
+    uint32_t textureCoordinate[3];
+};
+
+// Triangle partitioned by the position of its first corner
+struct CellRecord {
+    TriangleRecord triangle;
+    glm::vec3 point;
+};
+
+// Attribute requested by a chunk, the slot is its place in the gathered attributes of its type
+struct AttributeRequest {
+    uint64_t slot;
+    uint32_t index;
+    uint32_t type;
+};
+
+// Attribute value gathered for a slot
+struct AttributeValue {
+    uint64_t slot;
+    uint32_t type;
+    float value[3];
+};
+
+// Temporary file written sequentially and read back sequentially after a rewind
+// Sizes are counted in bytes
+struct SpillFile {
+    std::string filename;
+    std::FILE * file;
+    std::unique_ptr<char[]> buffer;
+    uint64_t size;
+};
+
+// Chunk cut from a cell, its topology is stored in the topology file as local indices
+// Local indices address the attribute slots of the chunk from its slot offset
+struct ChunkRecord {
+    size_t triangleCount;
+    uint64_t slotOffset[ATTRIBUTE_TYPE_COUNT];
+    uint64_t slotCount[ATTRIBUTE_TYPE_COUNT];
+};
+
+// Consecutive chunks whose attributes fit the memory budget together
+struct ChunkGroup {
+    size_t chunkOffset;
+    size_t chunkCount;
+    uint64_t slotOffset[ATTRIBUTE_TYPE_COUNT];
+    uint64_t slotCount[ATTRIBUTE_TYPE_COUNT];
+    uint64_t size;
+    SpillFile * values;
+};
+
+// Cell of the spatial partition waiting to be cut in chunks
+struct PendingCell {
+    SpillFile * records;
+    BoundingBox bounds;
+    int depth;
+};
+
+// Conversion state shared by the passes
+// Spill files are owned by the converter so every file left behind by a failure is removed
+struct Converter {
+    std::string prefix;
+    size_t dataBudget;
+    size_t chunkTriangleCount;
+
+    std::list<SpillFile> spillFiles;
+    uint64_t spillFileIndex;
+
+    SpillFile * attributes[ATTRIBUTE_TYPE_COUNT];
+    uint64_t attributeCounts[ATTRIBUTE_TYPE_COUNT];
+    uint64_t maxIndices[ATTRIBUTE_TYPE_COUNT];
+    bool usedAttributes[ATTRIBUTE_TYPE_COUNT];
+    BoundingBox bounds;
+
+    SpillFile * triangles;
+    uint64_t triangleCount;
+
+    std::vector<CellRecord> pendingRecords;
+    std::vector<ChunkRecord> chunks;
+    std::vector<ChunkGroup> groups;
+    SpillFile * topology;
+    std::vector<SpillFile *> requests[ATTRIBUTE_TYPE_COUNT];
+    uint64_t slotCounts[ATTRIBUTE_TYPE_COUNT];
+
+    ConverterStatistics * statistics;
+};
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char * skipSpaces(const char * cursor, const char * end) {
+    while (cursor < end && isSpace(*cursor))
+        cursor++;
+
+    return cursor;
+}
+
+// Spread lower 10 bits of value to every third bit
+uint32_t expandBits(uint32_t value) {
+    value &= 0x3FF;
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+
+    return value;
+}
+
+// Get number of attributes of a type held by the pass budget
+uint64_t getAttributeRangeSize(const Converter & converter, int type) {
+    size_t attributeSize = ATTRIBUTE_COMPONENTS[type] * sizeof(float);
+
+    return std::max<uint64_t>(1, converter.dataBudget / PASS_BUDGET_DIVISOR / attributeSize);
+}
+
+// Create spill file for writing, failing when too many files are open
+SpillFile * createSpillFile(Converter & converter) {
+    if (converter.spillFiles.size() >= MAX_SPILL_FILES) {
+        std::cout << "Cannot open more than " << MAX_SPILL_FILES
+            << " spill files, increase the memory budget." << std::endl;
+        return nullptr;
+    }
+
+    std::ostringstream filename;
+    filename << converter.prefix << converter.spillFileIndex++;
+
+    converter.spillFiles.push_back(SpillFile());
+
+    SpillFile & spill = converter.spillFiles.back();
+    spill.filename = filename.str();
+    spill.file = std::fopen(spill.filename.c_str(), "w+b");
+    spill.size = 0;
+
+    if (spill.file == nullptr) {
+        std::cout << "Cannot create spill file " << spill.filename << "." << std::endl;
+        converter.spillFiles.pop_back();
+        return nullptr;
+    }
+
+    spill.buffer.reset(new char[SPILL_BUFFER_SIZE]);
+    std::setvbuf(spill.file, spill.buffer.get(), _IOFBF, SPILL_BUFFER_SIZE);
+
+    converter.statistics->maxSpillFileCount = std::max(
+        converter.statistics->maxSpillFileCount,
+        converter.spillFiles.size());
+
+    return &spill;
+}
+
+// Close and remove spill file
+void deleteSpillFile(Converter & converter, SpillFile *& spill) {
+    if (spill == nullptr)
+        return;
+
+    for (std::list<SpillFile>::iterator i = converter.spillFiles.begin(); i != converter.spillFiles.end(); ++i) {
+        if (&*i == spill) {
+            std::fclose(i->file);
+            std::remove(i->filename.c_str());
+            converter.spillFiles.erase(i);
+            break;
+        }
+    }
+
+    spill = nullptr;
+}
+
+// Close and remove all spill files left
+void deleteSpillFiles(Converter & converter) {
+    for (std::list<SpillFile>::iterator i = converter.spillFiles.begin(); i != converter.spillFiles.end(); ++i) {
+        std::fclose(i->file);
+        std::remove(i->filename.c_str());
+    }
+
+    converter.spillFiles.clear();
+}
+
+// Append bytes to spill file
+bool writeSpill(Converter & converter, SpillFile * spill, const void * data, size_t size) {
+    if (std::fwrite(data, 1, size, spill->file) != size) {
+        std::cout << "Cannot write spill file " << spill->filename << "." << std::endl;
+        return false;
+    }
+
+    spill->size += size;
+    converter.statistics->spilledSize += size;
+
+    return true;
+}
+
+// Switch spill file from writing to reading from its beginning
+bool rewindSpill(SpillFile * spill) {
+    if (std::fflush(spill->file) != 0 || std::fseek(spill->file, 0, SEEK_SET) != 0) {
+        std::cout << "Cannot read spill file " << spill->filename << "." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Read exactly count records from spill file
+template<typename T>
+bool readSpill(SpillFile * spill, T * records, size_t count) {
+    if (std::fread(records, sizeof(T), count, spill->file) != count) {
+        std::cout << "Cannot read spill file " << spill->filename << "." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Read next batch of records from spill file, count is zero at the end of the file
+template<typename T>
+bool readSpillBatch(SpillFile * spill, std::vector<T> & records, size_t & count) {
+    records.resize(SPILL_BATCH_SIZE);
+    count = std::fread(records.data(), sizeof(T), records.size(), spill->file);
+
+    if (std::ferror(spill->file)) {
+        std::cout << "Cannot read spill file " << spill->filename << "." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Resolve one-based or negative OBJ index against the attributes read so far
+inline bool resolveIndex(int64_t index, Converter & converter, int type, uint32_t & result) {
+    int64_t value = index > 0 ? index - 1 : (int64_t)converter.attributeCounts[type] + index;
+
+    if (index == 0 || value < 0 || value >= (int64_t)MISSING_INDEX)
+        return false;
+
+    result = (uint32_t)value;
+    converter.maxIndices[type] = std::max<uint64_t>(converter.maxIndices[type], result + 1);
+
+    return true;
+}
+
+// Parse face statement, triangulate polygon as a fan and spill its triangles
+bool spillFace(const char * cursor, const char * end, Converter & converter, std::vector<TriangleRecord> & corners) {
+    corners.clear();
+
+    while (true) {
+        cursor = skipSpaces(cursor, end);
+
+        if (cursor == end || *cursor == '#')
+            break;
+
+        // Corners reuse the first index of each attribute of a triangle record
+        TriangleRecord corner;
+        corner.normal[0] = MISSING_INDEX;
+        corner.textureCoordinate[0] = MISSING_INDEX;
+
+        int64_t index;
+
+        if (!parseInteger(cursor, end, index)
+                || !resolveIndex(index, converter, ATTRIBUTE_POSITION, corner.position[0]))
+            return false;
+
+        if (cursor < end && *cursor == '/') {
+            cursor++;
+
+            if (cursor < end && *cursor != '/') {
+                if (!parseInteger(cursor, end, index)
+                        || !resolveIndex(index, converter, ATTRIBUTE_TEXTURE_COORDINATE, corner.textureCoordinate[0]))
+                    return false;
+            }
+
+            if (cursor < end && *cursor == '/') {
+                cursor++;
+
+                if (!parseInteger(cursor, end, index)
+                        || !resolveIndex(index, converter, ATTRIBUTE_NORMAL, corner.normal[0]))
+                    return false;
+            }
+        }
+
+        if (cursor < end && !isSpace(*cursor))
+            return false;
+
+        converter.usedAttributes[ATTRIBUTE_NORMAL] &= corner.normal[0] != MISSING_INDEX;
+        converter.usedAttributes[ATTRIBUTE_TEXTURE_COORDINATE] &= corner.textureCoordinate[0] != MISSING_INDEX;
+
+        corners.push_back(corner);
+    }
+
+    for (size_t i = 2; i < corners.size(); i++) {
+        const TriangleRecord * triangleCorners[3] = { &corners[0], &corners[i - 1], &corners[i] };
+
+        TriangleRecord triangle;
+
+        for (int j = 0; j < 3; j++) {
+            triangle.position[j] = triangleCorners[j]->position[0];
+            triangle.normal[j] = triangleCorners[j]->normal[0];
+            triangle.textureCoordinate[j] = triangleCorners[j]->textureCoordinate[0];
+        }
+
+        if (!writeSpill(converter, converter.triangles, &triangle, sizeof(triangle)))
+            return false;
+
+        converter.triangleCount++;
+    }
+
+    return true;
+}
+
+// Parse complete lines of block, spilling attributes and triangles
+bool spillLines(const char * cursor, const char * end, Converter & converter) {
+    std::vector<TriangleRecord> corners;
+
+    while (cursor < end) {
+        const char * lineEnd = (const char *)std::memchr(cursor, '\n', end - cursor);
+
+        if (lineEnd == nullptr)
+            lineEnd = end;
+
+        const char * p = skipSpaces(cursor, lineEnd);
+        bool valid = true;
+
+        int type = -1;
+        float value[3] = { 0.0f, 0.0f, 0.0f };
+
+        if (lineEnd - p >= 2 && p[0] == 'v' && isSpace(p[1])) {
+            type = ATTRIBUTE_POSITION;
+            p++;
+
+            valid = parseFloat(p, lineEnd, value[0])
+                 && parseFloat(p, lineEnd, value[1])
+                 && parseFloat(p, lineEnd, value[2]);
+
+            glm::vec3 position(value[0], value[1], value[2]);
+
+            converter.bounds.min = glm::min(converter.bounds.min, position);
+            converter.bounds.max = glm::max(converter.bounds.max, position);
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+            type = ATTRIBUTE_TEXTURE_COORDINATE;
+            p += 2;
+
+            valid = parseFloat(p, lineEnd, value[0]);
+            parseFloat(p, lineEnd, value[1]);
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+            type = ATTRIBUTE_NORMAL;
+            p += 2;
+
+            valid = parseFloat(p, lineEnd, value[0])
+                 && parseFloat(p, lineEnd, value[1])
+                 && parseFloat(p, lineEnd, value[2]);
+        }
+        else if (lineEnd - p >= 2 && p[0] == 'f' && isSpace(p[1]))
+            valid = spillFace(p + 1, lineEnd, converter, corners);
+
+        if (valid && type != -1) {
+            valid = writeSpill(
+                converter,
+                converter.attributes[type],
+                value,
+                ATTRIBUTE_COMPONENTS[type] * sizeof(float));
+
+            converter.attributeCounts[type]++;
+        }
+
+        if (!valid)
+            return false;
+
+        cursor = lineEnd + 1;
+    }
+
+    return true;
+}
+
+// Stream OBJ file in blocks of complete lines, spilling attributes and triangles
+bool spillObjFile(const std::string & filename, Converter & converter) {
+    PROFILE_ZONE("spillObjFile");
+
+    std::FILE * file = std::fopen(filename.c_str(), "rb");
+
+    if (file == nullptr)
+        return false;
+
+    std::vector<char> block(READ_BLOCK_SIZE);
+    size_t blockSize = 0;
+    bool success = true;
+
+    while (success) {
+        size_t readSize = std::fread(block.data() + blockSize, 1, block.size() - blockSize, file);
+        blockSize += readSize;
+
+        converter.statistics->inputSize += readSize;
+
+        if (std::ferror(file)) {
+            success = false;
+            break;
+        }
+
+        bool lastBlock = readSize == 0;
+
+        // Parse up to the last newline, keeping the partial line for the next block
+        size_t parsedSize = blockSize;
+
+        if (!lastBlock) {
+            const char * data = block.data();
+            parsedSize = 0;
+
+            for (size_t i = blockSize; i > 0; i--) {
+                if (data[i - 1] == '\n') {
+                    parsedSize = i;
+                    break;
+                }
+            }
+
+            // Grow block for lines longer than it
+            if (parsedSize == 0) {
+                if (blockSize == block.size())
+                    block.resize(block.size() * 2);
+
+                continue;
+            }
+        }
+
+        success = spillLines(block.data(), block.data() + parsedSize, converter);
+
+        std::memmove(block.data(), block.data() + parsedSize, blockSize - parsedSize);
+        blockSize -= parsedSize;
+
+        if (lastBlock)
+            break;
+    }
+
+    std::fclose(file);
+
+    if (!success)
+        return false;
+
+    // Validate indices against all attributes, positive indices may refer to later attributes
+    for (int i = 0; i < ATTRIBUTE_TYPE_COUNT; i++) {
+        if (converter.maxIndices[i] > converter.attributeCounts[i])
+            return false;
+
+        if (converter.attributeCounts[i] == 0)
+            converter.usedAttributes[i] = false;
+    }
+
+    return true;
+}
+
+// Distribute triangles in files by range of their first position index
+// A range of positions fits the pass budget
+bool bucketTriangles(Converter & converter, std::vector<SpillFile *> & buckets) {
+    PROFILE_ZONE("bucketTriangles");
+
+    uint64_t rangeSize = getAttributeRangeSize(converter, ATTRIBUTE_POSITION);
+    uint64_t rangeCount = (converter.attributeCounts[ATTRIBUTE_POSITION] + rangeSize - 1) / rangeSize;
+
+    buckets.assign(rangeCount, nullptr);
+
+    if (!rewindSpill(converter.triangles))
+        return false;
+
+    std::vector<TriangleRecord> triangles;
+    size_t count;
+
+    while (readSpillBatch(converter.triangles, triangles, count) && count > 0) {
+        for (size_t i = 0; i < count; i++) {
+            SpillFile *& bucket = buckets[triangles[i].position[0] / rangeSize];
+
+            if (bucket == nullptr && (bucket = createSpillFile(converter)) == nullptr)
+                return false;
+
+            if (!writeSpill(converter, bucket, &triangles[i], sizeof(TriangleRecord)))
+                return false;
+        }
+    }
+
+    if (std::ferror(converter.triangles->file))
+        return false;
+
+    deleteSpillFile(converter, converter.triangles);
+
+    return true;
+}
+
+// Get cell of point in grid over bounds
+int getGridCell(const BoundingBox & bounds, const glm::vec3 & point, int resolution) {
+    glm::vec3 extent = bounds.max - bounds.min;
+    int cell = 0;
+
+    for (int i = 2; i >= 0; i--) {
+        int coordinate = extent[i] > 0.0f ? (int)((point[i] - bounds.min[i]) / extent[i] * resolution) : 0;
+        cell = cell * resolution + std::min(std::max(coordinate, 0), resolution - 1);
+    }
+
+    return cell;
+}
+
+// Get bounds of cell in grid over bounds
+BoundingBox getGridCellBounds(const BoundingBox & bounds, int cell, int resolution) {
+    glm::vec3 extent = (bounds.max - bounds.min) / (float)resolution;
+    glm::vec3 coordinates(cell % resolution, cell / resolution % resolution, cell / resolution / resolution);
+
+    BoundingBox cellBounds;
+    cellBounds.min = bounds.min + coordinates * extent;
+    cellBounds.max = cellBounds.min + extent;
+
+    return cellBounds;
+}
+
+// Write cell records to the cells of a grid over bounds
+bool writeGridCell(
+        Converter & converter,
+        const CellRecord & record,
+        const BoundingBox & bounds,
+        int resolution,
+        std::vector<SpillFile *> & cells) {
+    SpillFile *& cell = cells[getGridCell(bounds, record.point, resolution)];
+
+    if (cell == nullptr && (cell = createSpillFile(converter)) == nullptr)
+        return false;
+
+    return writeSpill(converter, cell, &record, sizeof(record));
+}
+
+// Attach first corner positions to triangles and partition them in the top-level grid
+// Buckets are read in position order, so positions are streamed once
+bool partitionTriangles(Converter & converter, std::vector<SpillFile *> & buckets, std::vector<PendingCell> & cells) {
+    PROFILE_ZONE("partitionTriangles");
+
+    const int cellCount = GRID_RESOLUTION * GRID_RESOLUTION * GRID_RESOLUTION;
+
+    uint64_t rangeSize = getAttributeRangeSize(converter, ATTRIBUTE_POSITION);
+    uint64_t positionCount = converter.attributeCounts[ATTRIBUTE_POSITION];
+
+    std::vector<SpillFile *> cellFiles(cellCount, nullptr);
+    std::vector<glm::vec3> positions;
+
+    SpillFile * positionFile = converter.attributes[ATTRIBUTE_POSITION];
+
+    if (!rewindSpill(positionFile))
+        return false;
+
+    for (size_t i = 0; i < buckets.size(); i++) {
+        uint64_t rangeOffset = i * rangeSize;
+
+        positions.resize((size_t)std::min(rangeSize, positionCount - rangeOffset));
+
+        if (!readSpill(positionFile, positions.data(), positions.size()))
+            return false;
+
+        if (buckets[i] == nullptr || !rewindSpill(buckets[i]))
+            continue;
+
+        std::vector<TriangleRecord> triangles;
+        size_t count;
+
+        while (readSpillBatch(buckets[i], triangles, count) && count > 0) {
+            for (size_t j = 0; j < count; j++) {
+                CellRecord record;
+                record.triangle = triangles[j];
+                record.point = positions[triangles[j].position[0] - rangeOffset];
+
+                if (!writeGridCell(converter, record, converter.bounds, GRID_RESOLUTION, cellFiles))
+                    return false;
+            }
+        }
+
+        if (std::ferror(buckets[i]->file))
+            return false;
+
+        deleteSpillFile(converter, buckets[i]);
+    }
+
+    // Queue cells along a Morton curve so chunks carried over between cells stay compact
+    // Cells are processed from the back
+    std::vector<std::pair<uint32_t, int> > codes(cellCount);
+
+    for (int i = 0; i < cellCount; i++) {
+        uint32_t code = expandBits(i % GRID_RESOLUTION)
+            | (expandBits(i / GRID_RESOLUTION % GRID_RESOLUTION) << 1)
+            | (expandBits(i / GRID_RESOLUTION / GRID_RESOLUTION) << 2);
+
+        codes[i] = std::make_pair(code, i);
+    }
+
+    std::sort(codes.begin(), codes.end());
+
+    for (int i = cellCount - 1; i >= 0; i--) {
+        int index = codes[i].second;
+
+        if (cellFiles[index] == nullptr)
+            continue;
+
+        PendingCell cell;
+        cell.records = cellFiles[index];
+        cell.bounds = getGridCellBounds(converter.bounds, index, GRID_RESOLUTION);
+        cell.depth = 0;
+
+        cells.push_back(cell);
+    }
+
+    return true;
+}
+
+// Assign attribute slots to chunk, spill its local topology and request its attributes
+bool spillChunk(Converter & converter, const CellRecord * records, size_t count) {
+    ChunkRecord chunk;
+    chunk.triangleCount = count;
+
+    uint64_t chunkSize = 0;
+
+    std::vector<uint32_t> indices(count * 3);
+    std::vector<uint32_t> uniqueIndices;
+    std::vector<std::pair<uint32_t, uint32_t> > sortedCorners(count * 3);
+
+    for (int type = 0; type < ATTRIBUTE_TYPE_COUNT; type++) {
+        chunk.slotOffset[type] = converter.slotCounts[type];
+        chunk.slotCount[type] = 0;
+
+        if (!converter.usedAttributes[type])
+            continue;
+
+        for (size_t i = 0; i < count; i++) {
+            const TriangleRecord & triangle = records[i].triangle;
+
+            const uint32_t * corners = type == ATTRIBUTE_POSITION ? triangle.position
+                : type == ATTRIBUTE_NORMAL ? triangle.normal
+                : triangle.textureCoordinate;
+
+            for (int j = 0; j < 3; j++)
+                sortedCorners[i * 3 + j] = std::make_pair(corners[j], (uint32_t)(i * 3 + j));
+        }
+
+        // Deduplicate attributes referenced by the chunk in index order
+        std::sort(sortedCorners.begin(), sortedCorners.end());
+        uniqueIndices.clear();
+
+        for (size_t i = 0; i < sortedCorners.size(); i++) {
+            if (i == 0 || sortedCorners[i].first != sortedCorners[i - 1].first)
+                uniqueIndices.push_back(sortedCorners[i].first);
+
+            indices[sortedCorners[i].second] = (uint32_t)(uniqueIndices.size() - 1);
+        }
+
+        if (!writeSpill(converter, converter.topology, indices.data(), indices.size() * sizeof(uint32_t)))
+            return false;
+
+        // Request attributes from the file of their index range
+        uint64_t rangeSize = getAttributeRangeSize(converter, type);
+
+        for (size_t i = 0; i < uniqueIndices.size(); i++) {
+            AttributeRequest request;
+            request.slot = chunk.slotOffset[type] + i;
+            request.index = uniqueIndices[i];
+            request.type = type;
+
+            SpillFile *& requests = converter.requests[type][request.index / rangeSize];
+
+            if (requests == nullptr && (requests = createSpillFile(converter)) == nullptr)
+                return false;
+
+            if (!writeSpill(converter, requests, &request, sizeof(request)))
+                return false;
+        }
+
+        chunk.slotCount[type] = uniqueIndices.size();
+        converter.slotCounts[type] += uniqueIndices.size();
+
+        chunkSize += uniqueIndices.size() * ATTRIBUTE_COMPONENTS[type] * sizeof(float);
+    }
+
+    // Group consecutive chunks while their attributes fit the pass budget
+    uint64_t groupBudget = converter.dataBudget / PASS_BUDGET_DIVISOR;
+
+    if (converter.groups.empty() || converter.groups.back().size + chunkSize > groupBudget) {
+        ChunkGroup group;
+        group.chunkOffset = converter.chunks.size();
+        group.chunkCount = 0;
+        group.size = 0;
+        group.values = nullptr;
+
+        for (int type = 0; type < ATTRIBUTE_TYPE_COUNT; type++) {
+            group.slotOffset[type] = chunk.slotOffset[type];
+            group.slotCount[type] = 0;
+        }
+
+        converter.groups.push_back(group);
+    }
+
+    ChunkGroup & group = converter.groups.back();
+    group.chunkCount++;
+    group.size += chunkSize;
+
+    for (int type = 0; type < ATTRIBUTE_TYPE_COUNT; type++)
+        group.slotCount[type] += chunk.slotCount[type];
+
+    converter.chunks.push_back(chunk);
+
+    return true;
+}
+
+// Sort cell records along a Morton curve and cut them in chunks
+bool cutChunks(Converter & converter, std::vector<CellRecord> & records, const BoundingBox & bounds) {
+    glm::vec3 extent = bounds.max - bounds.min;
+    float maxExtent = std::max(std::max(extent.x, extent.y), extent.z);
+    float quantization = maxExtent > 0.0f ? 1023.0f / maxExtent : 0.0f;
+
+    std::vector<std::pair<uint32_t, uint32_t> > codes(records.size());
+
+    for (size_t i = 0; i < records.size(); i++) {
+        glm::vec3 cell = glm::clamp((records[i].point - bounds.min) * quantization, 0.0f, 1023.0f);
+
+        uint32_t code = expandBits((uint32_t)cell.x)
+            | (expandBits((uint32_t)cell.y) << 1)
+            | (expandBits((uint32_t)cell.z) << 2);
+
+        codes[i] = std::make_pair(code, (uint32_t)i);
+    }
+
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<CellRecord> sorted(records.size());
+
+    for (size_t i = 0; i < records.size(); i++)
+        sorted[i] = records[codes[i].second];
+
+    codes.clear();
+    codes.shrink_to_fit();
+
+    // Cut full chunks, carrying the remainder of small cells over to the next cells
+    std::vector<CellRecord> & pending = converter.pendingRecords;
+
+    for (size_t i = 0; i < sorted.size();) {
+        size_t count = std::min(converter.chunkTriangleCount - pending.size(), sorted.size() - i);
+
+        if (pending.empty() && count == converter.chunkTriangleCount) {
+            if (!spillChunk(converter, sorted.data() + i, count))
+                return false;
+        }
+        else {
+            pending.insert(pending.end(), sorted.begin() + i, sorted.begin() + i + count);
+
+            if (pending.size() == converter.chunkTriangleCount) {
+                if (!spillChunk(converter, pending.data(), pending.size()))
+                    return false;
+
+                pending.clear();
+            }
+        }
+
+        i += count;
+    }
+
+    return true;
+}
+
+// Split cells larger than the data budget in octants, then cut cells in chunks
+bool spillChunks(Converter & converter, std::vector<PendingCell> & cells) {
+    PROFILE_ZONE("spillChunks");
+
+    size_t maxCellRecords = converter.dataBudget / PASS_BUDGET_DIVISOR
+        / (2 * sizeof(CellRecord) + sizeof(std::pair<uint32_t, uint32_t>));
+
+    for (int type = 0; type < ATTRIBUTE_TYPE_COUNT; type++) {
+        uint64_t rangeSize = getAttributeRangeSize(converter, type);
+        converter.requests[type].assign((converter.attributeCounts[type] + rangeSize - 1) / rangeSize, nullptr);
+    }
+
+    if ((converter.topology = createSpillFile(converter)) == nullptr)
+        return false;
+
+    std::vector<CellRecord> records;
+
+    while (!cells.empty()) {
+        PendingCell cell = cells.back();
+        cells.pop_back();
+
+        uint64_t recordCount = cell.records->size / sizeof(CellRecord);
+
+        if (!rewindSpill(cell.records))
+            return false;
+
+        if (recordCount > maxCellRecords && cell.depth < MAX_SPLIT_DEPTH) {
+            std::vector<SpillFile *> octants(8, nullptr);
+            size_t count;
+
+            while (readSpillBatch(cell.records, records, count) && count > 0) {
+                for (size_t i = 0; i < count; i++) {
+                    if (!writeGridCell(converter, records[i], cell.bounds, 2, octants))
+                        return false;
+                }
+            }
+
+            if (std::ferror(cell.records->file))
+                return false;
+
+            deleteSpillFile(converter, cell.records);
+
+            for (int i = 7; i >= 0; i--) {
+                if (octants[i] == nullptr)
+                    continue;
+
+                PendingCell octant;
+                octant.records = octants[i];
+                octant.bounds = getGridCellBounds(cell.bounds, i, 2);
+                octant.depth = cell.depth + 1;
+
+                cells.push_back(octant);
+            }
+
+            continue;
+        }
+
+        // Cells at maximum depth are cut in pieces of the largest cell size
+        for (uint64_t offset = 0; offset < recordCount; offset += maxCellRecords) {
+            records.resize((size_t)std::min<uint64_t>(maxCellRecords, recordCount - offset));
+
+            if (!readSpill(cell.records, records.data(), records.size()))
+                return false;
+
+            if (!cutChunks(converter, records, cell.bounds))
+                return false;
+        }
+
+        deleteSpillFile(converter, cell.records);
+    }
+
+    records.clear();
+    records.shrink_to_fit();
+
+    // Cut last chunk from the carried remainder
+    if (!converter.pendingRecords.empty()
+            && !spillChunk(converter, converter.pendingRecords.data(), converter.pendingRecords.size()))
+        return false;
+
+    converter.pendingRecords.clear();
+    converter.pendingRecords.shrink_to_fit();
+
+    return true;
+}
+
+// Find group holding attribute slot of type
+ChunkGroup & findChunkGroup(Converter & converter, int type, uint64_t slot) {
+    size_t first = 0;
+    size_t last = converter.groups.size();
+
+    while (last - first > 1) {
+        size_t middle = (first + last) / 2;
+
+        if (converter.groups[middle].slotOffset[type] <= slot)
+            first = middle;
+        else
+            last = middle;
+    }
+
+    return converter.groups[first];
+}
+
+// Gather requested attributes range by range, streaming each attribute file once,
+// and distribute their values to the files of the chunk groups
+bool gatherAttributes(Converter & converter) {
+    PROFILE_ZONE("gatherAttributes");
+
+    std::vector<float> attributes;
+    std::vector<AttributeRequest> requests;
+
+    for (int type = 0; type < ATTRIBUTE_TYPE_COUNT; type++) {
+        if (!converter.usedAttributes[type]) {
+            deleteSpillFile(converter, converter.attributes[type]);
+            continue;
+        }
+
+        size_t components = ATTRIBUTE_COMPONENTS[type];
+        uint64_t rangeSize = getAttributeRangeSize(converter, type);
+        uint64_t attributeCount = converter.attributeCounts[type];
+
+        if (!rewindSpill(converter.attributes[type]))
+            return false;
+
+        for (size_t i = 0; i < converter.requests[type].size(); i++) {
+            uint64_t rangeOffset = i * rangeSize;
+
+            attributes.resize((size_t)std::min(rangeSize, attributeCount - rangeOffset) * components);
+
+            if (!readSpill(converter.attributes[type], attributes.data(), attributes.size()))
+                return false;
+
+            SpillFile *& requestFile = converter.requests[type][i];
+
+            if (requestFile == nullptr)
+                continue;
+
+            if (!rewindSpill(requestFile))
+                return false;
+
+            size_t count;
+
+            while (readSpillBatch(requestFile, requests, count) && count > 0) {
+                for (size_t j = 0; j < count; j++) {
+                    const AttributeRequest & request = requests[j];
+                    ChunkGroup & group = findChunkGroup(converter, type, request.slot);
+
+                    AttributeValue value;
+                    value.slot = request.slot;
+                    value.type = request.type;
+                    value.value[2] = 0.0f;
+
+                    std::memcpy(
+                        value.value,
+                        attributes.data() + (request.index - rangeOffset) * components,
+                        components * sizeof(float));
+
+                    if (group.values == nullptr && (group.values = createSpillFile(converter)) == nullptr)
+                        return false;
+
+                    if (!writeSpill(converter, group.values, &value, sizeof(value)))
+                        return false;
+                }
+            }
+
+            if (std::ferror(requestFile->file))
+                return false;
+
+            deleteSpillFile(converter, requestFile);
+        }
+
+        deleteSpillFile(converter, converter.attributes[type]);
+    }
+
+    return true;
+}
+
+// Copy slots of chunk from group attributes
+template<typename T>
+void copyChunkAttributes(
+        const std::vector<float> & values,
+        const ChunkGroup & group,
+        const ChunkRecord & chunk,
+        int type,
+        std::vector<T> & attributes) {
+    const T * first = (const T *)values.data() + (chunk.slotOffset[type] - group.slotOffset[type]);
+    attributes.assign(first, first + chunk.slotCount[type]);
+}
+
+// Build chunks group by group and append them to the chunked mesh
+// Chunks of a group are built in parallel batches and appended in order
+bool writeChunks(Converter & converter, ChunkedMeshWriter & writer) {
+    PROFILE_ZONE("writeChunks");
+
+    std::vector<float> values[ATTRIBUTE_TYPE_COUNT];
+    std::vector<AttributeValue> records;
+
+    if (!rewindSpill(converter.topology))
+        return false;
+
+    size_t batchSize = getThreadCount();
+
+    for (size_t i = 0; i < converter.groups.size(); i++) {
+        ChunkGroup & group = converter.groups[i];
+
+        // Fill group attributes by slot
+        for (int type = 0; type < ATTRIBUTE_TYPE_COUNT; type++)
+            values[type].assign((size_t)group.slotCount[type] * ATTRIBUTE_COMPONENTS[type], 0.0f);
+
+        if (group.values != nullptr) {
+            if (!rewindSpill(group.values))
+                return false;
+
+            size_t count;
+
+            while (readSpillBatch(group.values, records, count) && count > 0) {
+                for (size_t j = 0; j < count; j++) {
+                    const AttributeValue & value = records[j];
+                    size_t components = ATTRIBUTE_COMPONENTS[value.type];
+
+                    std::memcpy(
+                        values[value.type].data() + (value.slot - group.slotOffset[value.type]) * components,
+                        value.value,
+                        components * sizeof(float));
+                }
+            }
+
+            if (std::ferror(group.values->file))
+                return false;
+
+            deleteSpillFile(converter, group.values);
+        }
+
+        for (size_t j = 0; j < group.chunkCount; j += batchSize) {
+            size_t count = std::min(batchSize, group.chunkCount - j);
+
+            // Read local topology of batch sequentially
+            std::vector<std::vector<uint32_t> > indices(count * ATTRIBUTE_TYPE_COUNT);
+
+            for (size_t k = 0; k < count; k++) {
+                const ChunkRecord & chunk = converter.chunks[group.chunkOffset + j + k];
+
+                for (int type = 0; type < ATTRIBUTE_TYPE_COUNT; type++) {
+                    if (!converter.usedAttributes[type])
+                        continue;
+
+                    std::vector<uint32_t> & typeIndices = indices[k * ATTRIBUTE_TYPE_COUNT + type];
+                    typeIndices.resize(chunk.triangleCount * 3);
+
+                    if (!readSpill(converter.topology, typeIndices.data(), typeIndices.size()))
+                        return false;
+                }
+            }
+
+            // Build, optimize and split chunks in meshlets
+            std::vector<TriangleMesh> meshes(count);
+
+            parallelFor(count, [&](size_t index, size_t) {
+                const ChunkRecord & chunk = converter.chunks[group.chunkOffset + j + index];
+                const std::vector<uint32_t> * chunkIndices = &indices[index * ATTRIBUTE_TYPE_COUNT];
+
+                std::vector<glm::vec3> positions, normals;
+                std::vector<glm::vec2> textureCoordinates;
+
+                copyChunkAttributes(values[ATTRIBUTE_POSITION], group, chunk, ATTRIBUTE_POSITION, positions);
+                copyChunkAttributes(values[ATTRIBUTE_NORMAL], group, chunk, ATTRIBUTE_NORMAL, normals);
+                copyChunkAttributes(
+                    values[ATTRIBUTE_TEXTURE_COORDINATE],
+                    group,
+                    chunk,
+                    ATTRIBUTE_TEXTURE_COORDINATE,
+                    textureCoordinates);
+
+                TriangleMesh & mesh = meshes[index];
+
+                buildTriangleMesh(
+                    positions,
+                    normals,
+                    textureCoordinates,
+                    chunkIndices[ATTRIBUTE_POSITION],
+                    chunkIndices[ATTRIBUTE_NORMAL],
+                    chunkIndices[ATTRIBUTE_TEXTURE_COORDINATE],
+                    mesh);
+
+                optimizeTriangleMesh(mesh);
+                buildMeshlets(mesh);
+            });
+
+            for (size_t k = 0; k < count; k++) {
+                if (!appendMeshChunk(writer, meshes[k])) {
+                    std::cout << "Cannot write chunked mesh." << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    deleteSpillFile(converter, converter.topology);
+
+    return true;
+}
+
+}
+
+bool convertObjFile(
+        const std::string & inputFilename,
+        const std::string & outputFilename,
+        const ConverterSettings & settings,
+        ConverterStatistics & statistics) {
+    PROFILE_ZONE("convertObjFile");
+
+    std::memset(&statistics, 0, sizeof(statistics));
+
+    if (settings.memoryBudget < MIN_CONVERTER_MEMORY_BUDGET) {
+        std::cout << "Memory budget is lower than " << (MIN_CONVERTER_MEMORY_BUDGET >> 20) << " MiB." << std::endl;
+        return false;
+    }
+
+    // Reserve spill file buffers and the read block from the budget
+    Converter converter;
+    converter.prefix = outputFilename + ".spill.";
+    converter.dataBudget = settings.memoryBudget - MAX_SPILL_FILES * SPILL_BUFFER_SIZE - READ_BLOCK_SIZE;
+    converter.chunkTriangleCount = std::max<size_t>(1, std::min(
+        settings.chunkTriangleCount,
+        converter.dataBudget / PASS_BUDGET_DIVISOR / getThreadCount() / CHUNK_BYTES_PER_TRIANGLE));
+    converter.spillFileIndex = 0;
+    converter.bounds.min = glm::vec3(INFINITY);
+    converter.bounds.max = glm::vec3(-INFINITY);
+    converter.triangles = nullptr;
+    converter.triangleCount = 0;
+    converter.topology = nullptr;
+    converter.statistics = &statistics;
+
+    for (int i = 0; i < ATTRIBUTE_TYPE_COUNT; i++) {
+        converter.attributes[i] = nullptr;
+        converter.attributeCounts[i] = 0;
+        converter.maxIndices[i] = 0;
+        converter.usedAttributes[i] = true;
+        converter.slotCounts[i] = 0;
+    }
+
+    bool success = true;
+
+    for (int i = 0; i < ATTRIBUTE_TYPE_COUNT && success; i++)
+        success = (converter.attributes[i] = createSpillFile(converter)) != nullptr;
+
+    success = success && (converter.triangles = createSpillFile(converter)) != nullptr;
+
+    // Stream OBJ file once, spilling attributes and triangles
+    if (success && !spillObjFile(inputFilename, converter)) {
+        std::cout << "Cannot read OBJ file " << inputFilename << "." << std::endl;
+        success = false;
+    }
+
+    statistics.positionCount = converter.attributeCounts[ATTRIBUTE_POSITION];
+    statistics.normalCount = converter.attributeCounts[ATTRIBUTE_NORMAL];
+    statistics.textureCoordinateCount = converter.attributeCounts[ATTRIBUTE_TEXTURE_COORDINATE];
+    statistics.triangleCount = converter.triangleCount;
+
+    // Partition triangles spatially and cut them in chunks
+    std::vector<SpillFile *> buckets;
+    std::vector<PendingCell> cells;
+
+    success = success
+        && bucketTriangles(converter, buckets)
+        && partitionTriangles(converter, buckets, cells)
+        && spillChunks(converter, cells);
+
+    // Gather chunk attributes, then build and write chunks
+    success = success && gatherAttributes(converter);
+
+    ChunkedMeshWriter writer;
+
+    if (success && !beginChunkedMesh(outputFilename, writer)) {
+        std::cout << "Cannot create chunked mesh " << outputFilename << "." << std::endl;
+        success = false;
+    }
+    else if (success) {
+        success = writeChunks(converter, writer);
+        success = endChunkedMesh(writer, success) && success;
+    }
+
+    statistics.chunkCount = converter.chunks.size();
+
+    deleteSpillFiles(converter);
+
+    return success;
+}
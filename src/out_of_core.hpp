@@ -0,0 +1,47 @@
+#ifndef CG20192_OUT_OF_CORE_HPP
+#define CG20192_OUT_OF_CORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Default memory budget and chunk size of the out-of-core converter
+const size_t DEFAULT_CONVERTER_MEMORY_BUDGET = (size_t)256 << 20;
+const size_t DEFAULT_CHUNK_TRIANGLE_COUNT = 65536;
+
+// Smallest memory budget accepted by the converter
+const size_t MIN_CONVERTER_MEMORY_BUDGET = (size_t)32 << 20;
+
+// Out-of-core converter settings
+// The memory budget bounds the attributes, triangles and file buffers held by every pass,
+// the chunk triangle count is lowered when chunks would not fit the budget
+struct ConverterSettings {
+    size_t memoryBudget;
+    size_t chunkTriangleCount;
+};
+
+// Out-of-core conversion counters
+struct ConverterStatistics {
+    uint64_t inputSize;
+    uint64_t positionCount;
+    uint64_t normalCount;
+    uint64_t textureCoordinateCount;
+    uint64_t triangleCount;
+    uint64_t chunkCount;
+    uint64_t spilledSize;
+    size_t maxSpillFileCount;
+};
+
+// Convert Wavefront OBJ file of any size to a chunked mesh file under a memory budget
+// The OBJ is streamed once, attributes and triangles are spilled to temporary files next to
+// the output, triangles are partitioned in an adaptive grid and cut in spatially compact chunks
+// along a Morton curve, then attributes are gathered per chunk with sequential passes
+// Every chunk is built, optimized and split in meshlets as an independent mesh
+// Normals and texture coordinates are kept only when every corner has them
+bool convertObjFile(
+        const std::string & inputFilename,
+        const std::string & outputFilename,
+        const ConverterSettings & settings,
+        ConverterStatistics & statistics);
+
+#endif
@@ -0,0 +1,136 @@
+#include "parallel.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Worker threads waiting for parallel loops
+// The calling thread always takes part in the loop as thread 0
+struct ThreadPool {
+    std::vector<std::thread> workers;
+
+    std::mutex dispatch;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(size_t, size_t)> * task;
+    size_t count;
+    std::atomic<size_t> next;
+
+    size_t generation;
+    size_t busy;
+    bool stop;
+
+    ThreadPool() : task(nullptr), count(0), next(0), generation(0), busy(0), stop(false) {
+        unsigned int threadCount = std::thread::hardware_concurrency();
+
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.push_back(std::thread(&ThreadPool::work, this, (size_t)i));
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+
+        wake.notify_all();
+
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    // Pull item indices until the current loop is exhausted
+    void run(size_t thread) {
+        size_t index;
+
+        while ((index = next.fetch_add(1)) < count)
+            (*task)(index, thread);
+    }
+
+    // Worker thread main loop
+    void work(size_t thread);
+};
+
+// Flag set while the current thread executes a parallel loop item
+thread_local bool INSIDE_PARALLEL_LOOP = false;
+
+void ThreadPool::work(size_t thread) {
+    INSIDE_PARALLEL_LOOP = true;
+
+    size_t seen = 0;
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stop || generation != seen; });
+
+        if (stop)
+            return;
+
+        seen = generation;
+        lock.unlock();
+
+        run(thread);
+
+        lock.lock();
+
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+ThreadPool & getThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+}
+
+size_t getThreadCount() {
+    return getThreadPool().workers.size() + 1;
+}
+
+void parallelFor(size_t count, const std::function<void(size_t index, size_t thread)> & task) {
+    if (count == 0)
+        return;
+
+    ThreadPool & pool = getThreadPool();
+
+    // Run serially for single items, nested loops or when another thread owns the pool
+    std::unique_lock<std::mutex> dispatch(pool.dispatch, std::defer_lock);
+
+    if (count == 1 || pool.workers.empty() || INSIDE_PARALLEL_LOOP || !dispatch.try_lock()) {
+        for (size_t i = 0; i < count; i++)
+            task(i, 0);
+
+        return;
+    }
+
+    // Publish loop and wake workers
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        pool.task = &task;
+        pool.count = count;
+        pool.next = 0;
+        pool.busy = pool.workers.size();
+        pool.generation++;
+    }
+
+    pool.wake.notify_all();
+
+    // Take part in the loop and wait for workers to finish
+    INSIDE_PARALLEL_LOOP = true;
+    pool.run(0);
+    INSIDE_PARALLEL_LOOP = false;
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done.wait(lock, [&] { return pool.busy == 0; });
+
+    pool.task = nullptr;
+}
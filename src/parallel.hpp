@@ -0,0 +1,17 @@
+#ifndef CG20192_PARALLEL_HPP
+#define CG20192_PARALLEL_HPP
+
+#include <cstddef>
+#include <functional>
+
+// Get number of threads used by parallel loops, including the calling thread
+size_t getThreadCount();
+
+// Run task for each index in [0, count) on a persistent pool of worker threads
+// Indices are dispatched dynamically in increasing order, so callers should pass
+// coarse-grained work items (chunks, tiles, blocks) rather than single elements
+// The task receives the item index and the index of the executing thread in [0, getThreadCount())
+// Nested or concurrent calls from other threads run serially on the calling thread
+void parallelFor(size_t count, const std::function<void(size_t index, size_t thread)> & task);
+
+#endif
@@ -0,0 +1,211 @@
+#include "profiler.hpp"
+#include "file.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+static_assert((PROFILER_THREAD_CAPACITY & (PROFILER_THREAD_CAPACITY - 1)) == 0, "Profiler capacity must be a power of two");
+
+namespace {
+
+struct ProfileEvent {
+    const char * name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Single producer ring buffer of zones recorded by one thread
+// The count is published after each zone is written, so readers never see a partial zone
+// unless the ring wraps around while it is read
+struct ThreadTrace {
+    std::vector<ProfileEvent> events;
+    std::atomic<uint64_t> count;
+
+    ThreadTrace() : events(PROFILER_THREAD_CAPACITY), count(0) {}
+};
+
+struct TrackEvent {
+    const char * track;
+    ProfileEvent event;
+};
+
+// Registered thread traces and zones of other clocks
+// Thread traces live until exit, so traces of finished threads are still written
+struct Profiler {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadTrace> > threads;
+
+    std::vector<TrackEvent> trackEvents;
+    size_t trackEventCount;
+
+    uint64_t startTicks;
+    uint64_t startNanoseconds;
+
+    Profiler() : trackEvents(PROFILER_THREAD_CAPACITY), trackEventCount(0) {
+        startNanoseconds = getProfilerNanoseconds();
+        startTicks = getProfilerTicks();
+    }
+};
+
+Profiler & getProfiler() {
+    static Profiler profiler;
+    return profiler;
+}
+
+// Get ring buffer of the calling thread, registering it on first use
+ThreadTrace & getThreadTrace() {
+    static thread_local ThreadTrace * trace = nullptr;
+
+    if (trace == nullptr) {
+        Profiler & profiler = getProfiler();
+        std::lock_guard<std::mutex> lock(profiler.mutex);
+
+        profiler.threads.push_back(std::unique_ptr<ThreadTrace>(new ThreadTrace()));
+        trace = profiler.threads.back().get();
+    }
+
+    return *trace;
+}
+
+void writeEvent(std::string & json, const char * name, int thread, double begin, double duration) {
+    char buffer[256];
+
+    std::snprintf(
+        buffer,
+        sizeof(buffer),
+        ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+        name,
+        thread,
+        begin,
+        duration);
+
+    json += buffer;
+}
+
+void writeThreadName(std::string & json, const char * name, int thread) {
+    char buffer[256];
+
+    std::snprintf(
+        buffer,
+        sizeof(buffer),
+        ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+        thread,
+        name);
+
+    json += buffer;
+}
+
+}
+
+uint64_t getProfilerNanoseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recordProfileZone(const char * name, uint64_t beginTicks, uint64_t endTicks) {
+    ThreadTrace & trace = getThreadTrace();
+
+    uint64_t index = trace.count.load(std::memory_order_relaxed);
+    ProfileEvent & event = trace.events[index & (PROFILER_THREAD_CAPACITY - 1)];
+
+    event.name = name;
+    event.begin = beginTicks;
+    event.end = endTicks;
+
+    trace.count.store(index + 1, std::memory_order_release);
+}
+
+void recordProfileTrackZone(const char * track, const char * name, uint64_t begin, uint64_t end) {
+    Profiler & profiler = getProfiler();
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+
+    TrackEvent & trackEvent = profiler.trackEvents[profiler.trackEventCount++ & (PROFILER_THREAD_CAPACITY - 1)];
+
+    trackEvent.track = track;
+    trackEvent.event.name = name;
+    trackEvent.event.begin = begin;
+    trackEvent.event.end = end;
+}
+
+bool writeProfileTrace(const std::string & filename) {
+    Profiler & profiler = getProfiler();
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+
+    // Calibrate ticks against the steady clock over the whole run
+    uint64_t endTicks = getProfilerTicks();
+    uint64_t endNanoseconds = getProfilerNanoseconds();
+
+    double nanosecondsPerTick = endTicks > profiler.startTicks
+        ? (double)(endNanoseconds - profiler.startNanoseconds) / (endTicks - profiler.startTicks)
+        : 1.0;
+
+    // Timestamps and durations are written in microseconds since profiler start
+    const double microsecondsPerTick = nanosecondsPerTick * 1e-3;
+
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"cg20192\"}}";
+
+    for (size_t i = 0; i < profiler.threads.size(); i++) {
+        const ThreadTrace & trace = *profiler.threads[i];
+
+        uint64_t count = trace.count.load(std::memory_order_acquire);
+        uint64_t first = count > PROFILER_THREAD_CAPACITY ? count - PROFILER_THREAD_CAPACITY : 0;
+
+        std::string name = "Thread " + std::to_string(i);
+        writeThreadName(json, name.c_str(), (int)i);
+
+        for (uint64_t j = first; j < count; j++) {
+            const ProfileEvent & event = trace.events[j & (PROFILER_THREAD_CAPACITY - 1)];
+
+            writeEvent(
+                json,
+                event.name,
+                (int)i,
+                ((double)event.begin - (double)profiler.startTicks) * microsecondsPerTick,
+                (double)(event.end - event.begin) * microsecondsPerTick);
+        }
+    }
+
+    // Tracks follow thread identifiers in order of first appearance
+    std::vector<const char *> tracks;
+
+    size_t firstTrackEvent = profiler.trackEventCount > PROFILER_THREAD_CAPACITY
+        ? profiler.trackEventCount - PROFILER_THREAD_CAPACITY
+        : 0;
+
+    for (size_t i = firstTrackEvent; i < profiler.trackEventCount; i++) {
+        const TrackEvent & trackEvent = profiler.trackEvents[i & (PROFILER_THREAD_CAPACITY - 1)];
+
+        size_t track = 0;
+
+        while (track < tracks.size() && std::string(tracks[track]) != trackEvent.track)
+            track++;
+
+        int thread = (int)(profiler.threads.size() + track);
+
+        if (track == tracks.size()) {
+            tracks.push_back(trackEvent.track);
+            writeThreadName(json, trackEvent.track, thread);
+        }
+
+        const ProfileEvent & event = trackEvent.event;
+
+        writeEvent(
+            json,
+            event.name,
+            thread,
+            ((double)event.begin - (double)profiler.startNanoseconds) * 1e-3,
+            (double)(event.end - event.begin) * 1e-3);
+    }
+
+    json += "\n]}\n";
+
+    const void * blocks[1] = { json.data() };
+    size_t sizes[1] = { json.size() };
+
+    return writeFileAtomic(filename, blocks, sizes, 1);
+}
@@ -0,0 +1,75 @@
+#ifndef CG20192_PROFILER_HPP
+#define CG20192_PROFILER_HPP
+
+#include <cstdint>
+#include <string>
+
+// Profiler zones are compiled in unless CG20192_PROFILER is defined as 0
+#ifndef CG20192_PROFILER
+#define CG20192_PROFILER 1
+#endif
+
+#if CG20192_PROFILER && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define CG20192_PROFILER_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+// Number of zones kept per thread, older zones are overwritten
+const size_t PROFILER_THREAD_CAPACITY = 1 << 16;
+
+// Read profiler clock in ticks
+// Ticks are CPU timestamp counter cycles on x86 and steady clock nanoseconds elsewhere,
+// converted to nanoseconds when the trace is written
+inline uint64_t getProfilerTicks() {
+#ifdef CG20192_PROFILER_TSC
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Get steady clock time in nanoseconds, the time base of the written trace
+uint64_t getProfilerNanoseconds();
+
+// Append zone to the ring buffer of the calling thread
+// Names must be string literals or otherwise outlive the profiler
+void recordProfileZone(const char * name, uint64_t beginTicks, uint64_t endTicks);
+
+// Append zone measured by another clock to a named track, such as GPU timer queries
+// Times are steady clock nanoseconds as returned by getProfilerNanoseconds
+void recordProfileTrackZone(const char * track, const char * name, uint64_t begin, uint64_t end);
+
+// Write recorded zones of all threads and tracks in Chrome trace event JSON format
+// Must be called while no other thread records zones
+bool writeProfileTrace(const std::string & filename);
+
+// Scoped zone measuring the lifetime of the object
+struct ProfileZone {
+    const char * name;
+    uint64_t begin;
+
+    explicit ProfileZone(const char * zoneName) : name(zoneName), begin(getProfilerTicks()) {}
+
+    ~ProfileZone() {
+        recordProfileZone(name, begin, getProfilerTicks());
+    }
+};
+
+#define CG20192_PROFILE_CONCATENATE_EXPANDED(a, b) a##b
+#define CG20192_PROFILE_CONCATENATE(a, b) CG20192_PROFILE_CONCATENATE_EXPANDED(a, b)
+
+// Record zone from this line to the end of the enclosing scope
+#if CG20192_PROFILER
+#define PROFILE_ZONE(name) ProfileZone CG20192_PROFILE_CONCATENATE(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#endif
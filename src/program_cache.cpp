@@ -0,0 +1,229 @@
+#include "program_cache.hpp"
+#include "file.hpp"
+#include "gl_utility.hpp"
+#include "profiler.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+// Program binary constants of OpenGL 4.1
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace {
+
+typedef void (APIENTRYP GetProgramBinaryProcedure)(
+    GLuint program, GLsizei bufferSize, GLsizei * length, GLenum * binaryFormat, void * binary);
+typedef void (APIENTRYP ProgramBinaryProcedure)(
+    GLuint program, GLenum binaryFormat, const void * binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProcedure)(GLuint program, GLenum name, GLint value);
+
+GetProgramBinaryProcedure getProgramBinary = nullptr;
+ProgramBinaryProcedure programBinary = nullptr;
+ProgramParameteriProcedure programParameteri = nullptr;
+
+// File identification and format version
+const char PROGRAM_CACHE_MAGIC[8] = { 'C', 'G', 'P', 'R', 'O', 'G', '\0', '\0' };
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// Program cache file header followed by the driver binary, stored in native byte order
+struct ProgramCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint64_t sourceHash;
+    uint64_t binarySize;
+};
+
+static_assert(sizeof(ProgramCacheHeader) == 32, "Unexpected program cache header padding");
+
+std::string getString(GLenum name) {
+    const char * value = (const char *)glGetString(name);
+    return value != nullptr ? value : "";
+}
+
+}
+
+std::string getShaderDefines(uint32_t variant) {
+    std::string defines;
+
+    if (variant & SHADER_TEXTURED)
+        defines += "#define TEXTURED\n";
+
+    if (variant & SHADER_NORMALS)
+        defines += "#define NORMALS\n";
+
+    if (variant & SHADER_SPECULAR)
+        defines += "#define SPECULAR\n";
+
+    if (variant & SHADER_VIRTUAL_TEXTURE)
+        defines += "#define VIRTUAL_TEXTURE\n";
+
+    if (variant & SHADER_VIRTUAL_FEEDBACK)
+        defines += "#define VIRTUAL_FEEDBACK\n";
+
+    return defines;
+}
+
+std::string injectShaderDefines(const std::string & source, const std::string & defines) {
+    size_t version = source.find("#version");
+
+    if (version == std::string::npos)
+        return defines + source;
+
+    size_t lineEnd = source.find('\n', version);
+
+    if (lineEnd == std::string::npos)
+        return source + "\n" + defines;
+
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+bool loadProgramBinaryProcedures(GLADloadproc load) {
+    getProgramBinary = nullptr;
+    programBinary = nullptr;
+    programParameteri = nullptr;
+
+    if (!hasVersionOrExtension(4, 1, "GL_ARB_get_program_binary"))
+        return false;
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+    if (formatCount <= 0)
+        return false;
+
+    getProgramBinary = (GetProgramBinaryProcedure)load("glGetProgramBinary");
+    programBinary = (ProgramBinaryProcedure)load("glProgramBinary");
+    programParameteri = (ProgramParameteriProcedure)load("glProgramParameteri");
+
+    if (!isProgramBinarySupported()) {
+        getProgramBinary = nullptr;
+        programBinary = nullptr;
+        programParameteri = nullptr;
+
+        return false;
+    }
+
+    return true;
+}
+
+bool isProgramBinarySupported() {
+    return getProgramBinary != nullptr && programBinary != nullptr && programParameteri != nullptr;
+}
+
+uint64_t hashProgramSources(const std::string & vertexSource, const std::string & fragmentSource) {
+    std::string driver = getString(GL_VENDOR) + "\n" + getString(GL_RENDERER) + "\n" + getString(GL_VERSION);
+
+    uint64_t hash = hashData(driver.data(), driver.size(), 0);
+    hash = hashData(vertexSource.data(), vertexSource.size(), hash);
+    hash = hashData(fragmentSource.data(), fragmentSource.size(), hash);
+
+    return hash;
+}
+
+std::string getProgramCacheFilename(const std::string & name, uint32_t variant) {
+    std::ostringstream filename;
+    filename << name << ".variant" << variant << ".cgprogram";
+
+    return filename.str();
+}
+
+void setProgramRetrievable(GLuint id) {
+    if (isProgramBinarySupported())
+        programParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool readProgramCache(const std::string & filename, uint64_t sourceHash, GLuint & id) {
+    PROFILE_ZONE("readProgramCache");
+
+    if (!isProgramBinarySupported())
+        return false;
+
+    MappedFile file;
+
+    if (!openMappedFile(filename, file))
+        return false;
+
+    ProgramCacheHeader header;
+
+    bool valid = file.size >= sizeof(header);
+
+    if (valid) {
+        std::memcpy(&header, file.data, sizeof(header));
+
+        valid = std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) == 0
+            && header.version == PROGRAM_CACHE_VERSION
+            && header.sourceHash == sourceHash
+            && header.binarySize > 0
+            && header.binarySize == file.size - sizeof(header);
+    }
+
+    if (!valid) {
+        closeMappedFile(file);
+        return false;
+    }
+
+    // Drivers reject binaries after updates, even with an unchanged version string
+    GLuint programID = glCreateProgram();
+
+    programBinary(programID, header.binaryFormat, file.data + sizeof(header), (GLsizei)header.binarySize);
+
+    closeMappedFile(file);
+
+    GLint status;
+    glGetProgramiv(programID, GL_LINK_STATUS, &status);
+
+    if (status != GL_TRUE) {
+        glDeleteProgram(programID);
+        return false;
+    }
+
+    id = programID;
+
+    return true;
+}
+
+bool writeProgramCache(const std::string & filename, uint64_t sourceHash, GLuint id) {
+    PROFILE_ZONE("writeProgramCache");
+
+    if (!isProgramBinarySupported())
+        return false;
+
+    GLint size = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &size);
+
+    if (size <= 0)
+        return false;
+
+    std::vector<char> binary((size_t)size);
+    GLsizei length = 0;
+    GLenum binaryFormat = 0;
+
+    getProgramBinary(id, size, &length, &binaryFormat, binary.data());
+
+    if (length <= 0)
+        return false;
+
+    ProgramCacheHeader header;
+    std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.binaryFormat = binaryFormat;
+    header.sourceHash = sourceHash;
+    header.binarySize = (uint64_t)length;
+
+    const void * blocks[] = { &header, binary.data() };
+    size_t sizes[] = { sizeof(header), (size_t)length };
+
+    return writeFileAtomic(filename, blocks, sizes, sizeof(sizes) / sizeof(sizes[0]));
+}
@@ -0,0 +1,55 @@
+#ifndef CG20192_PROGRAM_CACHE_HPP
+#define CG20192_PROGRAM_CACHE_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+
+// Shader variant bits, each one enables a #define injected into the shader sources
+// TEXTURED: modulate material color by the texture
+// NORMALS: interpolate vertex normals, otherwise faces are shaded flat from position derivatives
+// SPECULAR: add normalized Blinn-Phong specular with the material exponent
+// VIRTUAL_TEXTURE: sample the texture through the indirection table of a virtual texture
+// VIRTUAL_FEEDBACK: write the virtual texture pages sampled by fragments instead of shading them
+const uint32_t SHADER_TEXTURED = 1;
+const uint32_t SHADER_NORMALS = 2;
+const uint32_t SHADER_SPECULAR = 4;
+const uint32_t SHADER_VIRTUAL_TEXTURE = 8;
+const uint32_t SHADER_VIRTUAL_FEEDBACK = 16;
+
+// Number of shader variants, all combinations of variant bits
+const uint32_t SHADER_VARIANT_COUNT = 32;
+
+// Get #define lines of shader variant
+std::string getShaderDefines(uint32_t variant);
+
+// Insert lines after the #version directive, which must stay first
+std::string injectShaderDefines(const std::string & source, const std::string & defines);
+
+// Load program binary procedures missing from the OpenGL 3.3 loader
+// Fails when neither OpenGL 4.1 nor GL_ARB_get_program_binary is available
+// or the driver exposes no binary format, then programs are always compiled
+bool loadProgramBinaryProcedures(GLADloadproc load);
+
+// Check whether linked programs can be saved and reloaded
+bool isProgramBinarySupported();
+
+// Hash program sources with the driver vendor, renderer and version,
+// as binaries are only valid for the driver that produced them
+uint64_t hashProgramSources(const std::string & vertexSource, const std::string & fragmentSource);
+
+// Get program cache filename of shader variant stored next to the shader sources
+std::string getProgramCacheFilename(const std::string & name, uint32_t variant);
+
+// Mark program to be linked as retrievable, call before linking
+void setProgramRetrievable(GLuint id);
+
+// Create program from cache file matching the source hash
+// Fails when the file is missing or stale, or the driver rejects the binary
+bool readProgramCache(const std::string & filename, uint64_t sourceHash, GLuint & id);
+
+// Write binary of linked program to cache file
+bool writeProgramCache(const std::string & filename, uint64_t sourceHash, GLuint id);
+
+#endif
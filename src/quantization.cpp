@@ -0,0 +1,123 @@
+#include "quantization.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+static_assert(sizeof(QuantizedVertex) == 16, "Unexpected quantized vertex padding");
+
+namespace {
+
+inline float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+inline int16_t quantizeSnorm(float value) {
+    return (int16_t)std::floor(glm::clamp(value, -1.0f, 1.0f) * 32767.0f + 0.5f);
+}
+
+inline float dequantizeSnorm(int16_t value) {
+    return std::max(value / 32767.0f, -1.0f);
+}
+
+// Map unit vector to the octahedron unfolded over the unit square [-1, 1]^2
+glm::vec2 encodeOctahedral(const glm::vec3 & normal) {
+    glm::vec3 n = normal / (std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z));
+
+    if (n.z < 0.0f)
+        return glm::vec2(
+            (1.0f - std::fabs(n.y)) * signNotZero(n.x),
+            (1.0f - std::fabs(n.x)) * signNotZero(n.y));
+
+    return glm::vec2(n.x, n.y);
+}
+
+// Map octahedral coordinates back to unit vector, matching the vertex shader decoding
+glm::vec3 decodeOctahedral(const glm::vec2 & encoded) {
+    glm::vec3 n(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+    float t = std::max(-n.z, 0.0f);
+
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    return glm::normalize(n);
+}
+
+}
+
+size_t getVertexSize(VertexFormat format) {
+    return format == VERTEX_FORMAT_QUANTIZED ? sizeof(QuantizedVertex) : sizeof(Vertex);
+}
+
+void quantizeVertices(
+        const Vertex * vertices,
+        size_t vertexCount,
+        const BoundingBox & bounds,
+        std::vector<QuantizedVertex> & quantizedVertices,
+        glm::mat4 & dequantization,
+        QuantizationError & error) {
+    // Uniform scale over the largest extent
+    glm::vec3 extent = bounds.max - bounds.min;
+    float scale = std::max(std::max(extent.x, extent.y), extent.z);
+
+    if (scale <= 0.0f)
+        scale = 1.0f;
+
+    float inverseScale = 1.0f / scale;
+
+    dequantization = glm::scale(glm::translate(glm::mat4(1.0f), bounds.min), glm::vec3(scale));
+
+    error.position = 0.0f;
+    error.normal = 0.0f;
+    error.textureCoordinate = 0.0f;
+
+    quantizedVertices.resize(vertexCount);
+
+    float minimumCosine = 1.0f;
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        const Vertex & vertex = vertices[i];
+        QuantizedVertex & quantized = quantizedVertices[i];
+
+        // Quantize position to 16-bit unsigned normalized integers
+        glm::vec3 position = glm::clamp((vertex.position - bounds.min) * inverseScale, 0.0f, 1.0f);
+
+        for (int j = 0; j < 3; j++) {
+            quantized.position[j] = (uint16_t)std::floor(position[j] * 65535.0f + 0.5f);
+
+            float decoded = bounds.min[j] + quantized.position[j] / 65535.0f * scale;
+            error.position = std::max(error.position, std::fabs(decoded - vertex.position[j]));
+        }
+
+        quantized.position[3] = 0;
+
+        // Encode normal in octahedral mapping
+        float length = glm::length(vertex.normal);
+        glm::vec3 normal = length > 0.0f ? vertex.normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        glm::vec2 encoded = encodeOctahedral(normal);
+
+        quantized.normal[0] = quantizeSnorm(encoded.x);
+        quantized.normal[1] = quantizeSnorm(encoded.y);
+
+        glm::vec3 decodedNormal = decodeOctahedral(glm::vec2(
+            dequantizeSnorm(quantized.normal[0]),
+            dequantizeSnorm(quantized.normal[1])));
+
+        minimumCosine = std::min(minimumCosine, glm::dot(normal, decodedNormal));
+
+        // Convert texture coordinate to half floats
+        for (int j = 0; j < 2; j++) {
+            quantized.textureCoordinate[j] = glm::packHalf1x16(vertex.textureCoordinate[j]);
+
+            float decoded = glm::unpackHalf1x16(quantized.textureCoordinate[j]);
+            error.textureCoordinate = std::max(
+                error.textureCoordinate,
+                std::fabs(decoded - vertex.textureCoordinate[j]));
+        }
+    }
+
+    error.normal = glm::degrees(std::acos(glm::clamp(minimumCosine, -1.0f, 1.0f)));
+}
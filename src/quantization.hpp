@@ -0,0 +1,49 @@
+#ifndef CG20192_QUANTIZATION_HPP
+#define CG20192_QUANTIZATION_HPP
+
+#include "mesh.hpp"
+
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Vertex layouts uploaded to OpenGL
+enum VertexFormat {
+    VERTEX_FORMAT_FLOAT,
+    VERTEX_FORMAT_QUANTIZED
+};
+
+// Compressed interleaved vertex attributes (16 bytes)
+// Positions are 16-bit unsigned normalized against the bounding box with a uniform scale,
+// normals are octahedral encoded in 16-bit signed normalized integers
+// and texture coordinates are half floats
+struct QuantizedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t textureCoordinate[2];
+};
+
+// Maximum errors introduced by quantization
+// Position error is measured in object space units and normal error in degrees
+struct QuantizationError {
+    float position;
+    float normal;
+    float textureCoordinate;
+};
+
+// Get vertex size in bytes of vertex format
+size_t getVertexSize(VertexFormat format);
+
+// Quantize vertices against bounding box
+// The dequantization matrix maps normalized positions back to object space and is meant
+// to be folded into the model matrix, its uniform scale keeps normal transformations valid
+void quantizeVertices(
+        const Vertex * vertices,
+        size_t vertexCount,
+        const BoundingBox & bounds,
+        std::vector<QuantizedVertex> & quantizedVertices,
+        glm::mat4 & dequantization,
+        QuantizationError & error);
+
+#endif
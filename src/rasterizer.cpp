@@ -0,0 +1,625 @@
+#include "rasterizer.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Number of vertices or triangles processed by each parallel task
+const size_t VERTEX_BLOCK_SIZE = 4096;
+const size_t TRIANGLE_BLOCK_SIZE = 4096;
+
+const float INV_PI = 0.31830988618379067154f;
+
+// Specular reflectance at normal incidence of dielectrics
+const float F0 = 0.04f;
+
+// Vertex shader outputs with clip space position
+struct ShadedVertex {
+    glm::vec4 position;
+    glm::vec3 worldPosition;
+    glm::vec3 normal;
+    glm::vec2 textureCoordinate;
+};
+
+// Triangle set up for rasterization
+// Edge functions are normalized by the triangle area, so they evaluate to barycentric coordinates
+// at pixel centers, and attributes are interpolated with the inverse clip space w
+struct RasterTriangle {
+    float edgeX[3];
+    float edgeY[3];
+    float edgeConstant[3];
+    float depth[3];
+    float inverseW[3];
+    glm::vec3 worldPosition[3];
+    glm::vec3 normal[3];
+    glm::vec2 textureCoordinate[3];
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+};
+
+// Triangles of a block of the index buffer with the triangles overlapping each tile
+struct TriangleBin {
+    std::vector<RasterTriangle> triangles;
+    std::vector<std::vector<uint32_t> > tiles;
+};
+
+// Per thread depth and visible triangle of each tile pixel
+struct TileBuffer {
+    std::vector<float> depths;
+    std::vector<const RasterTriangle *> triangles;
+};
+
+ShadedVertex interpolateVertex(const ShadedVertex & a, const ShadedVertex & b, float t) {
+    ShadedVertex vertex;
+
+    vertex.position = glm::mix(a.position, b.position, t);
+    vertex.worldPosition = glm::mix(a.worldPosition, b.worldPosition, t);
+    vertex.normal = glm::mix(a.normal, b.normal, t);
+    vertex.textureCoordinate = glm::mix(a.textureCoordinate, b.textureCoordinate, t);
+
+    return vertex;
+}
+
+// Clip polygon against the near plane z = -w
+// Returns the number of output vertices, at most one more than the input
+size_t clipNearPlane(const ShadedVertex * input, size_t count, ShadedVertex * output) {
+    size_t outputCount = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const ShadedVertex & a = input[i];
+        const ShadedVertex & b = input[(i + 1) % count];
+
+        float distanceA = a.position.z + a.position.w;
+        float distanceB = b.position.z + b.position.w;
+
+        if (distanceA >= 0.0f)
+            output[outputCount++] = a;
+
+        if ((distanceA >= 0.0f) != (distanceB >= 0.0f))
+            output[outputCount++] = interpolateVertex(a, b, distanceA / (distanceA - distanceB));
+    }
+
+    return outputCount;
+}
+
+// Project triangle to screen space and compute its edge functions
+// Returns false for degenerate triangles and triangles covering no pixel center
+bool setupTriangle(
+        const ShadedVertex & a,
+        const ShadedVertex & b,
+        const ShadedVertex & c,
+        size_t width,
+        size_t height,
+        RasterTriangle & triangle) {
+    const ShadedVertex * vertices[3] = { &a, &b, &c };
+    float x[3], y[3];
+
+    for (size_t i = 0; i < 3; i++) {
+        const ShadedVertex & vertex = *vertices[i];
+        float inverseW = 1.0f / vertex.position.w;
+
+        // Rows are stored top to bottom
+        x[i] = (vertex.position.x * inverseW * 0.5f + 0.5f) * width;
+        y[i] = (0.5f - vertex.position.y * inverseW * 0.5f) * height;
+
+        triangle.depth[i] = vertex.position.z * inverseW * 0.5f + 0.5f;
+        triangle.inverseW[i] = inverseW;
+        triangle.worldPosition[i] = vertex.worldPosition;
+        triangle.normal[i] = vertex.normal;
+        triangle.textureCoordinate[i] = vertex.textureCoordinate;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+
+    if (area == 0.0f || !std::isfinite(area))
+        return false;
+
+    // Orient edges so inside pixels are positive for both windings
+    float inverseArea = 1.0f / area;
+
+    for (size_t i = 0; i < 3; i++) {
+        size_t j = (i + 1) % 3;
+        size_t k = (i + 2) % 3;
+
+        triangle.edgeX[i] = (y[j] - y[k]) * inverseArea;
+        triangle.edgeY[i] = (x[k] - x[j]) * inverseArea;
+        triangle.edgeConstant[i] = (x[j] * y[k] - x[k] * y[j]) * inverseArea;
+    }
+
+    // Bounds of covered pixel centers clamped to the viewport (maximum exclusive)
+    float minX = std::min(std::min(x[0], x[1]), x[2]);
+    float minY = std::min(std::min(y[0], y[1]), y[2]);
+    float maxX = std::max(std::max(x[0], x[1]), x[2]);
+    float maxY = std::max(std::max(y[0], y[1]), y[2]);
+
+    triangle.minX = (int)std::max(std::ceil(minX - 0.5f), 0.0f);
+    triangle.minY = (int)std::max(std::ceil(minY - 0.5f), 0.0f);
+    triangle.maxX = (int)std::min(std::floor(maxX - 0.5f) + 1.0f, (float)width);
+    triangle.maxY = (int)std::min(std::floor(maxY - 0.5f) + 1.0f, (float)height);
+
+    return triangle.minX < triangle.maxX && triangle.minY < triangle.maxY;
+}
+
+// Check if triangle lies entirely outside one of the side or far planes of the view frustum
+bool isOutsideFrustum(const ShadedVertex & a, const ShadedVertex & b, const ShadedVertex & c) {
+    const glm::vec4 * positions[3] = { &a.position, &b.position, &c.position };
+
+    for (int axis = 0; axis < 3; axis++) {
+        bool outsideMin = true;
+        bool outsideMax = true;
+
+        for (size_t i = 0; i < 3; i++) {
+            const glm::vec4 & position = *positions[i];
+
+            outsideMin = outsideMin && position[axis] < -position.w;
+            outsideMax = outsideMax && position[axis] > position.w;
+        }
+
+        if ((outsideMin && axis < 2) || outsideMax)
+            return true;
+    }
+
+    return false;
+}
+
+// Write depth and triangle of tile pixels covered by triangle and passing the depth test
+void rasterizeTriangle(
+        const RasterTriangle & triangle,
+        int tileX,
+        int tileY,
+        int tileWidth,
+        int tileHeight,
+        TileBuffer & buffer) {
+    int beginX = std::max(triangle.minX - tileX, 0) & ~3;
+    int beginY = std::max(triangle.minY - tileY, 0);
+    int endX = std::min(triangle.maxX - tileX, tileWidth);
+    int endY = std::min(triangle.maxY - tileY, tileHeight);
+
+    for (int y = beginY; y < endY; y++) {
+        float centerY = tileY + y + 0.5f;
+
+        float rowBarycentrics[3];
+
+        for (size_t i = 0; i < 3; i++)
+            rowBarycentrics[i] = triangle.edgeY[i] * centerY + triangle.edgeConstant[i];
+
+        float * depths = &buffer.depths[y * RASTERIZER_TILE_SIZE];
+        const RasterTriangle ** triangles = &buffer.triangles[y * RASTERIZER_TILE_SIZE];
+
+        int x = beginX;
+
+#ifdef CG20192_SSE2
+        // Evaluate edge functions and depth of 4 pixels per iteration
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+        __m128 edgeX[3], row[3], depth[3];
+
+        for (size_t i = 0; i < 3; i++) {
+            edgeX[i] = _mm_set1_ps(triangle.edgeX[i]);
+            row[i] = _mm_set1_ps(rowBarycentrics[i]);
+            depth[i] = _mm_set1_ps(triangle.depth[i]);
+        }
+
+        for (; x < endX; x += 4) {
+            __m128 centerX = _mm_add_ps(_mm_set1_ps((float)(tileX + x)), offsets);
+
+            __m128 b0 = _mm_add_ps(_mm_mul_ps(edgeX[0], centerX), row[0]);
+            __m128 b1 = _mm_add_ps(_mm_mul_ps(edgeX[1], centerX), row[1]);
+            __m128 b2 = _mm_add_ps(_mm_mul_ps(edgeX[2], centerX), row[2]);
+
+            __m128 mask = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(b0, zero), _mm_cmpge_ps(b1, zero)),
+                _mm_cmpge_ps(b2, zero));
+
+            if (_mm_movemask_ps(mask) == 0)
+                continue;
+
+            __m128 z = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(b0, depth[0]), _mm_mul_ps(b1, depth[1])),
+                _mm_mul_ps(b2, depth[2]));
+
+            __m128 previous = _mm_loadu_ps(depths + x);
+            mask = _mm_and_ps(mask, _mm_cmplt_ps(z, previous));
+
+            int bits = _mm_movemask_ps(mask);
+
+            if (bits == 0)
+                continue;
+
+            _mm_storeu_ps(depths + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, previous)));
+
+            for (int k = 0; k < 4; k++) {
+                if (bits & (1 << k))
+                    triangles[x + k] = &triangle;
+            }
+        }
+#else
+        for (; x < endX; x++) {
+            float centerX = tileX + x + 0.5f;
+
+            float b0 = triangle.edgeX[0] * centerX + rowBarycentrics[0];
+            float b1 = triangle.edgeX[1] * centerX + rowBarycentrics[1];
+            float b2 = triangle.edgeX[2] * centerX + rowBarycentrics[2];
+
+            if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+                continue;
+
+            float z = b0 * triangle.depth[0] + b1 * triangle.depth[1] + b2 * triangle.depth[2];
+
+            if (z < depths[x]) {
+                depths[x] = z;
+                triangles[x] = &triangle;
+            }
+        }
+#endif
+    }
+}
+
+// Sample texture with bilinear filtering and repeat wrapping as OpenGL
+glm::vec3 sampleTexture(const RasterizerTexture & texture, glm::vec2 textureCoordinate) {
+    if (texture.texels.empty())
+        return glm::vec3(1.0f);
+
+    float s = textureCoordinate.x * texture.width - 0.5f;
+    float t = textureCoordinate.y * texture.height - 0.5f;
+
+    float floorS = std::floor(s);
+    float floorT = std::floor(t);
+
+    float u = s - floorS;
+    float v = t - floorT;
+
+    long long width = (long long)texture.width;
+    long long height = (long long)texture.height;
+
+    long long x0 = (long long)floorS % width;
+    long long y0 = (long long)floorT % height;
+
+    if (x0 < 0)
+        x0 += width;
+
+    if (y0 < 0)
+        y0 += height;
+
+    long long x1 = x0 + 1 < width ? x0 + 1 : 0;
+    long long y1 = y0 + 1 < height ? y0 + 1 : 0;
+
+    const glm::vec3 * row0 = &texture.texels[y0 * texture.width];
+    const glm::vec3 * row1 = &texture.texels[y1 * texture.width];
+
+    return glm::mix(
+        glm::mix(row0[x0], row0[x1], u),
+        glm::mix(row1[x0], row1[x1], u),
+        v);
+}
+
+// Interpolated fragment shader inputs and sampled texture color
+struct Fragment {
+    glm::vec3 worldPosition;
+    glm::vec3 normal;
+    glm::vec3 color;
+};
+
+void interpolateFragment(
+        const RasterTriangle & triangle,
+        float centerX,
+        float centerY,
+        const RasterizerTexture & texture,
+        Fragment & fragment) {
+    // Perspective correct barycentric coordinates
+    float weights[3];
+    float sum = 0.0f;
+
+    for (size_t i = 0; i < 3; i++) {
+        float barycentric = triangle.edgeX[i] * centerX
+            + triangle.edgeY[i] * centerY
+            + triangle.edgeConstant[i];
+
+        weights[i] = std::max(barycentric, 0.0f) * triangle.inverseW[i];
+        sum += weights[i];
+    }
+
+    for (size_t i = 0; i < 3; i++)
+        weights[i] /= sum;
+
+    glm::vec2 textureCoordinate =
+        triangle.textureCoordinate[0] * weights[0]
+        + triangle.textureCoordinate[1] * weights[1]
+        + triangle.textureCoordinate[2] * weights[2];
+
+    fragment.worldPosition =
+        triangle.worldPosition[0] * weights[0]
+        + triangle.worldPosition[1] * weights[1]
+        + triangle.worldPosition[2] * weights[2];
+
+    fragment.normal =
+        triangle.normal[0] * weights[0]
+        + triangle.normal[1] * weights[1]
+        + triangle.normal[2] * weights[2];
+
+    fragment.color = sampleTexture(texture, glm::vec2(textureCoordinate.x, -textureCoordinate.y));
+}
+
+inline unsigned char quantizeColor(float value) {
+    return (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// Get normalized Blinn-Phong specular reflectance of fragment, zero without exponent
+// Normalization keeps reflected energy constant across exponents
+inline float getSpecular(const Fragment & fragment, const RasterizerUniforms & uniforms) {
+    if (uniforms.exponent <= 0.0f || glm::dot(fragment.normal, fragment.normal) <= 0.0f)
+        return 0.0f;
+
+    glm::vec3 normal = glm::normalize(fragment.normal);
+    glm::vec3 light = glm::normalize(uniforms.lightPosition - fragment.worldPosition);
+    glm::vec3 view = glm::normalize(uniforms.cameraPosition - fragment.worldPosition);
+    glm::vec3 half = glm::normalize(light + view);
+
+    float normalization = (uniforms.exponent + 8.0f) * INV_PI / 8.0f;
+
+    return F0 * normalization * std::pow(std::max(glm::dot(normal, half), 0.0f), uniforms.exponent);
+}
+
+// Shade visible pixels of tile with the Lambert model and normalized Blinn-Phong specular
+// of the blinn_phong shader program and write them to image
+void shadeTile(
+        const TileBuffer & buffer,
+        int tileX,
+        int tileY,
+        int tileWidth,
+        int tileHeight,
+        const RasterizerUniforms & uniforms,
+        const RasterizerTexture & texture,
+        Image & image) {
+    glm::vec3 radiance = uniforms.materialColor * uniforms.lightColor * INV_PI;
+
+    unsigned char clearColor[3];
+
+    for (int c = 0; c < 3; c++)
+        clearColor[c] = quantizeColor(uniforms.clearColor[c]);
+
+    for (int y = 0; y < tileHeight; y++) {
+        const RasterTriangle * const * triangles = &buffer.triangles[y * RASTERIZER_TILE_SIZE];
+        unsigned char * pixels = &image.pixels[((tileY + y) * image.width + tileX) * 3];
+
+        for (int x = 0; x < tileWidth; x += 4) {
+            int laneCount = std::min(tileWidth - x, 4);
+            int coverage = 0;
+
+            for (int k = 0; k < laneCount; k++) {
+                if (triangles[x + k] != nullptr)
+                    coverage |= 1 << k;
+            }
+
+            if (coverage == 0) {
+                for (int k = 0; k < laneCount; k++)
+                    std::memcpy(&pixels[(x + k) * 3], clearColor, 3);
+
+                continue;
+            }
+
+            // Gather fragments in structure of arrays layout
+            float positions[3][4], normals[3][4], colors[3][4], speculars[4];
+
+            for (int k = 0; k < 4; k++) {
+                Fragment fragment;
+
+                if (coverage & (1 << k))
+                    interpolateFragment(
+                        *triangles[x + k],
+                        tileX + x + k + 0.5f,
+                        tileY + y + 0.5f,
+                        texture,
+                        fragment);
+                else {
+                    fragment.worldPosition = uniforms.lightPosition + glm::vec3(1.0f);
+                    fragment.normal = glm::vec3(0.0f);
+                    fragment.color = glm::vec3(0.0f);
+                }
+
+                for (int c = 0; c < 3; c++) {
+                    positions[c][k] = fragment.worldPosition[c];
+                    normals[c][k] = fragment.normal[c];
+                    colors[c][k] = fragment.color[c];
+                }
+
+                speculars[k] = coverage & (1 << k) ? getSpecular(fragment, uniforms) : 0.0f;
+            }
+
+            float results[3][4];
+
+#ifdef CG20192_SSE2
+            // Shade 4 pixels per iteration
+            __m128 lightX = _mm_sub_ps(_mm_set1_ps(uniforms.lightPosition.x), _mm_loadu_ps(positions[0]));
+            __m128 lightY = _mm_sub_ps(_mm_set1_ps(uniforms.lightPosition.y), _mm_loadu_ps(positions[1]));
+            __m128 lightZ = _mm_sub_ps(_mm_set1_ps(uniforms.lightPosition.z), _mm_loadu_ps(positions[2]));
+
+            __m128 distance2 = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(lightX, lightX), _mm_mul_ps(lightY, lightY)),
+                _mm_mul_ps(lightZ, lightZ));
+
+            __m128 inverseDistance2 = _mm_div_ps(_mm_set1_ps(1.0f), distance2);
+
+            __m128 cosine = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(normals[0]), lightX),
+                    _mm_mul_ps(_mm_loadu_ps(normals[1]), lightY)),
+                _mm_mul_ps(_mm_loadu_ps(normals[2]), lightZ));
+
+            cosine = _mm_max_ps(_mm_mul_ps(cosine, _mm_sqrt_ps(inverseDistance2)), _mm_setzero_ps());
+
+            __m128 factor = _mm_mul_ps(inverseDistance2, cosine);
+
+            __m128 specular = _mm_loadu_ps(speculars);
+
+            for (int c = 0; c < 3; c++) {
+                __m128 reflectance = _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(colors[c]), _mm_set1_ps(radiance[c])),
+                    _mm_mul_ps(specular, _mm_set1_ps(uniforms.lightColor[c])));
+
+                _mm_storeu_ps(results[c], _mm_mul_ps(reflectance, factor));
+            }
+#else
+            for (int k = 0; k < 4; k++) {
+                glm::vec3 light = uniforms.lightPosition
+                    - glm::vec3(positions[0][k], positions[1][k], positions[2][k]);
+
+                float inverseDistance2 = 1.0f / glm::dot(light, light);
+
+                glm::vec3 normal(normals[0][k], normals[1][k], normals[2][k]);
+                float cosine = std::max(glm::dot(normal, light) * std::sqrt(inverseDistance2), 0.0f);
+
+                for (int c = 0; c < 3; c++)
+                    results[c][k] = (colors[c][k] * radiance[c] + speculars[k] * uniforms.lightColor[c])
+                        * inverseDistance2 * cosine;
+            }
+#endif
+
+            for (int k = 0; k < laneCount; k++) {
+                if (coverage & (1 << k)) {
+                    for (int c = 0; c < 3; c++)
+                        pixels[(x + k) * 3 + c] = quantizeColor(results[c][k]);
+                }
+                else
+                    std::memcpy(&pixels[(x + k) * 3], clearColor, 3);
+            }
+        }
+    }
+}
+
+}
+
+void renderTriangles(
+        const Vertex * vertices,
+        size_t vertexCount,
+        const uint32_t * indices,
+        size_t indexCount,
+        const RasterizerUniforms & uniforms,
+        const RasterizerTexture & texture,
+        size_t width,
+        size_t height,
+        Image & image) {
+    PROFILE_ZONE("renderTriangles");
+
+    image.width = width;
+    image.height = height;
+    image.channelCount = 3;
+    image.channelSize = 1;
+    image.pixels.resize(width * height * 3);
+
+    // Transform vertices as the vertex shader
+    std::vector<ShadedVertex> shadedVertices(vertexCount);
+
+    glm::mat4 viewProjection = uniforms.projection * uniforms.view;
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(uniforms.model)));
+
+    size_t vertexBlockCount = (vertexCount + VERTEX_BLOCK_SIZE - 1) / VERTEX_BLOCK_SIZE;
+
+    parallelFor(vertexBlockCount, [&](size_t block, size_t) {
+        PROFILE_ZONE("shadeVertices");
+
+        size_t end = std::min((block + 1) * VERTEX_BLOCK_SIZE, vertexCount);
+
+        for (size_t i = block * VERTEX_BLOCK_SIZE; i < end; i++) {
+            const Vertex & vertex = vertices[i];
+            ShadedVertex & shadedVertex = shadedVertices[i];
+
+            glm::vec4 position = uniforms.model * glm::vec4(vertex.position, 1.0f);
+
+            shadedVertex.worldPosition = glm::vec3(position);
+            shadedVertex.normal = glm::normalize(normalMatrix * vertex.normal);
+            shadedVertex.textureCoordinate = vertex.textureCoordinate;
+            shadedVertex.position = viewProjection * position;
+        }
+    });
+
+    // Set up triangles and bin them in the tiles they overlap
+    size_t tileCountX = (width + RASTERIZER_TILE_SIZE - 1) / RASTERIZER_TILE_SIZE;
+    size_t tileCountY = (height + RASTERIZER_TILE_SIZE - 1) / RASTERIZER_TILE_SIZE;
+    size_t tileCount = tileCountX * tileCountY;
+
+    size_t triangleCount = indexCount / 3;
+    size_t triangleBlockCount = (triangleCount + TRIANGLE_BLOCK_SIZE - 1) / TRIANGLE_BLOCK_SIZE;
+
+    std::vector<TriangleBin> bins(triangleBlockCount);
+
+    parallelFor(triangleBlockCount, [&](size_t block, size_t) {
+        PROFILE_ZONE("binTriangles");
+
+        size_t end = std::min((block + 1) * TRIANGLE_BLOCK_SIZE, triangleCount);
+        TriangleBin & bin = bins[block];
+
+        bin.tiles.resize(tileCount);
+
+        for (size_t i = block * TRIANGLE_BLOCK_SIZE; i < end; i++) {
+            ShadedVertex polygon[4];
+            ShadedVertex triangle[3];
+
+            for (size_t k = 0; k < 3; k++)
+                triangle[k] = shadedVertices[indices[i * 3 + k]];
+
+            if (isOutsideFrustum(triangle[0], triangle[1], triangle[2]))
+                continue;
+
+            // Split the polygon clipped by the near plane in a triangle fan
+            size_t polygonCount = clipNearPlane(triangle, 3, polygon);
+
+            for (size_t k = 2; k < polygonCount; k++) {
+                RasterTriangle rasterTriangle;
+
+                if (!setupTriangle(polygon[0], polygon[k - 1], polygon[k], width, height, rasterTriangle))
+                    continue;
+
+                uint32_t index = (uint32_t)bin.triangles.size();
+                bin.triangles.push_back(rasterTriangle);
+
+                size_t beginTileX = rasterTriangle.minX / RASTERIZER_TILE_SIZE;
+                size_t beginTileY = rasterTriangle.minY / RASTERIZER_TILE_SIZE;
+                size_t endTileX = (rasterTriangle.maxX - 1) / RASTERIZER_TILE_SIZE;
+                size_t endTileY = (rasterTriangle.maxY - 1) / RASTERIZER_TILE_SIZE;
+
+                for (size_t tileY = beginTileY; tileY <= endTileY; tileY++) {
+                    for (size_t tileX = beginTileX; tileX <= endTileX; tileX++)
+                        bin.tiles[tileY * tileCountX + tileX].push_back(index);
+                }
+            }
+        }
+    });
+
+    // Rasterize and shade tiles in parallel, visiting triangles in submission order
+    std::vector<TileBuffer> buffers(getThreadCount());
+
+    parallelFor(tileCount, [&](size_t tile, size_t thread) {
+        PROFILE_ZONE("rasterizeTile");
+
+        TileBuffer & buffer = buffers[thread];
+
+        buffer.depths.assign(RASTERIZER_TILE_SIZE * RASTERIZER_TILE_SIZE, 1.0f);
+        buffer.triangles.assign(RASTERIZER_TILE_SIZE * RASTERIZER_TILE_SIZE, nullptr);
+
+        int tileX = (int)((tile % tileCountX) * RASTERIZER_TILE_SIZE);
+        int tileY = (int)((tile / tileCountX) * RASTERIZER_TILE_SIZE);
+        int tileWidth = (int)std::min(RASTERIZER_TILE_SIZE, width - tileX);
+        int tileHeight = (int)std::min(RASTERIZER_TILE_SIZE, height - tileY);
+
+        for (size_t i = 0; i < bins.size(); i++) {
+            const TriangleBin & bin = bins[i];
+            const std::vector<uint32_t> & triangles = bin.tiles[tile];
+
+            for (size_t j = 0; j < triangles.size(); j++)
+                rasterizeTriangle(bin.triangles[triangles[j]], tileX, tileY, tileWidth, tileHeight, buffer);
+        }
+
+        shadeTile(buffer, tileX, tileY, tileWidth, tileHeight, uniforms, texture, image);
+    });
+}
@@ -0,0 +1,53 @@
+#ifndef CG20192_RASTERIZER_HPP
+#define CG20192_RASTERIZER_HPP
+
+#include "mesh.hpp"
+#include "image.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Screen tile size in pixels, a multiple of the SIMD width
+const size_t RASTERIZER_TILE_SIZE = 64;
+
+// Texture sampled with bilinear filtering and repeat wrapping
+// Texels are linear RGB stored top to bottom as uploaded to OpenGL
+struct RasterizerTexture {
+    size_t width;
+    size_t height;
+    std::vector<glm::vec3> texels;
+};
+
+// Transformations and shading parameters matching the blinn_phong shader program uniforms
+// Specular is shaded when the material exponent is positive, like the specular program variant
+struct RasterizerUniforms {
+    glm::mat4 model;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 cameraPosition;
+    glm::vec3 lightPosition;
+    glm::vec3 lightColor;
+    glm::vec3 materialColor;
+    float exponent;
+    glm::vec3 clearColor;
+};
+
+// Render indexed triangles on the CPU to an 8-bit RGB image of the given size
+// Triangles are clipped against the near plane and binned in screen tiles,
+// then tiles are rasterized in parallel with a depth test and shaded once per pixel
+// Like the OpenGL path, no face culling is done and colors are clamped without conversion
+void renderTriangles(
+        const Vertex * vertices,
+        size_t vertexCount,
+        const uint32_t * indices,
+        size_t indexCount,
+        const RasterizerUniforms & uniforms,
+        const RasterizerTexture & texture,
+        size_t width,
+        size_t height,
+        Image & image);
+
+#endif
@@ -0,0 +1,255 @@
+#include "scene.hpp"
+#include "simplification.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Get bounding sphere of object, scaled by the largest axis scale of its model matrix
+glm::vec4 getObjectSphere(const Scene & scene, const SceneObject & object) {
+    const BoundingBox & bounds = scene.meshes[object.mesh].bounds;
+    const glm::mat4 & model = object.model;
+
+    glm::vec3 center(model * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+
+    float scale = std::max(
+        std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))),
+        glm::length(glm::vec3(model[2])));
+
+    return glm::vec4(center, glm::length(bounds.max - bounds.min) * 0.5f * scale);
+}
+
+bool compareDrawItems(const DrawItem & a, const DrawItem & b) {
+    return a.key < b.key;
+}
+
+}
+
+bool readSceneFile(const std::string & filename, SceneDescription & description) {
+    PROFILE_ZONE("readSceneFile");
+
+    std::ifstream file(filename, std::ifstream::in);
+
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+
+    while (std::getline(file, line)) {
+        std::istringstream elements(line);
+
+        std::string type;
+        elements >> type;
+
+        if (type.empty() || type[0] == '#')
+            continue;
+
+        if (type == "mesh" || type == "texture") {
+            std::string elementFilename;
+            elements >> elementFilename;
+
+            if (type == "mesh")
+                description.meshFilenames.push_back(elementFilename);
+            else
+                description.imageFilenames.push_back(elementFilename);
+        }
+        else if (type == "material") {
+            SceneMaterial material;
+            material.program = 0;
+            material.texture = SCENE_NO_TEXTURE;
+
+            std::string texture, shading;
+
+            elements >> texture
+                >> material.color.r >> material.color.g >> material.color.b
+                >> material.exponent;
+
+            if (elements.fail())
+                return false;
+
+            if (texture != "-") {
+                std::istringstream index(texture);
+
+                if (!(index >> material.texture) || material.texture >= description.imageFilenames.size())
+                    return false;
+            }
+
+            // Read optional shading keyword, clearing the end of line state
+            if (!(elements >> shading))
+                elements.clear();
+
+            if (!shading.empty() && shading != "flat")
+                return false;
+
+            material.flatShading = shading == "flat";
+
+            description.materials.push_back(material);
+        }
+        else if (type == "object") {
+            SceneObject object;
+
+            glm::vec3 position;
+            float angle, scale;
+
+            elements >> object.mesh >> object.material
+                >> position.x >> position.y >> position.z
+                >> angle >> scale;
+
+            if (elements.fail()
+                    || object.mesh >= description.meshFilenames.size()
+                    || object.material >= description.materials.size())
+                return false;
+
+            object.model = glm::translate(glm::mat4(1.0f), position)
+                * glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f))
+                * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+
+            description.objects.push_back(object);
+        }
+        else if (type == "light") {
+            PointLight light;
+
+            elements >> light.position.x >> light.position.y >> light.position.z
+                >> light.color.r >> light.color.g >> light.color.b
+                >> light.radius;
+
+            if (elements.fail() || !(light.radius > 0.0f))
+                return false;
+
+            description.lights.push_back(light);
+        }
+        else
+            return false;
+
+        if (elements.fail())
+            return false;
+    }
+
+    return true;
+}
+
+uint64_t makeDrawKey(uint32_t program, uint32_t texture, uint32_t mesh, uint32_t level, float depth) {
+    // Bits of positive floating point numbers sort as the numbers, so the depth keeps
+    // its most significant bits without normalization to the view range
+    uint32_t depthBits = 0;
+
+    if (depth > 0.0f)
+        std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    uint64_t key = program & ((1u << DRAW_KEY_PROGRAM_BITS) - 1);
+    key = (key << DRAW_KEY_TEXTURE_BITS) | (texture & ((1u << DRAW_KEY_TEXTURE_BITS) - 1));
+    key = (key << DRAW_KEY_MESH_BITS) | (mesh & ((1u << DRAW_KEY_MESH_BITS) - 1));
+    key = (key << DRAW_KEY_LEVEL_BITS) | (level & ((1u << DRAW_KEY_LEVEL_BITS) - 1));
+    key = (key << DRAW_KEY_DEPTH_BITS) | (depthBits >> (32 - DRAW_KEY_DEPTH_BITS));
+
+    return key;
+}
+
+BoundingBox computeSceneBounds(const Scene & scene) {
+    BoundingBox bounds;
+    bounds.min = glm::vec3(INFINITY);
+    bounds.max = glm::vec3(-INFINITY);
+
+    for (size_t i = 0; i < scene.objects.size(); i++) {
+        glm::vec4 sphere = getObjectSphere(scene, scene.objects[i]);
+
+        bounds.min = glm::min(bounds.min, glm::vec3(sphere) - sphere.w);
+        bounds.max = glm::max(bounds.max, glm::vec3(sphere) + sphere.w);
+    }
+
+    if (scene.objects.empty())
+        bounds.min = bounds.max = glm::vec3(0.0f);
+
+    return bounds;
+}
+
+void buildDrawList(
+        const Scene & scene,
+        const glm::mat4 & viewProjection,
+        const glm::vec3 & camera,
+        float projectionScale,
+        float pixelError,
+        DrawList & list) {
+    PROFILE_ZONE("buildDrawList");
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+
+    // Keep objects whose sphere is not behind any frustum plane
+    list.items.clear();
+
+    for (size_t i = 0; i < scene.objects.size(); i++) {
+        const SceneObject & object = scene.objects[i];
+        const SceneMaterial & material = scene.materials[object.material];
+
+        glm::vec4 sphere = getObjectSphere(scene, object);
+        glm::vec3 center(sphere);
+
+        bool visible = true;
+
+        for (int j = 0; j < 6 && visible; j++)
+            visible = glm::dot(glm::vec3(planes[j]), center) + planes[j].w > -sphere.w;
+
+        if (!visible)
+            continue;
+
+        float distance = glm::distance(center, camera);
+
+        DrawItem item;
+        item.object = (uint32_t)i;
+        item.level = (uint32_t)selectLevelOfDetail(
+            scene.meshes[object.mesh].levels,
+            sphere.w,
+            distance,
+            projectionScale,
+            pixelError);
+        item.key = makeDrawKey(material.program, material.texture, object.mesh, item.level, distance);
+
+        list.items.push_back(item);
+    }
+
+    std::sort(list.items.begin(), list.items.end(), compareDrawItems);
+
+    // Merge consecutive items sharing program, texture, mesh and level
+    // Fields are compared instead of keys, which truncate indices
+    list.batches.clear();
+    list.instances.resize(list.items.size());
+
+    for (size_t i = 0; i < list.items.size(); i++) {
+        const DrawItem & item = list.items[i];
+        const SceneObject & object = scene.objects[item.object];
+        const SceneMaterial & material = scene.materials[object.material];
+
+        bool merged = !list.batches.empty()
+            && list.batches.back().program == material.program
+            && list.batches.back().texture == material.texture
+            && list.batches.back().mesh == object.mesh
+            && list.batches.back().level == item.level;
+
+        if (!merged) {
+            DrawBatch batch;
+            batch.program = material.program;
+            batch.texture = material.texture;
+            batch.mesh = object.mesh;
+            batch.level = item.level;
+            batch.object = item.object;
+            batch.instanceOffset = i;
+            batch.instanceCount = 0;
+
+            list.batches.push_back(batch);
+        }
+
+        list.batches.back().instanceCount++;
+
+        setInstanceModel(object.model, list.instances[i]);
+        list.instances[i].materialColor = glm::vec4(material.color, material.exponent);
+    }
+}
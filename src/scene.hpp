@@ -0,0 +1,144 @@
+#ifndef CG20192_SCENE_HPP
+#define CG20192_SCENE_HPP
+
+#include "mesh.hpp"
+#include "meshlet.hpp"
+#include "quantization.hpp"
+#include "instancing.hpp"
+#include "light_clusters.hpp"
+
+#include <glad/glad.h>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Draw key bit layout from the most significant bits
+// Draws are sorted by program, texture, mesh and level, then front to back by depth
+const int DRAW_KEY_PROGRAM_BITS = 8;
+const int DRAW_KEY_TEXTURE_BITS = 16;
+const int DRAW_KEY_MESH_BITS = 16;
+const int DRAW_KEY_LEVEL_BITS = 4;
+const int DRAW_KEY_DEPTH_BITS = 20;
+
+// OpenGL objects and draw parameters of a loaded triangle mesh
+// Levels of detail and meshlets are index ranges in the element buffer object
+struct MeshBuffers {
+    GLuint vao;
+    GLuint vbo;
+    GLuint ebo;
+    GLenum indexType;
+    size_t indexSize;
+    std::vector<LevelOfDetail> levels;
+    std::vector<Meshlet> meshlets;
+    MeshletBounds meshletBounds;
+    VertexFormat vertexFormat;
+    glm::mat4 dequantization;
+    BoundingBox bounds;
+};
+
+// Texture index of untextured materials
+const uint32_t SCENE_NO_TEXTURE = 0xFFFFFFFF;
+
+// Surface material, texture and program are scene indices
+// The color and exponent are passed per instance, so materials sharing
+// a texture and program are drawn together
+// Flat shaded materials ignore vertex normals and materials without exponent have no specular
+struct SceneMaterial {
+    glm::vec3 color;
+    float exponent;
+    uint32_t texture;
+    uint32_t program;
+    bool flatShading;
+};
+
+// Mesh placed in the scene with a material, mesh and material are scene indices
+struct SceneObject {
+    uint32_t mesh;
+    uint32_t material;
+    glm::mat4 model;
+};
+
+// Scene file contents before meshes and textures are loaded
+struct SceneDescription {
+    std::vector<std::string> meshFilenames;
+    std::vector<std::string> imageFilenames;
+    std::vector<SceneMaterial> materials;
+    std::vector<SceneObject> objects;
+    std::vector<PointLight> lights;
+};
+
+// Loaded meshes, textures and programs with the materials and objects using them
+// Per-instance attributes of every mesh vertex array object read the instance buffer
+// Meshes and textures not loaded yet are copies of the placeholders
+struct Scene {
+    std::vector<GLuint> programs;
+    std::vector<GLuint> textures;
+    std::vector<MeshBuffers> meshes;
+    std::vector<SceneMaterial> materials;
+    std::vector<SceneObject> objects;
+    std::vector<PointLight> lights;
+    GLuint instanceBuffer;
+    MeshBuffers placeholderMesh;
+    GLuint placeholderTexture;
+};
+
+// Visible object with its level of detail and sort key
+struct DrawItem {
+    uint64_t key;
+    uint32_t object;
+    uint32_t level;
+};
+
+// Visible objects sharing program, texture, mesh and level of detail
+// Their instances are consecutive in the draw list from the instance offset
+struct DrawBatch {
+    uint32_t program;
+    uint32_t texture;
+    uint32_t mesh;
+    uint32_t level;
+    uint32_t object;
+    size_t instanceOffset;
+    size_t instanceCount;
+};
+
+// Draw list rebuilt every frame, buffers are kept across frames to avoid allocations
+struct DrawList {
+    std::vector<DrawItem> items;
+    std::vector<DrawBatch> batches;
+    std::vector<Instance> instances;
+};
+
+// Read scene from text file
+// Each line declares one element, referenced by later lines by its zero-based index in its kind:
+// mesh <file>
+// texture <file>
+// material <texture or -> <red> <green> <blue> <exponent> [flat]
+// object <mesh> <material> <x> <y> <z> <rotation about y in degrees> <scale>
+// light <x> <y> <z> <red> <green> <blue> <radius>
+// Chunks of chunked mesh files are meshes named <file>#<chunk index>
+// Empty lines and lines starting with # are ignored
+bool readSceneFile(const std::string & filename, SceneDescription & description);
+
+// Make draw key from scene indices and view depth, indices are truncated to their bits
+uint64_t makeDrawKey(uint32_t program, uint32_t texture, uint32_t mesh, uint32_t level, float depth);
+
+// Get bounding box of all objects of the scene
+BoundingBox computeSceneBounds(const Scene & scene);
+
+// Find objects intersecting the view frustum, select their levels of detail,
+// sort them by draw key and merge consecutive objects sharing state in batches
+// Levels are selected from the projected sphere diameter in pixels,
+// where projection scale is the vertical projection factor times the viewport height
+void buildDrawList(
+        const Scene & scene,
+        const glm::mat4 & viewProjection,
+        const glm::vec3 & camera,
+        float projectionScale,
+        float pixelError,
+        DrawList & list);
+
+#endif
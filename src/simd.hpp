@@ -0,0 +1,11 @@
+#ifndef CG20192_SIMD_HPP
+#define CG20192_SIMD_HPP
+
+// Enable SSE2 code paths when the target supports them (always on x86-64)
+// Functions using SIMD keep a scalar fallback for other targets
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CG20192_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#endif
@@ -0,0 +1,626 @@
+#include "simplification.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace {
+
+const uint32_t INVALID_GROUP = 0xFFFFFFFF;
+
+// Number of position groups processed by a single task
+const size_t GROUP_BLOCK_SIZE = 4096;
+
+// Weight of planes constraining open borders relative to triangle planes
+const double BORDER_WEIGHT = 10.0;
+
+// Levels keeping a larger fraction of the previous level triangles end the chain
+const float MAXIMUM_LEVEL_RATIO = 0.95f;
+
+// Sum of weighted squared distances to planes
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+void addPlane(Quadric & quadric, const glm::dvec3 & normal, double distance, double weight) {
+    quadric.a00 += weight * normal.x * normal.x;
+    quadric.a01 += weight * normal.x * normal.y;
+    quadric.a02 += weight * normal.x * normal.z;
+    quadric.a11 += weight * normal.y * normal.y;
+    quadric.a12 += weight * normal.y * normal.z;
+    quadric.a22 += weight * normal.z * normal.z;
+    quadric.b0 += weight * distance * normal.x;
+    quadric.b1 += weight * distance * normal.y;
+    quadric.b2 += weight * distance * normal.z;
+    quadric.c += weight * distance * distance;
+    quadric.weight += weight;
+}
+
+void addQuadric(Quadric & quadric, const Quadric & other) {
+    quadric.a00 += other.a00;
+    quadric.a01 += other.a01;
+    quadric.a02 += other.a02;
+    quadric.a11 += other.a11;
+    quadric.a12 += other.a12;
+    quadric.a22 += other.a22;
+    quadric.b0 += other.b0;
+    quadric.b1 += other.b1;
+    quadric.b2 += other.b2;
+    quadric.c += other.c;
+    quadric.weight += other.weight;
+}
+
+// Evaluate weighted sum of squared distances to the planes of quadric
+double evaluateQuadric(const Quadric & quadric, const glm::vec3 & position) {
+    double x = position.x;
+    double y = position.y;
+    double z = position.z;
+
+    double value = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z
+        + 2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z)
+        + 2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z)
+        + quadric.c;
+
+    return value;
+}
+
+inline glm::dvec3 computeNormal(const glm::vec3 & p0, const glm::vec3 & p1, const glm::vec3 & p2) {
+    return glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+}
+
+// Vertices sharing a position, stored contiguously by group
+struct PositionGroups {
+    std::vector<uint32_t> vertexGroups;
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> vertices;
+    std::vector<glm::vec3> positions;
+};
+
+void buildPositionGroups(const std::vector<Vertex> & vertices, PositionGroups & groups) {
+    size_t vertexCount = vertices.size();
+
+    groups.vertices.resize(vertexCount);
+
+    for (size_t i = 0; i < vertexCount; i++)
+        groups.vertices[i] = (uint32_t)i;
+
+    // Sort vertices bitwise by position, then by index for a deterministic order
+    std::sort(groups.vertices.begin(), groups.vertices.end(), [&](uint32_t a, uint32_t b) {
+        int order = std::memcmp(&vertices[a].position, &vertices[b].position, sizeof(glm::vec3));
+        return order != 0 ? order < 0 : a < b;
+    });
+
+    groups.vertexGroups.resize(vertexCount);
+    groups.offsets.clear();
+    groups.positions.clear();
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        const glm::vec3 & position = vertices[groups.vertices[i]].position;
+
+        if (i == 0 || std::memcmp(&position, &vertices[groups.vertices[i - 1]].position, sizeof(glm::vec3)) != 0) {
+            groups.offsets.push_back(i);
+            groups.positions.push_back(position);
+        }
+
+        groups.vertexGroups[groups.vertices[i]] = (uint32_t)(groups.positions.size() - 1);
+    }
+
+    groups.offsets.push_back(vertexCount);
+}
+
+// Triangle edge seen from the group of its source vertex
+// Forward edges follow the triangle winding, so every triangle has one forward edge per corner
+struct HalfEdge {
+    uint32_t target;
+    uint32_t sourceVertex;
+    uint32_t targetVertex;
+    uint32_t triangle;
+    bool forward;
+};
+
+inline bool compareHalfEdges(const HalfEdge & a, const HalfEdge & b) {
+    if (a.target != b.target)
+        return a.target < b.target;
+
+    if (a.sourceVertex != b.sourceVertex)
+        return a.sourceVertex < b.sourceVertex;
+
+    if (a.targetVertex != b.targetVertex)
+        return a.targetVertex < b.targetVertex;
+
+    return a.triangle < b.triangle;
+}
+
+// Half-edges bucketed by source group and sorted by target group
+// Runs of equal target hold one half-edge per triangle sharing the edge
+struct EdgeTable {
+    std::vector<size_t> offsets;
+    std::vector<HalfEdge> edges;
+};
+
+void collectEdges(
+        const std::vector<uint32_t> & indices,
+        const PositionGroups & groups,
+        EdgeTable & table) {
+    size_t groupCount = groups.positions.size();
+    size_t triangleCount = indices.size() / 3;
+
+    table.offsets.assign(groupCount + 1, 0);
+
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        table.offsets[groups.vertexGroups[indices[i]] + 1] += 2;
+
+    for (size_t i = 0; i < groupCount; i++)
+        table.offsets[i + 1] += table.offsets[i];
+
+    table.edges.resize(table.offsets[groupCount]);
+
+    std::vector<size_t> cursors(table.offsets.begin(), table.offsets.end() - 1);
+
+    for (size_t i = 0; i < triangleCount; i++) {
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t a = indices[i * 3 + k];
+            uint32_t b = indices[i * 3 + (k + 1) % 3];
+
+            uint32_t groupA = groups.vertexGroups[a];
+            uint32_t groupB = groups.vertexGroups[b];
+
+            HalfEdge forward = { groupB, a, b, (uint32_t)i, true };
+            HalfEdge backward = { groupA, b, a, (uint32_t)i, false };
+
+            table.edges[cursors[groupA]++] = forward;
+            table.edges[cursors[groupB]++] = backward;
+        }
+    }
+
+    size_t blockCount = (groupCount + GROUP_BLOCK_SIZE - 1) / GROUP_BLOCK_SIZE;
+
+    parallelFor(blockCount, [&](size_t block, size_t) {
+        size_t end = std::min((block + 1) * GROUP_BLOCK_SIZE, groupCount);
+
+        for (size_t i = block * GROUP_BLOCK_SIZE; i < end; i++)
+            std::sort(
+                table.edges.begin() + table.offsets[i],
+                table.edges.begin() + table.offsets[i + 1],
+                compareHalfEdges);
+    });
+}
+
+// Get end of the run of half-edges sharing the target group
+inline size_t findRunEnd(const EdgeTable & table, size_t begin, size_t end) {
+    size_t i = begin + 1;
+
+    while (i < end && table.edges[i].target == table.edges[begin].target)
+        i++;
+
+    return i;
+}
+
+// Initialize quadric of group from its triangle planes and border edge planes
+void computeQuadric(
+        uint32_t group,
+        const std::vector<uint32_t> & indices,
+        const PositionGroups & groups,
+        const EdgeTable & table,
+        Quadric & quadric) {
+    std::memset(&quadric, 0, sizeof(quadric));
+
+    size_t begin = table.offsets[group];
+    size_t end = table.offsets[group + 1];
+
+    for (size_t i = begin; i < end;) {
+        size_t runEnd = findRunEnd(table, i, end);
+
+        for (size_t j = i; j < runEnd; j++) {
+            const HalfEdge & edge = table.edges[j];
+            const uint32_t * triangle = &indices[edge.triangle * 3];
+
+            const glm::vec3 & p0 = groups.positions[groups.vertexGroups[triangle[0]]];
+            const glm::vec3 & p1 = groups.positions[groups.vertexGroups[triangle[1]]];
+            const glm::vec3 & p2 = groups.positions[groups.vertexGroups[triangle[2]]];
+
+            glm::dvec3 normal = computeNormal(p0, p1, p2);
+            double length = glm::length(normal);
+
+            if (length == 0.0)
+                continue;
+
+            normal /= length;
+
+            // Plane of triangle, weighted by area
+            if (edge.forward)
+                addPlane(quadric, normal, -glm::dot(normal, glm::dvec3(p0)), length * 0.5);
+
+            // Plane through border edge perpendicular to the triangle
+            if (runEnd - i == 1) {
+                glm::dvec3 source(groups.positions[group]);
+                glm::dvec3 direction = glm::dvec3(groups.positions[edge.target]) - source;
+                glm::dvec3 borderNormal = glm::cross(direction, normal);
+                double borderLength = glm::length(borderNormal);
+
+                if (borderLength > 0.0) {
+                    borderNormal /= borderLength;
+
+                    addPlane(
+                        quadric,
+                        borderNormal,
+                        -glm::dot(borderNormal, source),
+                        glm::dot(direction, direction) * BORDER_WEIGHT);
+                }
+            }
+        }
+
+        i = runEnd;
+    }
+}
+
+// Check that the groups of an edge share only the vertices opposite to the edge,
+// so the collapse keeps the surface manifold
+bool checkLink(uint32_t source, uint32_t target, size_t triangleCount, const EdgeTable & table) {
+    size_t i = table.offsets[source];
+    size_t iEnd = table.offsets[source + 1];
+    size_t j = table.offsets[target];
+    size_t jEnd = table.offsets[target + 1];
+
+    size_t commonCount = 0;
+
+    while (i < iEnd && j < jEnd) {
+        uint32_t a = table.edges[i].target;
+        uint32_t b = table.edges[j].target;
+
+        if (a == b)
+            commonCount++;
+
+        if (a <= b)
+            i = findRunEnd(table, i, iEnd);
+
+        if (b <= a)
+            j = findRunEnd(table, j, jEnd);
+    }
+
+    return commonCount == triangleCount;
+}
+
+// Find cheapest collapse of group onto a neighbor group
+// Non-manifold groups are kept, border groups move only along border edges
+// and every vertex of the group must share an edge with a vertex of the target group
+void findCollapse(
+        uint32_t group,
+        const PositionGroups & groups,
+        const EdgeTable & table,
+        const std::vector<Quadric> & quadrics,
+        const std::vector<uint32_t> & liveCounts,
+        uint32_t & target,
+        double & cost) {
+    target = INVALID_GROUP;
+    cost = std::numeric_limits<double>::infinity();
+
+    size_t begin = table.offsets[group];
+    size_t end = table.offsets[group + 1];
+
+    bool border = false;
+
+    for (size_t i = begin; i < end;) {
+        size_t runEnd = findRunEnd(table, i, end);
+
+        if (runEnd - i > 2)
+            return;
+
+        if (runEnd - i == 1)
+            border = true;
+
+        i = runEnd;
+    }
+
+    for (size_t i = begin; i < end;) {
+        size_t runEnd = findRunEnd(table, i, end);
+        size_t triangleCount = runEnd - i;
+        uint32_t candidate = table.edges[i].target;
+
+        size_t wedgeCount = 1;
+
+        for (size_t j = i + 1; j < runEnd; j++) {
+            if (table.edges[j].sourceVertex != table.edges[j - 1].sourceVertex)
+                wedgeCount++;
+        }
+
+        i = runEnd;
+
+        if ((border && triangleCount != 1) || wedgeCount != liveCounts[group])
+            continue;
+
+        // Mean squared distance of the target position to the planes of both groups
+        const glm::vec3 & position = groups.positions[candidate];
+        double weight = quadrics[group].weight + quadrics[candidate].weight;
+
+        double candidateCost = weight > 0.0
+            ? std::fabs(evaluateQuadric(quadrics[group], position)
+                + evaluateQuadric(quadrics[candidate], position)) / weight
+            : 0.0;
+
+        if (candidateCost >= cost || !checkLink(group, candidate, triangleCount, table))
+            continue;
+
+        target = candidate;
+        cost = candidateCost;
+    }
+}
+
+// Check if moving group onto target flips any of its remaining triangles
+bool flipsTriangles(
+        uint32_t group,
+        uint32_t target,
+        const std::vector<uint32_t> & indices,
+        const PositionGroups & groups,
+        const EdgeTable & table) {
+    for (size_t i = table.offsets[group]; i < table.offsets[group + 1]; i++) {
+        const HalfEdge & edge = table.edges[i];
+
+        if (!edge.forward)
+            continue;
+
+        const uint32_t * triangle = &indices[edge.triangle * 3];
+
+        glm::vec3 positions[3];
+        glm::vec3 moved[3];
+        bool collapsed = false;
+
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t corner = groups.vertexGroups[triangle[k]];
+
+            positions[k] = groups.positions[corner];
+            moved[k] = corner == group ? groups.positions[target] : positions[k];
+            collapsed = collapsed || corner == target;
+        }
+
+        if (collapsed)
+            continue;
+
+        glm::dvec3 before = computeNormal(positions[0], positions[1], positions[2]);
+        glm::dvec3 after = computeNormal(moved[0], moved[1], moved[2]);
+
+        if (glm::dot(before, after) <= 0.0)
+            return true;
+    }
+
+    return false;
+}
+
+}
+
+void simplifyTriangles(
+        const std::vector<Vertex> & vertices,
+        const std::vector<uint32_t> & indices,
+        size_t targetIndexCount,
+        float maxError,
+        std::vector<uint32_t> & result,
+        float & error) {
+    PositionGroups groups;
+    buildPositionGroups(vertices, groups);
+
+    size_t groupCount = groups.positions.size();
+    size_t blockCount = (groupCount + GROUP_BLOCK_SIZE - 1) / GROUP_BLOCK_SIZE;
+
+    // Drop triangles without area in position space
+    result.clear();
+    result.reserve(indices.size());
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = groups.vertexGroups[indices[i]];
+        uint32_t b = groups.vertexGroups[indices[i + 1]];
+        uint32_t c = groups.vertexGroups[indices[i + 2]];
+
+        if (a != b && b != c && c != a)
+            result.insert(result.end(), indices.begin() + i, indices.begin() + i + 3);
+    }
+
+    // Errors are measured relative to the largest extent of the mesh
+    BoundingBox bounds = computeBoundingBox(vertices.data(), vertices.size());
+    glm::vec3 extent = bounds.max - bounds.min;
+    double scale = std::max(std::max(extent.x, extent.y), extent.z);
+
+    if (scale <= 0.0)
+        scale = 1.0;
+
+    double maxCost = (maxError * scale) * (maxError * scale);
+    double resultCost = 0.0;
+
+    EdgeTable table;
+    collectEdges(result, groups, table);
+
+    std::vector<Quadric> quadrics(groupCount);
+
+    parallelFor(blockCount, [&](size_t block, size_t) {
+        size_t end = std::min((block + 1) * GROUP_BLOCK_SIZE, groupCount);
+
+        for (size_t i = block * GROUP_BLOCK_SIZE; i < end; i++)
+            computeQuadric((uint32_t)i, result, groups, table, quadrics[i]);
+    });
+
+    std::vector<uint32_t> remap(vertices.size());
+
+    for (size_t i = 0; i < remap.size(); i++)
+        remap[i] = (uint32_t)i;
+
+    std::vector<unsigned char> referenced(vertices.size());
+    std::vector<uint32_t> liveCounts(groupCount);
+    std::vector<uint32_t> targets(groupCount);
+    std::vector<double> costs(groupCount);
+    std::vector<unsigned char> locked(groupCount);
+    std::vector<uint32_t> candidates;
+
+    // Collapse independent edges in passes until the target or the error limit is reached
+    while (result.size() > targetIndexCount) {
+        std::fill(referenced.begin(), referenced.end(), 0);
+
+        for (size_t i = 0; i < result.size(); i++)
+            referenced[result[i]] = 1;
+
+        // Find cheapest collapse of every group in parallel
+        parallelFor(blockCount, [&](size_t block, size_t) {
+            size_t end = std::min((block + 1) * GROUP_BLOCK_SIZE, groupCount);
+
+            for (size_t i = block * GROUP_BLOCK_SIZE; i < end; i++) {
+                uint32_t liveCount = 0;
+
+                for (size_t j = groups.offsets[i]; j < groups.offsets[i + 1]; j++)
+                    liveCount += referenced[groups.vertices[j]];
+
+                liveCounts[i] = liveCount;
+            }
+
+            for (size_t i = block * GROUP_BLOCK_SIZE; i < end; i++)
+                findCollapse((uint32_t)i, groups, table, quadrics, liveCounts, targets[i], costs[i]);
+        });
+
+        candidates.clear();
+
+        for (size_t i = 0; i < groupCount; i++) {
+            if (targets[i] != INVALID_GROUP && costs[i] <= maxCost)
+                candidates.push_back((uint32_t)i);
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+            return costs[a] != costs[b] ? costs[a] < costs[b] : a < b;
+        });
+
+        // Accept cheapest collapses whose one-ring neighborhoods do not overlap,
+        // so every triangle moves at most one corner in a pass
+        std::fill(locked.begin(), locked.end(), 0);
+
+        size_t removeCount = (result.size() - targetIndexCount) / 3;
+        size_t removedCount = 0;
+        size_t collapseCount = 0;
+
+        for (size_t i = 0; i < candidates.size() && removedCount < removeCount; i++) {
+            uint32_t group = candidates[i];
+            uint32_t target = targets[group];
+
+            if (locked[group] || locked[target])
+                continue;
+
+            if (flipsTriangles(group, target, result, groups, table))
+                continue;
+
+            locked[group] = 1;
+
+            for (size_t j = table.offsets[group]; j < table.offsets[group + 1]; j++) {
+                const HalfEdge & edge = table.edges[j];
+
+                locked[edge.target] = 1;
+
+                // Move every vertex of the group to the vertex it shares an edge with
+                if (edge.target == target) {
+                    if (remap[edge.sourceVertex] == edge.sourceVertex)
+                        remap[edge.sourceVertex] = edge.targetVertex;
+
+                    removedCount++;
+                }
+            }
+
+            addQuadric(quadrics[target], quadrics[group]);
+            resultCost = std::max(resultCost, costs[group]);
+            collapseCount++;
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        // Remap collapsed vertices and drop degenerate triangles
+        size_t count = 0;
+
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = remap[result[i]];
+            uint32_t b = remap[result[i + 1]];
+            uint32_t c = remap[result[i + 2]];
+
+            uint32_t groupA = groups.vertexGroups[a];
+            uint32_t groupB = groups.vertexGroups[b];
+            uint32_t groupC = groups.vertexGroups[c];
+
+            if (groupA == groupB || groupB == groupC || groupC == groupA)
+                continue;
+
+            result[count++] = a;
+            result[count++] = b;
+            result[count++] = c;
+        }
+
+        result.resize(count);
+
+        collectEdges(result, groups, table);
+    }
+
+    error = (float)(std::sqrt(resultCost) / scale);
+}
+
+void generateLevelsOfDetail(TriangleMesh & mesh, const LevelOfDetailSettings & settings) {
+    PROFILE_ZONE("generateLevelsOfDetail");
+
+    if (mesh.levels.empty())
+        return;
+
+    const LevelOfDetail & last = mesh.levels.back();
+
+    std::vector<uint32_t> previous(
+        mesh.indices.begin() + last.indexOffset,
+        mesh.indices.begin() + last.indexOffset + last.indexCount);
+
+    float previousError = last.error;
+
+    std::vector<uint32_t> indices;
+
+    while (mesh.levels.size() < settings.levelCount && previousError < settings.maxError) {
+        size_t targetIndexCount = (size_t)(previous.size() / 3 * settings.ratio) * 3;
+        float error;
+
+        simplifyTriangles(
+            mesh.vertices,
+            previous,
+            targetIndexCount,
+            settings.maxError - previousError,
+            indices,
+            error);
+
+        if (indices.empty() || indices.size() > previous.size() * MAXIMUM_LEVEL_RATIO)
+            break;
+
+        // Errors of consecutive levels add up relative to the full resolution level
+        LevelOfDetail level = { mesh.indices.size(), indices.size(), previousError + error, 0, 0 };
+
+        mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+        mesh.levels.push_back(level);
+
+        previous.swap(indices);
+        previousError = level.error;
+    }
+}
+
+size_t selectLevelOfDetail(
+        const std::vector<LevelOfDetail> & levels,
+        float radius,
+        float distance,
+        float projectionScale,
+        float pixelError) {
+    if (distance <= radius)
+        return 0;
+
+    // Projected sphere diameter in pixels
+    float size = radius / distance * projectionScale;
+
+    // Level errors are relative to the largest extent, bounded by the sphere diameter
+    for (size_t i = levels.size() - 1; i > 0; i--) {
+        if (levels[i].error * size <= pixelError)
+            return i;
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef CG20192_SIMPLIFICATION_HPP
+#define CG20192_SIMPLIFICATION_HPP
+
+#include "mesh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Level of detail chain settings
+// The level count includes the full resolution level and each level targets
+// the triangle ratio of the previous one within the maximum relative error
+struct LevelOfDetailSettings {
+    size_t levelCount;
+    float ratio;
+    float maxError;
+};
+
+// Simplify triangle list by quadric error edge collapses onto existing vertices
+// Vertices sharing a position collapse together, so attribute seams and open borders are kept,
+// and the result indexes the same vertices as the input
+// The error is the largest collapse distance relative to the mesh extent
+void simplifyTriangles(
+        const std::vector<Vertex> & vertices,
+        const std::vector<uint32_t> & indices,
+        size_t targetIndexCount,
+        float maxError,
+        std::vector<uint32_t> & result,
+        float & error);
+
+// Append levels of detail to mesh, each simplified from the previous level
+// The chain stops early when a level cannot be reduced within the maximum error
+void generateLevelsOfDetail(TriangleMesh & mesh, const LevelOfDetailSettings & settings);
+
+// Select the coarsest level of detail whose error stays below the pixel error on screen
+// for a bounding sphere at a distance from the camera, full resolution when the camera is inside it
+// Projection scale is the vertical projection factor times the viewport height in pixels
+size_t selectLevelOfDetail(
+        const std::vector<LevelOfDetail> & levels,
+        float radius,
+        float distance,
+        float projectionScale,
+        float pixelError);
+
+#endif
@@ -0,0 +1,187 @@
+#include "simulation.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double TWO_PI = 6.28318530717958647692;
+
+// Largest orbit speed of moving lights in radians per second
+const float MAX_LIGHT_ORBIT_SPEED = 0.5f;
+
+// Lights moved by a single task of a simulation step
+const size_t LIGHT_BLOCK_SIZE = 1024;
+
+// Golden ratio conjugate, spreading consecutive indices evenly in [0, 1)
+const double GOLDEN_RATIO_CONJUGATE = 0.61803398874989484820;
+
+// Flag of the middle slot index set when it holds a snapshot not acquired yet
+const uint32_t SNAPSHOT_FRESH = 4;
+
+// Publish filled back slot as the latest snapshot and take the previous middle slot as back slot
+void publishSnapshot(Simulation & simulation) {
+    uint32_t slot = simulation.middle.exchange(simulation.back | SNAPSHOT_FRESH, std::memory_order_acq_rel);
+    simulation.back = slot & ~SNAPSHOT_FRESH;
+}
+
+// Step simulation at the fixed timestep until stopped
+void runSimulation(Simulation * simulation) {
+    std::chrono::steady_clock::duration timestep = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(SIMULATION_TIMESTEP));
+
+    std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now() + timestep;
+
+    while (!simulation->stop.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_until(due);
+
+        // Drop steps that cannot be caught up
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        if (now - due > timestep * (std::chrono::steady_clock::rep)MAX_SIMULATION_CATCH_UP_STEPS)
+            due = now;
+
+        FrameSnapshot & snapshot = simulation->snapshots[simulation->back];
+        snapshot.previous = simulation->state;
+
+        stepSimulation(
+            simulation->orbits,
+            simulation->input->rotationSteps.exchange(0),
+            simulation->input->backgroundToggles.exchange(0),
+            simulation->state);
+
+        snapshot.current = simulation->state;
+        snapshot.time = due;
+
+        publishSnapshot(*simulation);
+
+        due += timestep;
+    }
+}
+
+}
+
+void createLightOrbits(
+        const std::vector<PointLight> & lights,
+        size_t firstMovingLight,
+        const glm::vec3 & center,
+        LightOrbits & orbits) {
+    orbits.lights = lights;
+    orbits.speeds.assign(lights.size(), 0.0f);
+    orbits.center = center;
+
+    for (size_t i = firstMovingLight; i < lights.size(); i++) {
+        double offset = i * GOLDEN_RATIO_CONJUGATE;
+        orbits.speeds[i] = MAX_LIGHT_ORBIT_SPEED * (float)(2.0 * (offset - std::floor(offset)) - 1.0);
+    }
+}
+
+void stepSimulation(
+        const LightOrbits & orbits,
+        int32_t rotationSteps,
+        uint32_t backgroundToggles,
+        SimulationState & state) {
+    PROFILE_ZONE("stepSimulation");
+
+    state.step++;
+    state.time = state.step * SIMULATION_TIMESTEP;
+    state.modelAngle += MODEL_ROTATION_STEP * rotationSteps;
+    state.background = state.background != ((backgroundToggles & 1) != 0);
+
+    // Rotate start positions of lights by their elapsed angle about the vertical axis
+    size_t lightCount = orbits.lights.size();
+
+    state.lights.resize(lightCount);
+
+    parallelFor((lightCount + LIGHT_BLOCK_SIZE - 1) / LIGHT_BLOCK_SIZE, [&](size_t block, size_t) {
+        size_t end = std::min(lightCount, (block + 1) * LIGHT_BLOCK_SIZE);
+
+        for (size_t i = block * LIGHT_BLOCK_SIZE; i < end; i++) {
+            const PointLight & light = orbits.lights[i];
+
+            state.lights[i] = light;
+
+            if (orbits.speeds[i] == 0.0f)
+                continue;
+
+            float angle = (float)std::fmod(orbits.speeds[i] * state.time, TWO_PI);
+            float cosAngle = std::cos(angle);
+            float sinAngle = std::sin(angle);
+
+            glm::vec3 offset = light.position - orbits.center;
+
+            state.lights[i].position = orbits.center + glm::vec3(
+                cosAngle * offset.x + sinAngle * offset.z,
+                offset.y,
+                cosAngle * offset.z - sinAngle * offset.x);
+        }
+    });
+}
+
+void interpolateSimulation(
+        const FrameSnapshot & snapshot,
+        std::chrono::steady_clock::time_point time,
+        SimulationState & state) {
+    std::chrono::duration<double> elapsed = time - snapshot.time;
+    float alpha = (float)std::min(std::max(elapsed.count() / SIMULATION_TIMESTEP, 0.0), 1.0);
+
+    const SimulationState & previous = snapshot.previous;
+    const SimulationState & current = snapshot.current;
+
+    // Discrete state switches at the current step
+    state.step = current.step;
+    state.time = previous.time + (current.time - previous.time) * alpha;
+    state.modelAngle = glm::mix(previous.modelAngle, current.modelAngle, alpha);
+    state.background = current.background;
+    state.lights = current.lights;
+
+    if (previous.lights.size() != current.lights.size())
+        return;
+
+    for (size_t i = 0; i < state.lights.size(); i++)
+        state.lights[i].position = glm::mix(previous.lights[i].position, current.lights[i].position, alpha);
+}
+
+void startSimulation(
+        const SimulationState & initial,
+        const LightOrbits & orbits,
+        SimulationInput & input,
+        Simulation & simulation) {
+    simulation.state = initial;
+    simulation.orbits = orbits;
+    simulation.input = &input;
+
+    // Fill every slot with the initial state, so a snapshot is always available
+    for (int i = 0; i < 3; i++) {
+        simulation.snapshots[i].previous = initial;
+        simulation.snapshots[i].current = initial;
+        simulation.snapshots[i].time = std::chrono::steady_clock::now();
+    }
+
+    simulation.front = 0;
+    simulation.middle.store(1);
+    simulation.back = 2;
+
+    simulation.stop.store(false);
+    simulation.thread = std::thread(runSimulation, &simulation);
+}
+
+const FrameSnapshot & acquireSnapshot(Simulation & simulation) {
+    if (simulation.middle.load(std::memory_order_relaxed) & SNAPSHOT_FRESH) {
+        uint32_t slot = simulation.middle.exchange(simulation.front, std::memory_order_acq_rel);
+        simulation.front = slot & ~SNAPSHOT_FRESH;
+    }
+
+    return simulation.snapshots[simulation.front];
+}
+
+void stopSimulation(Simulation & simulation) {
+    simulation.stop.store(true);
+
+    if (simulation.thread.joinable())
+        simulation.thread.join();
+}
@@ -0,0 +1,111 @@
+#ifndef CG20192_SIMULATION_HPP
+#define CG20192_SIMULATION_HPP
+
+#include "light_clusters.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Fixed timestep of the update thread in seconds
+const double SIMULATION_TIMESTEP = 1.0 / 60.0;
+
+// Steps the update thread runs to catch up before dropping the backlog,
+// so steps slower than the timestep slow the simulation down instead of piling up
+const size_t MAX_SIMULATION_CATCH_UP_STEPS = 4;
+
+// Model rotation about the vertical axis per key press in radians
+const float MODEL_ROTATION_STEP = 0.1f;
+
+// Input recorded by window callbacks, consumed by the update thread at its next step
+// Callbacks only add to the counters, so no event is lost between steps
+struct SimulationInput {
+    std::atomic<int32_t> rotationSteps;
+    std::atomic<uint32_t> backgroundToggles;
+};
+
+// State advanced by every simulation step, the time is in seconds
+struct SimulationState {
+    uint64_t step;
+    double time;
+    float modelAngle;
+    bool background;
+    std::vector<PointLight> lights;
+};
+
+// Lights orbiting the vertical axis through the center, static lights have zero speed
+// Positions are computed from the start positions and elapsed time, so they do not drift
+struct LightOrbits {
+    std::vector<PointLight> lights;
+    std::vector<float> speeds;
+    glm::vec3 center;
+};
+
+// Immutable result of a simulation step, holding the state of the step before for interpolation
+// The time is when the step was due, the render thread interpolates from it by the timestep
+struct FrameSnapshot {
+    SimulationState previous;
+    SimulationState current;
+    std::chrono::steady_clock::time_point time;
+};
+
+// Update thread stepping the simulation at a fixed timestep
+// Snapshots are exchanged through a lock-free triple buffer: the update thread fills the back
+// slot and swaps it with the middle slot, the render thread swaps the middle slot with the
+// front slot when it holds a newer snapshot, so neither thread ever waits for the other
+struct Simulation {
+    FrameSnapshot snapshots[3];
+    std::atomic<uint32_t> middle;
+    uint32_t back;
+    uint32_t front;
+
+    SimulationState state;
+    LightOrbits orbits;
+    SimulationInput * input;
+
+    std::atomic<bool> stop;
+    std::thread thread;
+};
+
+// Set lights orbiting center, lights from the first moving light on get random speeds
+void createLightOrbits(
+        const std::vector<PointLight> & lights,
+        size_t firstMovingLight,
+        const glm::vec3 & center,
+        LightOrbits & orbits);
+
+// Advance state by one timestep with the input received since the last step
+// Lights are moved in parallel blocks
+void stepSimulation(
+        const LightOrbits & orbits,
+        int32_t rotationSteps,
+        uint32_t backgroundToggles,
+        SimulationState & state);
+
+// Get state between the previous and current states of snapshot at time,
+// lagging one timestep behind the simulation
+void interpolateSimulation(
+        const FrameSnapshot & snapshot,
+        std::chrono::steady_clock::time_point time,
+        SimulationState & state);
+
+// Start update thread from initial state, reading input recorded by callbacks
+void startSimulation(
+        const SimulationState & initial,
+        const LightOrbits & orbits,
+        SimulationInput & input,
+        Simulation & simulation);
+
+// Get latest snapshot published by the update thread, valid until the next call
+// Must be called from a single thread
+const FrameSnapshot & acquireSnapshot(Simulation & simulation);
+
+// Stop update thread after its current step
+void stopSimulation(Simulation & simulation);
+
+#endif
@@ -0,0 +1,153 @@
+#include "stream_buffer.hpp"
+#include "gl_utility.hpp"
+#include "profiler.hpp"
+
+// Buffer storage constants of OpenGL 4.4
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace {
+
+typedef void (APIENTRYP BufferStorageProcedure)(
+    GLenum target, GLsizeiptr size, const void * data, GLbitfield flags);
+
+BufferStorageProcedure bufferStorage = nullptr;
+
+// Wait time of a fence before checking it again in nanoseconds
+const GLuint64 STREAM_FENCE_TIMEOUT = 1000000;
+
+// Persistent mapping flags, coherent so writes are visible without explicit flushes
+const GLbitfield PERSISTENT_MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+}
+
+bool loadBufferStorageProcedures(GLADloadproc load) {
+    bufferStorage = nullptr;
+
+    if (!hasVersionOrExtension(4, 4, "GL_ARB_buffer_storage"))
+        return false;
+
+    bufferStorage = (BufferStorageProcedure)load("glBufferStorage");
+
+    return isBufferStorageSupported();
+}
+
+bool isBufferStorageSupported() {
+    return bufferStorage != nullptr;
+}
+
+void createStreamBuffer(GLenum target, size_t regionSize, StreamBuffer & buffer) {
+    size_t size = regionSize * STREAM_BUFFER_REGION_COUNT;
+
+    buffer.target = target;
+    buffer.regionSize = regionSize;
+    buffer.region = STREAM_BUFFER_REGION_COUNT - 1;
+    buffer.persistentData = nullptr;
+    buffer.stallCount = 0;
+
+    for (size_t i = 0; i < STREAM_BUFFER_REGION_COUNT; i++)
+        buffer.fences[i] = nullptr;
+
+    glGenBuffers(1, &buffer.buffer);
+    glBindBuffer(target, buffer.buffer);
+
+    // Map immutable storage once for the lifetime of the buffer
+    if (isBufferStorageSupported()) {
+        bufferStorage(target, size, nullptr, PERSISTENT_MAP_FLAGS);
+        buffer.persistentData = (unsigned char *)glMapBufferRange(target, 0, size, PERSISTENT_MAP_FLAGS);
+
+        // Immutable storage cannot be reallocated, replace the buffer before falling back
+        if (buffer.persistentData == nullptr) {
+            glDeleteBuffers(1, &buffer.buffer);
+            glGenBuffers(1, &buffer.buffer);
+            glBindBuffer(target, buffer.buffer);
+        }
+    }
+
+    // Fall back to mutable storage mapped region by region
+    if (buffer.persistentData == nullptr)
+        glBufferData(target, size, nullptr, GL_STREAM_DRAW);
+}
+
+void * beginStreamRegion(StreamBuffer & buffer) {
+    PROFILE_ZONE("beginStreamRegion");
+
+    buffer.region = (buffer.region + 1) % STREAM_BUFFER_REGION_COUNT;
+
+    // Wait for the frame that last read the region, normally done long ago
+    GLsync & fence = buffer.fences[buffer.region];
+
+    if (fence != nullptr) {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+
+        if (status == GL_TIMEOUT_EXPIRED) {
+            buffer.stallCount++;
+
+            do
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_FENCE_TIMEOUT);
+            while (status == GL_TIMEOUT_EXPIRED);
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    size_t offset = buffer.region * buffer.regionSize;
+
+    glBindBuffer(buffer.target, buffer.buffer);
+
+    if (buffer.persistentData != nullptr)
+        return buffer.persistentData + offset;
+
+    // The fence already guarantees the region is unused, so the driver must not synchronize
+    return glMapBufferRange(
+        buffer.target,
+        offset,
+        buffer.regionSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+size_t endStreamRegion(StreamBuffer & buffer) {
+    if (buffer.persistentData == nullptr) {
+        glBindBuffer(buffer.target, buffer.buffer);
+        glUnmapBuffer(buffer.target);
+    }
+
+    return buffer.region * buffer.regionSize;
+}
+
+size_t abortStreamRegion(StreamBuffer & buffer) {
+    buffer.region = (buffer.region + STREAM_BUFFER_REGION_COUNT - 1) % STREAM_BUFFER_REGION_COUNT;
+
+    return buffer.region * buffer.regionSize;
+}
+
+void fenceStreamRegion(StreamBuffer & buffer) {
+    GLsync & fence = buffer.fences[buffer.region];
+
+    if (fence != nullptr)
+        glDeleteSync(fence);
+
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void deleteStreamBuffer(StreamBuffer & buffer) {
+    for (size_t i = 0; i < STREAM_BUFFER_REGION_COUNT; i++) {
+        if (buffer.fences[i] != nullptr)
+            glDeleteSync(buffer.fences[i]);
+
+        buffer.fences[i] = nullptr;
+    }
+
+    if (buffer.persistentData != nullptr) {
+        glBindBuffer(buffer.target, buffer.buffer);
+        glUnmapBuffer(buffer.target);
+    }
+
+    glDeleteBuffers(1, &buffer.buffer);
+}
@@ -0,0 +1,56 @@
+#ifndef CG20192_STREAM_BUFFER_HPP
+#define CG20192_STREAM_BUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Regions of a stream buffer, the CPU writes one while the GPU may still read the others
+const size_t STREAM_BUFFER_REGION_COUNT = 3;
+
+// Buffer object split in regions written in turn, one per frame
+// With buffer storage the buffer stays persistently mapped, otherwise each region is mapped
+// unsynchronized while it is written, in both cases fences tell when the GPU is done with a region
+// The stall count tells how many regions were still in use when they were written again
+struct StreamBuffer {
+    GLuint buffer;
+    GLenum target;
+    size_t regionSize;
+    size_t region;
+    GLsync fences[STREAM_BUFFER_REGION_COUNT];
+    unsigned char * persistentData;
+    size_t stallCount;
+};
+
+// Load buffer storage procedure missing from the OpenGL 3.3 loader
+// Fails when neither OpenGL 4.4 nor GL_ARB_buffer_storage is available,
+// then stream buffers map their regions every frame
+bool loadBufferStorageProcedures(GLADloadproc load);
+
+// Check whether stream buffers are persistently mapped
+bool isBufferStorageSupported();
+
+// Create buffer object of all regions bound to target
+void createStreamBuffer(GLenum target, size_t regionSize, StreamBuffer & buffer);
+
+// Move to the next region and get its memory to be written, waiting only when the GPU
+// is still reading it, the region stays bound to the buffer target until it is ended
+// Returns null when a region of mutable storage cannot be mapped, the region must then be aborted
+void * beginStreamRegion(StreamBuffer & buffer);
+
+// Finish writing current region
+// Returns the byte offset of the region in the buffer object
+size_t endStreamRegion(StreamBuffer & buffer);
+
+// Give up current region that could not be mapped, nothing is unmapped
+// The previous region becomes current again, so it is fenced after the commands reading it
+// Returns the byte offset of the previous region in the buffer object
+size_t abortStreamRegion(StreamBuffer & buffer);
+
+// Fence current region after the commands reading it
+void fenceStreamRegion(StreamBuffer & buffer);
+
+// Delete buffer object and fences
+void deleteStreamBuffer(StreamBuffer & buffer);
+
+#endif
@@ -0,0 +1,283 @@
+#include "tangent_space.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Triangles or vertices per parallel work item
+const size_t TANGENT_SPACE_BLOCK_SIZE = 16384;
+
+// Corners adjacent to each vertex, stored contiguously by vertex
+struct CornerAdjacency {
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> corners;
+};
+
+// Build corner adjacency with a parallel counting sort
+// Each chunk of triangles counts and places its corners in its own slots of every vertex,
+// so no two threads write the same counter and the order does not depend on scheduling
+// Every chunk holds a counter per vertex, so the chunks are limited to keep the counters
+// no larger than the corner list
+void buildCornerAdjacency(
+        const uint32_t * indices,
+        size_t cornerCount,
+        size_t vertexCount,
+        CornerAdjacency & adjacency) {
+    PROFILE_ZONE("buildCornerAdjacency");
+
+    size_t triangleCount = cornerCount / 3;
+    size_t chunkCount = std::min(getThreadCount(), triangleCount / TANGENT_SPACE_BLOCK_SIZE);
+    chunkCount = std::max(std::min(chunkCount, cornerCount / std::max(vertexCount, (size_t)1)), (size_t)1);
+    size_t chunkSize = (triangleCount + chunkCount - 1) / chunkCount;
+    size_t vertexBlockCount = (vertexCount + TANGENT_SPACE_BLOCK_SIZE - 1) / TANGENT_SPACE_BLOCK_SIZE;
+
+    // Count corners of each vertex by chunk
+    std::vector<uint32_t> counts(chunkCount * vertexCount, 0);
+
+    parallelFor(chunkCount, [&](size_t chunk, size_t) {
+        uint32_t * chunkCounts = &counts[chunk * vertexCount];
+
+        size_t end = std::min((chunk + 1) * chunkSize, triangleCount) * 3;
+
+        for (size_t i = chunk * chunkSize * 3; i < end; i++)
+            chunkCounts[indices[i]]++;
+    });
+
+    // Sum counts by vertex, then offsets are a prefix sum over vertices
+    adjacency.offsets.resize(vertexCount + 1);
+
+    parallelFor(vertexBlockCount, [&](size_t block, size_t) {
+        size_t end = std::min((block + 1) * TANGENT_SPACE_BLOCK_SIZE, vertexCount);
+
+        for (size_t i = block * TANGENT_SPACE_BLOCK_SIZE; i < end; i++) {
+            size_t count = 0;
+
+            for (size_t j = 0; j < chunkCount; j++)
+                count += counts[j * vertexCount + i];
+
+            adjacency.offsets[i + 1] = count;
+        }
+    });
+
+    adjacency.offsets[0] = 0;
+
+    for (size_t i = 0; i < vertexCount; i++)
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+
+    // Turn counts into the first slot of each chunk in each vertex
+    parallelFor(vertexBlockCount, [&](size_t block, size_t) {
+        size_t end = std::min((block + 1) * TANGENT_SPACE_BLOCK_SIZE, vertexCount);
+
+        for (size_t i = block * TANGENT_SPACE_BLOCK_SIZE; i < end; i++) {
+            uint32_t cursor = 0;
+
+            for (size_t j = 0; j < chunkCount; j++) {
+                uint32_t count = counts[j * vertexCount + i];
+                counts[j * vertexCount + i] = cursor;
+                cursor += count;
+            }
+        }
+    });
+
+    // Place corners in chunk order
+    adjacency.corners.resize(triangleCount * 3);
+
+    parallelFor(chunkCount, [&](size_t chunk, size_t) {
+        uint32_t * cursors = &counts[chunk * vertexCount];
+
+        size_t end = std::min((chunk + 1) * chunkSize, triangleCount) * 3;
+
+        for (size_t i = chunk * chunkSize * 3; i < end; i++) {
+            uint32_t vertex = indices[i];
+            adjacency.corners[adjacency.offsets[vertex] + cursors[vertex]++] = (uint32_t)i;
+        }
+    });
+}
+
+// Get interior angle of triangle at corner
+inline float getCornerAngle(const glm::vec3 & corner, const glm::vec3 & next, const glm::vec3 & previous) {
+    glm::vec3 u = next - corner;
+    glm::vec3 v = previous - corner;
+
+    float lengths = std::sqrt(glm::dot(u, u) * glm::dot(v, v));
+
+    if (lengths <= 0.0f)
+        return 0.0f;
+
+    return std::acos(glm::clamp(glm::dot(u, v) / lengths, -1.0f, 1.0f));
+}
+
+// Normalize vector, or return fallback when it has no direction
+inline glm::vec3 normalizeOr(const glm::vec3 & v, const glm::vec3 & fallback) {
+    float length = glm::length(v);
+    return length > 0.0f ? v / length : fallback;
+}
+
+}
+
+void generateSmoothNormals(
+        const std::vector<glm::vec3> & positions,
+        const std::vector<uint32_t> & positionIndices,
+        float creaseAngle,
+        NormalWeighting weighting,
+        std::vector<glm::vec3> & normals) {
+    PROFILE_ZONE("generateSmoothNormals");
+
+    size_t triangleCount = positionIndices.size() / 3;
+    size_t triangleBlockCount = (triangleCount + TANGENT_SPACE_BLOCK_SIZE - 1) / TANGENT_SPACE_BLOCK_SIZE;
+
+    // Triangle normals and weights of their corners
+    std::vector<glm::vec3> triangleNormals(triangleCount);
+    std::vector<float> weights(triangleCount * 3);
+
+    parallelFor(triangleBlockCount, [&](size_t block, size_t) {
+        size_t end = std::min((block + 1) * TANGENT_SPACE_BLOCK_SIZE, triangleCount);
+
+        for (size_t i = block * TANGENT_SPACE_BLOCK_SIZE; i < end; i++) {
+            const glm::vec3 & a = positions[positionIndices[i * 3 + 0]];
+            const glm::vec3 & b = positions[positionIndices[i * 3 + 1]];
+            const glm::vec3 & c = positions[positionIndices[i * 3 + 2]];
+
+            glm::vec3 n = glm::cross(b - a, c - a);
+            float area = glm::length(n);
+
+            triangleNormals[i] = area > 0.0f ? n / area : glm::vec3(0.0f);
+
+            if (weighting == NORMAL_WEIGHTING_AREA) {
+                weights[i * 3 + 0] = weights[i * 3 + 1] = weights[i * 3 + 2] = area;
+            }
+            else {
+                weights[i * 3 + 0] = getCornerAngle(a, b, c);
+                weights[i * 3 + 1] = getCornerAngle(b, c, a);
+                weights[i * 3 + 2] = getCornerAngle(c, a, b);
+            }
+        }
+    });
+
+    CornerAdjacency adjacency;
+    buildCornerAdjacency(positionIndices.data(), triangleCount * 3, positions.size(), adjacency);
+
+    // Gather normals of smoothed triangles around each corner, every corner writes only itself
+    float creaseCosine = std::cos(glm::radians(creaseAngle));
+
+    normals.resize(triangleCount * 3);
+
+    parallelFor(triangleBlockCount, [&](size_t block, size_t) {
+        size_t end = std::min((block + 1) * TANGENT_SPACE_BLOCK_SIZE, triangleCount);
+
+        for (size_t i = block * TANGENT_SPACE_BLOCK_SIZE; i < end; i++) {
+            const glm::vec3 & triangleNormal = triangleNormals[i];
+
+            for (size_t j = 0; j < 3; j++) {
+                uint32_t position = positionIndices[i * 3 + j];
+                glm::vec3 normal(0.0f);
+
+                for (size_t k = adjacency.offsets[position]; k < adjacency.offsets[position + 1]; k++) {
+                    uint32_t corner = adjacency.corners[k];
+                    const glm::vec3 & otherNormal = triangleNormals[corner / 3];
+
+                    if (glm::dot(triangleNormal, otherNormal) >= creaseCosine)
+                        normal += otherNormal * weights[corner];
+                }
+
+                normals[i * 3 + j] = normalizeOr(normal, normalizeOr(triangleNormal, glm::vec3(0.0f, 0.0f, 1.0f)));
+            }
+        }
+    });
+}
+
+void generateTangents(const TriangleMesh & mesh, std::vector<glm::vec4> & tangents) {
+    PROFILE_ZONE("generateTangents");
+
+    const std::vector<Vertex> & vertices = mesh.vertices;
+    const uint32_t * indices = mesh.indices.data() + mesh.levels[0].indexOffset;
+
+    size_t triangleCount = mesh.levels[0].indexCount / 3;
+    size_t vertexCount = vertices.size();
+
+    size_t triangleBlockCount = (triangleCount + TANGENT_SPACE_BLOCK_SIZE - 1) / TANGENT_SPACE_BLOCK_SIZE;
+    size_t vertexBlockCount = (vertexCount + TANGENT_SPACE_BLOCK_SIZE - 1) / TANGENT_SPACE_BLOCK_SIZE;
+
+    // Position derivative along the first texture coordinate of each triangle,
+    // scaled by the sign of its texture area as in MikkTSpace
+    std::vector<glm::vec3> triangleTangents(triangleCount);
+    std::vector<unsigned char> triangleOrientations(triangleCount);
+
+    parallelFor(triangleBlockCount, [&](size_t block, size_t) {
+        size_t end = std::min((block + 1) * TANGENT_SPACE_BLOCK_SIZE, triangleCount);
+
+        for (size_t i = block * TANGENT_SPACE_BLOCK_SIZE; i < end; i++) {
+            const Vertex & a = vertices[indices[i * 3 + 0]];
+            const Vertex & b = vertices[indices[i * 3 + 1]];
+            const Vertex & c = vertices[indices[i * 3 + 2]];
+
+            glm::vec3 e1 = b.position - a.position;
+            glm::vec3 e2 = c.position - a.position;
+            glm::vec2 t1 = b.textureCoordinate - a.textureCoordinate;
+            glm::vec2 t2 = c.textureCoordinate - a.textureCoordinate;
+
+            float signedArea = t1.x * t2.y - t2.x * t1.y;
+            float sign = signedArea < 0.0f ? -1.0f : 1.0f;
+
+            triangleTangents[i] = (e1 * t2.y - e2 * t1.y) * sign;
+            triangleOrientations[i] = signedArea >= 0.0f;
+        }
+    });
+
+    CornerAdjacency adjacency;
+    buildCornerAdjacency(indices, triangleCount * 3, vertexCount, adjacency);
+
+    // Average projected triangle tangents by corner angle, separately for each orientation,
+    // and keep the orientation with the larger weight as vertices are not split
+    tangents.resize(vertexCount);
+
+    parallelFor(vertexBlockCount, [&](size_t block, size_t) {
+        size_t end = std::min((block + 1) * TANGENT_SPACE_BLOCK_SIZE, vertexCount);
+
+        for (size_t i = block * TANGENT_SPACE_BLOCK_SIZE; i < end; i++) {
+            glm::vec3 normal = normalizeOr(vertices[i].normal, glm::vec3(0.0f, 0.0f, 1.0f));
+
+            glm::vec3 tangentSums[2] = { glm::vec3(0.0f), glm::vec3(0.0f) };
+            float weightSums[2] = { 0.0f, 0.0f };
+
+            for (size_t k = adjacency.offsets[i]; k < adjacency.offsets[i + 1]; k++) {
+                uint32_t corner = adjacency.corners[k];
+                uint32_t triangle = corner / 3;
+
+                const glm::vec3 & p = vertices[indices[corner]].position;
+                const glm::vec3 & next = vertices[indices[triangle * 3 + (corner + 1) % 3]].position;
+                const glm::vec3 & previous = vertices[indices[triangle * 3 + (corner + 2) % 3]].position;
+
+                glm::vec3 tangent = triangleTangents[triangle];
+                tangent -= normal * glm::dot(normal, tangent);
+
+                float length = glm::length(tangent);
+
+                if (length <= 0.0f)
+                    continue;
+
+                float weight = getCornerAngle(p, next, previous);
+                int orientation = triangleOrientations[triangle];
+
+                tangentSums[orientation] += tangent / length * weight;
+                weightSums[orientation] += weight;
+            }
+
+            int orientation = weightSums[1] >= weightSums[0] ? 1 : 0;
+
+            // Fall back to any direction perpendicular to the normal
+            glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::vec3 fallback = glm::normalize(axis - normal * glm::dot(normal, axis));
+
+            glm::vec3 tangent = tangentSums[orientation];
+            tangent = normalizeOr(tangent - normal * glm::dot(normal, tangent), fallback);
+
+            tangents[i] = glm::vec4(tangent, orientation ? 1.0f : -1.0f);
+        }
+    });
+}
@@ -0,0 +1,38 @@
+#ifndef CG20192_TANGENT_SPACE_HPP
+#define CG20192_TANGENT_SPACE_HPP
+
+#include "mesh.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Weight of each triangle in the smooth normal of its corners
+enum NormalWeighting {
+    NORMAL_WEIGHTING_ANGLE,
+    NORMAL_WEIGHTING_AREA
+};
+
+// Largest angle in degrees between faces smoothed together
+const float DEFAULT_CREASE_ANGLE = 60.0f;
+
+// Generate smooth normal of each triangle corner from positions
+// A corner averages the normals of triangles sharing its position whose normal is within
+// the crease angle of its own triangle normal, so sharp edges stay faceted
+// Triangles are processed in parallel blocks without atomics
+void generateSmoothNormals(
+        const std::vector<glm::vec3> & positions,
+        const std::vector<uint32_t> & positionIndices,
+        float creaseAngle,
+        NormalWeighting weighting,
+        std::vector<glm::vec3> & normals);
+
+// Generate tangent of each vertex from texture coordinates of the full resolution level
+// Tangents follow MikkTSpace: triangle tangents are projected on the vertex normal plane
+// and averaged by corner angle among triangles of the same texture orientation
+// The bitangent is cross(normal, tangent.xyz) * tangent.w
+void generateTangents(const TriangleMesh & mesh, std::vector<glm::vec4> & tangents);
+
+#endif
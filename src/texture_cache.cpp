@@ -0,0 +1,447 @@
+#include "texture_cache.hpp"
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+// KTX 1.1 file identifier and byte order marker
+const unsigned char KTX_IDENTIFIER[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+// Rows, key-value pairs and levels are aligned to 4 bytes as required by KTX
+const size_t KTX_ALIGNMENT = 4;
+
+// Metadata keys identifying the source file, the mipmap and the compression settings
+// The version must be increased whenever the mipmap filtering changes
+// Caches without compression settings were written before compression and are uncompressed
+const char SOURCE_KEY[] = "CG20192Source";
+const char MIPMAP_KEY[] = "CG20192Mipmap";
+const char COMPRESSION_KEY[] = "CG20192Compression";
+const uint32_t MIPMAP_VERSION = 1;
+
+// KTX 1.1 file header
+struct KtxHeader {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+static_assert(sizeof(KtxHeader) == 64, "Unexpected KTX header padding");
+
+// Source file identification stored as metadata value
+struct SourceMetadata {
+    uint64_t size;
+    int64_t modificationTime;
+    uint64_t hash;
+};
+
+// Mipmap settings stored as metadata value
+struct MipmapMetadata {
+    uint32_t version;
+    uint32_t filter;
+    uint32_t sRGB;
+};
+
+// Compression settings stored as metadata value, the quality is zero without compression
+struct CompressionMetadata {
+    uint32_t format;
+    uint32_t quality;
+};
+
+inline size_t alignSize(size_t size) {
+    return (size + KTX_ALIGNMENT - 1) / KTX_ALIGNMENT * KTX_ALIGNMENT;
+}
+
+// Append key-value pair with padding
+void appendKeyValue(
+        std::vector<unsigned char> & buffer,
+        const char * key,
+        const void * value,
+        size_t valueSize) {
+    size_t keySize = std::strlen(key) + 1;
+    uint32_t size = (uint32_t)(keySize + valueSize);
+
+    const unsigned char * sizeBytes = (const unsigned char *)&size;
+    buffer.insert(buffer.end(), sizeBytes, sizeBytes + sizeof(size));
+    buffer.insert(buffer.end(), key, key + keySize);
+    buffer.insert(buffer.end(), (const unsigned char *)value, (const unsigned char *)value + valueSize);
+    buffer.resize(alignSize(buffer.size()), 0);
+}
+
+// Find value of key in key-value data
+const unsigned char * findKeyValue(
+        const unsigned char * data,
+        size_t size,
+        const char * key,
+        size_t valueSize) {
+    size_t keySize = std::strlen(key) + 1;
+    size_t offset = 0;
+
+    while (offset + sizeof(uint32_t) <= size) {
+        uint32_t pairSize;
+        std::memcpy(&pairSize, data + offset, sizeof(pairSize));
+        offset += sizeof(pairSize);
+
+        if (pairSize > size - offset)
+            return nullptr;
+
+        if (pairSize == keySize + valueSize && std::memcmp(data + offset, key, keySize) == 0)
+            return data + offset + keySize;
+
+        offset += alignSize(pairSize);
+    }
+
+    return nullptr;
+}
+
+// Get compression settings as stored in metadata
+CompressionMetadata getCompressionMetadata(const TextureCompressionSettings & compression) {
+    CompressionMetadata metadata;
+    metadata.format = (uint32_t)compression.format;
+    metadata.quality = compression.format == TEXTURE_COMPRESSION_NONE ? 0 : compression.quality;
+
+    return metadata;
+}
+
+// Get number of levels in a complete mipmap chain
+size_t getLevelCount(size_t width, size_t height) {
+    size_t count = 1;
+
+    while (width > 1 || height > 1) {
+        width = std::max(width / 2, (size_t)1);
+        height = std::max(height / 2, (size_t)1);
+        count++;
+    }
+
+    return count;
+}
+
+// Identify source file and settings in metadata, then write header, metadata and levels
+bool writeCacheFile(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        KtxHeader & header,
+        const std::vector<unsigned char> & levelData) {
+    SourceMetadata source;
+
+    if (!getFileStatus(sourceFilename, source.size, source.modificationTime))
+        return false;
+
+    if (!hashFile(sourceFilename, source.hash))
+        return false;
+
+    MipmapMetadata mipmap;
+    mipmap.version = MIPMAP_VERSION;
+    mipmap.filter = (uint32_t)filter;
+    mipmap.sRGB = (uint32_t)sRGB;
+
+    CompressionMetadata compressionMetadata = getCompressionMetadata(compression);
+
+    std::vector<unsigned char> keyValueData;
+    appendKeyValue(keyValueData, SOURCE_KEY, &source, sizeof(source));
+    appendKeyValue(keyValueData, MIPMAP_KEY, &mipmap, sizeof(mipmap));
+    appendKeyValue(keyValueData, COMPRESSION_KEY, &compressionMetadata, sizeof(compressionMetadata));
+
+    header.bytesOfKeyValueData = (uint32_t)keyValueData.size();
+
+    const void * blocks[] = { &header, keyValueData.data(), levelData.data() };
+    size_t sizes[] = { sizeof(header), keyValueData.size(), levelData.size() };
+
+    return writeFileAtomic(filename, blocks, sizes, sizeof(sizes) / sizeof(sizes[0]));
+}
+
+}
+
+void getTextureFormat(
+        const Image & image,
+        bool sRGB,
+        uint32_t & internalFormat,
+        uint32_t & format,
+        uint32_t & type) {
+    bool grayscale = image.channelCount == 1;
+    bool wide = image.channelSize == 2;
+
+    if (wide)
+        internalFormat = grayscale ? GL_R16 : GL_RGB16;
+    else if (sRGB)
+        internalFormat = GL_SRGB8;
+    else
+        internalFormat = grayscale ? GL_R8 : GL_RGB8;
+
+    format = grayscale ? GL_RED : GL_RGB;
+    type = wide ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+}
+
+std::string getTextureCacheFilename(const std::string & sourceFilename) {
+    size_t extension = sourceFilename.find_last_of('.');
+    size_t separator = sourceFilename.find_last_of("/\\");
+
+    if (extension == std::string::npos
+            || (separator != std::string::npos && extension < separator))
+        return sourceFilename + ".ktx";
+
+    return sourceFilename.substr(0, extension) + ".ktx";
+}
+
+bool openTextureCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        TextureCache & cache) {
+    PROFILE_ZONE("openTextureCache");
+
+    if (!openMappedFile(filename, cache.file))
+        return false;
+
+    const unsigned char * data = (const unsigned char *)cache.file.data;
+    size_t size = cache.file.size;
+
+    KtxHeader header;
+
+    if (size < sizeof(header)) {
+        closeMappedFile(cache.file);
+        return false;
+    }
+
+    std::memcpy(&header, data, sizeof(header));
+
+    // Validate uncompressed or block compressed two-dimensional texture with complete mipmap chain
+    TextureCompression format = getTextureCompression(header.glInternalFormat);
+    bool compressed = format != TEXTURE_COMPRESSION_NONE;
+
+    bool valid = std::memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0
+        && header.endianness == KTX_ENDIANNESS
+        && (compressed
+            ? header.glType == 0 && header.glTypeSize == 1 && header.glFormat == 0
+            : (header.glTypeSize == 1 || header.glTypeSize == 2) && (header.glFormat == GL_RED || header.glFormat == GL_RGB))
+        && header.pixelWidth > 0 && header.pixelHeight > 0
+        && header.pixelDepth == 0
+        && header.numberOfArrayElements == 0
+        && header.numberOfFaces == 1
+        && header.numberOfMipmapLevels == getLevelCount(header.pixelWidth, header.pixelHeight)
+        && header.bytesOfKeyValueData <= size - sizeof(header);
+
+    // Validate mipmap and compression settings and source file
+    const unsigned char * keyValueData = data + sizeof(header);
+
+    const unsigned char * sourceValue = valid
+        ? findKeyValue(keyValueData, header.bytesOfKeyValueData, SOURCE_KEY, sizeof(SourceMetadata))
+        : nullptr;
+
+    const unsigned char * mipmapValue = valid
+        ? findKeyValue(keyValueData, header.bytesOfKeyValueData, MIPMAP_KEY, sizeof(MipmapMetadata))
+        : nullptr;
+
+    const unsigned char * compressionValue = valid
+        ? findKeyValue(keyValueData, header.bytesOfKeyValueData, COMPRESSION_KEY, sizeof(CompressionMetadata))
+        : nullptr;
+
+    valid = sourceValue != nullptr && mipmapValue != nullptr;
+
+    if (valid) {
+        MipmapMetadata mipmap;
+        std::memcpy(&mipmap, mipmapValue, sizeof(mipmap));
+
+        CompressionMetadata cachedCompression = getCompressionMetadata(TextureCompressionSettings());
+        CompressionMetadata requestedCompression = getCompressionMetadata(compression);
+
+        if (compressionValue != nullptr)
+            std::memcpy(&cachedCompression, compressionValue, sizeof(cachedCompression));
+
+        SourceMetadata source;
+        std::memcpy(&source, sourceValue, sizeof(source));
+
+        uint64_t sourceSize;
+        int64_t sourceModificationTime;
+
+        valid = mipmap.version == MIPMAP_VERSION
+            && mipmap.filter == (uint32_t)filter
+            && mipmap.sRGB == (uint32_t)sRGB
+            && cachedCompression.format == requestedCompression.format
+            && cachedCompression.quality == requestedCompression.quality
+            && getFileStatus(sourceFilename, sourceSize, sourceModificationTime)
+            && sourceSize == source.size;
+
+        if (valid && sourceModificationTime != source.modificationTime) {
+            uint64_t sourceHash;
+            valid = hashFile(sourceFilename, sourceHash) && sourceHash == source.hash;
+        }
+    }
+
+    // Locate levels
+    cache.levels.clear();
+
+    size_t offset = sizeof(header) + header.bytesOfKeyValueData;
+    size_t channelCount = header.glFormat == GL_RGB ? 3 : 1;
+    size_t width = header.pixelWidth;
+    size_t height = header.pixelHeight;
+
+    for (uint32_t i = 0; valid && i < header.numberOfMipmapLevels; i++) {
+        uint32_t imageSize;
+
+        if (offset + sizeof(imageSize) > size) {
+            valid = false;
+            break;
+        }
+
+        std::memcpy(&imageSize, data + offset, sizeof(imageSize));
+        offset += sizeof(imageSize);
+
+        size_t expectedSize = compressed
+            ? getCompressedImageSize(format, width, height)
+            : alignSize(width * channelCount * header.glTypeSize) * height;
+
+        if (imageSize != expectedSize || imageSize > size - offset) {
+            valid = false;
+            break;
+        }
+
+        TextureLevel level;
+        level.width = width;
+        level.height = height;
+        level.data = data + offset;
+        level.size = imageSize;
+
+        cache.levels.push_back(level);
+
+        offset += alignSize(imageSize);
+        width = std::max(width / 2, (size_t)1);
+        height = std::max(height / 2, (size_t)1);
+    }
+
+    if (!valid) {
+        cache.levels.clear();
+        closeMappedFile(cache.file);
+        return false;
+    }
+
+    cache.internalFormat = header.glInternalFormat;
+    cache.format = header.glFormat;
+    cache.type = header.glType;
+    cache.alignment = KTX_ALIGNMENT;
+
+    return true;
+}
+
+void closeTextureCache(TextureCache & cache) {
+    cache.levels.clear();
+    closeMappedFile(cache.file);
+}
+
+bool writeTextureCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        const std::vector<Image> & levels) {
+    PROFILE_ZONE("writeTextureCache");
+
+    if (levels.empty())
+        return false;
+
+    const Image & image = levels[0];
+
+    // Fill header
+    KtxHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+
+    getTextureFormat(image, sRGB, header.glInternalFormat, header.glFormat, header.glType);
+
+    header.endianness = KTX_ENDIANNESS;
+    header.glTypeSize = (uint32_t)image.channelSize;
+    header.glBaseInternalFormat = header.glFormat;
+    header.pixelWidth = (uint32_t)image.width;
+    header.pixelHeight = (uint32_t)image.height;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (uint32_t)levels.size();
+
+    // Serialize levels with padded rows
+    std::vector<unsigned char> levelData;
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const Image & level = levels[i];
+
+        size_t pixelRowSize = level.width * level.channelCount * level.channelSize;
+        size_t rowSize = alignSize(pixelRowSize);
+        uint32_t imageSize = (uint32_t)(rowSize * level.height);
+
+        size_t offset = levelData.size();
+        levelData.resize(offset + sizeof(imageSize) + imageSize, 0);
+
+        std::memcpy(&levelData[offset], &imageSize, sizeof(imageSize));
+        offset += sizeof(imageSize);
+
+        for (size_t y = 0; y < level.height; y++)
+            std::memcpy(&levelData[offset + y * rowSize], &level.pixels[y * pixelRowSize], pixelRowSize);
+    }
+
+    return writeCacheFile(filename, sourceFilename, sRGB, filter, compression, header, levelData);
+}
+
+bool writeCompressedTextureCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        const std::vector<CompressedImage> & levels) {
+    PROFILE_ZONE("writeCompressedTextureCache");
+
+    if (levels.empty())
+        return false;
+
+    const CompressedImage & image = levels[0];
+
+    // Fill header, compressed textures have no pixel format and type
+    KtxHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+
+    header.endianness = KTX_ENDIANNESS;
+    header.glTypeSize = 1;
+    header.glInternalFormat = getCompressedTextureFormat(image.format, sRGB);
+    header.glBaseInternalFormat = image.format == TEXTURE_COMPRESSION_BC1 ? GL_RGB : GL_RGBA;
+    header.pixelWidth = (uint32_t)image.width;
+    header.pixelHeight = (uint32_t)image.height;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (uint32_t)levels.size();
+
+    // Serialize levels, block sizes are multiples of the KTX alignment
+    std::vector<unsigned char> levelData;
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const CompressedImage & level = levels[i];
+        uint32_t imageSize = (uint32_t)level.blocks.size();
+
+        const unsigned char * sizeBytes = (const unsigned char *)&imageSize;
+        levelData.insert(levelData.end(), sizeBytes, sizeBytes + sizeof(imageSize));
+        levelData.insert(levelData.end(), level.blocks.begin(), level.blocks.end());
+    }
+
+    return writeCacheFile(filename, sourceFilename, sRGB, filter, compression, header, levelData);
+}
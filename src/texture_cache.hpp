@@ -0,0 +1,78 @@
+#ifndef CG20192_TEXTURE_CACHE_HPP
+#define CG20192_TEXTURE_CACHE_HPP
+
+#include "file.hpp"
+#include "image.hpp"
+#include "mipmap.hpp"
+#include "texture_compression.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Texture level ready for upload
+// Rows are padded to the row alignment in bytes, compressed levels hold rows of blocks
+struct TextureLevel {
+    size_t width;
+    size_t height;
+    const void * data;
+    size_t size;
+};
+
+// Texture cache file in KTX 1.1 layout with a complete mipmap chain
+// Levels point directly into the mapped file, compressed caches have no format and type
+struct TextureCache {
+    MappedFile file;
+
+    uint32_t internalFormat;
+    uint32_t format;
+    uint32_t type;
+    size_t alignment;
+
+    std::vector<TextureLevel> levels;
+};
+
+// Get OpenGL internal format, pixel format and type storing image without conversion
+// 8-bit images can be stored as sRGB, 16-bit images are always linear
+void getTextureFormat(
+        const Image & image,
+        bool sRGB,
+        uint32_t & internalFormat,
+        uint32_t & format,
+        uint32_t & type);
+
+// Get texture cache filename stored next to the source file
+std::string getTextureCacheFilename(const std::string & sourceFilename);
+
+// Map texture cache file and validate it against the source file, mipmap and compression settings
+// The compression settings are the requested ones, images that cannot be compressed are cached uncompressed
+bool openTextureCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        TextureCache & cache);
+
+// Unmap texture cache file
+void closeTextureCache(TextureCache & cache);
+
+// Write mipmap chain to texture cache file
+bool writeTextureCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        const std::vector<Image> & levels);
+
+// Write compressed mipmap chain to texture cache file
+bool writeCompressedTextureCache(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        bool sRGB,
+        MipmapFilter filter,
+        const TextureCompressionSettings & compression,
+        const std::vector<CompressedImage> & levels);
+
+#endif
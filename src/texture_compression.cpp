@@ -0,0 +1,681 @@
+#include "texture_compression.hpp"
+#include "gl_utility.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// Compressed formats of GL_EXT_texture_compression_s3tc, GL_EXT_texture_sRGB and OpenGL 4.2
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+namespace {
+
+const size_t BLOCK_PIXEL_COUNT = COMPRESSION_BLOCK_SIZE * COMPRESSION_BLOCK_SIZE;
+
+// Bytes of a block
+const size_t BC1_BLOCK_SIZE = 8;
+const size_t BC7_BLOCK_SIZE = 16;
+
+// Interpolation weights of BC1 indices, indices 0 and 1 select the endpoints
+const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+// Interpolation weights of 4-bit BC7 indices in 64ths
+const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// BC7 mode 6 fields, the mode is the position of the first set bit
+const uint32_t BC7_MODE_6 = 1 << 6;
+const size_t BC7_MODE_BITS = 7;
+const size_t BC7_ENDPOINT_BITS = 7;
+const size_t BC7_INDEX_BITS = 4;
+const int BC7_MAX_ENDPOINT = (1 << BC7_ENDPOINT_BITS) - 1;
+
+// Least squares refinements by quality, refinement stops once the error no longer decreases
+const size_t REFINEMENT_COUNTS[MAX_COMPRESSION_QUALITY + 1] = { 0, 1, 4, 8 };
+
+// Rounds of neighboring endpoint search at the highest quality
+const size_t NEIGHBOR_SEARCH_ROUNDS = 4;
+
+// Power iterations finding the principal axis of block colors
+const size_t POWER_ITERATION_COUNT = 8;
+
+// Smallest determinant of the least squares system, smaller ones mean a single weight
+const float MIN_DETERMINANT = 1e-6f;
+
+// Colors of a block in structure of arrays layout, pixels in row-major order
+struct BlockPixels {
+    float channels[3][BLOCK_PIXEL_COUNT];
+};
+
+// Colors selected by block indices
+struct BlockPalette {
+    float colors[16][3];
+    size_t size;
+};
+
+// BC1 block with the larger endpoint first, so it decodes in 4-color mode
+struct Bc1Block {
+    uint16_t endpoints[2];
+    uint8_t indices[BLOCK_PIXEL_COUNT];
+    float error;
+};
+
+// BC7 endpoint with 7-bit channels and the bit extending them to 8 bits
+struct Bc7Endpoint {
+    int channels[3];
+    int extension;
+};
+
+// BC7 mode 6 block
+struct Bc7Block {
+    Bc7Endpoint endpoints[2];
+    uint8_t indices[BLOCK_PIXEL_COUNT];
+    float error;
+};
+
+inline glm::vec3 getPixel(const BlockPixels & pixels, size_t i) {
+    return glm::vec3(pixels.channels[0][i], pixels.channels[1][i], pixels.channels[2][i]);
+}
+
+// Copy block of image, clamping pixels outside the image to its edges
+void loadBlock(const Image & image, size_t blockX, size_t blockY, BlockPixels & pixels) {
+    for (size_t y = 0; y < COMPRESSION_BLOCK_SIZE; y++) {
+        size_t row = std::min(blockY * COMPRESSION_BLOCK_SIZE + y, image.height - 1);
+
+        for (size_t x = 0; x < COMPRESSION_BLOCK_SIZE; x++) {
+            size_t column = std::min(blockX * COMPRESSION_BLOCK_SIZE + x, image.width - 1);
+            const unsigned char * pixel = &image.pixels[(row * image.width + column) * image.channelCount];
+
+            for (size_t c = 0; c < 3; c++)
+                pixels.channels[c][y * COMPRESSION_BLOCK_SIZE + x] = pixel[image.channelCount == 1 ? 0 : c];
+        }
+    }
+}
+
+#ifndef CG20192_SSE2
+// Select closest palette color of every pixel
+// Returns the sum of squared errors
+float findIndices(const BlockPixels & pixels, const BlockPalette & palette, uint8_t * indices) {
+    float error = 0.0f;
+
+    for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i++) {
+        float best = FLT_MAX;
+
+        for (size_t j = 0; j < palette.size; j++) {
+            float dr = pixels.channels[0][i] - palette.colors[j][0];
+            float dg = pixels.channels[1][i] - palette.colors[j][1];
+            float db = pixels.channels[2][i] - palette.colors[j][2];
+            float distance = dr * dr + dg * dg + db * db;
+
+            if (distance < best) {
+                best = distance;
+                indices[i] = (uint8_t)j;
+            }
+        }
+
+        error += best;
+    }
+
+    return error;
+}
+#else
+// Select closest palette color of every pixel, four pixels at a time
+// Returns the sum of squared errors
+float findIndices(const BlockPixels & pixels, const BlockPalette & palette, uint8_t * indices) {
+    float error = 0.0f;
+
+    for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i += 4) {
+        __m128 r = _mm_loadu_ps(&pixels.channels[0][i]);
+        __m128 g = _mm_loadu_ps(&pixels.channels[1][i]);
+        __m128 b = _mm_loadu_ps(&pixels.channels[2][i]);
+
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestIndices = _mm_setzero_si128();
+
+        for (size_t j = 0; j < palette.size; j++) {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette.colors[j][0]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette.colors[j][1]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette.colors[j][2]));
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+            // Keep the first closest color as the scalar code does
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+
+            best = _mm_min_ps(distance, best);
+            bestIndices = _mm_or_si128(
+                _mm_and_si128(closer, _mm_set1_epi32((int)j)),
+                _mm_andnot_si128(closer, bestIndices));
+        }
+
+        int32_t laneIndices[4];
+        float laneErrors[4];
+
+        _mm_storeu_si128((__m128i *)laneIndices, bestIndices);
+        _mm_storeu_ps(laneErrors, best);
+
+        for (size_t k = 0; k < 4; k++) {
+            indices[i + k] = (uint8_t)laneIndices[k];
+            error += laneErrors[k];
+        }
+    }
+
+    return error;
+}
+#endif
+
+// Get corners of the bounding box of block colors
+void findBoundingBoxEndpoints(const BlockPixels & pixels, glm::vec3 & endpoint0, glm::vec3 & endpoint1) {
+    endpoint0 = glm::vec3(FLT_MAX);
+    endpoint1 = glm::vec3(-FLT_MAX);
+
+    for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i++) {
+        endpoint0 = glm::min(endpoint0, getPixel(pixels, i));
+        endpoint1 = glm::max(endpoint1, getPixel(pixels, i));
+    }
+}
+
+// Get extreme block colors projected on their principal axis, found by power iteration
+// on the covariance matrix, uniform blocks get their color as both endpoints
+void findPrincipalEndpoints(const BlockPixels & pixels, glm::vec3 & endpoint0, glm::vec3 & endpoint1) {
+    glm::vec3 mean(0.0f);
+
+    for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i++)
+        mean += getPixel(pixels, i);
+
+    mean /= (float)BLOCK_PIXEL_COUNT;
+
+    glm::mat3 covariance(0.0f);
+
+    for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i++) {
+        glm::vec3 offset = getPixel(pixels, i) - mean;
+        covariance += glm::outerProduct(offset, offset);
+    }
+
+    // Start from the channel of largest variance
+    size_t channel = 0;
+
+    for (size_t c = 1; c < 3; c++) {
+        if (covariance[c][c] > covariance[channel][channel])
+            channel = c;
+    }
+
+    glm::vec3 axis = covariance[channel];
+
+    for (size_t i = 0; i < POWER_ITERATION_COUNT; i++) {
+        float scale = std::max(std::max(std::abs(axis.x), std::abs(axis.y)), std::abs(axis.z));
+
+        if (scale == 0.0f)
+            break;
+
+        axis = covariance * (axis / scale);
+    }
+
+    float length = glm::length(axis);
+    axis = length > 0.0f ? axis / length : glm::vec3(0.0f);
+
+    float minProjection = FLT_MAX;
+    float maxProjection = -FLT_MAX;
+
+    for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i++) {
+        float projection = glm::dot(getPixel(pixels, i) - mean, axis);
+
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    endpoint0 = glm::clamp(mean + minProjection * axis, 0.0f, 255.0f);
+    endpoint1 = glm::clamp(mean + maxProjection * axis, 0.0f, 255.0f);
+}
+
+// Fit endpoints minimizing the squared error of pixels interpolated by the weights of their indices
+// Fails when every pixel has the same weight
+bool fitEndpoints(
+        const BlockPixels & pixels,
+        const uint8_t * indices,
+        const float * weights,
+        glm::vec3 & endpoint0,
+        glm::vec3 & endpoint1) {
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    glm::vec3 x(0.0f), y(0.0f);
+
+    for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i++) {
+        float t = weights[indices[i]];
+        float s = 1.0f - t;
+        glm::vec3 color = getPixel(pixels, i);
+
+        a += s * s;
+        b += s * t;
+        c += t * t;
+        x += s * color;
+        y += t * color;
+    }
+
+    float determinant = a * c - b * b;
+
+    if (std::abs(determinant) < MIN_DETERMINANT)
+        return false;
+
+    endpoint0 = glm::clamp((c * x - b * y) / determinant, 0.0f, 255.0f);
+    endpoint1 = glm::clamp((a * y - b * x) / determinant, 0.0f, 255.0f);
+
+    return true;
+}
+
+inline int quantizeChannel(float value, int maxValue) {
+    return std::min(std::max((int)std::floor(value * maxValue / 255.0f + 0.5f), 0), maxValue);
+}
+
+inline uint16_t quantizeBc1(const glm::vec3 & color) {
+    return (uint16_t)((quantizeChannel(color.r, 31) << 11) | (quantizeChannel(color.g, 63) << 5) | quantizeChannel(color.b, 31));
+}
+
+// Expand RGB565 color to 8-bit channels by bit replication
+inline glm::vec3 expandBc1(uint16_t color) {
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+
+    return glm::vec3((float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)));
+}
+
+// Encode block with quantized endpoints, ordered so the block decodes in 4-color mode
+// Equal endpoints select the first endpoint for every pixel
+void evaluateBc1(const BlockPixels & pixels, uint16_t endpoint0, uint16_t endpoint1, Bc1Block & block) {
+    if (endpoint0 < endpoint1)
+        std::swap(endpoint0, endpoint1);
+
+    glm::vec3 color0 = expandBc1(endpoint0);
+    glm::vec3 color1 = expandBc1(endpoint1);
+
+    BlockPalette palette;
+    palette.size = endpoint0 == endpoint1 ? 1 : 4;
+
+    for (size_t k = 0; k < palette.size; k++) {
+        glm::vec3 color = glm::mix(color0, color1, BC1_WEIGHTS[k]);
+
+        for (size_t c = 0; c < 3; c++)
+            palette.colors[k][c] = color[c];
+    }
+
+    block.endpoints[0] = endpoint0;
+    block.endpoints[1] = endpoint1;
+    block.error = findIndices(pixels, palette, block.indices);
+}
+
+// Keep block encoded with quantized endpoints when its error is lower
+bool tryBc1(const BlockPixels & pixels, uint16_t endpoint0, uint16_t endpoint1, Bc1Block & best) {
+    Bc1Block block;
+    evaluateBc1(pixels, endpoint0, endpoint1, block);
+
+    if (block.error >= best.error)
+        return false;
+
+    best = block;
+
+    return true;
+}
+
+// Move each endpoint channel by one quantization step while the error decreases
+void searchNeighborsBc1(const BlockPixels & pixels, Bc1Block & best) {
+    const int shifts[3] = { 11, 5, 0 };
+    const int maxValues[3] = { 31, 63, 31 };
+
+    for (size_t round = 0; round < NEIGHBOR_SEARCH_ROUNDS; round++) {
+        bool improved = false;
+
+        for (size_t e = 0; e < 2; e++) {
+            for (size_t c = 0; c < 3; c++) {
+                for (int delta = -1; delta <= 1; delta += 2) {
+                    uint16_t endpoints[2] = { best.endpoints[0], best.endpoints[1] };
+                    int value = ((endpoints[e] >> shifts[c]) & maxValues[c]) + delta;
+
+                    if (value < 0 || value > maxValues[c])
+                        continue;
+
+                    endpoints[e] = (uint16_t)((endpoints[e] & ~(maxValues[c] << shifts[c])) | (value << shifts[c]));
+                    improved = tryBc1(pixels, endpoints[0], endpoints[1], best) || improved;
+                }
+            }
+        }
+
+        if (!improved)
+            break;
+    }
+}
+
+void encodeBc1(const BlockPixels & pixels, uint32_t quality, unsigned char * output) {
+    glm::vec3 endpoint0, endpoint1;
+
+    if (quality == 0)
+        findBoundingBoxEndpoints(pixels, endpoint0, endpoint1);
+    else
+        findPrincipalEndpoints(pixels, endpoint0, endpoint1);
+
+    Bc1Block best;
+    best.error = FLT_MAX;
+
+    tryBc1(pixels, quantizeBc1(endpoint0), quantizeBc1(endpoint1), best);
+
+    for (size_t i = 0; i < REFINEMENT_COUNTS[quality] && best.error > 0.0f; i++) {
+        if (!fitEndpoints(pixels, best.indices, BC1_WEIGHTS, endpoint0, endpoint1))
+            break;
+
+        if (!tryBc1(pixels, quantizeBc1(endpoint0), quantizeBc1(endpoint1), best))
+            break;
+    }
+
+    if (quality == MAX_COMPRESSION_QUALITY && best.error > 0.0f)
+        searchNeighborsBc1(pixels, best);
+
+    // Store little-endian endpoints, then 2-bit indices from the first pixel in the lowest bits
+    uint32_t indices = 0;
+
+    for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i++)
+        indices |= (uint32_t)best.indices[i] << (2 * i);
+
+    for (size_t i = 0; i < 2; i++) {
+        output[2 * i] = (unsigned char)(best.endpoints[i] & 0xFF);
+        output[2 * i + 1] = (unsigned char)(best.endpoints[i] >> 8);
+    }
+
+    for (size_t i = 0; i < 4; i++)
+        output[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+inline int expandBc7(const Bc7Endpoint & endpoint, size_t channel) {
+    return (endpoint.channels[channel] << 1) | endpoint.extension;
+}
+
+// Quantize color to 7-bit channels with the given extension bit,
+// or with the bit closest to color when it is negative
+void quantizeBc7(const glm::vec3 & color, int extension, Bc7Endpoint & endpoint) {
+    float bestError = FLT_MAX;
+
+    for (int bit = 0; bit < 2; bit++) {
+        if (extension >= 0 && bit != extension)
+            continue;
+
+        Bc7Endpoint candidate;
+        candidate.extension = bit;
+
+        float error = 0.0f;
+
+        for (size_t c = 0; c < 3; c++) {
+            int value = (int)std::floor((color[c] - bit) * 0.5f + 0.5f);
+            candidate.channels[c] = std::min(std::max(value, 0), BC7_MAX_ENDPOINT);
+
+            float difference = (float)expandBc7(candidate, c) - color[c];
+            error += difference * difference;
+        }
+
+        if (error < bestError) {
+            bestError = error;
+            endpoint = candidate;
+        }
+    }
+}
+
+// Encode block with quantized endpoints, interpolated as the decoder does in 8-bit integers
+void evaluateBc7(const BlockPixels & pixels, const Bc7Endpoint & endpoint0, const Bc7Endpoint & endpoint1, Bc7Block & block) {
+    BlockPalette palette;
+    palette.size = 16;
+
+    for (size_t k = 0; k < palette.size; k++) {
+        for (size_t c = 0; c < 3; c++) {
+            int value = ((64 - BC7_WEIGHTS[k]) * expandBc7(endpoint0, c) + BC7_WEIGHTS[k] * expandBc7(endpoint1, c) + 32) >> 6;
+            palette.colors[k][c] = (float)value;
+        }
+    }
+
+    block.endpoints[0] = endpoint0;
+    block.endpoints[1] = endpoint1;
+    block.error = findIndices(pixels, palette, block.indices);
+}
+
+// Keep block encoded with quantized endpoints when its error is lower
+bool tryBc7(const BlockPixels & pixels, const Bc7Endpoint & endpoint0, const Bc7Endpoint & endpoint1, Bc7Block & best) {
+    Bc7Block block;
+    evaluateBc7(pixels, endpoint0, endpoint1, block);
+
+    if (block.error >= best.error)
+        return false;
+
+    best = block;
+
+    return true;
+}
+
+// Quantize endpoints and keep the block when its error is lower
+// Every combination of extension bits is tried at the highest quality,
+// otherwise each endpoint takes the bit closest to its color
+bool tryBc7(
+        const BlockPixels & pixels,
+        const glm::vec3 & endpoint0,
+        const glm::vec3 & endpoint1,
+        uint32_t quality,
+        Bc7Block & best) {
+    Bc7Endpoint endpoints[2];
+
+    if (quality < MAX_COMPRESSION_QUALITY) {
+        quantizeBc7(endpoint0, -1, endpoints[0]);
+        quantizeBc7(endpoint1, -1, endpoints[1]);
+
+        return tryBc7(pixels, endpoints[0], endpoints[1], best);
+    }
+
+    bool improved = false;
+
+    for (int i = 0; i < 4; i++) {
+        quantizeBc7(endpoint0, i & 1, endpoints[0]);
+        quantizeBc7(endpoint1, i >> 1, endpoints[1]);
+
+        improved = tryBc7(pixels, endpoints[0], endpoints[1], best) || improved;
+    }
+
+    return improved;
+}
+
+// Move each endpoint channel by one quantization step while the error decreases
+void searchNeighborsBc7(const BlockPixels & pixels, Bc7Block & best) {
+    for (size_t round = 0; round < NEIGHBOR_SEARCH_ROUNDS; round++) {
+        bool improved = false;
+
+        for (size_t e = 0; e < 2; e++) {
+            for (size_t c = 0; c < 3; c++) {
+                for (int delta = -1; delta <= 1; delta += 2) {
+                    Bc7Endpoint endpoints[2] = { best.endpoints[0], best.endpoints[1] };
+                    int value = endpoints[e].channels[c] + delta;
+
+                    if (value < 0 || value > BC7_MAX_ENDPOINT)
+                        continue;
+
+                    endpoints[e].channels[c] = value;
+                    improved = tryBc7(pixels, endpoints[0], endpoints[1], best) || improved;
+                }
+            }
+        }
+
+        if (!improved)
+            break;
+    }
+}
+
+// Append bits of value to block, least significant bit first
+void writeBits(unsigned char * block, size_t & position, uint32_t value, size_t count) {
+    for (size_t i = 0; i < count; i++, position++) {
+        if ((value >> i) & 1)
+            block[position >> 3] |= (unsigned char)(1 << (position & 7));
+    }
+}
+
+void encodeBc7(const BlockPixels & pixels, uint32_t quality, unsigned char * output) {
+    float weights[16];
+
+    for (size_t k = 0; k < 16; k++)
+        weights[k] = BC7_WEIGHTS[k] / 64.0f;
+
+    glm::vec3 endpoint0, endpoint1;
+
+    if (quality == 0)
+        findBoundingBoxEndpoints(pixels, endpoint0, endpoint1);
+    else
+        findPrincipalEndpoints(pixels, endpoint0, endpoint1);
+
+    Bc7Block best;
+    best.error = FLT_MAX;
+
+    tryBc7(pixels, endpoint0, endpoint1, quality, best);
+
+    for (size_t i = 0; i < REFINEMENT_COUNTS[quality] && best.error > 0.0f; i++) {
+        if (!fitEndpoints(pixels, best.indices, weights, endpoint0, endpoint1))
+            break;
+
+        if (!tryBc7(pixels, endpoint0, endpoint1, quality, best))
+            break;
+    }
+
+    if (quality == MAX_COMPRESSION_QUALITY && best.error > 0.0f)
+        searchNeighborsBc7(pixels, best);
+
+    // The most significant index bit of the first pixel is implicitly zero,
+    // so endpoints are swapped and indices inverted when it is set
+    if (best.indices[0] >= 8) {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+
+        for (size_t i = 0; i < BLOCK_PIXEL_COUNT; i++)
+            best.indices[i] = (uint8_t)(15 - best.indices[i]);
+    }
+
+    // Store mode, endpoint channels interleaved by channel, opaque alpha, extension bits and indices
+    // Alpha is 254 or 255 depending on the extension bits, textures sample only RGB
+    std::memset(output, 0, BC7_BLOCK_SIZE);
+    size_t position = 0;
+
+    writeBits(output, position, BC7_MODE_6, BC7_MODE_BITS);
+
+    for (size_t c = 0; c < 3; c++) {
+        writeBits(output, position, (uint32_t)best.endpoints[0].channels[c], BC7_ENDPOINT_BITS);
+        writeBits(output, position, (uint32_t)best.endpoints[1].channels[c], BC7_ENDPOINT_BITS);
+    }
+
+    writeBits(output, position, (uint32_t)BC7_MAX_ENDPOINT, BC7_ENDPOINT_BITS);
+    writeBits(output, position, (uint32_t)BC7_MAX_ENDPOINT, BC7_ENDPOINT_BITS);
+    writeBits(output, position, (uint32_t)best.endpoints[0].extension, 1);
+    writeBits(output, position, (uint32_t)best.endpoints[1].extension, 1);
+
+    writeBits(output, position, best.indices[0], BC7_INDEX_BITS - 1);
+
+    for (size_t i = 1; i < BLOCK_PIXEL_COUNT; i++)
+        writeBits(output, position, best.indices[i], BC7_INDEX_BITS);
+}
+
+size_t getCompressedBlockSize(TextureCompression format) {
+    switch (format) {
+    case TEXTURE_COMPRESSION_BC1:
+        return BC1_BLOCK_SIZE;
+    case TEXTURE_COMPRESSION_BC7:
+        return BC7_BLOCK_SIZE;
+    default:
+        return 0;
+    }
+}
+
+}
+
+size_t getCompressedImageSize(TextureCompression format, size_t width, size_t height) {
+    size_t blockColumns = (width + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE;
+    size_t blockRows = (height + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE;
+
+    return blockColumns * blockRows * getCompressedBlockSize(format);
+}
+
+uint32_t getCompressedTextureFormat(TextureCompression format, bool sRGB) {
+    switch (format) {
+    case TEXTURE_COMPRESSION_BC1:
+        return sRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_COMPRESSION_BC7:
+        return sRGB ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default:
+        return 0;
+    }
+}
+
+TextureCompression getTextureCompression(uint32_t internalFormat) {
+    switch (internalFormat) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        return TEXTURE_COMPRESSION_BC1;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return TEXTURE_COMPRESSION_BC7;
+    default:
+        return TEXTURE_COMPRESSION_NONE;
+    }
+}
+
+bool isTextureCompressionSupported(TextureCompression format) {
+    if (format == TEXTURE_COMPRESSION_BC1)
+        return hasExtension("GL_EXT_texture_compression_s3tc");
+
+    if (format == TEXTURE_COMPRESSION_BC7)
+        return hasVersionOrExtension(4, 2, "GL_ARB_texture_compression_bptc");
+
+    return true;
+}
+
+bool isImageCompressible(const Image & image) {
+    return image.channelSize == 1 && (image.channelCount == 1 || image.channelCount == 3);
+}
+
+void compressImage(
+        const Image & image,
+        const TextureCompressionSettings & settings,
+        CompressedImage & compressed) {
+    PROFILE_ZONE("compressImage");
+
+    size_t blockSize = getCompressedBlockSize(settings.format);
+    size_t blockColumns = (image.width + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE;
+    size_t blockRows = (image.height + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE;
+    uint32_t quality = std::min(settings.quality, MAX_COMPRESSION_QUALITY);
+
+    compressed.width = image.width;
+    compressed.height = image.height;
+    compressed.format = settings.format;
+    compressed.blocks.assign(blockColumns * blockRows * blockSize, 0);
+
+    parallelFor(blockRows, [&](size_t row, size_t) {
+        BlockPixels pixels;
+
+        for (size_t column = 0; column < blockColumns; column++) {
+            unsigned char * output = &compressed.blocks[(row * blockColumns + column) * blockSize];
+
+            loadBlock(image, column, row, pixels);
+
+            if (settings.format == TEXTURE_COMPRESSION_BC1)
+                encodeBc1(pixels, quality, output);
+            else
+                encodeBc7(pixels, quality, output);
+        }
+    });
+}
@@ -0,0 +1,68 @@
+#ifndef CG20192_TEXTURE_COMPRESSION_HPP
+#define CG20192_TEXTURE_COMPRESSION_HPP
+
+#include "image.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Side of the square pixel blocks of block compressed formats
+const size_t COMPRESSION_BLOCK_SIZE = 4;
+
+// Highest compression quality, encoding time grows with the quality
+const uint32_t MAX_COMPRESSION_QUALITY = 3;
+
+// Block compressed format of 8-bit textures
+// BC1 stores 4 bits per pixel, two RGB565 endpoints and 4 interpolation levels per block
+// BC7 stores 8 bits per pixel in mode 6, two RGBA7 endpoints extended by one bit each
+// and 16 interpolation levels per block
+enum TextureCompression {
+    TEXTURE_COMPRESSION_NONE,
+    TEXTURE_COMPRESSION_BC1,
+    TEXTURE_COMPRESSION_BC7
+};
+
+// Compression format and quality in [0, MAX_COMPRESSION_QUALITY]
+// Quality 0 fits endpoints to the bounding box of block colors, higher qualities
+// fit them to the principal axis and refine them by least squares, the highest
+// quality also searches neighboring endpoints
+struct TextureCompressionSettings {
+    TextureCompression format;
+    uint32_t quality;
+};
+
+// Image encoded in rows of blocks from top to bottom
+// Blocks crossing the right or bottom edge replicate the last column or row
+struct CompressedImage {
+    size_t width;
+    size_t height;
+    TextureCompression format;
+    std::vector<unsigned char> blocks;
+};
+
+// Get bytes of compressed image
+size_t getCompressedImageSize(TextureCompression format, size_t width, size_t height);
+
+// Get OpenGL internal format of compressed format, 8-bit channels can be stored as sRGB
+uint32_t getCompressedTextureFormat(TextureCompression format, bool sRGB);
+
+// Get compressed format of OpenGL internal format, none for uncompressed formats
+TextureCompression getTextureCompression(uint32_t internalFormat);
+
+// Check whether the current OpenGL context supports compressed format
+// BC1 requires GL_EXT_texture_compression_s3tc, BC7 requires OpenGL 4.2
+// or GL_ARB_texture_compression_bptc
+bool isTextureCompressionSupported(TextureCompression format);
+
+// Check whether image can be compressed, 16-bit images are kept uncompressed
+bool isImageCompressible(const Image & image);
+
+// Encode 8-bit grayscale or RGB image, grayscale images are replicated to RGB
+// Rows of blocks are encoded in parallel and interpolation indices are searched with SIMD
+void compressImage(
+        const Image & image,
+        const TextureCompressionSettings & settings,
+        CompressedImage & compressed);
+
+#endif
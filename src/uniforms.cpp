@@ -0,0 +1,34 @@
+#include "uniforms.hpp"
+
+#include <glm/glm.hpp>
+
+void computeFrameUniforms(
+        const glm::mat4 & view,
+        const glm::mat4 & projection,
+        const glm::vec3 & cameraPosition,
+        const ClusterGrid & grid,
+        FrameUniforms & uniforms) {
+    uniforms.view = view;
+    uniforms.projection = projection;
+    uniforms.viewProjection = projection * view;
+    uniforms.clusterScale = glm::vec4(
+        1.0f / CLUSTER_TILE_SIZE,
+        1.0f / CLUSTER_TILE_SIZE,
+        grid.sliceScale,
+        grid.sliceBias);
+    uniforms.clusterCounts = glm::ivec4(
+        (int)grid.tileCountX,
+        (int)grid.tileCountY,
+        (int)grid.sliceCount,
+        0);
+    uniforms.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+}
+
+void computeMeshUniforms(
+        const glm::mat4 & dequantization,
+        bool octahedralNormals,
+        MeshUniforms & uniforms) {
+    uniforms.dequantization = dequantization;
+    uniforms.octahedralNormals = octahedralNormals ? 1 : 0;
+    uniforms.padding[0] = uniforms.padding[1] = uniforms.padding[2] = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef CG20192_UNIFORMS_HPP
+#define CG20192_UNIFORMS_HPP
+
+#include "light_clusters.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// Uniform buffer binding points of the shader program blocks
+const uint32_t FRAME_UNIFORM_BINDING = 0;
+const uint32_t MESH_UNIFORM_BINDING = 1;
+
+// Per-frame uniform block shared by all objects, in std140 layout
+// Vectors are padded to 4 components
+// The cluster scale maps window coordinates to tiles and the view depth logarithm to slices,
+// the cluster counts hold the tile columns, tile rows and slices of the light cluster grid
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 clusterScale;
+    glm::ivec4 clusterCounts;
+    glm::vec4 cameraPosition;
+};
+
+// Per-mesh uniform block decoding vertices, in std140 layout
+// Objects are placed by per-instance model matrices, so the block only
+// dequantizes positions and selects the normal encoding of the mesh
+struct MeshUniforms {
+    glm::mat4 dequantization;
+    int32_t octahedralNormals;
+    int32_t padding[3];
+};
+
+static_assert(sizeof(FrameUniforms) == 240, "Unexpected std140 frame block size");
+static_assert(offsetof(MeshUniforms, octahedralNormals) == 64, "Unexpected std140 mesh block layout");
+static_assert(sizeof(MeshUniforms) == 80, "Unexpected std140 mesh block size");
+
+// Fill per-frame block from camera parameters and light cluster grid
+void computeFrameUniforms(
+        const glm::mat4 & view,
+        const glm::mat4 & projection,
+        const glm::vec3 & cameraPosition,
+        const ClusterGrid & grid,
+        FrameUniforms & uniforms);
+
+// Fill per-mesh block from the dequantization transform and normal encoding
+void computeMeshUniforms(
+        const glm::mat4 & dequantization,
+        bool octahedralNormals,
+        MeshUniforms & uniforms);
+
+#endif
@@ -0,0 +1,663 @@
+#include "virtual_texture.hpp"
+#include "image.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// File identification and format version
+const char VIRTUAL_TEXTURE_MAGIC[8] = { 'C', 'G', 'V', 'T', 'E', 'X', '\0', '\0' };
+const uint32_t VIRTUAL_TEXTURE_VERSION = 1;
+
+// Extension of page files
+const char * const VIRTUAL_TEXTURE_EXTENSION = ".cgvt";
+
+// Pages filtered in parallel and written at once while building page files
+const size_t BUILD_BATCH_SIZE = 64;
+
+// Page file header followed by the pages, stored in native byte order
+struct VirtualTextureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t levelCount;
+
+    uint64_t width;
+    uint64_t height;
+    uint64_t pageCount;
+
+    uint64_t sourceSize;
+    int64_t sourceModificationTime;
+
+    uint32_t pageSize;
+    uint32_t pageBorder;
+};
+
+static_assert(sizeof(VirtualTextureHeader) == 64, "Unexpected virtual texture header padding");
+
+// Get number of levels and first page index of each level of square pyramid
+void getLevelOffsets(size_t pageCount, std::vector<uint64_t> & levelOffsets) {
+    levelOffsets.clear();
+
+    uint64_t offset = 0;
+
+    for (size_t count = pageCount; count > 0; count /= 2) {
+        levelOffsets.push_back(offset);
+        offset += (uint64_t)count * count;
+    }
+
+    levelOffsets.push_back(offset);
+}
+
+// Rescale channel value to 8 bits
+inline unsigned char reduceChannel(uint32_t value, uint32_t maximum) {
+    if (value >= maximum)
+        return 0xFF;
+
+    return (unsigned char)((value * 0xFF + maximum / 2) / maximum);
+}
+
+// Write page of the finest level from the mapped source image, replicating its edges
+void writeSourceTile(const MappedImage & image, size_t pageX, size_t pageY, unsigned char * tile) {
+    size_t pixelSize = image.channelCount * image.channelSize;
+
+    for (size_t j = 0; j < VIRTUAL_TILE_SIZE; j++) {
+        long long y = (long long)(pageY * VIRTUAL_PAGE_SIZE + j) - (long long)VIRTUAL_PAGE_BORDER;
+        y = std::min(std::max(y, 0LL), (long long)image.height - 1);
+
+        const unsigned char * row = image.pixels + (size_t)y * image.width * pixelSize;
+
+        for (size_t i = 0; i < VIRTUAL_TILE_SIZE; i++) {
+            long long x = (long long)(pageX * VIRTUAL_PAGE_SIZE + i) - (long long)VIRTUAL_PAGE_BORDER;
+            x = std::min(std::max(x, 0LL), (long long)image.width - 1);
+
+            const unsigned char * pixel = row + (size_t)x * pixelSize;
+            unsigned char * output = tile + (j * VIRTUAL_TILE_SIZE + i) * 3;
+
+            for (size_t c = 0; c < 3; c++) {
+                size_t channel = image.channelCount == 3 ? c : 0;
+
+                uint32_t value = image.channelSize == 1
+                    ? pixel[channel]
+                    : ((uint32_t)pixel[channel * 2] << 8) | pixel[channel * 2 + 1];
+
+                output[c] = reduceChannel(value, image.maximum);
+            }
+        }
+    }
+}
+
+// Get pixel of level from its pages, coordinates in pixels of the level
+inline const unsigned char * getLevelPixel(const unsigned char * pages, size_t pageCount, size_t x, size_t y) {
+    size_t page = (y / VIRTUAL_PAGE_SIZE) * pageCount + x / VIRTUAL_PAGE_SIZE;
+    size_t i = x % VIRTUAL_PAGE_SIZE + VIRTUAL_PAGE_BORDER;
+    size_t j = y % VIRTUAL_PAGE_SIZE + VIRTUAL_PAGE_BORDER;
+
+    return pages + page * VIRTUAL_TILE_BYTES + (j * VIRTUAL_TILE_SIZE + i) * 3;
+}
+
+// Write page of a coarser level by box filtering the pages of the previous level,
+// clamping the border to the edges of the level
+void writeFilteredTile(
+        const unsigned char * previousPages,
+        size_t previousPageCount,
+        size_t pageX,
+        size_t pageY,
+        unsigned char * tile) {
+    long long size = (long long)(previousPageCount / 2 * VIRTUAL_PAGE_SIZE);
+
+    for (size_t j = 0; j < VIRTUAL_TILE_SIZE; j++) {
+        long long y = (long long)(pageY * VIRTUAL_PAGE_SIZE + j) - (long long)VIRTUAL_PAGE_BORDER;
+        y = std::min(std::max(y, 0LL), size - 1);
+
+        for (size_t i = 0; i < VIRTUAL_TILE_SIZE; i++) {
+            long long x = (long long)(pageX * VIRTUAL_PAGE_SIZE + i) - (long long)VIRTUAL_PAGE_BORDER;
+            x = std::min(std::max(x, 0LL), size - 1);
+
+            const unsigned char * p00 = getLevelPixel(previousPages, previousPageCount, (size_t)x * 2, (size_t)y * 2);
+            const unsigned char * p10 = getLevelPixel(previousPages, previousPageCount, (size_t)x * 2 + 1, (size_t)y * 2);
+            const unsigned char * p01 = getLevelPixel(previousPages, previousPageCount, (size_t)x * 2, (size_t)y * 2 + 1);
+            const unsigned char * p11 = getLevelPixel(previousPages, previousPageCount, (size_t)x * 2 + 1, (size_t)y * 2 + 1);
+
+            unsigned char * output = tile + (j * VIRTUAL_TILE_SIZE + i) * 3;
+
+            for (size_t c = 0; c < 3; c++)
+                output[c] = (unsigned char)((p00[c] + p10[c] + p01[c] + p11[c] + 2) / 4);
+        }
+    }
+}
+
+// Get indirection entry of page
+inline unsigned char * getIndirectionEntry(VirtualPageCache & cache, size_t level, size_t x, size_t y) {
+    size_t count = cache.pageCount >> level;
+
+    return &cache.indirection[level][(y * count + x) * 4];
+}
+
+// Grow dirty region of level by region
+void addDirtyRegion(VirtualPageCache & cache, size_t level, const VirtualRegion & region) {
+    VirtualRegion & dirty = cache.dirtyRegions[level];
+
+    if (dirty.beginX >= dirty.endX || dirty.beginY >= dirty.endY)
+        dirty = region;
+    else {
+        dirty.beginX = std::min(dirty.beginX, region.beginX);
+        dirty.beginY = std::min(dirty.beginY, region.beginY);
+        dirty.endX = std::max(dirty.endX, region.endX);
+        dirty.endY = std::max(dirty.endY, region.endY);
+    }
+}
+
+// Point entries of pages below page without a resident page of their own
+// at the entry of their parent, from the level below page down to the finest level
+void propagateIndirection(VirtualPageCache & cache, size_t level, size_t x, size_t y) {
+    VirtualRegion region = { x, y, x + 1, y + 1 };
+    addDirtyRegion(cache, level, region);
+
+    for (size_t k = level; k-- > 0;) {
+        size_t shift = level - k;
+
+        region.beginX = x << shift;
+        region.beginY = y << shift;
+        region.endX = (x + 1) << shift;
+        region.endY = (y + 1) << shift;
+
+        for (size_t j = region.beginY; j < region.endY; j++) {
+            for (size_t i = region.beginX; i < region.endX; i++) {
+                unsigned char * entry = getIndirectionEntry(cache, k, i, j);
+
+                if (entry[2] != k)
+                    std::memcpy(entry, getIndirectionEntry(cache, k + 1, i / 2, j / 2), 4);
+            }
+        }
+
+        addDirtyRegion(cache, k, region);
+    }
+}
+
+// Copy requested pages to free staging slots until stopped
+void runVirtualTextureStreamer(VirtualTextureStreamer * streamer) {
+    std::unique_lock<std::mutex> lock(streamer->mutex);
+
+    while (true) {
+        // Wait for a request and a free staging slot
+        std::vector<uint32_t>::iterator freeSlot;
+
+        streamer->wake.wait(lock, [&]() {
+            freeSlot = std::find(streamer->stagingPages.begin(), streamer->stagingPages.end(), VIRTUAL_NO_PAGE);
+
+            return streamer->stop || (!streamer->requests.empty() && freeSlot != streamer->stagingPages.end());
+        });
+
+        if (streamer->stop)
+            break;
+
+        // Requests are stored in reverse order, the next one is the last
+        StreamedPage page;
+        page.page = streamer->requests.back();
+        page.staging = (size_t)(freeSlot - streamer->stagingPages.begin());
+
+        streamer->requests.pop_back();
+        streamer->stagingPages[page.staging] = page.page;
+
+        // Copy page outside the lock, reading it from disk when it is not cached
+        lock.unlock();
+
+        {
+            PROFILE_ZONE("streamVirtualPage");
+
+            std::memcpy(
+                &streamer->staging[page.staging * VIRTUAL_TILE_BYTES],
+                getVirtualPage(*streamer->file, page.page),
+                VIRTUAL_TILE_BYTES);
+        }
+
+        lock.lock();
+
+        streamer->streamed.push_back(page);
+    }
+}
+
+}
+
+uint32_t getVirtualPageKey(size_t level, size_t x, size_t y) {
+    return (uint32_t)(level << 24 | y << 12 | x);
+}
+
+void splitVirtualPageKey(uint32_t page, size_t & level, size_t & x, size_t & y) {
+    level = page >> 24;
+    y = (page >> 12) & 0xFFF;
+    x = page & 0xFFF;
+}
+
+std::string getVirtualTextureFilename(const std::string & sourceFilename) {
+    size_t extension = sourceFilename.find_last_of('.');
+    size_t separator = sourceFilename.find_last_of("/\\");
+
+    if (extension == std::string::npos
+            || (separator != std::string::npos && extension < separator))
+        return sourceFilename + VIRTUAL_TEXTURE_EXTENSION;
+
+    return sourceFilename.substr(0, extension) + VIRTUAL_TEXTURE_EXTENSION;
+}
+
+bool buildVirtualTextureFile(const std::string & sourceFilename, const std::string & filename) {
+    PROFILE_ZONE("buildVirtualTextureFile");
+
+    VirtualTextureHeader header = {};
+    std::memcpy(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(VIRTUAL_TEXTURE_MAGIC));
+    header.version = VIRTUAL_TEXTURE_VERSION;
+    header.pageSize = (uint32_t)VIRTUAL_PAGE_SIZE;
+    header.pageBorder = (uint32_t)VIRTUAL_PAGE_BORDER;
+
+    if (!getFileStatus(sourceFilename, header.sourceSize, header.sourceModificationTime))
+        return false;
+
+    MappedImage image;
+
+    if (!openMappedImage(sourceFilename, image))
+        return false;
+
+    // Pad image to a power of two number of pages along both sides
+    size_t pageCount = 1;
+
+    while (pageCount * VIRTUAL_PAGE_SIZE < std::max(image.width, image.height) && pageCount < MAX_VIRTUAL_PAGE_COUNT)
+        pageCount *= 2;
+
+    if (pageCount * VIRTUAL_PAGE_SIZE < std::max(image.width, image.height)) {
+        closeMappedImage(image);
+        return false;
+    }
+
+    std::vector<uint64_t> levelOffsets;
+    getLevelOffsets(pageCount, levelOffsets);
+
+    header.width = image.width;
+    header.height = image.height;
+    header.pageCount = pageCount;
+    header.levelCount = (uint32_t)(levelOffsets.size() - 1);
+
+    std::string temporaryFilename = getTemporaryFilename(filename);
+    std::vector<unsigned char> tiles(BUILD_BATCH_SIZE * VIRTUAL_TILE_BYTES);
+
+    bool success = true;
+
+    // Append levels one at a time, mapping the written file to filter the next level
+    for (size_t level = 0; level < header.levelCount && success; level++) {
+        MappedFile previous = {};
+
+        if (level > 0)
+            success = openMappedFileOnDemand(temporaryFilename, previous);
+
+        std::FILE * file = success ? std::fopen(temporaryFilename.c_str(), level == 0 ? "wb" : "ab") : nullptr;
+        success = file != nullptr;
+
+        if (success && level == 0)
+            success = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+        size_t count = pageCount >> level;
+        size_t levelPageCount = count * count;
+
+        const unsigned char * previousPages = level > 0
+            ? (const unsigned char *)previous.data + sizeof(header) + levelOffsets[level - 1] * VIRTUAL_TILE_BYTES
+            : nullptr;
+
+        for (size_t begin = 0; begin < levelPageCount && success; begin += BUILD_BATCH_SIZE) {
+            size_t batchCount = std::min(BUILD_BATCH_SIZE, levelPageCount - begin);
+
+            parallelFor(batchCount, [&](size_t index, size_t) {
+                size_t page = begin + index;
+                unsigned char * tile = &tiles[index * VIRTUAL_TILE_BYTES];
+
+                if (level == 0)
+                    writeSourceTile(image, page % count, page / count, tile);
+                else
+                    writeFilteredTile(previousPages, count * 2, page % count, page / count, tile);
+            });
+
+            success = std::fwrite(tiles.data(), VIRTUAL_TILE_BYTES, batchCount, file) == batchCount;
+        }
+
+        if (file != nullptr)
+            success = std::fclose(file) == 0 && success;
+
+        closeMappedFile(previous);
+    }
+
+    closeMappedImage(image);
+
+    if (!success) {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    return replaceFile(temporaryFilename, filename);
+}
+
+bool openVirtualTextureFile(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        VirtualTextureFile & file) {
+    PROFILE_ZONE("openVirtualTextureFile");
+
+    if (!openMappedFileOnDemand(filename, file.file))
+        return false;
+
+    VirtualTextureHeader header;
+
+    bool valid = file.file.size >= sizeof(header);
+
+    if (valid) {
+        std::memcpy(&header, file.file.data, sizeof(header));
+
+        valid = std::memcmp(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(VIRTUAL_TEXTURE_MAGIC)) == 0
+            && header.version == VIRTUAL_TEXTURE_VERSION
+            && header.pageSize == VIRTUAL_PAGE_SIZE
+            && header.pageBorder == VIRTUAL_PAGE_BORDER
+            && header.pageCount > 0
+            && header.pageCount <= MAX_VIRTUAL_PAGE_COUNT
+            && (header.pageCount & (header.pageCount - 1)) == 0
+            && header.width > 0 && header.width <= header.pageCount * VIRTUAL_PAGE_SIZE
+            && header.height > 0 && header.height <= header.pageCount * VIRTUAL_PAGE_SIZE;
+    }
+
+    // Validate page count against the file size
+    if (valid) {
+        getLevelOffsets((size_t)header.pageCount, file.levelOffsets);
+
+        valid = header.levelCount == file.levelOffsets.size() - 1
+            && file.file.size == sizeof(header) + file.levelOffsets.back() * VIRTUAL_TILE_BYTES;
+    }
+
+    // Validate source file against its size and modification time
+    uint64_t sourceSize;
+    int64_t sourceModificationTime;
+
+    valid = valid
+        && getFileStatus(sourceFilename, sourceSize, sourceModificationTime)
+        && sourceSize == header.sourceSize
+        && sourceModificationTime == header.sourceModificationTime;
+
+    if (!valid) {
+        closeVirtualTextureFile(file);
+        return false;
+    }
+
+    file.width = (size_t)header.width;
+    file.height = (size_t)header.height;
+    file.pageCount = (size_t)header.pageCount;
+    file.levelCount = header.levelCount;
+
+    return true;
+}
+
+bool loadVirtualTextureFile(const std::string & sourceFilename, VirtualTextureFile & file) {
+    std::string filename = getVirtualTextureFilename(sourceFilename);
+
+    if (openVirtualTextureFile(filename, sourceFilename, file))
+        return true;
+
+    return buildVirtualTextureFile(sourceFilename, filename)
+        && openVirtualTextureFile(filename, sourceFilename, file);
+}
+
+void closeVirtualTextureFile(VirtualTextureFile & file) {
+    closeMappedFile(file.file);
+    file.levelOffsets.clear();
+}
+
+const unsigned char * getVirtualPage(const VirtualTextureFile & file, uint32_t page) {
+    size_t level, x, y;
+    splitVirtualPageKey(page, level, x, y);
+
+    uint64_t index = file.levelOffsets[level] + (uint64_t)y * (file.pageCount >> level) + x;
+
+    return (const unsigned char *)file.file.data + sizeof(VirtualTextureHeader) + index * VIRTUAL_TILE_BYTES;
+}
+
+void createVirtualPageCache(
+        const VirtualTextureFile & file,
+        size_t slotColumns,
+        size_t slotRows,
+        VirtualPageCache & cache) {
+    cache.pageCount = file.pageCount;
+    cache.levelCount = file.levelCount;
+
+    cache.slotColumns = slotColumns;
+    cache.slotRows = slotRows;
+    cache.slotPages.assign(slotColumns * slotRows, VIRTUAL_NO_PAGE);
+    cache.slotFrames.assign(slotColumns * slotRows, 0);
+
+    // Pin root page to the first slot
+    size_t root = file.levelCount - 1;
+
+    cache.slotPages[0] = getVirtualPageKey(root, 0, 0);
+    cache.slotFrames[0] = UINT64_MAX;
+
+    // Point every page at the root page
+    cache.indirection.resize(file.levelCount);
+    cache.dirtyRegions.resize(file.levelCount);
+
+    for (size_t level = 0; level < file.levelCount; level++) {
+        size_t count = file.pageCount >> level;
+
+        cache.indirection[level].resize(count * count * 4);
+
+        for (size_t i = 0; i < count * count; i++) {
+            unsigned char * entry = &cache.indirection[level][i * 4];
+
+            entry[0] = 0;
+            entry[1] = 0;
+            entry[2] = (unsigned char)root;
+            entry[3] = 0;
+        }
+
+        VirtualRegion region = { 0, 0, count, count };
+        cache.dirtyRegions[level] = region;
+    }
+}
+
+void decodeVirtualFeedback(
+        const VirtualPageCache & cache,
+        const unsigned char * pixels,
+        size_t pixelCount,
+        std::vector<uint32_t> & pages) {
+    PROFILE_ZONE("decodeVirtualFeedback");
+
+    pages.clear();
+
+    for (size_t i = 0; i < pixelCount; i++) {
+        const unsigned char * pixel = pixels + i * 4;
+
+        if (pixel[3] == 0)
+            continue;
+
+        size_t level = (size_t)pixel[3] - 1;
+        size_t x = pixel[0] | (size_t)(pixel[2] & 0x0F) << 8;
+        size_t y = pixel[1] | (size_t)(pixel[2] >> 4) << 8;
+
+        if (level < cache.levelCount && x < (cache.pageCount >> level) && y < (cache.pageCount >> level))
+            pages.push_back(getVirtualPageKey(level, x, y));
+    }
+
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+}
+
+void findMissingVirtualPages(
+        VirtualPageCache & cache,
+        const std::vector<uint32_t> & pages,
+        uint64_t frame,
+        std::vector<uint32_t> & missing) {
+    PROFILE_ZONE("findMissingVirtualPages");
+
+    missing.clear();
+
+    for (size_t i = 0; i < pages.size(); i++) {
+        size_t level, x, y;
+        splitVirtualPageKey(pages[i], level, x, y);
+
+        // Keep ancestors up to the root, they are drawn while finer pages are missing
+        // and blended with their children by trilinear filtering
+        for (; level < cache.levelCount; level++, x /= 2, y /= 2) {
+            const unsigned char * entry = getIndirectionEntry(cache, level, x, y);
+
+            if (entry[2] == level) {
+                size_t slot = entry[1] * cache.slotColumns + entry[0];
+                cache.slotFrames[slot] = std::max(cache.slotFrames[slot], frame);
+            }
+            else
+                missing.push_back(getVirtualPageKey(level, x, y));
+        }
+    }
+
+    // Request coarser levels first, so every region gets a sharper page soon
+    std::sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) {
+        return (a >> 24) != (b >> 24) ? (a >> 24) > (b >> 24) : a < b;
+    });
+
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+    // Drop requests beyond the slots not used in frame, which could not be placed
+    size_t availableCount = 0;
+
+    for (size_t i = 0; i < cache.slotFrames.size(); i++) {
+        if (cache.slotPages[i] == VIRTUAL_NO_PAGE || cache.slotFrames[i] < frame)
+            availableCount++;
+    }
+
+    if (missing.size() > availableCount)
+        missing.resize(availableCount);
+}
+
+bool isVirtualPageResident(const VirtualPageCache & cache, uint32_t page) {
+    size_t level, x, y;
+    splitVirtualPageKey(page, level, x, y);
+
+    return cache.indirection[level][(y * (cache.pageCount >> level) + x) * 4 + 2] == level;
+}
+
+bool insertVirtualPage(VirtualPageCache & cache, uint32_t page, uint64_t frame, size_t & slot) {
+    if (isVirtualPageResident(cache, page))
+        return false;
+
+    // Take a free slot or the least recently used slot not used in frame
+    slot = cache.slotPages.size();
+
+    for (size_t i = 0; i < cache.slotPages.size(); i++) {
+        if (cache.slotPages[i] == VIRTUAL_NO_PAGE) {
+            slot = i;
+            break;
+        }
+
+        if (cache.slotFrames[i] < frame && (slot == cache.slotPages.size() || cache.slotFrames[i] < cache.slotFrames[slot]))
+            slot = i;
+    }
+
+    if (slot == cache.slotPages.size())
+        return false;
+
+    // Point evicted page at its parent
+    size_t level, x, y;
+
+    if (cache.slotPages[slot] != VIRTUAL_NO_PAGE) {
+        splitVirtualPageKey(cache.slotPages[slot], level, x, y);
+
+        std::memcpy(getIndirectionEntry(cache, level, x, y), getIndirectionEntry(cache, level + 1, x / 2, y / 2), 4);
+        propagateIndirection(cache, level, x, y);
+    }
+
+    // Point placed page at its slot
+    splitVirtualPageKey(page, level, x, y);
+
+    unsigned char * entry = getIndirectionEntry(cache, level, x, y);
+
+    entry[0] = (unsigned char)(slot % cache.slotColumns);
+    entry[1] = (unsigned char)(slot / cache.slotColumns);
+    entry[2] = (unsigned char)level;
+
+    propagateIndirection(cache, level, x, y);
+
+    cache.slotPages[slot] = page;
+    cache.slotFrames[slot] = frame;
+
+    return true;
+}
+
+void clearVirtualDirtyRegions(VirtualPageCache & cache) {
+    VirtualRegion empty = {};
+
+    for (size_t level = 0; level < cache.dirtyRegions.size(); level++)
+        cache.dirtyRegions[level] = empty;
+}
+
+void startVirtualTextureStreamer(
+        const VirtualTextureFile & file,
+        size_t stagingCount,
+        VirtualTextureStreamer & streamer) {
+    streamer.file = &file;
+    streamer.staging.resize(stagingCount * VIRTUAL_TILE_BYTES);
+    streamer.stagingPages.assign(stagingCount, VIRTUAL_NO_PAGE);
+    streamer.requests.clear();
+    streamer.streamed.clear();
+    streamer.stop = false;
+
+    streamer.thread = std::thread(runVirtualTextureStreamer, &streamer);
+}
+
+void requestStreamedPages(VirtualTextureStreamer & streamer, const std::vector<uint32_t> & pages) {
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+
+        streamer.requests.clear();
+
+        for (size_t i = pages.size(); i-- > 0;) {
+            if (std::find(streamer.stagingPages.begin(), streamer.stagingPages.end(), pages[i]) == streamer.stagingPages.end())
+                streamer.requests.push_back(pages[i]);
+        }
+    }
+
+    streamer.wake.notify_one();
+}
+
+void takeStreamedPages(VirtualTextureStreamer & streamer, size_t maxCount, std::vector<StreamedPage> & pages) {
+    std::lock_guard<std::mutex> lock(streamer.mutex);
+
+    size_t count = std::min(maxCount, streamer.streamed.size());
+
+    pages.assign(streamer.streamed.begin(), streamer.streamed.begin() + count);
+    streamer.streamed.erase(streamer.streamed.begin(), streamer.streamed.begin() + count);
+}
+
+const unsigned char * getStagingPage(const VirtualTextureStreamer & streamer, size_t staging) {
+    return &streamer.staging[staging * VIRTUAL_TILE_BYTES];
+}
+
+void releaseStagingPage(VirtualTextureStreamer & streamer, size_t staging) {
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+
+        streamer.stagingPages[staging] = VIRTUAL_NO_PAGE;
+    }
+
+    streamer.wake.notify_one();
+}
+
+void stopVirtualTextureStreamer(VirtualTextureStreamer & streamer) {
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+
+        streamer.stop = true;
+    }
+
+    streamer.wake.notify_one();
+
+    if (streamer.thread.joinable())
+        streamer.thread.join();
+
+    streamer.requests.clear();
+    streamer.streamed.clear();
+}
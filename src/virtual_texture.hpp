@@ -0,0 +1,190 @@
+#ifndef CG20192_VIRTUAL_TEXTURE_HPP
+#define CG20192_VIRTUAL_TEXTURE_HPP
+
+#include "file.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Side of the square pages of virtual textures in pixels
+const size_t VIRTUAL_PAGE_SIZE = 128;
+
+// Pixels of the neighboring pages stored around every page, so filtering never reads
+// across the slots of the physical atlas
+const size_t VIRTUAL_PAGE_BORDER = 4;
+
+// Side of stored pages and atlas slots including the border
+const size_t VIRTUAL_TILE_SIZE = VIRTUAL_PAGE_SIZE + 2 * VIRTUAL_PAGE_BORDER;
+
+// Bytes of stored pages with 8-bit RGB pixels
+const size_t VIRTUAL_TILE_BYTES = VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE * 3;
+
+// Largest number of pages along a side of the finest level, page coordinates take 12 bits
+const size_t MAX_VIRTUAL_PAGE_COUNT = 4096;
+
+// Largest number of atlas slots along a side, slot coordinates take 8 bits
+const size_t MAX_VIRTUAL_SLOT_COUNT = 256;
+
+// Key of no page
+const uint32_t VIRTUAL_NO_PAGE = 0xFFFFFFFF;
+
+// Virtual texture page file (.cgvt) mapped to memory
+// The source image is padded to a power of two number of pages along both sides by
+// replicating its last column and row, then stored as a pyramid of bordered pages down
+// to a single page, finest level first and pages of each level in rows
+// Pages are read on demand, so only sampled pages are ever read from disk
+struct VirtualTextureFile {
+    MappedFile file;
+    size_t width;
+    size_t height;
+    size_t pageCount;
+    size_t levelCount;
+    std::vector<uint64_t> levelOffsets;
+};
+
+// Region of indirection entries, empty when the begin is not below the end
+struct VirtualRegion {
+    size_t beginX;
+    size_t beginY;
+    size_t endX;
+    size_t endY;
+};
+
+// Residency of virtual texture pages in the slots of a fixed size physical atlas
+// The indirection table holds RGBA8 entries for every page of every level, the slot
+// and level of the finest resident page covering it: the page itself or its nearest
+// resident ancestor, so missing pages are drawn blurrier instead of not at all
+// The root page is pinned to the first slot, other pages are evicted least recently used
+struct VirtualPageCache {
+    size_t pageCount;
+    size_t levelCount;
+
+    size_t slotColumns;
+    size_t slotRows;
+    std::vector<uint32_t> slotPages;
+    std::vector<uint64_t> slotFrames;
+
+    std::vector<std::vector<unsigned char>> indirection;
+    std::vector<VirtualRegion> dirtyRegions;
+};
+
+// Page copied to a staging slot by the streaming thread
+struct StreamedPage {
+    uint32_t page;
+    size_t staging;
+};
+
+// Thread copying requested pages from the mapped page file to a fixed pool of staging slots,
+// so reading pages from disk never stalls the render thread
+// The render thread replaces the requests every frame, takes the streamed pages and releases
+// their staging slots after upload, requests wait while no staging slot is free
+struct VirtualTextureStreamer {
+    const VirtualTextureFile * file;
+
+    std::vector<unsigned char> staging;
+    std::vector<uint32_t> stagingPages;
+
+    std::vector<uint32_t> requests;
+    std::vector<StreamedPage> streamed;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop;
+
+    std::thread thread;
+};
+
+// Get key of page from its level and coordinates in pages of the level
+uint32_t getVirtualPageKey(size_t level, size_t x, size_t y);
+
+// Get level and coordinates of page key
+void splitVirtualPageKey(uint32_t page, size_t & level, size_t & x, size_t & y);
+
+// Get page file filename stored next to the source file
+std::string getVirtualTextureFilename(const std::string & sourceFilename);
+
+// Build page file of binary PGM or PPM image out of core
+// The source and the finished levels are mapped, every level is filtered from the previous one
+// by a 2x2 box filter, so memory use does not depend on the image size
+// Grayscale images are replicated to RGB and 16-bit images are reduced to 8 bits
+bool buildVirtualTextureFile(const std::string & sourceFilename, const std::string & filename);
+
+// Map page file and validate it against the source file
+bool openVirtualTextureFile(
+        const std::string & filename,
+        const std::string & sourceFilename,
+        VirtualTextureFile & file);
+
+// Map page file of source image, rebuilding it when it is missing or stale
+bool loadVirtualTextureFile(const std::string & sourceFilename, VirtualTextureFile & file);
+
+// Unmap page file
+void closeVirtualTextureFile(VirtualTextureFile & file);
+
+// Get pixels of page with its border
+const unsigned char * getVirtualPage(const VirtualTextureFile & file, uint32_t page);
+
+// Create page cache of atlas slots holding the root page in the first slot
+// Every indirection level is marked dirty
+void createVirtualPageCache(
+        const VirtualTextureFile & file,
+        size_t slotColumns,
+        size_t slotRows,
+        VirtualPageCache & cache);
+
+// Decode RGBA8 feedback pixels of sampled pages to sorted unique page keys
+// Pixels store the low bytes of the page column and row, their high nibbles and the level
+// plus one, pixels without samples are zero
+void decodeVirtualFeedback(
+        const VirtualPageCache & cache,
+        const unsigned char * pixels,
+        size_t pixelCount,
+        std::vector<uint32_t> & pages);
+
+// Mark sampled pages and their ancestors as used in frame and list the missing ones,
+// coarser levels first and no more than the slots not used in frame
+// Slots used in frame are never evicted, so call before inserting the pages of frame
+void findMissingVirtualPages(
+        VirtualPageCache & cache,
+        const std::vector<uint32_t> & pages,
+        uint64_t frame,
+        std::vector<uint32_t> & missing);
+
+// Check whether page is resident in a slot
+bool isVirtualPageResident(const VirtualPageCache & cache, uint32_t page);
+
+// Place page in a free slot or the least recently used slot not used in frame
+// and update the indirection entries of the placed and evicted pages
+// Fails when the page is already resident or all slots are used in frame
+bool insertVirtualPage(VirtualPageCache & cache, uint32_t page, uint64_t frame, size_t & slot);
+
+// Mark every indirection level clean after upload
+void clearVirtualDirtyRegions(VirtualPageCache & cache);
+
+// Start streaming thread with staging slots for stagingCount pages
+void startVirtualTextureStreamer(
+        const VirtualTextureFile & file,
+        size_t stagingCount,
+        VirtualTextureStreamer & streamer);
+
+// Replace requests of streaming thread, pages already staged are skipped
+void requestStreamedPages(VirtualTextureStreamer & streamer, const std::vector<uint32_t> & pages);
+
+// Take up to maxCount streamed pages in streaming order
+void takeStreamedPages(VirtualTextureStreamer & streamer, size_t maxCount, std::vector<StreamedPage> & pages);
+
+// Get pixels of page in staging slot
+const unsigned char * getStagingPage(const VirtualTextureStreamer & streamer, size_t staging);
+
+// Free staging slot of taken page
+void releaseStagingPage(VirtualTextureStreamer & streamer, size_t staging);
+
+// Stop streaming thread, discarding requests and streamed pages
+void stopVirtualTextureStreamer(VirtualTextureStreamer & streamer);
+
+#endif
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Output buffer size of generated files
+const size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+// Wave amplitude and frequency of the generated height field
+const double WAVE_AMPLITUDE = 0.1;
+const double WAVE_FREQUENCY = 6.0;
+
+// Get lowercase extension of filename without the dot
+std::string getExtension(const std::string & filename) {
+    size_t extension = filename.find_last_of('.');
+    size_t directory = filename.find_last_of("/\\");
+
+    if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+        return std::string();
+
+    std::string result = filename.substr(extension + 1);
+
+    for (size_t i = 0; i < result.size(); i++)
+        result[i] = (char)std::tolower((unsigned char)result[i]);
+
+    return result;
+}
+
+// Hash integer to a pseudo-random byte, so generated files depend only on their size
+inline unsigned char hashByte(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+
+    return (unsigned char)(value & 0xFF);
+}
+
+// Write height field over the unit square in Wavefront OBJ file format
+// Grid columns and rows are chosen so the mesh has at least triangle count triangles,
+// every corner references a position, texture coordinate and normal shared with its neighbors
+bool writeHeightField(const std::string & filename, uint64_t triangleCount, uint64_t & writtenTriangleCount) {
+    uint64_t columns = std::max((uint64_t)1, (uint64_t)std::ceil(std::sqrt(triangleCount / 2.0)));
+    uint64_t rows = std::max((uint64_t)1, (triangleCount + 2 * columns - 1) / (2 * columns));
+
+    std::FILE * file = std::fopen(filename.c_str(), "wb");
+
+    if (file == nullptr)
+        return false;
+
+    std::vector<char> buffer(OUTPUT_BUFFER_SIZE);
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    std::fprintf(file, "# Height field of %llu triangles\n", (unsigned long long)(2 * rows * columns));
+
+    // Write attributes of every grid point
+    for (uint64_t y = 0; y <= rows; y++) {
+        for (uint64_t x = 0; x <= columns; x++) {
+            double u = (double)x / columns;
+            double v = (double)y / rows;
+
+            double height = WAVE_AMPLITUDE * std::sin(WAVE_FREQUENCY * u) * std::cos(WAVE_FREQUENCY * v);
+            double slopeU = WAVE_AMPLITUDE * WAVE_FREQUENCY * std::cos(WAVE_FREQUENCY * u) * std::cos(WAVE_FREQUENCY * v);
+            double slopeV = -WAVE_AMPLITUDE * WAVE_FREQUENCY * std::sin(WAVE_FREQUENCY * u) * std::sin(WAVE_FREQUENCY * v);
+            double length = std::sqrt(slopeU * slopeU + slopeV * slopeV + 1.0);
+
+            std::fprintf(file, "v %.6f %.6f %.6f\n", u - 0.5, height, v - 0.5);
+            std::fprintf(file, "vt %.6f %.6f\n", u, v);
+            std::fprintf(file, "vn %.6f %.6f %.6f\n", -slopeU / length, 1.0 / length, -slopeV / length);
+        }
+    }
+
+    // Write two counterclockwise triangles per grid cell
+    for (uint64_t y = 0; y < rows; y++) {
+        for (uint64_t x = 0; x < columns; x++) {
+            unsigned long long a = y * (columns + 1) + x + 1;
+            unsigned long long b = a + 1;
+            unsigned long long c = a + columns + 1;
+            unsigned long long d = c + 1;
+
+            std::fprintf(file, "f %llu/%llu/%llu %llu/%llu/%llu %llu/%llu/%llu\n", a, a, a, c, c, c, b, b, b);
+            std::fprintf(file, "f %llu/%llu/%llu %llu/%llu/%llu %llu/%llu/%llu\n", b, b, b, c, c, c, d, d, d);
+        }
+    }
+
+    bool failed = std::ferror(file) != 0;
+
+    if (std::fclose(file) != 0 || failed)
+        return false;
+
+    writtenTriangleCount = 2 * rows * columns;
+
+    return true;
+}
+
+// Write square 8-bit image of gradients and noise in binary Netpbm file format (PGM or PPM)
+// Rows are generated and written one at a time, so images larger than memory can be written
+bool writeGradientImage(const std::string & filename, size_t size, size_t channelCount) {
+    std::FILE * file = std::fopen(filename.c_str(), "wb");
+
+    if (file == nullptr)
+        return false;
+
+    std::fprintf(file, "P%d\n%llu %llu\n255\n", channelCount == 1 ? 5 : 6, (unsigned long long)size, (unsigned long long)size);
+
+    std::vector<unsigned char> row(size * channelCount);
+
+    for (size_t y = 0; y < size; y++) {
+        for (size_t x = 0; x < size; x++) {
+            unsigned char * pixel = &row[x * channelCount];
+            unsigned char noise = hashByte((uint64_t)y * size + x);
+
+            if (channelCount == 1)
+                pixel[0] = (unsigned char)std::min(x * 255 / size + noise / 8, (size_t)255);
+            else {
+                pixel[0] = (unsigned char)(x * 255 / size);
+                pixel[1] = (unsigned char)(y * 255 / size);
+                pixel[2] = noise;
+            }
+        }
+
+        if (std::fwrite(row.data(), 1, row.size(), file) != row.size())
+            break;
+    }
+
+    bool failed = std::ferror(file) != 0;
+
+    return std::fclose(file) == 0 && !failed;
+}
+
+}
+
+int main(int argc, char ** argv) {
+    // Parse command line options
+    // input_generator [options] <output.obj|output.ppm|output.pgm>
+    // --triangles <count>: minimum number of triangles of the generated mesh
+    // --size <pixels>: width and height of the generated image
+    uint64_t triangleCount = 10000;
+    size_t imageSize = 256;
+
+    std::string outputFilename;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+
+        if (option == "--triangles" && i + 1 < argc && std::atoll(argv[i + 1]) > 0)
+            triangleCount = (uint64_t)std::atoll(argv[++i]);
+        else if (option == "--size" && i + 1 < argc && std::atoll(argv[i + 1]) > 0)
+            imageSize = (size_t)std::atoll(argv[++i]);
+        else if (option.compare(0, 2, "--") != 0 && outputFilename.empty())
+            outputFilename = option;
+        else {
+            std::cout << "Unknown option " << option << "." << std::endl;
+            return -1;
+        }
+    }
+
+    std::string extension = getExtension(outputFilename);
+
+    if (extension != "obj" && extension != "ppm" && extension != "pgm") {
+        std::cout << "Usage: input_generator [--triangles <count>] [--size <pixels>] "
+            << "<output.obj|output.ppm|output.pgm>" << std::endl;
+        return -1;
+    }
+
+    // Generate mesh or image from the output file format
+    if (extension == "obj") {
+        uint64_t writtenTriangleCount = 0;
+
+        if (!writeHeightField(outputFilename, triangleCount, writtenTriangleCount)) {
+            std::cout << "Cannot write " << outputFilename << "." << std::endl;
+            return -1;
+        }
+
+        std::cout << "Wrote " << writtenTriangleCount << " triangles to " << outputFilename << "." << std::endl;
+    }
+    else {
+        if (!writeGradientImage(outputFilename, imageSize, extension == "pgm" ? 1 : 3)) {
+            std::cout << "Cannot write " << outputFilename << "." << std::endl;
+            return -1;
+        }
+
+        std::cout << "Wrote " << imageSize << "x" << imageSize << " pixels to " << outputFilename << "." << std::endl;
+    }
+
+    return 0;
+}
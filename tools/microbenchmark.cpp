@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "obj.hpp"
+#include "mesh.hpp"
+#include "quantization.hpp"
+#include "image.hpp"
+#include "virtual_texture.hpp"
+#include "file.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+namespace {
+
+// Timings and sizes of a benchmark over its iterations, times are in milliseconds
+// Bytes are the input bytes processed by a single iteration, counts are zero when not applicable
+// The peak resident size covers the benchmark and the data kept from previous benchmarks
+struct MicrobenchmarkResult {
+    std::string name;
+    std::string filename;
+    uint64_t size;
+    uint64_t triangleCount;
+    uint64_t pixelCount;
+    std::vector<double> times;
+    uint64_t peakResidentSize;
+};
+
+// Get lowercase extension of filename without the dot
+std::string getExtension(const std::string & filename) {
+    size_t extension = filename.find_last_of('.');
+    size_t directory = filename.find_last_of("/\\");
+
+    if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+        return std::string();
+
+    std::string result = filename.substr(extension + 1);
+
+    for (size_t i = 0; i < result.size(); i++)
+        result[i] = (char)std::tolower((unsigned char)result[i]);
+
+    return result;
+}
+
+// Reset peak resident size to the current resident size
+// Only Linux can reset it, elsewhere peaks are measured from the start of the process
+bool resetPeakResidentSize() {
+#ifdef __linux__
+    std::ofstream file("/proc/self/clear_refs");
+    file << "5";
+
+    return file.good();
+#else
+    return false;
+#endif
+}
+
+// Get peak resident set size of the process in bytes, zero when unknown
+uint64_t getPeakResidentSize() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return (uint64_t)counters.PeakWorkingSetSize;
+#else
+#ifdef __linux__
+    // The high water mark follows resets, unlike the maximum reported by getrusage
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return (uint64_t)std::atoll(line.c_str() + 6) << 10;
+    }
+#endif
+
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss << 10;
+#endif
+#endif
+}
+
+// Run task for iterations, measuring each iteration and the peak resident size
+void runMicrobenchmark(size_t iterationCount, const std::function<void()> & task, MicrobenchmarkResult & result) {
+    resetPeakResidentSize();
+
+    result.times.clear();
+
+    for (size_t i = 0; i < iterationCount; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        task();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        result.times.push_back(elapsed.count());
+    }
+
+    result.peakResidentSize = getPeakResidentSize();
+}
+
+std::string escapeJson(const std::string & text) {
+    std::string result;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\')
+            result += '\\';
+
+        result += text[i];
+    }
+
+    return result;
+}
+
+// Print result and append it as a single line of JSON to the report stream
+// Throughputs are computed from the median time
+void reportMicrobenchmark(const MicrobenchmarkResult & result, std::ostream * report) {
+    std::vector<double> times = result.times;
+    std::sort(times.begin(), times.end());
+
+    double minTime = times.front();
+    double medianTime = times[times.size() / 2];
+    double seconds = medianTime / 1000.0;
+
+    double mebibytesPerSecond = seconds > 0.0 ? result.size / seconds / (1 << 20) : 0.0;
+    double trianglesPerSecond = seconds > 0.0 ? result.triangleCount / seconds : 0.0;
+    double pixelsPerSecond = seconds > 0.0 ? result.pixelCount / seconds : 0.0;
+
+    std::cout << result.name << ": median " << medianTime << " ms, min " << minTime << " ms, "
+        << mebibytesPerSecond << " MiB/s";
+
+    if (result.triangleCount > 0)
+        std::cout << ", " << trianglesPerSecond / 1e6 << " M triangles/s";
+
+    if (result.pixelCount > 0)
+        std::cout << ", " << pixelsPerSecond / 1e6 << " M pixels/s";
+
+    std::cout << ", peak RSS " << (result.peakResidentSize >> 20) << " MiB." << std::endl;
+
+    if (report == nullptr)
+        return;
+
+    *report << "{ \"benchmark\": \"" << result.name << "\", "
+        << "\"input\": \"" << escapeJson(result.filename) << "\", "
+        << "\"time\": " << (long long)std::time(nullptr) << ", "
+        << "\"threads\": " << getThreadCount() << ", "
+        << "\"iterations\": " << result.times.size() << ", "
+        << "\"bytes\": " << result.size << ", "
+        << "\"triangles\": " << result.triangleCount << ", "
+        << "\"pixels\": " << result.pixelCount << ", "
+        << "\"minMilliseconds\": " << minTime << ", "
+        << "\"medianMilliseconds\": " << medianTime << ", "
+        << "\"mebibytesPerSecond\": " << mebibytesPerSecond << ", "
+        << "\"trianglesPerSecond\": " << trianglesPerSecond << ", "
+        << "\"pixelsPerSecond\": " << pixelsPerSecond << ", "
+        << "\"peakResidentBytes\": " << result.peakResidentSize << " }" << std::endl;
+}
+
+// Benchmark Wavefront OBJ parsing, then vertex building and quantization of the parsed mesh
+bool benchmarkMesh(const std::string & filename, size_t iterationCount, std::ostream * report) {
+    uint64_t fileSize;
+    int64_t modificationTime;
+
+    if (!getFileStatus(filename, fileSize, modificationTime))
+        return false;
+
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> textureCoordinates;
+    std::vector<uint32_t> positionIndices, normalIndices, textureCoordinateIndices;
+
+    bool read = true;
+
+    MicrobenchmarkResult result;
+    result.name = "readTriangleMesh";
+    result.filename = filename;
+    result.size = fileSize;
+    result.pixelCount = 0;
+
+    runMicrobenchmark(iterationCount, [&]() {
+        read = readTriangleMesh(
+            filename,
+            positions,
+            normals,
+            textureCoordinates,
+            positionIndices,
+            normalIndices,
+            textureCoordinateIndices) && read;
+    }, result);
+
+    if (!read)
+        return false;
+
+    result.triangleCount = positionIndices.size() / 3;
+    reportMicrobenchmark(result, report);
+
+    // Merge corners in unique vertices as done before upload
+    TriangleMesh mesh;
+
+    result.name = "buildTriangleMesh";
+    result.size = positions.size() * sizeof(glm::vec3)
+        + normals.size() * sizeof(glm::vec3)
+        + textureCoordinates.size() * sizeof(glm::vec2)
+        + (positionIndices.size() + normalIndices.size() + textureCoordinateIndices.size()) * sizeof(uint32_t);
+
+    runMicrobenchmark(iterationCount, [&]() {
+        buildTriangleMesh(
+            positions,
+            normals,
+            textureCoordinates,
+            positionIndices,
+            normalIndices,
+            textureCoordinateIndices,
+            mesh);
+    }, result);
+
+    reportMicrobenchmark(result, report);
+
+    // Quantize vertices in the compressed vertex format
+    BoundingBox bounds = computeBoundingBox(mesh.vertices.data(), mesh.vertices.size());
+
+    std::vector<QuantizedVertex> quantizedVertices;
+    glm::mat4 dequantization;
+    QuantizationError error;
+
+    result.name = "quantizeVertices";
+    result.size = mesh.vertices.size() * sizeof(Vertex);
+
+    runMicrobenchmark(iterationCount, [&]() {
+        quantizeVertices(mesh.vertices.data(), mesh.vertices.size(), bounds, quantizedVertices, dequantization, error);
+    }, result);
+
+    reportMicrobenchmark(result, report);
+
+    return true;
+}
+
+// Benchmark Netpbm image reading, then page file building of binary images
+bool benchmarkImage(const std::string & filename, size_t iterationCount, std::ostream * report) {
+    uint64_t fileSize;
+    int64_t modificationTime;
+
+    if (!getFileStatus(filename, fileSize, modificationTime))
+        return false;
+
+    Image image;
+    bool read = true;
+
+    MicrobenchmarkResult result;
+    result.name = "readImage";
+    result.filename = filename;
+    result.size = fileSize;
+    result.triangleCount = 0;
+
+    runMicrobenchmark(iterationCount, [&]() {
+        read = readImage(filename, image) && read;
+    }, result);
+
+    if (!read)
+        return false;
+
+    result.pixelCount = image.width * image.height;
+    reportMicrobenchmark(result, report);
+
+    // Release image, so the peak resident size shows the memory used by building the page file
+    Image().pixels.swap(image.pixels);
+
+    MappedImage mappedImage;
+
+    if (!openMappedImage(filename, mappedImage))
+        return true;
+
+    closeMappedImage(mappedImage);
+
+    std::string pageFilename = getVirtualTextureFilename(filename);
+    bool built = true;
+
+    result.name = "buildVirtualTextureFile";
+
+    runMicrobenchmark(iterationCount, [&]() {
+        built = buildVirtualTextureFile(filename, pageFilename) && built;
+    }, result);
+
+    if (!built)
+        return false;
+
+    reportMicrobenchmark(result, report);
+
+    return true;
+}
+
+// Benchmark text file reading, as done for shader sources before compilation
+bool benchmarkTextFile(const std::string & filename, size_t iterationCount, std::ostream * report) {
+    std::string text;
+    bool read = true;
+
+    MicrobenchmarkResult result;
+    result.name = "readTextFile";
+    result.filename = filename;
+    result.triangleCount = 0;
+    result.pixelCount = 0;
+
+    runMicrobenchmark(iterationCount, [&]() {
+        read = readTextFile(filename, text) && read;
+    }, result);
+
+    if (!read)
+        return false;
+
+    result.size = text.size();
+    reportMicrobenchmark(result, report);
+
+    return true;
+}
+
+}
+
+int main(int argc, char ** argv) {
+    // Parse command line options
+    // microbenchmark [options] <input>...
+    // Wavefront OBJ files benchmark readTriangleMesh, buildTriangleMesh and quantizeVertices,
+    // Netpbm files benchmark readImage and buildVirtualTextureFile, other files benchmark readTextFile
+    // --iterations <count>: number of measured runs of each benchmark
+    // --report <file>: append results to file, one JSON object per line
+    // --trace <file>: write profiler zones in Chrome trace event format at exit
+    size_t iterationCount = 5;
+    std::string reportFilename;
+    std::string traceFilename;
+
+    std::vector<std::string> inputFilenames;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+
+        if (option == "--iterations" && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            iterationCount = (size_t)std::atoi(argv[++i]);
+        else if (option == "--report" && i + 1 < argc)
+            reportFilename = argv[++i];
+        else if (option == "--trace" && i + 1 < argc)
+            traceFilename = argv[++i];
+        else if (option.compare(0, 2, "--") != 0)
+            inputFilenames.push_back(option);
+        else {
+            std::cout << "Unknown option " << option << "." << std::endl;
+            return -1;
+        }
+    }
+
+    if (inputFilenames.empty()) {
+        std::cout << "Usage: microbenchmark [--iterations <count>] [--report <file>] "
+            << "[--trace <file>] <input>..." << std::endl;
+        return -1;
+    }
+
+    std::ofstream reportFile;
+
+    if (!reportFilename.empty()) {
+        reportFile.open(reportFilename, std::ofstream::out | std::ofstream::app);
+
+        if (!reportFile.is_open()) {
+            std::cout << "Cannot open report file " << reportFilename << "." << std::endl;
+            return -1;
+        }
+    }
+
+    std::ostream * report = reportFile.is_open() ? &reportFile : nullptr;
+
+    if (!resetPeakResidentSize())
+        std::cout << "Peak RSS cannot be reset, peaks are measured from the start of the process." << std::endl;
+
+    std::cout << "Running " << iterationCount << " iterations on " << getThreadCount() << " threads." << std::endl;
+
+    // Select benchmarks by input file format
+    int status = 0;
+
+    for (size_t i = 0; i < inputFilenames.size(); i++) {
+        const std::string & filename = inputFilenames[i];
+        std::string extension = getExtension(filename);
+
+        std::cout << "Input " << filename << ":" << std::endl;
+
+        bool benchmarked;
+
+        if (extension == "obj")
+            benchmarked = benchmarkMesh(filename, iterationCount, report);
+        else if (extension == "ppm" || extension == "pgm")
+            benchmarked = benchmarkImage(filename, iterationCount, report);
+        else
+            benchmarked = benchmarkTextFile(filename, iterationCount, report);
+
+        if (!benchmarked) {
+            std::cout << "Cannot read " << filename << "." << std::endl;
+            status = -1;
+        }
+    }
+
+    if (!traceFilename.empty() && !writeProfileTrace(traceFilename))
+        std::cout << "Cannot write trace file " << traceFilename << "." << std::endl;
+
+    return status;
+}
@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "out_of_core.hpp"
+#include "profiler.hpp"
+
+int main(int argc, char ** argv) {
+    // Parse command line options
+    // obj_converter [options] <input.obj> [output.cgchunks]
+    // --memory <MiB>: memory budget of the conversion
+    // --chunk-triangles <count>: maximum number of triangles per chunk
+    // --trace <file>: write profiler zones in Chrome trace event format at exit
+    ConverterSettings settings;
+    settings.memoryBudget = DEFAULT_CONVERTER_MEMORY_BUDGET;
+    settings.chunkTriangleCount = DEFAULT_CHUNK_TRIANGLE_COUNT;
+
+    std::string inputFilename;
+    std::string outputFilename;
+    std::string traceFilename;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+
+        if (option == "--memory" && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            settings.memoryBudget = (size_t)std::atoi(argv[++i]) << 20;
+        else if (option == "--chunk-triangles" && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            settings.chunkTriangleCount = (size_t)std::atoi(argv[++i]);
+        else if (option == "--trace" && i + 1 < argc)
+            traceFilename = argv[++i];
+        else if (option.compare(0, 2, "--") != 0 && inputFilename.empty())
+            inputFilename = option;
+        else if (option.compare(0, 2, "--") != 0 && outputFilename.empty())
+            outputFilename = option;
+        else {
+            std::cout << "Unknown option " << option << "." << std::endl;
+            return -1;
+        }
+    }
+
+    if (inputFilename.empty()) {
+        std::cout << "Usage: obj_converter [--memory <MiB>] [--chunk-triangles <count>] "
+            << "[--trace <file>] <input.obj> [output.cgchunks]" << std::endl;
+        return -1;
+    }
+
+    // Replace OBJ extension by the chunked mesh extension
+    if (outputFilename.empty()) {
+        size_t extension = inputFilename.find_last_of('.');
+        size_t directory = inputFilename.find_last_of("/\\");
+
+        if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+            extension = inputFilename.size();
+
+        outputFilename = inputFilename.substr(0, extension) + ".cgchunks";
+    }
+
+    // Convert OBJ file under the memory budget
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    ConverterStatistics statistics;
+
+    if (!convertObjFile(inputFilename, outputFilename, settings, statistics)) {
+        std::cout << "Cannot convert " << inputFilename << "." << std::endl;
+        return -1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << "Converted " << inputFilename << " to " << outputFilename << "." << std::endl;
+    std::cout << "Positions: " << statistics.positionCount
+        << ", normals: " << statistics.normalCount
+        << ", texture coordinates: " << statistics.textureCoordinateCount << "." << std::endl;
+    std::cout << "Triangles: " << statistics.triangleCount
+        << ", chunks: " << statistics.chunkCount << "." << std::endl;
+    std::cout << "Spilled " << (statistics.spilledSize >> 20) << " MiB through at most "
+        << statistics.maxSpillFileCount << " spill files." << std::endl;
+    std::cout << "Read " << (statistics.inputSize >> 20) << " MiB in " << seconds << " s ("
+        << (seconds > 0.0 ? statistics.inputSize / seconds / (1 << 20) : 0.0) << " MiB/s)." << std::endl;
+
+    if (!traceFilename.empty() && !writeProfileTrace(traceFilename))
+        std::cout << "Cannot write trace file " << traceFilename << "." << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Generate inputs of increasing size and append microbenchmark results to a report,
+# one process per input so peak memory is measured per input on every platform
+# Usage: tools/run_microbenchmarks.sh [build directory] [input directory] [report file]
+# MAX_TRIANGLES and MAX_IMAGE_SIZE limit the largest inputs, the largest mesh takes
+# about 5 GB on disk and 13 GB of memory to read, ITERATIONS sets the measured runs
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=${1:-"$ROOT/build"}
+INPUTS=${2:-"$ROOT/build/inputs"}
+REPORT=${3:-"$ROOT/build/microbenchmarks.jsonl"}
+
+MAX_TRIANGLES=${MAX_TRIANGLES:-50000000}
+MAX_IMAGE_SIZE=${MAX_IMAGE_SIZE:-16384}
+ITERATIONS=${ITERATIONS:-5}
+
+mkdir -p "$INPUTS"
+
+for triangles in 10000 100000 1000000 10000000 50000000; do
+    if [ "$triangles" -le "$MAX_TRIANGLES" ]; then
+        input="$INPUTS/mesh_$triangles.obj"
+        [ -f "$input" ] || "$BUILD/input_generator" --triangles "$triangles" "$input"
+        "$BUILD/microbenchmark" --iterations "$ITERATIONS" --report "$REPORT" "$input"
+    fi
+done
+
+for size in 256 1024 4096 16384; do
+    if [ "$size" -le "$MAX_IMAGE_SIZE" ]; then
+        input="$INPUTS/image_$size.ppm"
+        [ -f "$input" ] || "$BUILD/input_generator" --size "$size" "$input"
+        "$BUILD/microbenchmark" --iterations "$ITERATIONS" --report "$REPORT" "$input"
+    fi
+done
+
+"$BUILD/microbenchmark" --iterations "$ITERATIONS" --report "$REPORT" "$ROOT"/res/shaders/*.vert "$ROOT"/res/shaders/*.frag